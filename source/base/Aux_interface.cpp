@@ -2,6 +2,9 @@
 #include "Aux_interface.h"
 
 #include "SE_EV_factory_charge_profile.h"
+#include "factory_registry.h"                   // factory_registry
+
+#include <stdexcept>                            // invalid_argument
 
 //#############################################################################
 //                        get_pevType_batterySize_map
@@ -41,28 +44,20 @@ std::vector<pev_batterySize_info> get_pevType_batterySize_map()
 //#############################################################################
 
 CP_interface::CP_interface( const std::string& input_path )
-    : loader{ load_EV_EVSE_inventory{ input_path } },
-    inventory{ this->loader.get_EV_EVSE_inventory() },
-    CP_library{ load_CP_library( inventory ) }
+    : loader{ factory_registry::get_inventory( input_path ) },
+    inventory{ this->loader->get_EV_EVSE_inventory() },
+    CP_library{ factory_registry::get_charge_profile_library( input_path, true ) }
 {
 }
 
 CP_interface::CP_interface( const std::string& input_path,
                             std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> >& validation_data )
-    : loader{ load_EV_EVSE_inventory{ input_path } },
-    inventory{ this->loader.get_EV_EVSE_inventory() },
-    CP_library{ load_CP_library(inventory, validation_data) }
+    : loader{ factory_registry::get_inventory( input_path ) },
+    inventory{ this->loader->get_EV_EVSE_inventory() },
+    CP_library{ std::make_shared<const pev_charge_profile_library>( load_CP_library(inventory, validation_data) ) }
 {
 }
 
-pev_charge_profile_library CP_interface::load_CP_library( const EV_EVSE_inventory& inventory ) const
-{
-    const bool create_charge_profile_library = true;
-    const bool save_validation_data = false;
-    std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > validation_data;
-    return factory_charge_profile_library::get_charge_profile_library( inventory, save_validation_data, create_charge_profile_library, validation_data );
-}
-
 pev_charge_profile_library CP_interface::load_CP_library( const EV_EVSE_inventory& inventory,
                                                           std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> >& validation_data ) const
 {
@@ -73,7 +68,7 @@ pev_charge_profile_library CP_interface::load_CP_library( const EV_EVSE_inventor
 
 double CP_interface::get_size_of_CP_library_MB()
 {
-    return (double)sizeof(this->CP_library)/1000000.0;
+    return (double)sizeof(*this->CP_library)/1000000.0;
 }
 
 
@@ -86,7 +81,7 @@ std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_d
 charge_event_P3kW_limits CP_interface::get_charge_event_P3kW_limits( const EV_type pev_type,
                                                                      const EVSE_type SE_type )
 {
-    const pev_charge_profile& charge_profile = this->CP_library.get_charge_profile(pev_type, SE_type);
+    const pev_charge_profile& charge_profile = this->CP_library->get_charge_profile(pev_type, SE_type);
     return charge_profile.get_charge_event_P3kW_limits();
 }
 
@@ -94,7 +89,7 @@ charge_event_P3kW_limits CP_interface::get_charge_event_P3kW_limits( const EV_ty
 std::vector<double> CP_interface::get_P3kW_setpoints_of_charge_profiles( const EV_type pev_type,
                                                                          const EVSE_type SE_type )
 {
-    const pev_charge_profile& charge_profile = this->CP_library.get_charge_profile(pev_type, SE_type);
+    const pev_charge_profile& charge_profile = this->CP_library->get_charge_profile(pev_type, SE_type);
     return charge_profile.get_P3kW_setpoints_of_charge_profiles();
 }
 
@@ -105,18 +100,36 @@ pev_charge_profile_result CP_interface::find_result_given_startSOC_and_endSOC( c
                                                                                const double startSOC,
                                                                                const double endSOC )
 {
-    const pev_charge_profile& charge_profile = this->CP_library.get_charge_profile(pev_type, SE_type);
+    const pev_charge_profile& charge_profile = this->CP_library->get_charge_profile(pev_type, SE_type);
     return charge_profile.find_result_given_startSOC_and_endSOC( setpoint_P3kW, startSOC, endSOC );
 }
 
 
+std::vector<pev_charge_profile_result> CP_interface::find_results_given_startSOC_and_endSOC( const EV_type pev_type,
+                                                                                             const EVSE_type SE_type,
+                                                                                             const std::vector<double>& setpoint_P3kW,
+                                                                                             const std::vector<double>& startSOC,
+                                                                                             const std::vector<double>& endSOC )
+{
+    if( setpoint_P3kW.size() != startSOC.size() || startSOC.size() != endSOC.size() )
+        throw std::invalid_argument("CALDERA ERROR: find_results_given_startSOC_and_endSOC needs setpoint_P3kW, startSOC and endSOC of the same length.");
+    
+    const pev_charge_profile& charge_profile = this->CP_library->get_charge_profile(pev_type, SE_type);
+    
+    std::vector<pev_charge_profile_result> results;
+    charge_profile.find_results_given_startSOC_and_endSOC( setpoint_P3kW, startSOC, endSOC, results );
+    
+    return results;
+}
+
+
 pev_charge_profile_result CP_interface::find_result_given_startSOC_and_chargeTime( const EV_type pev_type,
                                                                                    const EVSE_type SE_type,
                                                                                    const double setpoint_P3kW,
                                                                                    const double startSOC,
                                                                                    const double charge_time_hrs )
 {
-    const pev_charge_profile& charge_profile = this->CP_library.get_charge_profile(pev_type, SE_type);
+    const pev_charge_profile& charge_profile = this->CP_library->get_charge_profile(pev_type, SE_type);
     return charge_profile.find_result_given_startSOC_and_chargeTime( setpoint_P3kW, startSOC, charge_time_hrs );
 }
 
@@ -127,7 +140,7 @@ std::vector<pev_charge_profile_result> CP_interface::find_chargeProfile_given_st
                                                                                                     const double startSOC,
                                                                                                     const std::vector<double> endSOC )
 {
-    const pev_charge_profile& charge_profile = this->CP_library.get_charge_profile( pev_type, SE_type );
+    const pev_charge_profile& charge_profile = this->CP_library->get_charge_profile( pev_type, SE_type );
     
     std::vector<pev_charge_profile_result> charge_profile_res;
     charge_profile.find_chargeProfile_given_startSOC_and_endSOCs( setpoint_P3kW, startSOC, endSOC, charge_profile_res);
@@ -142,7 +155,7 @@ std::vector<pev_charge_profile_result> CP_interface::find_chargeProfile_given_st
                                                                                                         const double startSOC,
                                                                                                         const std::vector<double> charge_time_hrs )
 {
-    const pev_charge_profile& charge_profile = this->CP_library.get_charge_profile( pev_type, SE_type );
+    const pev_charge_profile& charge_profile = this->CP_library->get_charge_profile( pev_type, SE_type );
         
     std::vector<pev_charge_profile_result> charge_profile_res;
     charge_profile.find_chargeProfile_given_startSOC_and_chargeTimes( setpoint_P3kW, startSOC, charge_time_hrs, charge_profile_res);
@@ -7,6 +7,8 @@
 #include "helper.h"                                 // get_base_load_forecast
 #include "load_EV_EVSE_inventory.h"
 
+#include <memory>                                   // shared_ptr
+
 //std::vector<pev_batterySize_info> get_pevType_batterySize_map();
 
 #include "factory_charging_transitions.h"
@@ -15,9 +17,10 @@ class CP_interface
 {
 private:
 
-    const load_EV_EVSE_inventory loader;
+    // Shared through factory_registry with other interfaces built from the same inputs.
+    std::shared_ptr<const load_EV_EVSE_inventory> loader;
     const EV_EVSE_inventory& inventory;
-    pev_charge_profile_library CP_library;    
+    std::shared_ptr<const pev_charge_profile_library> CP_library;
     std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > CP_validation_data;
 
 public:
@@ -43,6 +46,14 @@ public:
                                                                      const double startSOC,
                                                                      const double endSOC );
 
+    // find_result_given_startSOC_and_endSOC for every (setpoint_P3kW[i], startSOC[i], endSOC[i]),
+    // evaluated in batches, one per setpoint profile.
+    std::vector<pev_charge_profile_result> find_results_given_startSOC_and_endSOC( const EV_type pev_type,
+                                                                                   const EVSE_type SE_type,
+                                                                                   const std::vector<double>& setpoint_P3kW,
+                                                                                   const std::vector<double>& startSOC,
+                                                                                   const std::vector<double>& endSOC );
+
     pev_charge_profile_result find_result_given_startSOC_and_chargeTime( const EV_type pev_type,
                                                                          const EVSE_type SE_type,
                                                                          const double setpoint_P3kW,
@@ -21,6 +21,7 @@ PYBIND11_MODULE(Caldera_ICM_Aux, m)
         .def("get_charge_event_P3kW_limits", &CP_interface::get_charge_event_P3kW_limits)
         .def("get_P3kW_setpoints_of_charge_profiles", &CP_interface::get_P3kW_setpoints_of_charge_profiles)
         .def("find_result_given_startSOC_and_endSOC", &CP_interface::find_result_given_startSOC_and_endSOC)
+        .def("find_results_given_startSOC_and_endSOC", &CP_interface::find_results_given_startSOC_and_endSOC)
         .def("find_result_given_startSOC_and_chargeTime", &CP_interface::find_result_given_startSOC_and_chargeTime)
         .def("find_chargeProfile_given_startSOC_and_endSOCs", &CP_interface::find_chargeProfile_given_startSOC_and_endSOCs)
         .def("find_chargeProfile_given_startSOC_and_chargeTimes", &CP_interface::find_chargeProfile_given_startSOC_and_chargeTimes)
@@ -5,12 +5,21 @@
 #include "SE_EV_factory_charge_profile.h"
 
 #include "load_EV_EVSE_inventory.h"
+#include "factory_registry.h"                  // factory_registry
 
 #include <iostream>
 #include <string>
 #include <unordered_set>
+#include <algorithm>                          // stable_sort
+#include <stdexcept>                          // invalid_argument
+#include <limits>                             // numeric_limits
 
-const factory_EV_charge_model interface_to_SE_groups::load_factory_EV_charge_model(
+#ifdef _OPENMP
+#include <omp.h>                              // omp_get_max_threads
+#endif
+
+std::shared_ptr<const factory_EV_charge_model> interface_to_SE_groups::load_factory_EV_charge_model(
+    const std::string& input_path,
     const interface_to_SE_groups_inputs& inputs
 )
 {
@@ -20,7 +29,7 @@ const factory_EV_charge_model interface_to_SE_groups::load_factory_EV_charge_mod
         ramping_by_pevType_seType_map[std::make_pair(X.pev_type, X.SE_type)] = X.pev_charge_ramping_obj;
     }
     
-    return factory_EV_charge_model{ this->inventory, inputs.ramping_by_pevType_only, ramping_by_pevType_seType_map, false };
+    return factory_registry::get_EV_charge_model_factory( input_path, inputs.ramping_by_pevType_only, ramping_by_pevType_seType_map, false );
 }
 
 interface_to_SE_groups::interface_to_SE_groups( 
@@ -28,13 +37,21 @@ interface_to_SE_groups::interface_to_SE_groups(
     const interface_to_SE_groups_inputs& inputs 
 )
     : 
-    loader{ input_path },
-    inventory{ this->loader.get_EV_EVSE_inventory() },
-    EV_model_factory{ this->load_factory_EV_charge_model(inputs) },
-    ac_to_dc_converter_factory{ this->inventory },
-    charge_profile_library{ load_charge_profile_library(inputs) },
-    baseLD_forecaster{ inputs.data_start_unix_time, inputs.data_timestep_sec, inputs.actual_load_akW, inputs.forecast_load_akW, inputs.adjustment_interval_hrs },
-    manage_L2_control{ inputs.L2_parameters }
+    loader{ factory_registry::get_inventory(input_path) },
+    inventory{ this->loader->get_EV_EVSE_inventory() },
+    registered_num_large_nodes{ 0 },
+    wake_up_window_num_steps{ 1 },
+    active_set_has_changed{ false },
+    charge_event_source{ nullptr },
+    charge_event_source_lookahead_sec{ 0 },
+    EV_model_factory{ this->load_factory_EV_charge_model(input_path, inputs) },
+    ac_to_dc_converter_factory{ factory_registry::get_ac_to_dc_converter_factory(input_path) },
+    charge_profile_library{ this->load_charge_profile_library(input_path, inputs) },
+    baseLD_forecaster{ std::make_shared<const get_base_load_forecast>(inputs.data_start_unix_time, inputs.data_timestep_sec, inputs.actual_load_akW, inputs.forecast_load_akW, inputs.adjustment_interval_hrs) },
+    manage_L2_control{ inputs.L2_parameters },
+    trial_step_is_open{ false },
+    trial_prev_unix_time{ 0 },
+    trial_now_unix_time{ 0 }
 {
     //==========================================
     //          Initialize infrastructure
@@ -45,12 +62,121 @@ interface_to_SE_groups::interface_to_SE_groups(
 
     for (const SE_group_configuration& SE_group_conf : inputs.infrastructure_topology)
     {
-        supply_equipment_group Y(SE_group_conf, SE_factory, this->EV_model_factory, this->ac_to_dc_converter_factory, this->charge_profile_library, this->baseLD_forecaster, manage_L2_control_);
+        supply_equipment_group Y(SE_group_conf, SE_factory, *this->EV_model_factory, *this->ac_to_dc_converter_factory, *this->charge_profile_library, *this->baseLD_forecaster, manage_L2_control_);
         this->SE_group_objs.push_back(Y);
     }
 
+    this->index_SE_objects();
+
+    //=========================================================================
+    //         set_ensure_pev_charge_needs_met_for_ext_control_strategy
+    //=========================================================================
+
+    for (supply_equipment* SE_ptr : this->SE_ptr_vector)
+    {
+        SE_ptr->set_ensure_pev_charge_needs_met_for_ext_control_strategy(inputs.ensure_pev_charge_needs_met);
+    }
+
+}
+
+
+interface_to_SE_groups::interface_to_SE_groups( const interface_to_SE_groups& obj )
+    :
+    loader{ obj.loader },
+    inventory{ obj.inventory },
+    SE_group_objs{ obj.SE_group_objs },
+    registered_num_large_nodes{ obj.registered_num_large_nodes },
+    wake_up_window_num_steps{ obj.wake_up_window_num_steps },
+    active_set_has_changed{ obj.active_set_has_changed },
+    charge_event_source{ nullptr },
+    charge_event_source_lookahead_sec{ obj.charge_event_source_lookahead_sec },
+    EV_model_factory{ obj.EV_model_factory },
+    ac_to_dc_converter_factory{ obj.ac_to_dc_converter_factory },
+    charge_profile_library{ obj.charge_profile_library },
+    baseLD_forecaster{ obj.baseLD_forecaster },
+    manage_L2_control{ obj.manage_L2_control },
+    trial_step_is_open{ false },
+    trial_prev_unix_time{ 0 },
+    trial_now_unix_time{ 0 }
+{
+    // The copied SEs still use the factories of obj, which are the shared ones, but
+    // their control strategies point at the manage_L2_control of obj.
+    this->index_SE_objects();
+    
+    std::unordered_map<const supply_equipment*, supply_equipment*> obj_SE_ptr_to_SE_ptr;
+    
+    for (int i = 0; i < (int)this->SE_ptr_vector.size(); i++)
+    {
+        this->SE_ptr_vector[i]->set_manage_L2_control(&this->manage_L2_control);
+        obj_SE_ptr_to_SE_ptr[obj.SE_ptr_vector[i]] = this->SE_ptr_vector[i];
+    }
+    
+    //---------------------------------
+    //  Registered grid nodes
+    //---------------------------------
+    
+    auto to_SE_ptrs = [&obj_SE_ptr_to_SE_ptr](const std::vector<supply_equipment*>& obj_SE_ptrs)
+    {
+        std::vector<supply_equipment*> SE_ptrs;
+        SE_ptrs.reserve(obj_SE_ptrs.size());
+        
+        for (supply_equipment* SE_ptr : obj_SE_ptrs)
+            SE_ptrs.push_back(obj_SE_ptr_to_SE_ptr.at(SE_ptr));
+        
+        return SE_ptrs;
+    };
+    
+    this->gridNodeId_to_node_index = obj.gridNodeId_to_node_index;
+    this->node_index_to_gridNodeId = obj.node_index_to_gridNodeId;
+    this->registered_node_sweep_order = obj.registered_node_sweep_order;
+    this->registered_node_power = obj.registered_node_power;
+    this->node_index_to_standby_power = obj.node_index_to_standby_power;
+    this->node_index_to_active_standby_power = obj.node_index_to_active_standby_power;
+    
+    for (const std::vector<supply_equipment*>& obj_SE_ptrs : obj.node_index_to_SE_ptrs)
+        this->node_index_to_SE_ptrs.push_back(to_SE_ptrs(obj_SE_ptrs));
+    
+    for (const std::vector<supply_equipment*>& obj_SE_ptrs : obj.node_index_to_active_SE_ptrs)
+        this->node_index_to_active_SE_ptrs.push_back(to_SE_ptrs(obj_SE_ptrs));
+    
+    for (std::vector<supply_equipment*>& active_SEs : this->node_index_to_active_SE_ptrs)
+        this->registered_node_SE_ptrs.push_back(&active_SEs);
+    
+    for (const std::pair<supply_equipment* const, int>& X : obj.registered_SE_ptr_to_node_index)
+        this->registered_SE_ptr_to_node_index[obj_SE_ptr_to_SE_ptr.at(X.first)] = X.second;
+    
+    for (supply_equipment* SE_ptr : obj.active_SE_ptrs)
+        this->active_SE_ptrs.insert(obj_SE_ptr_to_SE_ptr.at(SE_ptr));
+    
+    this->add_idle_registered_SEs_to_calendar();
+    
     //---------------------------------
+    //  Charge event file
+    //---------------------------------
+    
+    if (obj.charge_event_source != nullptr)
+    {
+        this->charge_event_source.reset(new load_charge_events(obj.charge_event_source->get_charge_events_file()));
+        this->charge_event_source->set_position(obj.charge_event_source->get_position());
+    }
+}
+
 
+std::unique_ptr<interface_to_SE_groups> interface_to_SE_groups::fork() const
+{
+    this->check_no_trial_step_is_open("fork");
+    
+    return std::unique_ptr<interface_to_SE_groups>(new interface_to_SE_groups(*this));
+}
+
+
+void interface_to_SE_groups::index_SE_objects()
+{
+    // register_grid_nodes keeps its own copy of the SEs of each grid node, which would
+    // miss SEs added afterwards.
+    if(!this->node_index_to_gridNodeId.empty())
+        throw std::invalid_argument("CALDERA ERROR: SEs can not be added after register_grid_nodes has been called.");
+    
     for (supply_equipment_group& SE_group : this->SE_group_objs)
     {
         SE_group_configuration SE_group_conf = SE_group.get_SE_group_configuration();
@@ -78,28 +204,35 @@ interface_to_SE_groups::interface_to_SE_groups(
             this->gridNodeId_to_SE_ptrs[SE_conf.grid_node_id].push_back(SE_ptr);
         }
     }
+}
 
-    //=========================================================================
-    //         set_ensure_pev_charge_needs_met_for_ext_control_strategy
-    //=========================================================================
-
-    for (supply_equipment* SE_ptr : this->SE_ptr_vector)
-    {
-        SE_ptr->set_ensure_pev_charge_needs_met_for_ext_control_strategy(inputs.ensure_pev_charge_needs_met);
-    }
-
+std::shared_ptr<const pev_charge_profile_library> interface_to_SE_groups::load_charge_profile_library(const std::string& input_path, const interface_to_SE_groups_inputs& inputs)
+{
+    return factory_registry::get_charge_profile_library( input_path, inputs.create_charge_profile_library, inputs.lazy_charge_profile_library, inputs.event_driven_charge_profile_library );
 }
 
-pev_charge_profile_library interface_to_SE_groups::load_charge_profile_library(const interface_to_SE_groups_inputs& inputs)
+
+void interface_to_SE_groups::build_charge_profiles( const std::vector<charge_event_data>& charge_events ) const
 {
-    std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > validation_data;
-    const bool save_validation_data = false;
-    return factory_charge_profile_library::get_charge_profile_library( this->inventory, save_validation_data, inputs.create_charge_profile_library, validation_data);
+    std::vector<pev_SE_pair> pev_SE_pairs;
+    pev_SE_pairs.reserve(charge_events.size());
+    
+    for( const charge_event_data& X : charge_events )
+    {
+        const std::map<SE_id_type, supply_equipment*>::const_iterator it = this->SEid_to_SE_ptr.find(X.SE_id);
+        
+        if(it != this->SEid_to_SE_ptr.end())
+            pev_SE_pairs.push_back(pev_SE_pair{ X.vehicle_type, it->second->get_SE_configuration().supply_equipment_type });
+    }
+    
+    this->charge_profile_library->build_charge_profiles(pev_SE_pairs);
 }
 
 
 void interface_to_SE_groups::stop_active_charge_events(std::vector<SupplyEquipmentId> SE_ids)
 {
+    this->check_no_trial_step_is_open("stop_active_charge_events");
+    
     try
     {
         for(SupplyEquipmentId x : SE_ids)
@@ -115,13 +248,23 @@ void interface_to_SE_groups::stop_active_charge_events(std::vector<SupplyEquipme
 
 void interface_to_SE_groups::add_charge_events( const std::vector<charge_event_data>& charge_events )
 {
+    this->check_no_trial_step_is_open("add_charge_events");
+    
     try
     {
         for( const charge_event_data& X : charge_events )
         {
-            this->SEid_to_SE_ptr.at(X.SE_id)->add_charge_event(X);
+            supply_equipment* SE_ptr = this->SEid_to_SE_ptr.at(X.SE_id);
+            SE_ptr->add_charge_event(X);
+            
+            if(!this->registered_SE_ptr_to_node_index.empty())
+                this->SEs_with_new_charge_events.push_back(SE_ptr);
         }
     }
+    catch(const std::invalid_argument& e)
+    {
+        std::cout << e.what() << "  See interface_to_SE_groups::add_charge_events." << std::endl;
+    }
     catch(...)
     {
         // Throw and Error or something ???
@@ -132,6 +275,8 @@ void interface_to_SE_groups::add_charge_events( const std::vector<charge_event_d
 
 void interface_to_SE_groups::add_charge_events_by_SE_group( const std::vector<SE_group_charge_event_data>& SE_group_charge_events )
 {    
+    this->check_no_trial_step_is_open("add_charge_events_by_SE_group");
+    
     for( const SE_group_charge_event_data& CE_data : SE_group_charge_events)
     {
         if( this->SE_group_Id_to_ptr.count(CE_data.SE_group_id) == 0 )
@@ -147,9 +292,17 @@ void interface_to_SE_groups::add_charge_events_by_SE_group( const std::vector<SE
             {
                 for( const charge_event_data& X : charge_events )
                 {
-                    this->SEid_to_SE_ptr.at(X.SE_id)->add_charge_event(X);
+                    supply_equipment* SE_ptr = this->SEid_to_SE_ptr.at(X.SE_id);
+                    SE_ptr->add_charge_event(X);
+                    
+                    if(!this->registered_SE_ptr_to_node_index.empty())
+                        this->SEs_with_new_charge_events.push_back(SE_ptr);
                 }
             }
+            catch(const std::invalid_argument& e)
+            {
+                std::cout << e.what() << "  See interface_to_SE_groups::add_charge_events_by_SE_group." << std::endl;
+            }
             catch(...)
             {
                 // Throw and Error or something ???
@@ -160,8 +313,56 @@ void interface_to_SE_groups::add_charge_events_by_SE_group( const std::vector<SE
 }
 
 
+charge_event_queue_memory_usage interface_to_SE_groups::get_charge_event_queue_memory_usage() const
+{
+    charge_event_queue_memory_usage return_val;
+    
+    for(const supply_equipment* SE_ptr : this->SE_ptr_vector)
+        SE_ptr->add_charge_event_queue_memory_usage(return_val);
+    
+    return return_val;
+}
+
+
+charge_model_allocation_counters interface_to_SE_groups::get_charge_model_allocation_counters() const
+{
+    charge_model_allocation_counters return_val;
+    return_val.EV_charge_models_allocated = factory_EV_charge_model::get_num_EV_charge_models_allocated();
+    return_val.EV_charge_models_reused = factory_EV_charge_model::get_num_EV_charge_models_reused();
+    return_val.ac_to_dc_converters_allocated = factory_ac_to_dc_converter::get_num_converters_allocated();
+    return_val.ac_to_dc_converters_reused = factory_ac_to_dc_converter::get_num_converters_reused();
+    
+    return return_val;
+}
+
+
+void interface_to_SE_groups::set_charge_event_source( const std::string& charge_events_file, const double lookahead_sec )
+{
+    if(lookahead_sec < 0)
+        throw std::invalid_argument("set_charge_event_source: lookahead_sec can not be negative.");
+    
+    this->charge_event_source.reset(new load_charge_events(charge_events_file));
+    this->charge_event_source_lookahead_sec = lookahead_sec;
+}
+
+
+void interface_to_SE_groups::add_charge_events_from_source( const double now_unix_time )
+{
+    if(this->charge_event_source == nullptr)
+        return;
+    
+    this->charge_event_source_batch.clear();
+    this->charge_event_source->read_until(now_unix_time + this->charge_event_source_lookahead_sec, this->charge_event_source_batch);
+    
+    if(!this->charge_event_source_batch.empty())
+        this->add_charge_events(this->charge_event_source_batch);
+}
+
+
 void interface_to_SE_groups::set_PQ_setpoints(double now_unix_time, std::vector<SE_setpoint> SE_setpoints)
 {
+    this->check_no_trial_step_is_open("set_PQ_setpoints");
+    
     control_strategy_enums Z;
     supply_equipment* SE_ptr;
     std::string NA_string = "NA";
@@ -440,101 +641,914 @@ std::vector<double> interface_to_SE_groups::get_SE_group_charge_profile_forecast
 }
 
 
+void interface_to_SE_groups::get_grid_node_sweep_order( const std::vector<const std::vector<supply_equipment*>*>& node_SE_ptrs,
+                                                        std::vector<int>& sweep_order,
+                                                        int& num_large_nodes )
+{
+    // Largest grid nodes first so the dynamic schedule finishes with the cheap ones.
+    // Grid nodes without SEs are left out of the sweep.
+    sweep_order.clear();
+    
+    for(int i = 0; i < (int)node_SE_ptrs.size(); i++)
+    {
+        if(!node_SE_ptrs[i]->empty())
+            sweep_order.push_back(i);
+    }
+    
+    std::stable_sort(sweep_order.begin(), sweep_order.end(), [&node_SE_ptrs](const int a, const int b)
+    {
+        return node_SE_ptrs[a]->size() > node_SE_ptrs[b]->size();
+    });
+    
+    size_t num_SEs = 0;
+    for(const int node_index : sweep_order)
+        num_SEs += node_SE_ptrs[node_index]->size();
+    
+#ifdef _OPENMP
+    const size_t num_SEs_per_thread = num_SEs / omp_get_max_threads();
+#else
+    const size_t num_SEs_per_thread = num_SEs;
+#endif
+    
+    num_large_nodes = 0;
+    while(num_large_nodes < (int)sweep_order.size() && node_SE_ptrs[sweep_order[num_large_nodes]]->size() > std::max<size_t>(num_SEs_per_thread, 1))
+        num_large_nodes++;
+}
+
+
+void interface_to_SE_groups::sweep_grid_nodes( const double prev_unix_time,
+                                               const double now_unix_time,
+                                               const std::vector<const std::vector<supply_equipment*>*>& node_SE_ptrs,
+                                               const std::vector<int>& sweep_order,
+                                               const int num_large_nodes,
+                                               const double* pu_Vrms,
+                                               ac_power_metrics* node_power )
+{
+    // NOTE: There may be multiple supply-equipments on a single grid-node-id.
+    // Every SE belongs to exactly one grid node and every grid node writes only to
+    // its own node_power entry, so no locking is needed between grid nodes.
+    
+    // As of 11/14/2024, the get_next function is threadsafe although it isn't const.
+    // All class members are local or const& except for manage_L2_control_strategy 
+    // which is protected by pragma omp critical. 
+    // Future version will need to ensure we maintain thread safety.
+    
+    for(int i = 0; i < (int)node_SE_ptrs.size(); i++)
+    {
+        node_power[i].P1_kW = 0;
+        node_power[i].P2_kW = 0;
+        node_power[i].P3_kW = 0;
+        node_power[i].Q3_kVAR = 0;
+    }
+    
+    //--------------------------------------------------
+    //  Large grid nodes: split the SEs across threads
+    //--------------------------------------------------
+    
+    for(int j = 0; j < num_large_nodes; j++)
+    {
+        const int node_index = sweep_order[j];
+        const std::vector<supply_equipment*>& SE_ptrs = *node_SE_ptrs[node_index];
+        const double pu_Vrms_ = pu_Vrms[node_index];
+        const int vec_size = SE_ptrs.size();
+        
+        // The SEs are summed in order afterwards, as for the small grid nodes, rather
+        // than by an OpenMP reduction whose order depends on the number of threads.
+        if((int)this->large_node_SE_power.size() < vec_size)
+            this->large_node_SE_power.resize(vec_size);
+        
+        ac_power_metrics* SE_power = this->large_node_SE_power.data();
+        
+        #pragma omp parallel for
+        for (int i = 0; i < vec_size; i++)
+        {
+            double soc;
+            SE_ptrs[i]->get_next(prev_unix_time, now_unix_time, pu_Vrms_, soc, SE_power[i]);
+        }
+        
+        double P1_kW = 0;
+        double P2_kW = 0;
+        double P3_kW = 0;
+        double Q3_kVAR = 0;
+        
+        for (int i = 0; i < vec_size; i++)
+        {
+            P1_kW += SE_power[i].P1_kW;
+            P2_kW += SE_power[i].P2_kW;
+            P3_kW += SE_power[i].P3_kW;
+            Q3_kVAR += SE_power[i].Q3_kVAR;
+        }
+        
+        node_power[node_index].P1_kW = P1_kW;
+        node_power[node_index].P2_kW = P2_kW;
+        node_power[node_index].P3_kW = P3_kW;
+        node_power[node_index].Q3_kVAR = Q3_kVAR;
+    }
+    
+    //--------------------------------------------------
+    //  Small grid nodes: hand out whole grid nodes
+    //--------------------------------------------------
+    // Idle threads grab the next chunk of grid nodes from the shared counter, so
+    // grid nodes with long charging calculations do not stall the other threads.
+    
+    const int sweep_size = sweep_order.size();
+    
+    #pragma omp parallel for schedule(dynamic, 8)
+    for (int j = num_large_nodes; j < sweep_size; j++)
+    {
+        const int node_index = sweep_order[j];
+        const std::vector<supply_equipment*>& SE_ptrs = *node_SE_ptrs[node_index];
+        const double pu_Vrms_ = pu_Vrms[node_index];
+        
+        ac_power_metrics ac_power_tmp;
+        double soc;
+        
+        double P1_kW = 0;
+        double P2_kW = 0;
+        double P3_kW = 0;
+        double Q3_kVAR = 0;
+        
+        for(supply_equipment* SE_ptr : SE_ptrs)
+        {
+            SE_ptr->get_next(prev_unix_time, now_unix_time, pu_Vrms_, soc, ac_power_tmp);
+            
+            P1_kW += ac_power_tmp.P1_kW;
+            P2_kW += ac_power_tmp.P2_kW;
+            P3_kW += ac_power_tmp.P3_kW;
+            Q3_kVAR += ac_power_tmp.Q3_kVAR;
+        }
+        
+        node_power[node_index].P1_kW = P1_kW;
+        node_power[node_index].P2_kW = P2_kW;
+        node_power[node_index].P3_kW = P3_kW;
+        node_power[node_index].Q3_kVAR = Q3_kVAR;
+    }
+}
+
+
 std::map<grid_node_id_type, std::pair<double, double>> interface_to_SE_groups::get_charging_power( const double prev_unix_time,
                                                                                                    const double now_unix_time,
                                                                                                    const std::map<grid_node_id_type, double> gnid_to_puVrms_map)
 {
+    this->check_no_trial_step_is_open("get_charging_power");
+    
     const int POWER_TO_RETURN_P1P2P3 = 3;
     
     std::map<grid_node_id_type, std::pair<double, double> > return_val;
     
+    this->add_charge_events_from_source(now_unix_time);
+    
+    //---------------------------
+    //  Gather the grid nodes
+    //---------------------------
+    
+    // There is no SE on some grid nodes. They point to an empty vector and get zeros.
+    static const std::vector<supply_equipment*> no_SE_ptrs;
+    
+    const int num_nodes = gnid_to_puVrms_map.size();
+    std::vector<const std::vector<supply_equipment*>*> node_SE_ptrs;
+    std::vector<double> pu_Vrms;
+    node_SE_ptrs.reserve(num_nodes);
+    pu_Vrms.reserve(num_nodes);
+    
+    std::map<grid_node_id_type, std::vector<supply_equipment*> >::const_iterator it;
+    
+    for(const std::pair<const grid_node_id_type, double>& gnid_puVrms_pair : gnid_to_puVrms_map)
+    {
+        it = this->gridNodeId_to_SE_ptrs.find(gnid_puVrms_pair.first);
+        
+        if( it == this->gridNodeId_to_SE_ptrs.end() )
+            node_SE_ptrs.push_back(&no_SE_ptrs);
+        else
+            node_SE_ptrs.push_back(&it->second);
+        
+        pu_Vrms.push_back(gnid_puVrms_pair.second);
+    }
+    
+    std::vector<int> sweep_order;
+    int num_large_nodes;
+    get_grid_node_sweep_order(node_SE_ptrs, sweep_order, num_large_nodes);
+    
+    std::vector<ac_power_metrics> node_power(num_nodes);
+    this->sweep_grid_nodes(prev_unix_time, now_unix_time, node_SE_ptrs, sweep_order, num_large_nodes, pu_Vrms.data(), node_power.data());
+    
+    //---------------------------
+    //  Return the results
     //---------------------------
     
-    std::map<grid_node_id_type, std::vector<supply_equipment*> >::iterator it;
     std::pair<double, double> tmp_pwr;
-    double P1_kW, P2_kW, P3_kW, Q3_kVAR;
+    int i = 0;
     
-    for(std::pair<grid_node_id_type, double> gnid_puVrms_pair : gnid_to_puVrms_map)
+    for(const std::pair<const grid_node_id_type, double>& gnid_puVrms_pair : gnid_to_puVrms_map)
     {
-        const grid_node_id_type& gnid = gnid_puVrms_pair.first;
-        const double pu_Vrms = gnid_puVrms_pair.second;
+        if( POWER_TO_RETURN_P1P2P3 == 1 )      tmp_pwr.first = node_power[i].P1_kW;
+        else if( POWER_TO_RETURN_P1P2P3 == 2 ) tmp_pwr.first = node_power[i].P2_kW;
+        else if( POWER_TO_RETURN_P1P2P3 == 3 ) tmp_pwr.first = node_power[i].P3_kW;
+        else
+        {
+            std::cout << "Error in interface_to_SE_groups::get_charging_power [1]" << std::endl;
+            exit(0);
+        }
+        tmp_pwr.second = node_power[i].Q3_kVAR;
         
-        it = this->gridNodeId_to_SE_ptrs.find(gnid);
+        return_val.emplace_hint(return_val.end(), gnid_puVrms_pair.first, tmp_pwr);
+        i++;
+    }
+    
+    return return_val;
+}
+
+
+std::vector<int> interface_to_SE_groups::register_grid_nodes(const std::vector<grid_node_id_type>& grid_node_ids)
+{
+    this->check_no_trial_step_is_open("register_grid_nodes");
+    
+    std::vector<int> return_val;
+    return_val.reserve(grid_node_ids.size());
+    
+    for(const grid_node_id_type& gnid : grid_node_ids)
+    {
+        std::map<grid_node_id_type, int>::const_iterator it = this->gridNodeId_to_node_index.find(gnid);
         
-        if( it == this->gridNodeId_to_SE_ptrs.end() )
+        if(it != this->gridNodeId_to_node_index.end())
         {
-            // There is no SE on this grid node. Just put zeros in there.
-            P1_kW = 0;
-            P2_kW = 0;
-            P3_kW = 0;
-            Q3_kVAR = 0;
-            if( POWER_TO_RETURN_P1P2P3 == 1 )      tmp_pwr.first = P1_kW;
-            else if( POWER_TO_RETURN_P1P2P3 == 2 ) tmp_pwr.first = P2_kW;
-            else if( POWER_TO_RETURN_P1P2P3 == 3 ) tmp_pwr.first = P3_kW;
-            else
-            {
-                std::cout << "Error in interface_to_SE_groups::get_charging_power [1]" << std::endl;
-                exit(0);
-            }
-            tmp_pwr.second = Q3_kVAR;
-            return_val[gnid] = tmp_pwr;
+            // Already registered, hand back the same index.
+            return_val.push_back(it->second);
+            continue;
         }
+        
+        const int node_index = this->node_index_to_gridNodeId.size();
+        this->gridNodeId_to_node_index[gnid] = node_index;
+        this->node_index_to_gridNodeId.push_back(gnid);
+        
+        // Grid nodes without any SE get an empty vector and always report zero power.
+        std::map<grid_node_id_type, std::vector<supply_equipment*> >::const_iterator SE_it = this->gridNodeId_to_SE_ptrs.find(gnid);
+        
+        if(SE_it == this->gridNodeId_to_SE_ptrs.end())
+            this->node_index_to_SE_ptrs.emplace_back();
         else
+            this->node_index_to_SE_ptrs.push_back(SE_it->second);
+        
+        return_val.push_back(node_index);
+    }
+    
+    //---------------------------------------
+    //  Rebuild the sweep over grid nodes
+    //---------------------------------------
+    // Every registered SE starts in the active set.  Idle SEs drop out after their first step.
+    
+    const int num_nodes = this->node_index_to_SE_ptrs.size();
+    
+    this->node_index_to_active_SE_ptrs = this->node_index_to_SE_ptrs;
+    this->node_index_to_standby_power.assign(num_nodes, ac_power_metrics());
+    this->node_index_to_active_standby_power.assign(num_nodes, ac_power_metrics());
+    this->registered_SE_ptr_to_node_index.clear();
+    this->active_SE_ptrs.clear();
+    this->idle_SE_calendar.clear();
+    this->SEs_with_new_charge_events.clear();
+    
+    this->registered_node_SE_ptrs.clear();
+    
+    for(int i = 0; i < num_nodes; i++)
+    {
+        ac_power_metrics& standby_power = this->node_index_to_standby_power[i];
+        standby_power.P1_kW = 0;
+        standby_power.P2_kW = 0;
+        standby_power.P3_kW = 0;
+        standby_power.Q3_kVAR = 0;
+        
+        for(supply_equipment* SE_ptr : this->node_index_to_SE_ptrs[i])
+        {
+            standby_power.P3_kW += SE_ptr->get_standby_acP_kW();
+            standby_power.Q3_kVAR += SE_ptr->get_standby_acQ_kVAR();
+            
+            this->registered_SE_ptr_to_node_index[SE_ptr] = i;
+            this->active_SE_ptrs.insert(SE_ptr);
+        }
+        
+        this->update_active_standby_power(i);
+        this->registered_node_SE_ptrs.push_back(&this->node_index_to_active_SE_ptrs[i]);
+    }
+    
+    // One more step than the longest voltage LPF window.
+    this->wake_up_window_num_steps = this->manage_L2_control.get_LPF_max_window_size() + 1;
+    
+    get_grid_node_sweep_order(this->registered_node_SE_ptrs, this->registered_node_sweep_order, this->registered_num_large_nodes);
+    this->registered_node_power.resize(num_nodes);
+    this->active_set_has_changed = false;
+    
+    return return_val;
+}
+
+
+void interface_to_SE_groups::update_active_standby_power( const int node_index )
+{
+    ac_power_metrics& X = this->node_index_to_active_standby_power[node_index];
+    X.P1_kW = 0;
+    X.P2_kW = 0;
+    X.P3_kW = 0;
+    X.Q3_kVAR = 0;
+    
+    for(supply_equipment* SE_ptr : this->node_index_to_active_SE_ptrs[node_index])
+    {
+        X.P3_kW += SE_ptr->get_standby_acP_kW();
+        X.Q3_kVAR += SE_ptr->get_standby_acQ_kVAR();
+    }
+}
+
+
+void interface_to_SE_groups::activate_SE( supply_equipment* SE_ptr )
+{
+    std::unordered_map<supply_equipment*, int>::const_iterator it = this->registered_SE_ptr_to_node_index.find(SE_ptr);
+    
+    // SEs that are not on a registered grid node are not swept by the registered grid nodes.
+    if(it == this->registered_SE_ptr_to_node_index.end())
+        return;
+    
+    if(!this->active_SE_ptrs.insert(SE_ptr).second)
+        return;
+    
+    this->node_index_to_active_SE_ptrs[it->second].push_back(SE_ptr);
+    this->update_active_standby_power(it->second);
+    this->active_set_has_changed = true;
+}
+
+
+void interface_to_SE_groups::sweep_registered_grid_nodes( const double prev_unix_time,
+                                                          const double now_unix_time,
+                                                          const double* pu_Vrms )
+{
+    this->wake_up_registered_SEs(prev_unix_time, now_unix_time);
+    this->sweep_active_registered_SEs(prev_unix_time, now_unix_time, pu_Vrms);
+    this->put_idle_registered_SEs_to_sleep(prev_unix_time, now_unix_time);
+}
+
+
+void interface_to_SE_groups::wake_up_registered_SEs( const double prev_unix_time, const double now_unix_time )
+{
+    const double wake_up_window_sec = this->wake_up_window_num_steps * (now_unix_time - prev_unix_time);
+    
+    this->add_charge_events_from_source(now_unix_time + wake_up_window_sec);
+    
+    // Calendar entries can be stale if the SE was woken up early by a new charge event.
+    // Waking it up again only costs one extra step.
+    this->idle_SE_calendar.pop_due(now_unix_time + wake_up_window_sec, this->SEs_with_new_charge_events);
+    
+    for(supply_equipment* SE_ptr : this->SEs_with_new_charge_events)
+        this->activate_SE(SE_ptr);
+    
+    this->SEs_with_new_charge_events.clear();
+    
+    if(this->active_set_has_changed)
+    {
+        get_grid_node_sweep_order(this->registered_node_SE_ptrs, this->registered_node_sweep_order, this->registered_num_large_nodes);
+        this->active_set_has_changed = false;
+    }
+}
+
+
+void interface_to_SE_groups::sweep_active_registered_SEs( const double prev_unix_time, const double now_unix_time, const double* pu_Vrms )
+{
+    this->sweep_grid_nodes(prev_unix_time, now_unix_time, this->registered_node_SE_ptrs, this->registered_node_sweep_order, this->registered_num_large_nodes, pu_Vrms, this->registered_node_power.data());
+    
+    const int num_nodes = this->registered_node_power.size();
+    
+    for(int i = 0; i < num_nodes; i++)
+    {
+        // Idle SEs only draw standby power.
+        this->registered_node_power[i].P3_kW += this->node_index_to_standby_power[i].P3_kW - this->node_index_to_active_standby_power[i].P3_kW;
+        this->registered_node_power[i].Q3_kVAR += this->node_index_to_standby_power[i].Q3_kVAR - this->node_index_to_active_standby_power[i].Q3_kVAR;
+    }
+}
+
+
+void interface_to_SE_groups::put_idle_registered_SEs_to_sleep( const double prev_unix_time, const double now_unix_time )
+{
+    const double wake_up_window_sec = this->wake_up_window_num_steps * (now_unix_time - prev_unix_time);
+    
+    double next_arrival_unix_time;
+    
+    for(const int node_index : this->registered_node_sweep_order)
+    {
+        std::vector<supply_equipment*>& active_SEs = this->node_index_to_active_SE_ptrs[node_index];
+        bool node_has_changed = false;
+        
+        for(int k = (int)active_SEs.size() - 1; k >= 0; k--)
         {
-            // Access the object the iterator is pointing to.
-            const std::pair< grid_node_id_type, std::vector<supply_equipment*> >& gridnodeid_SEvec_pair = *it; 
+            supply_equipment* SE_ptr = active_SEs[k];
             
-            // NOTE: There may be multiple supply-equipments on a single grid-node-id.
+            if(!SE_ptr->is_idle(next_arrival_unix_time) || next_arrival_unix_time - wake_up_window_sec <= now_unix_time)
+                continue;
+            
+            active_SEs[k] = active_SEs.back();
+            active_SEs.pop_back();
+            this->active_SE_ptrs.erase(SE_ptr);
             
-            // --------------------------------------------------------------------------------------------------
-            // Iterate over each supply_equipment pointer and sum up the power used by each during this timestep.
-            // --------------------------------------------------------------------------------------------------
+            if(next_arrival_unix_time < std::numeric_limits<double>::max())
+                this->idle_SE_calendar.add(next_arrival_unix_time, SE_ptr);
             
-            P1_kW = 0;
-            P2_kW = 0;
-            P3_kW = 0;
-            Q3_kVAR = 0;
+            node_has_changed = true;
+        }
+        
+        if(node_has_changed)
+        {
+            this->update_active_standby_power(node_index);
+            this->active_set_has_changed = true;
+        }
+    }
+}
+
+
+int interface_to_SE_groups::get_num_registered_grid_nodes() const
+{
+    return this->node_index_to_gridNodeId.size();
+}
+
+
+std::vector<grid_node_id_type> interface_to_SE_groups::get_registered_grid_node_ids() const
+{
+    return this->node_index_to_gridNodeId;
+}
 
-            const int vec_size = gridnodeid_SEvec_pair.second.size();
 
-            #pragma omp parallel for reduction(+:P3_kW, P2_kW, P1_kW, Q3_kVAR)
-            for (int i = 0; i < vec_size; i++)
+void interface_to_SE_groups::get_charging_power_by_index( const double prev_unix_time,
+                                                          const double now_unix_time,
+                                                          const double* pu_Vrms,
+                                                          double* P3_kW,
+                                                          double* Q3_kVAR )
+{
+    this->check_no_trial_step_is_open("get_charging_power_by_index");
+    
+    this->sweep_registered_grid_nodes(prev_unix_time, now_unix_time, pu_Vrms);
+    
+    const int num_nodes = this->registered_node_power.size();
+    
+    for(int i = 0; i < num_nodes; i++)
+    {
+        P3_kW[i] = this->registered_node_power[i].P3_kW;
+        Q3_kVAR[i] = this->registered_node_power[i].Q3_kVAR;
+    }
+}
+
+
+void interface_to_SE_groups::get_charging_power_sensitivity_by_index( const double* pu_Vrms,
+                                                                      double* dP3_dpuVrms,
+                                                                      double* dQ3_dpuVrms )
+{
+    // Idle SEs return standby power, so only the active set contributes.
+    const int num_nodes = this->node_index_to_active_SE_ptrs.size();
+    
+    #pragma omp parallel for schedule(dynamic, 8)
+    for(int i = 0; i < num_nodes; i++)
+    {
+        double dP3 = 0;
+        double dQ3 = 0;
+        double SE_dP3, SE_dQ3;
+        
+        for(supply_equipment* SE_ptr : this->node_index_to_active_SE_ptrs[i])
+        {
+            SE_ptr->get_power_sensitivity(pu_Vrms[i], SE_dP3, SE_dQ3);
+            dP3 += SE_dP3;
+            dQ3 += SE_dQ3;
+        }
+        
+        dP3_dpuVrms[i] = dP3;
+        dQ3_dpuVrms[i] = dQ3;
+    }
+}
+
+
+std::map<grid_node_id_type, std::pair<double, double> > interface_to_SE_groups::get_charging_power_sensitivity( const std::map<grid_node_id_type, double> gnid_to_puVrms_map )
+{
+    std::map<grid_node_id_type, std::pair<double, double> > return_val;
+    
+    std::map<grid_node_id_type, std::vector<supply_equipment*> >::const_iterator it;
+    double SE_dP3, SE_dQ3;
+    
+    for(const std::pair<const grid_node_id_type, double>& gnid_puVrms_pair : gnid_to_puVrms_map)
+    {
+        std::pair<double, double> tmp_sens = std::make_pair(0.0, 0.0);
+        
+        it = this->gridNodeId_to_SE_ptrs.find(gnid_puVrms_pair.first);
+        
+        if( it != this->gridNodeId_to_SE_ptrs.end() )
+        {
+            for(supply_equipment* SE_ptr : it->second)
             {
-                supply_equipment* SE_ptr = gridnodeid_SEvec_pair.second.at(i);
-                ac_power_metrics ac_power_tmp;
-                double soc;
-                
-                // As of 11/14/2024, the get_next function is threadsafe although it isn't const.
-                // All class members are local or const& except for manage_L2_control_strategy 
-                // which is protected by pragma omp critical. 
-                // Future version will need to ensure we maintain thread safety.
-                SE_ptr->get_next(prev_unix_time, now_unix_time, pu_Vrms, soc, ac_power_tmp);
-                
-                P1_kW += ac_power_tmp.P1_kW;
-                P2_kW += ac_power_tmp.P2_kW;
-                P3_kW += ac_power_tmp.P3_kW;
-                Q3_kVAR += ac_power_tmp.Q3_kVAR;
+                SE_ptr->get_power_sensitivity(gnid_puVrms_pair.second, SE_dP3, SE_dQ3);
+                tmp_sens.first += SE_dP3;
+                tmp_sens.second += SE_dQ3;
             }
+        }
+        
+        return_val.emplace_hint(return_val.end(), gnid_puVrms_pair.first, tmp_sens);
+    }
+    
+    return return_val;
+}
+
+
+void interface_to_SE_groups::check_no_trial_step_is_open( const std::string& function_name ) const
+{
+    if(this->trial_step_is_open)
+        throw std::invalid_argument("CALDERA ERROR: " + function_name + " can not be called while a trial step is open.  Call commit_trial_step or rollback_trial_step first.");
+}
+
+
+void interface_to_SE_groups::restore_trial_SE_states()
+{
+    const int num_nodes = this->node_index_to_active_SE_ptrs.size();
+    
+    #pragma omp parallel for schedule(dynamic, 8)
+    for(int i = 0; i < num_nodes; i++)
+    {
+        const std::vector<supply_equipment*>& active_SEs = this->node_index_to_active_SE_ptrs[i];
+        
+        for(int k = 0; k < (int)active_SEs.size(); k++)
+            active_SEs[k]->restore_trial_state(this->trial_SE_states[i][k]);
+    }
+    
+    this->manage_L2_control = this->trial_manage_L2_control;
+}
+
+
+void interface_to_SE_groups::end_trial_step()
+{
+    const int num_nodes = this->node_index_to_active_SE_ptrs.size();
+    
+    #pragma omp parallel for schedule(dynamic, 8)
+    for(int i = 0; i < num_nodes; i++)
+    {
+        for(supply_equipment* SE_ptr : this->node_index_to_active_SE_ptrs[i])
+            SE_ptr->end_trial_step();
+    }
+    
+    this->trial_step_is_open = false;
+}
+
+
+void interface_to_SE_groups::get_trial_charging_power_by_index( const double prev_unix_time,
+                                                                const double now_unix_time,
+                                                                const double* pu_Vrms,
+                                                                double* P3_kW,
+                                                                double* Q3_kVAR )
+{
+    if(!this->trial_step_is_open)
+    {
+        // Waking up SEs does not depend on the voltages, so it is kept whatever the
+        // outcome of the trial step.  The active set does not change until the commit.
+        this->wake_up_registered_SEs(prev_unix_time, now_unix_time);
+        
+        const int num_nodes = this->node_index_to_active_SE_ptrs.size();
+        this->trial_SE_states.resize(num_nodes);
+        
+        #pragma omp parallel for schedule(dynamic, 8)
+        for(int i = 0; i < num_nodes; i++)
+        {
+            const std::vector<supply_equipment*>& active_SEs = this->node_index_to_active_SE_ptrs[i];
+            std::vector<supply_equipment_step_state>& states = this->trial_SE_states[i];
             
-            if( POWER_TO_RETURN_P1P2P3 == 1 )      tmp_pwr.first = P1_kW;
-            else if( POWER_TO_RETURN_P1P2P3 == 2 ) tmp_pwr.first = P2_kW;
-            else if( POWER_TO_RETURN_P1P2P3 == 3 ) tmp_pwr.first = P3_kW;
-            else
-            {
-                std::cout << "Error in interface_to_SE_groups::get_charging_power [2]" << std::endl;
-                exit(0);
-            }
-            tmp_pwr.second = Q3_kVAR;
+            // Not cleared, so the states keep their capacity from the previous trial steps.
+            if(states.size() < active_SEs.size())
+                states.resize(active_SEs.size());
+            
+            for(int k = 0; k < (int)active_SEs.size(); k++)
+                active_SEs[k]->begin_trial_step(states[k]);
+        }
+        
+        this->trial_manage_L2_control = this->manage_L2_control;
+        this->trial_prev_unix_time = prev_unix_time;
+        this->trial_now_unix_time = now_unix_time;
+        this->trial_step_is_open = true;
+    }
+    else
+    {
+        if(prev_unix_time != this->trial_prev_unix_time || now_unix_time != this->trial_now_unix_time)
+            throw std::invalid_argument("CALDERA ERROR: get_trial_charging_power_by_index must use the same prev_unix_time and now_unix_time until the trial step is committed or rolled back.");
+        
+        this->restore_trial_SE_states();
+    }
+    
+    this->sweep_active_registered_SEs(prev_unix_time, now_unix_time, pu_Vrms);
+    
+    const int num_nodes = this->registered_node_power.size();
+    
+    for(int i = 0; i < num_nodes; i++)
+    {
+        P3_kW[i] = this->registered_node_power[i].P3_kW;
+        Q3_kVAR[i] = this->registered_node_power[i].Q3_kVAR;
+    }
+}
+
+
+void interface_to_SE_groups::commit_trial_step()
+{
+    if(!this->trial_step_is_open)
+        return;
+    
+    this->end_trial_step();
+    this->put_idle_registered_SEs_to_sleep(this->trial_prev_unix_time, this->trial_now_unix_time);
+}
+
+
+void interface_to_SE_groups::rollback_trial_step()
+{
+    if(!this->trial_step_is_open)
+        return;
+    
+    this->restore_trial_SE_states();
+    this->end_trial_step();
+}
+
+
+bool interface_to_SE_groups::has_open_trial_step() const
+{
+    return this->trial_step_is_open;
+}
+
+
+void interface_to_SE_groups::add_idle_registered_SEs_to_calendar()
+{
+    // Idle SEs go back on the calendar from their own charge event queues.
+    double next_arrival_unix_time;
+    
+    for (supply_equipment* SE_ptr : this->SE_ptr_vector)
+    {
+        if (this->registered_SE_ptr_to_node_index.count(SE_ptr) == 1 && this->active_SE_ptrs.count(SE_ptr) == 0 &&
+            SE_ptr->is_idle(next_arrival_unix_time) && next_arrival_unix_time < std::numeric_limits<double>::max())
+            this->idle_SE_calendar.add(next_arrival_unix_time, SE_ptr);
+    }
+}
+
+
+std::shared_ptr<interface_to_SE_groups_checkpoint> interface_to_SE_groups::save_checkpoint()
+{
+    this->check_no_trial_step_is_open("save_checkpoint");
+    
+    std::shared_ptr<interface_to_SE_groups_checkpoint> checkpoint = std::make_shared<interface_to_SE_groups_checkpoint>();
+    interface_to_SE_groups_checkpoint& X = *checkpoint;
+    
+    X.EV_model_factory = this->EV_model_factory;
+    X.ac_to_dc_converter_factory = this->ac_to_dc_converter_factory;
+    X.charge_profile_library = this->charge_profile_library;
+    
+    X.SE_objs.reserve(this->SE_ptr_vector.size());
+    for(supply_equipment* SE_ptr : this->SE_ptr_vector)
+        X.SE_objs.push_back(*SE_ptr);
+    
+    X.manage_L2_control = this->manage_L2_control;
+    
+    //---------------------------
+    //  Registered grid nodes
+    //---------------------------
+    
+    const int num_SEs = this->SE_ptr_vector.size();
+    
+    std::unordered_map<const supply_equipment*, int> SE_ptr_to_SE_index;
+    for(int i = 0; i < num_SEs; i++)
+        SE_ptr_to_SE_index[this->SE_ptr_vector[i]] = i;
+    
+    auto to_SE_indexes = [&SE_ptr_to_SE_index](const std::vector<supply_equipment*>& SE_ptrs)
+    {
+        std::vector<int> SE_indexes;
+        SE_indexes.reserve(SE_ptrs.size());
+        
+        for(supply_equipment* SE_ptr : SE_ptrs)
+            SE_indexes.push_back(SE_ptr_to_SE_index.at(SE_ptr));
+        
+        return SE_indexes;
+    };
+    
+    X.gridNodeId_to_node_index = this->gridNodeId_to_node_index;
+    X.node_index_to_gridNodeId = this->node_index_to_gridNodeId;
+    X.registered_node_sweep_order = this->registered_node_sweep_order;
+    X.registered_num_large_nodes = this->registered_num_large_nodes;
+    X.registered_node_power = this->registered_node_power;
+    X.node_index_to_standby_power = this->node_index_to_standby_power;
+    X.node_index_to_active_standby_power = this->node_index_to_active_standby_power;
+    
+    for(const std::vector<supply_equipment*>& SE_ptrs : this->node_index_to_SE_ptrs)
+        X.node_index_to_SE_indexes.push_back(to_SE_indexes(SE_ptrs));
+    
+    for(const std::vector<supply_equipment*>& SE_ptrs : this->node_index_to_active_SE_ptrs)
+        X.node_index_to_active_SE_indexes.push_back(to_SE_indexes(SE_ptrs));
+    
+    X.SE_index_to_registered_node_index.assign(num_SEs, -1);
+    X.SE_is_active.assign(num_SEs, false);
+    
+    for(int i = 0; i < num_SEs; i++)
+    {
+        std::unordered_map<supply_equipment*, int>::const_iterator it = this->registered_SE_ptr_to_node_index.find(this->SE_ptr_vector[i]);
+        
+        if(it != this->registered_SE_ptr_to_node_index.end())
+            X.SE_index_to_registered_node_index[i] = it->second;
+        
+        X.SE_is_active[i] = (this->active_SE_ptrs.count(this->SE_ptr_vector[i]) == 1);
+    }
+    
+    this->idle_SE_calendar.get_state(SE_ptr_to_SE_index, X.idle_SE_calendar);
+    X.SEs_with_new_charge_events = to_SE_indexes(this->SEs_with_new_charge_events);
+    X.wake_up_window_num_steps = this->wake_up_window_num_steps;
+    X.active_set_has_changed = this->active_set_has_changed;
+    
+    X.has_charge_event_source = (this->charge_event_source != nullptr);
+    X.charge_event_source_lookahead_sec = this->charge_event_source_lookahead_sec;
+    
+    if(X.has_charge_event_source)
+    {
+        X.charge_event_source_file = this->charge_event_source->get_charge_events_file();
+        X.charge_event_source_position = this->charge_event_source->get_position();
+    }
+    
+    return checkpoint;
+}
+
+
+void interface_to_SE_groups::restore_checkpoint( const std::shared_ptr<interface_to_SE_groups_checkpoint>& checkpoint )
+{
+    this->check_no_trial_step_is_open("restore_checkpoint");
+    
+    if(checkpoint == nullptr)
+        throw std::invalid_argument("CALDERA ERROR: restore_checkpoint was given no checkpoint.");
+    
+    const interface_to_SE_groups_checkpoint& X = *checkpoint;
+    const int num_SEs = this->SE_ptr_vector.size();
+    
+    bool is_compatible = X.EV_model_factory == this->EV_model_factory && X.ac_to_dc_converter_factory == this->ac_to_dc_converter_factory &&
+                         X.charge_profile_library == this->charge_profile_library && (int)X.SE_objs.size() == num_SEs;
+    
+    for(int i = 0; is_compatible && i < num_SEs; i++)
+        is_compatible = X.SE_objs[i].get_SE_configuration().SE_id == this->SE_ptr_vector[i]->get_SE_configuration().SE_id;
+    
+    if(!is_compatible)
+        throw std::invalid_argument("CALDERA ERROR: restore_checkpoint can only restore a checkpoint saved by an interface built from the same inputs and SE groups.");
+    
+    //---------------------------
+    //  SEs
+    //---------------------------
+    
+    
+    // The control strategies of the SE copies point at the manage_L2_control of the
+    // interface that saved the checkpoint.
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(int i = 0; i < num_SEs; i++)
+    {
+        *this->SE_ptr_vector[i] = X.SE_objs[i];
+        this->SE_ptr_vector[i]->set_manage_L2_control(&this->manage_L2_control);
+    }
+    
+    this->manage_L2_control = X.manage_L2_control;
+    
+    //---------------------------
+    //  Registered grid nodes
+    //---------------------------
+    
+    auto to_SE_ptrs = [this](const std::vector<int>& SE_indexes)
+    {
+        std::vector<supply_equipment*> SE_ptrs;
+        SE_ptrs.reserve(SE_indexes.size());
+        
+        for(const int SE_index : SE_indexes)
+            SE_ptrs.push_back(this->SE_ptr_vector[SE_index]);
+        
+        return SE_ptrs;
+    };
+    
+    this->gridNodeId_to_node_index = X.gridNodeId_to_node_index;
+    this->node_index_to_gridNodeId = X.node_index_to_gridNodeId;
+    this->registered_node_sweep_order = X.registered_node_sweep_order;
+    this->registered_num_large_nodes = X.registered_num_large_nodes;
+    this->registered_node_power = X.registered_node_power;
+    this->node_index_to_standby_power = X.node_index_to_standby_power;
+    this->node_index_to_active_standby_power = X.node_index_to_active_standby_power;
+    
+    this->node_index_to_SE_ptrs.clear();
+    for(const std::vector<int>& SE_indexes : X.node_index_to_SE_indexes)
+        this->node_index_to_SE_ptrs.push_back(to_SE_ptrs(SE_indexes));
+    
+    this->node_index_to_active_SE_ptrs.clear();
+    for(const std::vector<int>& SE_indexes : X.node_index_to_active_SE_indexes)
+        this->node_index_to_active_SE_ptrs.push_back(to_SE_ptrs(SE_indexes));
+    
+    this->registered_SE_ptr_to_node_index.clear();
+    this->active_SE_ptrs.clear();
+    
+    for(int i = 0; i < num_SEs; i++)
+    {
+        if(X.SE_index_to_registered_node_index[i] >= 0)
+            this->registered_SE_ptr_to_node_index[this->SE_ptr_vector[i]] = X.SE_index_to_registered_node_index[i];
+        
+        if(X.SE_is_active[i])
+            this->active_SE_ptrs.insert(this->SE_ptr_vector[i]);
+    }
+    
+    this->idle_SE_calendar.set_state(X.idle_SE_calendar, this->SE_ptr_vector);
+    this->SEs_with_new_charge_events = to_SE_ptrs(X.SEs_with_new_charge_events);
+    this->wake_up_window_num_steps = X.wake_up_window_num_steps;
+    this->active_set_has_changed = X.active_set_has_changed;
+    
+    // The sweep points into node_index_to_active_SE_ptrs, which was just reassigned.
+    this->registered_node_SE_ptrs.clear();
+    for(std::vector<supply_equipment*>& active_SEs : this->node_index_to_active_SE_ptrs)
+        this->registered_node_SE_ptrs.push_back(&active_SEs);
+    
+    //---------------------------
+    //  Charge event file
+    //---------------------------
+    
+    if(!X.has_charge_event_source)
+        this->charge_event_source.reset();
+    else
+    {
+        if(this->charge_event_source == nullptr || this->charge_event_source->get_charge_events_file() != X.charge_event_source_file)
+            this->charge_event_source.reset(new load_charge_events(X.charge_event_source_file));
+        
+        this->charge_event_source->set_position(X.charge_event_source_position);
+    }
+    
+    this->charge_event_source_lookahead_sec = X.charge_event_source_lookahead_sec;
+}
+
+void interface_to_SE_groups::advance( const double start_unix_time,
+                                      const int num_steps,
+                                      const double time_step_sec,
+                                      const double* pu_Vrms,
+                                      const bool return_time_series,
+                                      grid_nodes_advance_result& result )
+{
+    this->check_no_trial_step_is_open("advance");
+    
+    if(this->get_num_registered_grid_nodes() == 0)
+        throw std::invalid_argument("CALDERA ERROR:  interface_to_SE_groups::advance() -> No grid nodes are registered, call register_grid_nodes first.");
+    
+    if(num_steps < 0 || time_step_sec <= 0)
+        throw std::invalid_argument("CALDERA ERROR:  interface_to_SE_groups::advance() -> num_steps must be non-negative and time_step_sec must be positive.");
+    
+    if(pu_Vrms == nullptr)
+        throw std::invalid_argument("CALDERA ERROR:  interface_to_SE_groups::advance() -> pu_Vrms must hold one value per registered grid node.");
+    
+    const int num_nodes = this->registered_node_power.size();
+    const double time_step_hrs = time_step_sec / 3600.0;
+    
+    result.start_unix_time = start_unix_time;
+    result.time_step_sec = time_step_sec;
+    result.num_steps = num_steps;
+    result.num_grid_nodes = num_nodes;
+    result.has_time_series = return_time_series;
+    
+    // size_t so num_steps*num_nodes does not overflow for long runs over many nodes.
+    const size_t num_values = return_time_series ? (size_t)num_steps*num_nodes : num_nodes;
+    result.P3_kW.assign(num_values, 0.0);
+    result.Q3_kVAR.assign(num_values, 0.0);
+    result.E3_kWh.assign(num_nodes, 0.0);
+    result.Q3_kVARh.assign(num_nodes, 0.0);
+    
+    double prev_unix_time, now_unix_time;
+    size_t offset;
+    
+    for(int k = 0; k < num_steps; k++)
+    {
+        // Computed from start_unix_time every step so round-off does not accumulate.
+        prev_unix_time = start_unix_time + k*time_step_sec;
+        now_unix_time = start_unix_time + (k+1)*time_step_sec;
+        
+        this->sweep_registered_grid_nodes(prev_unix_time, now_unix_time, pu_Vrms);
+        
+        offset = return_time_series ? (size_t)k*num_nodes : 0;
+        
+        for(int i = 0; i < num_nodes; i++)
+        {
+            const ac_power_metrics& node_power = this->registered_node_power[i];
             
-            return_val[gnid] = tmp_pwr;
+            result.P3_kW[offset + i] = node_power.P3_kW;
+            result.Q3_kVAR[offset + i] = node_power.Q3_kVAR;
+            result.E3_kWh[i] += node_power.P3_kW * time_step_hrs;
+            result.Q3_kVARh[i] += node_power.Q3_kVAR * time_step_hrs;
         }
     }
+}
+
+
+grid_nodes_advance_result interface_to_SE_groups::advance( const double start_unix_time,
+                                                           const int num_steps,
+                                                           const double time_step_sec,
+                                                           const std::vector<double>& pu_Vrms,
+                                                           const bool return_time_series )
+{
+    if((int)pu_Vrms.size() != this->get_num_registered_grid_nodes())
+        throw std::invalid_argument("CALDERA ERROR:  interface_to_SE_groups::advance() -> pu_Vrms must have one value per registered grid node.");
+    
+    grid_nodes_advance_result return_val;
+    this->advance(start_unix_time, num_steps, time_step_sec, pu_Vrms.data(), return_time_series, return_val);
     
     return return_val;
 }
 
+
 SE_power interface_to_SE_groups::get_SE_power(SupplyEquipmentId SE_id, double prev_unix_time, double now_unix_time, double pu_Vrms)
 {
+    this->add_charge_events_from_source(now_unix_time);
+    
     SE_power return_val;
     
     if(this->SEid_to_SE_ptr.count(SE_id) == 0)
@@ -7,12 +7,16 @@
 #include "supply_equipment.h"                       // supply_equipment
 #include "supply_equipment_control.h"               // manage_L2_control_strategy_parameters
 #include "charge_profile_library.h"                 // pev_charge_profile_library
+#include "charge_event_calendar.h"                  // charge_event_calendar
 #include "helper.h"                                 // get_base_load_forecast
 #include "inputs.h"
 
 #include <vector>
 #include <map>
 #include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <memory>                                   // unique_ptr, shared_ptr
 
 #include "factory_EV_charge_model.h"
 #include "factory_charging_transitions.h"
@@ -20,12 +24,59 @@
 #include "factory_supply_equipment_model.h"
 
 #include "load_EV_EVSE_inventory.h"
+#include "load_charge_events.h"                     // load_charge_events
+
+class interface_to_SE_groups;
+
+// Mutable simulation state saved by interface_to_SE_groups::save_checkpoint.  The SE copies
+// hold the charge event queues, the charge models (battery, integrate_X_through_time),
+// the control strategies with their LPF buffers and the completed charge events.  The
+// factories and the charge profile library are only referenced, so a checkpoint can only
+// be restored into the interface it was taken from, or into another one built from the
+// same inputs and SE groups, which gets the same factories from factory_registry.
+//
+// SEs are given by their index in SE_objs (the order of SE_ptr_vector), never by pointer,
+// so a checkpoint stays valid after the interface that saved it is destroyed.
+struct interface_to_SE_groups_checkpoint
+{
+    std::shared_ptr<const factory_EV_charge_model> EV_model_factory;
+    std::shared_ptr<const factory_ac_to_dc_converter> ac_to_dc_converter_factory;
+    std::shared_ptr<const pev_charge_profile_library> charge_profile_library;
+    
+    std::vector<supply_equipment> SE_objs;          // in SE_ptr_vector order
+    manage_L2_control_strategy_parameters manage_L2_control;
+    
+    // Registered grid nodes and their active set
+    std::map<grid_node_id_type, int> gridNodeId_to_node_index;
+    std::vector<grid_node_id_type> node_index_to_gridNodeId;
+    std::vector<std::vector<int> > node_index_to_SE_indexes;
+    std::vector<int> registered_node_sweep_order;
+    int registered_num_large_nodes;
+    std::vector<ac_power_metrics> registered_node_power;
+    std::vector<std::vector<int> > node_index_to_active_SE_indexes;
+    std::vector<ac_power_metrics> node_index_to_standby_power;
+    std::vector<ac_power_metrics> node_index_to_active_standby_power;
+    std::vector<int> SE_index_to_registered_node_index;   // -1 for SEs of no registered grid node
+    std::vector<bool> SE_is_active;
+    charge_event_calendar_state idle_SE_calendar;
+    std::vector<int> SEs_with_new_charge_events;
+    int wake_up_window_num_steps;
+    bool active_set_has_changed;
+    
+    // Charge event file
+    bool has_charge_event_source;
+    std::string charge_event_source_file;
+    load_charge_events_position charge_event_source_position;
+    double charge_event_source_lookahead_sec;
+};
 
 class interface_to_SE_groups
 {
 private:
 
-    const load_EV_EVSE_inventory loader;
+    // The inventory, factories, charge profile library and base load forecaster are
+    // immutable and shared with every interface forked from this one.
+    std::shared_ptr<const load_EV_EVSE_inventory> loader;
     const EV_EVSE_inventory& inventory;
 
     std::vector<supply_equipment_group> SE_group_objs;
@@ -33,12 +84,42 @@ private:
     std::map<SE_id_type, supply_equipment*> SEid_to_SE_ptr;
     std::vector<supply_equipment*> SE_ptr_vector;
     std::map<grid_node_id_type, std::vector<supply_equipment*> > gridNodeId_to_SE_ptrs;
+
+    // Grid nodes registered through register_grid_nodes. The position in these
+    // vectors is the dense node index used by get_charging_power_by_index.
+    std::map<grid_node_id_type, int> gridNodeId_to_node_index;
+    std::vector<grid_node_id_type> node_index_to_gridNodeId;
+    std::vector<std::vector<supply_equipment*> > node_index_to_SE_ptrs;
+    std::vector<const std::vector<supply_equipment*>*> registered_node_SE_ptrs;
+    std::vector<int> registered_node_sweep_order;
+    int registered_num_large_nodes;
+    std::vector<ac_power_metrics> registered_node_power;
+
+    // Active set of the registered grid nodes.  Only SEs with a PEV connected or with a
+    // charge event arriving within the wake up window are swept.  Every other SE returns
+    // standby power, which is precomputed per grid node.  SEs are woken up a full voltage
+    // LPF window before the arrival so the filter history matches a full sweep.
+    std::vector<std::vector<supply_equipment*> > node_index_to_active_SE_ptrs;
+    std::vector<ac_power_metrics> node_index_to_standby_power;
+    std::vector<ac_power_metrics> node_index_to_active_standby_power;
+    std::unordered_map<supply_equipment*, int> registered_SE_ptr_to_node_index;
+    std::unordered_set<supply_equipment*> active_SE_ptrs;
+    charge_event_calendar idle_SE_calendar;
+    std::vector<supply_equipment*> SEs_with_new_charge_events;
+    int wake_up_window_num_steps;
+    bool active_set_has_changed;
+    
+    // Charge events streamed from a file.  Events are added to their SE once they
+    // arrive within charge_event_source_lookahead_sec of the simulation clock.
+    std::unique_ptr<load_charge_events> charge_event_source;
+    double charge_event_source_lookahead_sec;
+    std::vector<charge_event_data> charge_event_source_batch;
     
     // References to the following should be in every supply_equipment_load object.
-    const factory_EV_charge_model EV_model_factory;
-    const factory_ac_to_dc_converter ac_to_dc_converter_factory;
-    const pev_charge_profile_library charge_profile_library;
-    const get_base_load_forecast baseLD_forecaster;
+    std::shared_ptr<const factory_EV_charge_model> EV_model_factory;
+    std::shared_ptr<const factory_ac_to_dc_converter> ac_to_dc_converter_factory;
+    std::shared_ptr<const pev_charge_profile_library> charge_profile_library;
+    std::shared_ptr<const get_base_load_forecast> baseLD_forecaster;
 
     // manage_L2_control_strategy_parameters consists of random number generator
     // that keeps track of internal state. 
@@ -47,17 +128,90 @@ private:
     // not a great idea. 1 solution could be using omp_critical block.
     manage_L2_control_strategy_parameters manage_L2_control;
     
-    const factory_EV_charge_model load_factory_EV_charge_model(const interface_to_SE_groups_inputs& inputs);
+    // Open trial step (see get_trial_charging_power_by_index).  trial_SE_states[i][k]
+    // is the state of node_index_to_active_SE_ptrs[i][k] before the first trial.  Only
+    // the active SEs are saved since idle SEs are not touched by a sweep.  The vectors
+    // are kept between trial steps so saving the states does not allocate.
+    bool trial_step_is_open;
+    double trial_prev_unix_time;
+    double trial_now_unix_time;
+    std::vector<std::vector<supply_equipment_step_state> > trial_SE_states;
+    manage_L2_control_strategy_parameters trial_manage_L2_control;
+    
+    std::shared_ptr<const factory_EV_charge_model> load_factory_EV_charge_model(const std::string& input_path, const interface_to_SE_groups_inputs& inputs);
+
+    // Grid nodes with more SEs than a thread's share of the sweep are swept one at a
+    // time with the SEs split across threads, because one of them handed out whole
+    // would keep a thread busy after the others finish.  All other grid nodes are
+    // handed out whole.  Both paths sum the SEs of a grid node in the same order, so
+    // the result does not depend on the number of threads.
+    std::vector<ac_power_metrics> large_node_SE_power;
+
+    static void get_grid_node_sweep_order( const std::vector<const std::vector<supply_equipment*>*>& node_SE_ptrs,
+                                           std::vector<int>& sweep_order,
+                                           int& num_large_nodes );
+
+    // Used by fork.  Shares the immutable data of obj and copies the SEs.
+    interface_to_SE_groups( const interface_to_SE_groups& obj );
+    void index_SE_objects();
+
+    void add_idle_registered_SEs_to_calendar();
+    void activate_SE( supply_equipment* SE_ptr );
+    void update_active_standby_power( const int node_index );
+    void add_charge_events_from_source( const double now_unix_time );
+    void sweep_registered_grid_nodes( const double prev_unix_time,
+                                      const double now_unix_time,
+                                      const double* pu_Vrms );
+    void wake_up_registered_SEs( const double prev_unix_time, const double now_unix_time );
+    void sweep_active_registered_SEs( const double prev_unix_time, const double now_unix_time, const double* pu_Vrms );
+    void put_idle_registered_SEs_to_sleep( const double prev_unix_time, const double now_unix_time );
+    void restore_trial_SE_states();
+    void end_trial_step();
+    void check_no_trial_step_is_open( const std::string& function_name ) const;
+
+    void sweep_grid_nodes( const double prev_unix_time,
+                           const double now_unix_time,
+                           const std::vector<const std::vector<supply_equipment*>*>& node_SE_ptrs,
+                           const std::vector<int>& sweep_order,
+                           const int num_large_nodes,
+                           const double* pu_Vrms,
+                           ac_power_metrics* node_power );
 
 public:
     interface_to_SE_groups( const std::string& input_path,
                             const interface_to_SE_groups_inputs& inputs );
 
-    pev_charge_profile_library load_charge_profile_library(const interface_to_SE_groups_inputs& inputs);
+    // The inventory, factories and charge profile library come from factory_registry,
+    // so interfaces built from the same inputs in one process share them.
+    std::shared_ptr<const pev_charge_profile_library> load_charge_profile_library(const std::string& input_path, const interface_to_SE_groups_inputs& inputs);
+    
+    // With inputs.lazy_charge_profile_library, builds the charge profiles the charge events
+    // will need up front and in parallel, instead of in the first time steps they arrive
+    // in.  Does nothing for a full library.
+    void build_charge_profiles( const std::vector<charge_event_data>& charge_events ) const;
+    
+    // Independent copy of the running simulation, for ensembles of replicas.  The fork
+    // shares the inventory, factories and charge profile library with this interface
+    // and copies only the SEs and their control state, including the random number
+    // generators.  Can not be called during a trial step.
+    std::unique_ptr<interface_to_SE_groups> fork() const;
     
     void stop_active_charge_events(std::vector<SE_id_type> SE_ids);
     void add_charge_events( const std::vector<charge_event_data>& charge_events );
     void add_charge_events_by_SE_group( const std::vector<SE_group_charge_event_data>& SE_group_charge_events );
+    
+    // Memory held by the queued (not yet arrived) charge events of all SEs.
+    charge_event_queue_memory_usage get_charge_event_queue_memory_usage() const;
+    
+    // EV charge models and ac to dc converters are recycled between charge events (see
+    // object_pool).  The counters cover every interface in the process.
+    charge_model_allocation_counters get_charge_model_allocation_counters() const;
+    
+    // Reads charge events lazily from a CSV or binary file sorted by arrival time
+    // (see load_charge_events) instead of adding them all up front.  The charge events
+    // go through add_charge_events lookahead_sec before they arrive.
+    void set_charge_event_source( const std::string& charge_events_file, const double lookahead_sec );
+    
     void set_PQ_setpoints(double now_unix_time, std::vector<SE_setpoint> SE_setpoints);
     std::vector<completed_CE> get_completed_CE();
 
@@ -76,6 +230,86 @@ public:
     std::map<grid_node_id_type, std::pair<double, double> > get_charging_power( const double prev_unix_time,
                                                                                 const double now_unix_time,
                                                                                 const std::map<grid_node_id_type, double> gnid_to_puVrms_map);
+
+    //---------------------------------------------
+    //  Batched access with dense grid node indexes
+    //---------------------------------------------
+    // Grid nodes are registered once and receive dense indexes in the order given.
+    // get_charging_power_by_index then reads pu_Vrms[i] and writes P3_kW[i], Q3_kVAR[i]
+    // for every registered node i.  The arrays are owned by the caller and must hold
+    // get_num_registered_grid_nodes() values.  Nothing is allocated per call.  The SEs of
+    // each node are taken at registration, so no SE can be added after it.
+    std::vector<int> register_grid_nodes(const std::vector<grid_node_id_type>& grid_node_ids);
+    int get_num_registered_grid_nodes() const;
+    std::vector<grid_node_id_type> get_registered_grid_node_ids() const;
+
+    void get_charging_power_by_index( const double prev_unix_time,
+                                      const double now_unix_time,
+                                      const double* pu_Vrms,
+                                      double* P3_kW,
+                                      double* Q3_kVAR );
+
+    // Analytic sensitivity of the power returned by the last call to get_charging_power,
+    // get_charging_power_by_index or get_trial_charging_power_by_index, evaluated at the
+    // same voltages.  dP3_dpuVrms is in kW/pu and dQ3_dpuVrms in kVAR/pu.  Only the
+    // P2 vs puVrms limit of the batteries is differentiated (chained through the
+    // converter curves); voltage control strategies act through their LPF on later
+    // steps and are not included.  The batteries only move their P2 limit once it
+    // changes by more than 0.5 kW, so a voltage change smaller than that moves P3 by
+    // zero instead of by the slope (see calculate_E1_energy_limit::get_dP2_limit_dpuVrms).
+    void get_charging_power_sensitivity_by_index( const double* pu_Vrms,
+                                                  double* dP3_dpuVrms,
+                                                  double* dQ3_dpuVrms );
+
+    std::map<grid_node_id_type, std::pair<double, double> > get_charging_power_sensitivity( const std::map<grid_node_id_type, double> gnid_to_puVrms_map );
+
+    // Runs num_steps steps of time_step_sec in one call with pu_Vrms held constant
+    // (one value per registered grid node).  Step k covers
+    // [start_unix_time + k*time_step_sec, start_unix_time + (k+1)*time_step_sec].
+    // The result vectors are reused when the same result object is passed again.
+    // Throws std::invalid_argument when no grid nodes are registered, num_steps is
+    // negative or time_step_sec is not positive.
+    void advance( const double start_unix_time,
+                  const int num_steps,
+                  const double time_step_sec,
+                  const double* pu_Vrms,
+                  const bool return_time_series,
+                  grid_nodes_advance_result& result );
+
+    grid_nodes_advance_result advance( const double start_unix_time,
+                                       const int num_steps,
+                                       const double time_step_sec,
+                                       const std::vector<double>& pu_Vrms,
+                                       const bool return_time_series );
+
+    //---------------------------------------------
+    //  Trial steps for iterative power flow
+    //---------------------------------------------
+    // get_trial_charging_power_by_index works like get_charging_power_by_index, but the
+    // first call saves the state of the SEs it touches.  Every further call with the same
+    // prev_unix_time and now_unix_time starts again from the saved state, so candidate
+    // voltages can be evaluated until the power flow converges.  commit_trial_step keeps
+    // the state of the last trial, rollback_trial_step goes back to the saved state.
+    // No other stepping function can be called while a trial step is open.
+    void get_trial_charging_power_by_index( const double prev_unix_time,
+                                            const double now_unix_time,
+                                            const double* pu_Vrms,
+                                            double* P3_kW,
+                                            double* Q3_kVAR );
+    void commit_trial_step();
+    void rollback_trial_step();
+    bool has_open_trial_step() const;
+
+    //---------------------------------------------
+    //  Checkpoints
+    //---------------------------------------------
+    // save_checkpoint copies the mutable state (see interface_to_SE_groups_checkpoint).
+    // restore_checkpoint puts it back and can be called any number of times, so several
+    // what-if runs can branch from one warm-up.  It also restores into a new interface
+    // built from the same inputs and SE groups.  Neither can be called during a trial step.
+    std::shared_ptr<interface_to_SE_groups_checkpoint> save_checkpoint();
+    void restore_checkpoint( const std::shared_ptr<interface_to_SE_groups_checkpoint>& checkpoint );
+
     // "pu_Vrms" means "per unit voltage root mean squared"
     SE_power get_SE_power(SE_id_type SE_id, double prev_unix_time, double now_unix_time, double pu_Vrms);
     
@@ -1,10 +1,14 @@
 
 #include "ICM_interface.h"
+#include "factory_registry.h"
 #include "datatypes_global.h"
 #include "inputs.h"
 
 #include <pybind11/pybind11.h>
 #include <pybind11/stl.h>
+#include <pybind11/numpy.h>
+
+#include <stdexcept>
 
 namespace py = pybind11;
 
@@ -17,20 +21,83 @@ PYBIND11_MODULE(Caldera_ICM, m)
     //======================================================= 
     //======================================================= 
     
+    // Opaque to Python, only handed back to restore_checkpoint.
+    py::class_<interface_to_SE_groups_checkpoint, std::shared_ptr<interface_to_SE_groups_checkpoint> >(m, "interface_to_SE_groups_checkpoint");
+    
     py::class_<interface_to_SE_groups>(m, "interface_to_SE_groups")
         .def(py::init<const std::string&, const interface_to_SE_groups_inputs&>())
         //.def("initialize", &interface_to_SE_groups::initialize)
         //.def("initialize_infrastructure", &interface_to_SE_groups::initialize_infrastructure)
         //.def("initialize_baseLD_forecaster", &interface_to_SE_groups::initialize_baseLD_forecaster)
         //.def("initialize_L2_control_strategy_parameters", &interface_to_SE_groups::initialize_L2_control_strategy_parameters)
+        .def("build_charge_profiles", &interface_to_SE_groups::build_charge_profiles)
         .def("add_charge_events", &interface_to_SE_groups::add_charge_events)
         .def("add_charge_events_by_SE_group", &interface_to_SE_groups::add_charge_events_by_SE_group)
         .def("stop_active_charge_events", &interface_to_SE_groups::stop_active_charge_events)
+        .def("get_charge_event_queue_memory_usage", &interface_to_SE_groups::get_charge_event_queue_memory_usage)
+        .def("get_charge_model_allocation_counters", &interface_to_SE_groups::get_charge_model_allocation_counters)
+        .def("set_charge_event_source", &interface_to_SE_groups::set_charge_event_source)
         //.def("set_ensure_pev_charge_needs_met_for_ext_control_strategy", &interface_to_SE_groups::set_ensure_pev_charge_needs_met_for_ext_control_strategy)        
         //.def("get_SE_charge_profile_forecast_akW", &interface_to_SE_groups::get_SE_charge_profile_forecast_akW)
         //.def("get_SE_group_charge_profile_forecast_akW", &interface_to_SE_groups::get_SE_group_charge_profile_forecast_akW)
         .def("get_charging_power", &interface_to_SE_groups::get_charging_power)
+        .def("register_grid_nodes", &interface_to_SE_groups::register_grid_nodes)
+        .def("get_num_registered_grid_nodes", &interface_to_SE_groups::get_num_registered_grid_nodes)
+        .def("get_registered_grid_node_ids", &interface_to_SE_groups::get_registered_grid_node_ids)
+        .def("get_charging_power_by_index", [](interface_to_SE_groups& self,
+                                               const double prev_unix_time,
+                                               const double now_unix_time,
+                                               py::array_t<double, py::array::c_style | py::array::forcecast> pu_Vrms,
+                                               py::array_t<double, py::array::c_style> P3_kW,
+                                               py::array_t<double, py::array::c_style> Q3_kVAR)
+            {
+                // The output arrays are filled in place so no memory is allocated per step.
+                const py::ssize_t num_nodes = self.get_num_registered_grid_nodes();
+                
+                if(pu_Vrms.size() != num_nodes || P3_kW.size() != num_nodes || Q3_kVAR.size() != num_nodes)
+                    throw std::invalid_argument("CALDERA ERROR: get_charging_power_by_index array sizes must equal the number of registered grid nodes.");
+                
+                self.get_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.mutable_data(), Q3_kVAR.mutable_data());
+            },
+            // noconvert: an output array that is not C-contiguous float64 would be copied and the results lost.
+            py::arg("prev_unix_time"), py::arg("now_unix_time"), py::arg("pu_Vrms"), py::arg("P3_kW").noconvert(), py::arg("Q3_kVAR").noconvert())
+        .def("get_charging_power_sensitivity", &interface_to_SE_groups::get_charging_power_sensitivity)
+        .def("get_charging_power_sensitivity_by_index", [](interface_to_SE_groups& self,
+                                                           py::array_t<double, py::array::c_style | py::array::forcecast> pu_Vrms,
+                                                           py::array_t<double, py::array::c_style> dP3_dpuVrms,
+                                                           py::array_t<double, py::array::c_style> dQ3_dpuVrms)
+            {
+                const py::ssize_t num_nodes = self.get_num_registered_grid_nodes();
+                
+                if(pu_Vrms.size() != num_nodes || dP3_dpuVrms.size() != num_nodes || dQ3_dpuVrms.size() != num_nodes)
+                    throw std::invalid_argument("CALDERA ERROR: get_charging_power_sensitivity_by_index array sizes must equal the number of registered grid nodes.");
+                
+                self.get_charging_power_sensitivity_by_index(pu_Vrms.data(), dP3_dpuVrms.mutable_data(), dQ3_dpuVrms.mutable_data());
+            },
+            py::arg("pu_Vrms"), py::arg("dP3_dpuVrms").noconvert(), py::arg("dQ3_dpuVrms").noconvert())
+        .def("get_trial_charging_power_by_index", [](interface_to_SE_groups& self,
+                                                     const double prev_unix_time,
+                                                     const double now_unix_time,
+                                                     py::array_t<double, py::array::c_style | py::array::forcecast> pu_Vrms,
+                                                     py::array_t<double, py::array::c_style> P3_kW,
+                                                     py::array_t<double, py::array::c_style> Q3_kVAR)
+            {
+                const py::ssize_t num_nodes = self.get_num_registered_grid_nodes();
+                
+                if(pu_Vrms.size() != num_nodes || P3_kW.size() != num_nodes || Q3_kVAR.size() != num_nodes)
+                    throw std::invalid_argument("CALDERA ERROR: get_trial_charging_power_by_index array sizes must equal the number of registered grid nodes.");
+                
+                self.get_trial_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.mutable_data(), Q3_kVAR.mutable_data());
+            },
+            py::arg("prev_unix_time"), py::arg("now_unix_time"), py::arg("pu_Vrms"), py::arg("P3_kW").noconvert(), py::arg("Q3_kVAR").noconvert())
+        .def("commit_trial_step", &interface_to_SE_groups::commit_trial_step)
+        .def("rollback_trial_step", &interface_to_SE_groups::rollback_trial_step)
+        .def("has_open_trial_step", &interface_to_SE_groups::has_open_trial_step)
+        .def("fork", &interface_to_SE_groups::fork)
+        .def("save_checkpoint", &interface_to_SE_groups::save_checkpoint)
+        .def("restore_checkpoint", &interface_to_SE_groups::restore_checkpoint)
         //.def("get_SE_power", &interface_to_SE_groups::get_SE_power)
+        .def("advance", py::overload_cast<const double, const int, const double, const std::vector<double>&, const bool>(&interface_to_SE_groups::advance))
         .def("set_PQ_setpoints", &interface_to_SE_groups::set_PQ_setpoints)
         //.def("get_completed_CE", &interface_to_SE_groups::get_completed_CE)
         //.def("get_FICE_by_extCS", &interface_to_SE_groups::get_FICE_by_extCS)
@@ -42,5 +109,11 @@ PYBIND11_MODULE(Caldera_ICM, m)
         .def("get_active_CEs_by_SEids", &interface_to_SE_groups::get_active_CEs_by_SEids)
         .def("ES500_get_charging_needs", &interface_to_SE_groups::ES500_get_charging_needs)
         .def("ES500_set_energy_setpoints", &interface_to_SE_groups::ES500_set_energy_setpoints);
+    
+    // Converts charge events to the binary format read by set_charge_event_source.
+    m.def("write_charge_events_binary_file", &load_charge_events::write_binary_file);
+    
+    // Releases the inventories, factories and charge profile libraries kept for reuse.
+    m.def("clear_factory_registry", &factory_registry::clear);
+    m.def("set_charge_profile_library_cache_dir", &factory_registry::set_charge_profile_library_cache_dir);
 }
-
@@ -9,29 +9,61 @@
 #include "charge_profile_library.h"
 #include "charge_profile_downsample_fragments.h"
 
-#include "factory_supply_equipment_model.h"
-#include "factory_ac_to_dc_converter.h"
-#include "factory_EV_charge_model.h"
-
 #include <cmath>
 #include <vector>
 #include <algorithm>                        // sort
 #include <iostream>                            // cout
+#include <memory>                           // unique_ptr, shared_ptr
+
+
+namespace
+{
+    // Length of the next step of a charge profile simulation.  In event driven integration
+    // the time steps over which the charge draws constant power are merged into one, which
+    // ends a time step short of the next event so the event itself is stepped at time_step_sec.
+    double get_next_time_step_sec( const supply_equipment& SE_obj,
+                                   const double time_step_sec,
+                                   const bool event_driven_integration )
+    {
+        if(!event_driven_integration)
+        {
+            return time_step_sec;
+        }
+        
+        const double num_time_steps = std::floor(SE_obj.get_time_at_constant_power_sec()/time_step_sec) - 1;
+        
+        return (num_time_steps >= 2) ? num_time_steps*time_step_sec : time_step_sec;
+    }
+}
 
 
+//#############################################################################
+//                      Charge Profile Simulation Factories
+//#############################################################################
+
+charge_profile_simulation_factories::charge_profile_simulation_factories( const EV_EVSE_inventory& inventory,
+                                                                          const double c_rate_scale_factor )
+    : SE_factory{ inventory },
+    ac_to_dc_converter_factory{ inventory },
+    charge_profile_library{ inventory },
+    PEV_charge_factory{ inventory, EV_ramping_map{}, EV_EVSE_ramping_map{}, false, c_rate_scale_factor },   // false -> model_stochastic_battery_degregation
+    c_rate_scale_factor{ c_rate_scale_factor }
+{
+}
+
 
 //#############################################################################
 //                      Charge Profile Library Factory
 //#############################################################################
 
-void factory_charge_profile_library::create_charge_fragments_vector( const EV_EVSE_inventory& inventory,
+void factory_charge_profile_library::create_charge_fragments_vector( const charge_profile_simulation_factories& factories,
                                                                      const int charge_event_Id,
                                                                      const double time_step_sec,
                                                                      const double target_acP3_kW,
                                                                      const pev_SE_pair pev_SE,
+                                                                     const bool event_driven_integration,
                                                                      double& max_P3kW,
-                                                                     std::vector<pev_charge_fragment>& charge_fragments,
-                                                                     const double c_rate_scale_factor )
+                                                                     std::vector<pev_charge_fragment>& charge_fragments )
 {
     //std::cout << "time_step_sec: " << time_step_sec << "  target_acP3_kW: " << target_acP3_kW << " EV_type: " << pev_SE.EV_type << " SE_type: " << pev_SE.SE_type << std::endl;
     
@@ -44,20 +76,6 @@ void factory_charge_profile_library::create_charge_fragments_vector( const EV_EV
         return;
     }
     
-    //------------------------
-    //   Create Factories
-    //------------------------
-    factory_supply_equipment_model SE_factory{ inventory };
-    factory_ac_to_dc_converter ac_to_dc_converter_factory{ inventory };
-    pev_charge_profile_library charge_profile_library{ inventory };
-    
-    EV_ramping_map EV_ramping;
-    EV_EVSE_ramping_map EV_EVSE_ramping;
-    bool model_stochastic_battery_degregation = false;
-
-    factory_EV_charge_model PEV_charge_factory{ inventory, EV_ramping, EV_EVSE_ramping, model_stochastic_battery_degregation, c_rate_scale_factor };
-    //PEV_charge_factory.set_bool_model_stochastic_battery_degregation(false);
-
     //------------------------
     //   Create SE Object
     //------------------------
@@ -66,7 +84,7 @@ void factory_charge_profile_library::create_charge_fragments_vector( const EV_EV
     
     bool building_charge_profile_library = true;
     SE_configuration SE_config(1, 1, pev_SE.se_type, 12.2, 9.2, "bus_A", "U");  // (station_id, SE_id, SE_enum, lat, long, grid_node_id, location_type)
-    supply_equipment SE_obj = SE_factory.get_supply_equipment_model(building_charge_profile_library, SE_config, baseLD_forecaster, manage_L2_control, PEV_charge_factory, ac_to_dc_converter_factory, charge_profile_library);
+    supply_equipment SE_obj = factories.SE_factory.get_supply_equipment_model(building_charge_profile_library, SE_config, baseLD_forecaster, manage_L2_control, factories.PEV_charge_factory, factories.ac_to_dc_converter_factory, factories.charge_profile_library);
     
     //------------------------
     //  Create Charge Event
@@ -91,6 +109,7 @@ void factory_charge_profile_library::create_charge_fragments_vector( const EV_EV
     //------------------------
     ac_power_metrics ac_power;
     pev_charge_fragment fragment;
+    fragment.soc = charge_event.arrival_SOC;
     fragment.E1_kWh = 0;
     fragment.E2_kWh = 0;
     fragment.E3_kWh = 0;
@@ -98,12 +117,13 @@ void factory_charge_profile_library::create_charge_fragments_vector( const EV_EV
     
     const double pu_Vrms = 1.0;
     double now_unix_time = arrival_unix_time - 3*time_step_sec;
+    double step_sec = time_step_sec;
     bool SE_targets_have_been_initialized = false;
     double soc;
     
     while(true)
     {
-        SE_obj.get_next(now_unix_time-time_step_sec, now_unix_time, pu_Vrms, soc, ac_power);
+        SE_obj.get_next(now_unix_time-step_sec, now_unix_time, pu_Vrms, soc, ac_power);
         SE_status status_obj = SE_obj.get_SE_status();
         
         if(!SE_targets_have_been_initialized)
@@ -127,23 +147,34 @@ void factory_charge_profile_library::create_charge_fragments_vector( const EV_EV
                 max_P3kW = ac_power.P3_kW;
             }
 
-            fragment.soc = status_obj.current_charge.now_soc;
-            fragment.E1_kWh += ac_power.P1_kW * ac_power.time_step_duration_hrs;
-            fragment.E2_kWh += ac_power.P2_kW * ac_power.time_step_duration_hrs;
-            fragment.E3_kWh += ac_power.P3_kW * ac_power.time_step_duration_hrs;
-            fragment.cumQ3_kVARh += ac_power.Q3_kVAR * ac_power.time_step_duration_hrs;
-            fragment.time_since_charge_began_hrs = (now_unix_time - arrival_unix_time)/3600;
-            charge_fragments.push_back(fragment);
+            // Constant power over a merged step, so it is written out as the time steps it
+            // stands for with the soc linear in time, as in factory_charge_profile_library_v2.
+            const int num_time_steps = (int)std::lround(step_sec/time_step_sec);
+            const double start_soc_val = fragment.soc;
+            const double time_step_hrs = (num_time_steps == 1) ? ac_power.time_step_duration_hrs : time_step_sec/3600;
+            
+            for(int i = 1; i <= num_time_steps; i++)
+            {
+                fragment.soc = (i == num_time_steps) ? status_obj.current_charge.now_soc : start_soc_val + (status_obj.current_charge.now_soc - start_soc_val)*i/num_time_steps;
+                fragment.E1_kWh += ac_power.P1_kW * time_step_hrs;
+                fragment.E2_kWh += ac_power.P2_kW * time_step_hrs;
+                fragment.E3_kWh += ac_power.P3_kW * time_step_hrs;
+                fragment.cumQ3_kVARh += ac_power.Q3_kVAR * time_step_hrs;
+                fragment.time_since_charge_began_hrs = (now_unix_time - (num_time_steps - i)*time_step_sec - arrival_unix_time)/3600;
+                charge_fragments.push_back(fragment);
+            }
         }
         
-        now_unix_time += time_step_sec;
+        step_sec = get_next_time_step_sec(SE_obj, time_step_sec, event_driven_integration);
+        now_unix_time += step_sec;
     }
 }
 
 
-double factory_charge_profile_library::get_max_P3kW( const EV_EVSE_inventory& inventory,
+double factory_charge_profile_library::get_max_P3kW( const charge_profile_simulation_factories& factories,
                                                      const double time_step_sec,
-                                                     const pev_SE_pair pev_SE )
+                                                     const pev_SE_pair pev_SE,
+                                                     const bool event_driven_integration )
 {
     std::vector<pev_charge_fragment> charge_fragments;
     double max_P3kW;
@@ -151,7 +182,7 @@ double factory_charge_profile_library::get_max_P3kW( const EV_EVSE_inventory& in
     int charge_event_Id = 1000;
     
     // Compute 'max_P3kW'.
-    factory_charge_profile_library::create_charge_fragments_vector(inventory, charge_event_Id, time_step_sec, target_acP3_kW, pev_SE, max_P3kW, charge_fragments);
+    factory_charge_profile_library::create_charge_fragments_vector(factories, charge_event_Id, time_step_sec, target_acP3_kW, pev_SE, event_driven_integration, max_P3kW, charge_fragments);
     
     // Return the result.
     return max_P3kW;
@@ -275,19 +306,20 @@ void factory_charge_profile_library::get_charge_profile_aux_parameters( const do
 }
 
 
-pev_charge_profile_aux factory_charge_profile_library::get_pev_charge_profile_aux( const EV_EVSE_inventory& inventory,
+pev_charge_profile_aux factory_charge_profile_library::get_pev_charge_profile_aux( const charge_profile_simulation_factories& factories,
                                                                                    const int charge_event_Id,
                                                                                    const bool save_validation_data,
                                                                                    const double time_step_sec,
                                                                                    const double target_acP3_kW,
                                                                                    const pev_SE_pair pev_SE,
                                                                                    const pev_charge_fragment_removal_criteria fragment_removal_criteria,
+                                                                                   const bool event_driven_integration,
                                                                                    double& max_P3kW,
                                                                                    std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> >& validation_data )
 {
     std::vector<pev_charge_fragment> original_charge_fragments, downsampled_charge_fragments;
     
-    factory_charge_profile_library::create_charge_fragments_vector(inventory, charge_event_Id, time_step_sec, target_acP3_kW, pev_SE, max_P3kW, original_charge_fragments);
+    factory_charge_profile_library::create_charge_fragments_vector(factories, charge_event_Id, time_step_sec, target_acP3_kW, pev_SE, event_driven_integration, max_P3kW, original_charge_fragments);
 
     downsample_charge_fragment_vector downsample_obj(fragment_removal_criteria);
     downsample_obj.downsample(original_charge_fragments, downsampled_charge_fragments);
@@ -319,10 +351,53 @@ pev_charge_profile_aux factory_charge_profile_library::get_pev_charge_profile_au
 }
 
 
+void factory_charge_profile_library::get_charge_profile_parameters( const charge_profile_simulation_factories& factories,
+                                                                    const EV_EVSE_inventory& inventory,
+                                                                    const pev_SE_pair pev_SE,
+                                                                    const bool event_driven_integration,
+                                                                    std::vector<double>& time_step_sec,
+                                                                    std::vector<double>& target_acP3_kW,
+                                                                    std::vector<pev_charge_fragment_removal_criteria>& fragment_removal_criteria )
+{
+    double get_max_time_step_sec;
+    
+    if( inventory.get_EVSE_inventory().at(pev_SE.se_type).get_level() == EVSE_level::L1 )
+    {
+        get_max_time_step_sec = 60;
+    }
+    else if( inventory.get_EVSE_inventory().at(pev_SE.se_type).get_level() == EVSE_level::L2 )
+    {
+        get_max_time_step_sec = 30;
+    }
+    else
+    {
+        get_max_time_step_sec = 1;
+    }
+    
+    const double max_target_P3kW = factory_charge_profile_library::get_max_P3kW(factories, get_max_time_step_sec, pev_SE, event_driven_integration);
+    
+    factory_charge_profile_library::get_charge_profile_aux_parameters( max_target_P3kW, pev_SE, time_step_sec, target_acP3_kW, fragment_removal_criteria );
+}
+
+
+pev_charge_profile factory_charge_profile_library::get_pev_charge_profile( const EV_EVSE_inventory& inventory,
+                                                                           const double max_P3kW,
+                                                                           const pev_SE_pair pev_SE,
+                                                                           const std::vector<pev_charge_profile_aux>& charge_profiles_aux )
+{
+    charge_event_P3kW_limits CE_P3kW_limits;
+    CE_P3kW_limits.max_P3kW = max_P3kW;
+    CE_P3kW_limits.min_P3kW = factory_charge_profile_library::get_min_P3kW( inventory, max_P3kW, pev_SE );
+    
+    return pev_charge_profile(pev_SE.ev_type, pev_SE.se_type, CE_P3kW_limits, charge_profiles_aux);
+}
+
+
 pev_charge_profile_library factory_charge_profile_library::get_charge_profile_library( const EV_EVSE_inventory& inventory,
                                                                                        const bool save_validation_data,
                                                                                        const bool create_charge_profile_library,
-                                                                                       std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> >& validation_data )
+                                                                                       std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> >& validation_data,
+                                                                                       const bool event_driven_integration )
 {
     if( save_validation_data )
     {
@@ -335,74 +410,119 @@ pev_charge_profile_library factory_charge_profile_library::get_charge_profile_li
 
     if(create_charge_profile_library)
     {
+        // Every charge profile simulation builds its own SE from the shared factories, so
+        // the simulations run in parallel.  Ids and results are assigned by position in
+        // all_pev_SE_pairs, so the library does not depend on the thread count.
+        
+        const charge_profile_simulation_factories factories{ inventory };
+        
         const std::vector<pev_SE_pair>& all_pev_SE_pairs = inventory.get_all_compatible_pev_SE_combinations();
+        const int num_pev_SE_pairs = (int)all_pev_SE_pairs.size();
+        
+        //-------------------------------------
+        //  Parameters of each (EV, EVSE) pair
+        //-------------------------------------
         
+        std::vector<std::vector<double> > time_step_sec(num_pev_SE_pairs);
+        std::vector<std::vector<double> > target_acP3_kW(num_pev_SE_pairs);
+        std::vector<std::vector<pev_charge_fragment_removal_criteria> > fragment_removal_criteria(num_pev_SE_pairs);
+        
+        #pragma omp parallel for schedule(dynamic, 1)
+        for(int pair_index = 0; pair_index < num_pev_SE_pairs; pair_index++)
+        {
+            factory_charge_profile_library::get_charge_profile_parameters( factories, inventory, all_pev_SE_pairs[pair_index], event_driven_integration, time_step_sec[pair_index], target_acP3_kW[pair_index], fragment_removal_criteria[pair_index] );
+        }
+        
+        //-------------------------------------
+        //  One task per (pair, setpoint)
+        //-------------------------------------
+        
+        struct charge_profile_task
+        {
+            int pair_index;
+            int setpoint_index;
+            int charge_event_Id;
+        };
+        
+        std::vector<charge_profile_task> tasks;
+        std::vector<int> first_task_index(num_pev_SE_pairs);
         int charge_event_Id = 1000;
-        double get_max_time_step_sec;
         
-        for(const pev_SE_pair& pev_SE : all_pev_SE_pairs)
+        for(int pair_index = 0; pair_index < num_pev_SE_pairs; pair_index++)
         {
-            if( inventory.get_EVSE_inventory().at(pev_SE.se_type).get_level() == EVSE_level::L1 )
-            {
-                get_max_time_step_sec = 60;
-            }
-            else if( inventory.get_EVSE_inventory().at(pev_SE.se_type).get_level() == EVSE_level::L2 )
-            {
-                get_max_time_step_sec = 30;
-            }
-            else
+            first_task_index[pair_index] = (int)tasks.size();
+            
+            for(int i = 0; i < (int)time_step_sec[pair_index].size(); i++)
             {
-                get_max_time_step_sec = 1;
+                charge_event_Id += 1;
+                tasks.push_back({ pair_index, i, charge_event_Id });
             }
+        }
+        
+        const int num_tasks = (int)tasks.size();
+        
+        std::vector<std::unique_ptr<pev_charge_profile_aux> > charge_profiles_aux(num_tasks);
+        std::vector<double> max_P3kW_by_task(num_tasks, 0);
+        std::vector<std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > > validation_data_by_task(save_validation_data ? num_tasks : 0);
+        
+        #pragma omp parallel for schedule(dynamic, 1)
+        for(int task_index = 0; task_index < num_tasks; task_index++)
+        {
+            const charge_profile_task& task = tasks[task_index];
+            const int pair_index = task.pair_index;
+            const int i = task.setpoint_index;
             
-            const double max_target_P3kW = factory_charge_profile_library::get_max_P3kW(inventory, get_max_time_step_sec, pev_SE);
-            
-            //-----------------------
-            
-            std::vector<double> time_step_sec;
-            std::vector<double> target_acP3_kW;
-            std::vector<pev_charge_fragment_removal_criteria> fragment_removal_criteria;
-            
-            factory_charge_profile_library::get_charge_profile_aux_parameters( max_target_P3kW, pev_SE, time_step_sec, target_acP3_kW, fragment_removal_criteria );
+            std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > dummy_validation_data;
             
-            //-----------------------
+            charge_profiles_aux[task_index] = std::make_unique<pev_charge_profile_aux>(
+                factory_charge_profile_library::get_pev_charge_profile_aux( factories,
+                                                                            task.charge_event_Id,
+                                                                            save_validation_data,
+                                                                            time_step_sec[pair_index].at(i),
+                                                                            target_acP3_kW[pair_index].at(i),
+                                                                            all_pev_SE_pairs[pair_index],
+                                                                            fragment_removal_criteria[pair_index].at(i),
+                                                                            event_driven_integration,
+                                                                            max_P3kW_by_task[task_index],
+                                                                            save_validation_data ? validation_data_by_task[task_index] : dummy_validation_data )
+            );
+        }
+        
+        //-------------------------------------
+        //  Assemble in pair order
+        //-------------------------------------
+        
+        for(int pair_index = 0; pair_index < num_pev_SE_pairs; pair_index++)
+        {
+            const pev_SE_pair& pev_SE = all_pev_SE_pairs[pair_index];
+            const int begin = first_task_index[pair_index];
+            const int end = begin + (int)time_step_sec[pair_index].size();
             
             std::vector<pev_charge_profile_aux> charge_profiles_aux_vector;
-            
             double max_P3kW = 0;
-            double max_P3kW_tmp;
             
-            for( int i = 0; i < time_step_sec.size(); i++ )
+            for(int task_index = begin; task_index < end; task_index++)
             {
-                charge_event_Id += 1;
-                charge_profiles_aux_vector.push_back(
-                    factory_charge_profile_library::get_pev_charge_profile_aux( inventory,
-                                                                                charge_event_Id,
-                                                                                save_validation_data,
-                                                                                time_step_sec.at(i),
-                                                                                target_acP3_kW.at(i),
-                                                                                pev_SE,
-                                                                                fragment_removal_criteria.at(i),
-                                                                                max_P3kW_tmp,
-                                                                                validation_data )
-                );
-            
-                if(max_P3kW_tmp > max_P3kW)
+                charge_profiles_aux_vector.push_back(std::move(*charge_profiles_aux[task_index]));
+                
+                if(max_P3kW_by_task[task_index] > max_P3kW)
                 {
-                    max_P3kW = max_P3kW_tmp;
+                    max_P3kW = max_P3kW_by_task[task_index];
+                }
+                
+                if(save_validation_data)
+                {
+                    for(std::pair<const std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> >& X : validation_data_by_task[task_index])
+                    {
+                        std::vector<charge_profile_validation_data>& Y = validation_data[X.first];
+                        Y.insert(Y.end(), X.second.begin(), X.second.end());
+                    }
                 }
             }
             
             //-----------------------
             
-            charge_event_P3kW_limits CE_P3kW_limits;
-            CE_P3kW_limits.max_P3kW = max_P3kW;
-            CE_P3kW_limits.min_P3kW = factory_charge_profile_library::get_min_P3kW( inventory, max_P3kW, pev_SE );
-            
-            //-----------------------
-
-            pev_charge_profile charge_profile(pev_SE.ev_type, pev_SE.se_type, CE_P3kW_limits, charge_profiles_aux_vector);
-            return_val.add_charge_profile_to_library(pev_SE.ev_type, pev_SE.se_type, charge_profile);
+            return_val.add_charge_profile_to_library(pev_SE.ev_type, pev_SE.se_type, factory_charge_profile_library::get_pev_charge_profile(inventory, max_P3kW, pev_SE, charge_profiles_aux_vector));
         }
     }
 
@@ -411,6 +531,66 @@ pev_charge_profile_library factory_charge_profile_library::get_charge_profile_li
 
 
 
+pev_charge_profile factory_charge_profile_library::get_charge_profile( const charge_profile_simulation_factories& factories,
+                                                                       const EV_EVSE_inventory& inventory,
+                                                                       const pev_SE_pair pev_SE,
+                                                                       const bool event_driven_integration )
+{
+    std::vector<double> time_step_sec;
+    std::vector<double> target_acP3_kW;
+    std::vector<pev_charge_fragment_removal_criteria> fragment_removal_criteria;
+    
+    factory_charge_profile_library::get_charge_profile_parameters( factories, inventory, pev_SE, event_driven_integration, time_step_sec, target_acP3_kW, fragment_removal_criteria );
+    
+    //-----------------------------------
+    
+    std::vector<pev_charge_profile_aux> charge_profiles_aux_vector;
+    std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > dummy_validation_data;
+    const bool save_validation_data = false;
+    double max_P3kW = 0;
+    
+    for(int i = 0; i < (int)time_step_sec.size(); i++)
+    {
+        double setpoint_max_P3kW = 0;
+        const int charge_event_Id = 1001 + i;
+        
+        charge_profiles_aux_vector.push_back(
+            factory_charge_profile_library::get_pev_charge_profile_aux( factories,
+                                                                        charge_event_Id,
+                                                                        save_validation_data,
+                                                                        time_step_sec[i],
+                                                                        target_acP3_kW[i],
+                                                                        pev_SE,
+                                                                        fragment_removal_criteria[i],
+                                                                        event_driven_integration,
+                                                                        setpoint_max_P3kW,
+                                                                        dummy_validation_data )
+        );
+        
+        if(setpoint_max_P3kW > max_P3kW)
+        {
+            max_P3kW = setpoint_max_P3kW;
+        }
+    }
+    
+    return factory_charge_profile_library::get_pev_charge_profile(inventory, max_P3kW, pev_SE, charge_profiles_aux_vector);
+}
+
+
+pev_charge_profile_library factory_charge_profile_library::get_lazy_charge_profile_library( const EV_EVSE_inventory& inventory,
+                                                                                            const bool event_driven_integration )
+{
+    // The builder owns the factories, the library can outlive this call and is used from
+    // the threads of the simulation.  The factories are read only after construction.
+    const std::shared_ptr<const charge_profile_simulation_factories> factories = std::make_shared<const charge_profile_simulation_factories>(inventory);
+    
+    return pev_charge_profile_library( inventory, [factories, &inventory, event_driven_integration]( const pev_SE_pair& pev_SE )
+    {
+        return factory_charge_profile_library::get_charge_profile(*factories, inventory, pev_SE, event_driven_integration);
+    });
+}
+
+
 std::vector<pev_charge_fragment> factory_charge_profile_library::USE_FOR_DEBUG_PURPOSES_ONLY_get_raw_charge_profile( const EV_EVSE_inventory& inventory,
                                                                                                                      const double time_step_sec,
                                                                                                                      const double target_acP3_kW,
@@ -421,10 +601,11 @@ std::vector<pev_charge_fragment> factory_charge_profile_library::USE_FOR_DEBUG_P
     pev_SE.ev_type = pev_type;
     pev_SE.se_type = SE_type;
     
+    const charge_profile_simulation_factories factories{ inventory };
     double max_P3kW;
     int charge_event_Id = 1000;
     std::vector<pev_charge_fragment> return_val;    
-    create_charge_fragments_vector(inventory, charge_event_Id, time_step_sec, target_acP3_kW, pev_SE, max_P3kW, return_val);
+    create_charge_fragments_vector(factories, charge_event_Id, time_step_sec, target_acP3_kW, pev_SE, false, max_P3kW, return_val);  // false -> event_driven_integration
     
     return return_val;
 }
@@ -446,6 +627,21 @@ void factory_charge_profile_library_v2::create_charge_profile( const EV_EVSE_inv
                                                                std::vector<double>& soc,
                                                                std::vector<ac_power_metrics>& charge_profile,
                                                                const double c_rate_scale_factor )
+{
+    const charge_profile_simulation_factories factories{ inventory, c_rate_scale_factor };
+    factory_charge_profile_library_v2::create_charge_profile( factories, time_step_sec, pev_SE, start_soc, end_soc, target_acP3_kW, soc, charge_profile );
+}
+
+
+void factory_charge_profile_library_v2::create_charge_profile( const charge_profile_simulation_factories& factories,
+                                                               const double time_step_sec,
+                                                               const pev_SE_pair pev_SE,
+                                                               const double start_soc,
+                                                               const double end_soc,
+                                                               const double target_acP3_kW,
+                                                               std::vector<double>& soc,
+                                                               std::vector<ac_power_metrics>& charge_profile,
+                                                               const bool event_driven_integration )
 {
     charge_profile.clear();
     soc.clear();
@@ -457,20 +653,6 @@ void factory_charge_profile_library_v2::create_charge_profile( const EV_EVSE_inv
         return;
     }
     
-    //------------------------
-    //   Create Factories
-    //------------------------
-    factory_supply_equipment_model SE_factory{ inventory };
-    factory_ac_to_dc_converter ac_to_dc_converter_factory{inventory};
-    pev_charge_profile_library charge_profile_library{ inventory }; // Is needed in SE_obj
-    
-    EV_ramping_map EV_ramping;
-    EV_EVSE_ramping_map EV_EVSE_ramping;
-    bool model_stochastic_battery_degregation = false;
-
-    // This is where a whole bunch of stuff happens.
-    factory_EV_charge_model PEV_charge_factory{ inventory, EV_ramping, EV_EVSE_ramping, model_stochastic_battery_degregation, c_rate_scale_factor };
-
     //------------------------
     //   Create SE Object
     //------------------------
@@ -479,7 +661,7 @@ void factory_charge_profile_library_v2::create_charge_profile( const EV_EVSE_inv
     
     bool building_charge_profile_library = true;
     SE_configuration SE_config(1, 1, pev_SE.se_type, 12.2, 9.2, "bus_A", "U");  // (station_id, SE_id, SE_enum, lat, long, grid_node_id, location_type)
-    supply_equipment SE_obj = SE_factory.get_supply_equipment_model(building_charge_profile_library, SE_config, baseLD_forecaster, manage_L2_control, PEV_charge_factory, ac_to_dc_converter_factory, charge_profile_library);
+    supply_equipment SE_obj = factories.SE_factory.get_supply_equipment_model(building_charge_profile_library, SE_config, baseLD_forecaster, manage_L2_control, factories.PEV_charge_factory, factories.ac_to_dc_converter_factory, factories.charge_profile_library);
     
     //------------------------
     //  Create Charge Event
@@ -506,6 +688,7 @@ void factory_charge_profile_library_v2::create_charge_profile( const EV_EVSE_inv
     
     double pu_Vrms = 1.0;
     double now_unix_time = arrival_unix_time - 3*time_step_sec;
+    double step_sec = time_step_sec;
     bool SE_targets_have_been_initialized = false;
     SE_status status_obj;
     double soc_val;
@@ -513,7 +696,7 @@ void factory_charge_profile_library_v2::create_charge_profile( const EV_EVSE_inv
     while(true)
     {
         // Get the next value of 'soc_val' and 'ac_power'.
-        SE_obj.get_next(now_unix_time-time_step_sec, now_unix_time, pu_Vrms, soc_val, ac_power);
+        SE_obj.get_next(now_unix_time-step_sec, now_unix_time, pu_Vrms, soc_val, ac_power);
         
         // Get the status.
         status_obj = SE_obj.get_SE_status();
@@ -532,11 +715,29 @@ void factory_charge_profile_library_v2::create_charge_profile( const EV_EVSE_inv
         
         if(status_obj.SE_charging_status_val == SE_charging_status::ev_charging || status_obj.SE_charging_status_val == SE_charging_status::ev_plugged_in_not_charging)
         {
-            charge_profile.push_back(ac_power);
-            soc.push_back(soc_val);
+            const int num_time_steps = (int)std::lround(step_sec/time_step_sec);
+            
+            if(num_time_steps == 1)
+            {
+                charge_profile.push_back(ac_power);
+                soc.push_back(soc_val);
+            }
+            else
+            {
+                // Constant power over the merged step, so the soc is linear in time.
+                const double start_soc_val = soc.back();
+                ac_power.time_step_duration_hrs = time_step_sec/3600;
+                
+                for(int i = 1; i <= num_time_steps; i++)
+                {
+                    charge_profile.push_back(ac_power);
+                    soc.push_back(start_soc_val + (soc_val - start_soc_val)*i/num_time_steps);
+                }
+            }
         }
         
-        now_unix_time += time_step_sec;
+        step_sec = get_next_time_step_sec(SE_obj, time_step_sec, event_driven_integration);
+        now_unix_time += step_sec;
     }
 }
 
@@ -545,7 +746,8 @@ pev_charge_profile_library_v2 factory_charge_profile_library_v2::get_charge_prof
                                                                                              const double L1_timestep_sec,
                                                                                              const double L2_timestep_sec,
                                                                                              const double HPC_timestep_sec,
-                                                                                             const std::vector<double> c_rate_scale_factor_levels )
+                                                                                             const std::vector<double> c_rate_scale_factor_levels,
+                                                                                             const bool event_driven_integration )
 {
     pev_charge_profile_library_v2 return_val{ inventory, c_rate_scale_factor_levels };
     std::vector<pev_SE_pair> all_pev_SE_pairs = inventory.get_all_compatible_pev_SE_combinations();
@@ -557,6 +759,13 @@ pev_charge_profile_library_v2 factory_charge_profile_library_v2::get_charge_prof
     const double start_soc = 0;
     const double end_soc = 100;
     
+    // One set of factories per c-rate, shared by all pairs.
+    std::vector<std::unique_ptr<const charge_profile_simulation_factories> > factories_by_c_rate;
+    for( const double c_rate_scale_factor : c_rate_scale_factor_levels )
+    {
+        factories_by_c_rate.push_back( std::make_unique<const charge_profile_simulation_factories>( inventory, c_rate_scale_factor ) );
+    }
+    
     for( pev_SE_pair pev_SE : all_pev_SE_pairs )
     {
         const double time_step_sec = [&] () {
@@ -579,7 +788,7 @@ pev_charge_profile_library_v2 factory_charge_profile_library_v2::get_charge_prof
         for( int crsf_i = 0; crsf_i < c_rate_scale_factor_levels.size(); crsf_i++ )
         {
             // "soc" and "charge_profile" are initialized by calling this function.
-            factory_charge_profile_library_v2::create_charge_profile( inventory, time_step_sec, pev_SE, start_soc, end_soc, target_acP3_kW, soc, charge_profile, c_rate_scale_factor_levels.at(crsf_i) );
+            factory_charge_profile_library_v2::create_charge_profile( *factories_by_c_rate.at(crsf_i), time_step_sec, pev_SE, start_soc, end_soc, target_acP3_kW, soc, charge_profile, event_driven_integration );
             
             // Put the charge profile in the library.
             return_val.add_charge_PkW_profile_to_library( pev_SE.ev_type, pev_SE.se_type, crsf_i, time_step_sec, soc, charge_profile );
@@ -590,27 +799,25 @@ pev_charge_profile_library_v2 factory_charge_profile_library_v2::get_charge_prof
 }
 
 
-all_charge_profile_data factory_charge_profile_library_v2::build_all_charge_profile_data_for_specific_pev_SE_pair( const EV_EVSE_inventory& inventory,
+all_charge_profile_data factory_charge_profile_library_v2::build_all_charge_profile_data_for_specific_pev_SE_pair( const charge_profile_simulation_factories& factories,
                                                                                                                    const double timestep_sec,
                                                                                                                    pev_SE_pair pev_SE,
                                                                                                                    const double start_soc,
                                                                                                                    const double end_soc,
-                                                                                                                   const double target_acP3_kW,
-                                                                                                                   const double c_rate_scale_factor )
+                                                                                                                   const double target_acP3_kW )
 {
     std::vector<double> soc_vec;
     std::vector<ac_power_metrics> charge_profile_vec;
     
     factory_charge_profile_library_v2::create_charge_profile(
-        inventory,                        // const EV_EVSE_inventory& inventory, 
+        factories,                        // const charge_profile_simulation_factories& factories,
         timestep_sec,                     // const double time_step_sec,
         pev_SE,                           // const pev_SE_pair pev_SE,
         start_soc,                        // const double start_soc,
         end_soc,                          // const double end_soc,
         target_acP3_kW,                   // const double target_acP3_kW,
         soc_vec,                          // std::vector<double>& soc,
-        charge_profile_vec,               // std::vector<ac_power_metrics>& charge_profile,
-        c_rate_scale_factor               // const double c_rate_scale_factor
+        charge_profile_vec                // std::vector<ac_power_metrics>& charge_profile
     );
     
     // Construct a 'all_charge_profile_data' object.
@@ -670,14 +877,15 @@ void factory_charge_profile_library_v2::collect_power_profiles( const EV_EVSE_in
         const double c_rate_scale_factor = c_rate_scale_factor_levels.at(i);
         
         // Generate the profile data.
+        const charge_profile_simulation_factories factories{ inventory, c_rate_scale_factor };
+        
         const all_charge_profile_data all_profile_data = factory_charge_profile_library_v2::build_all_charge_profile_data_for_specific_pev_SE_pair(
-                                                                                                                        inventory,
+                                                                                                                        factories,
                                                                                                                         timestep_sec,
                                                                                                                         pev_SE,
                                                                                                                         start_soc,
                                                                                                                         end_soc,
-                                                                                                                        target_acP3_kW,
-                                                                                                                        c_rate_scale_factor );
+                                                                                                                        target_acP3_kW );
         // Add the 'all_charge_profile_data' to the vector.
         all_charge_profile_data_vec.push_back( all_profile_data );
     }
@@ -15,10 +15,38 @@
 #include "EVSE_characteristics.h"
 #include "EV_EVSE_inventory.h"
 #include "factory_charging_transitions.h"
+#include "factory_supply_equipment_model.h"         // factory_supply_equipment_model
+#include "factory_ac_to_dc_converter.h"             // factory_ac_to_dc_converter
+#include "factory_EV_charge_model.h"                // factory_EV_charge_model
+#include "charge_profile_library.h"                 // pev_charge_profile_library
 
 #include <tuple>
 
 
+//#############################################################################
+//                      Charge Profile Simulation Factories
+//#############################################################################
+
+// The factories a charge profile simulation builds its SE from.  They depend only on
+// the inventory and the c-rate scale factor, so one set is built per c-rate and shared
+// (read only, also across threads) by every profile simulated with it.
+
+class charge_profile_simulation_factories
+{
+public:
+    const factory_supply_equipment_model SE_factory;
+    const factory_ac_to_dc_converter ac_to_dc_converter_factory;
+    const pev_charge_profile_library charge_profile_library;    // Empty, is needed by the SE
+    const factory_EV_charge_model PEV_charge_factory;
+    const double c_rate_scale_factor;
+    
+    charge_profile_simulation_factories( const EV_EVSE_inventory& inventory, const double c_rate_scale_factor = 1.0 );
+    
+    charge_profile_simulation_factories( const charge_profile_simulation_factories& ) = delete;
+    charge_profile_simulation_factories& operator=( const charge_profile_simulation_factories& ) = delete;
+};
+
+
 //#############################################################################
 //                      Charge Profile Library Factory
 //#############################################################################
@@ -26,22 +54,87 @@
 class factory_charge_profile_library
 {
 private:
-    const EV_EVSE_inventory& inventory;
-
-    std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > validation_data;
+    static void create_charge_fragments_vector( const charge_profile_simulation_factories& factories,
+                                                const int charge_event_Id,
+                                                const double time_step_sec,
+                                                const double target_acP3_kW,
+                                                const pev_SE_pair pev_SE,
+                                                const bool event_driven_integration,
+                                                double& max_P3kW,
+                                                std::vector<pev_charge_fragment>& charge_fragments );
     
-    void create_charge_fragments_vector(int charge_event_Id, double time_step_sec, double target_acP3_kW, pev_SE_pair pev_SE, double& max_P3kW, std::vector<pev_charge_fragment>& charge_fragments);
-    double get_max_P3kW(double time_step_sec, pev_SE_pair pev_SE);
-    double get_min_P3kW(double max_P3kW, pev_SE_pair pev_SE);
-    void get_charge_profile_aux_parameters(double max_P3kW, pev_SE_pair pev_SE, std::vector<double>& time_step_sec, std::vector<double>& target_acP3_kW, std::vector<pev_charge_fragment_removal_criteria>& fragment_removal_criteria);
-    pev_charge_profile_aux get_pev_charge_profile_aux(int charge_event_Id, bool save_validation_data, double time_step_sec, double target_acP3_kW, pev_SE_pair pev_SE, pev_charge_fragment_removal_criteria fragment_removal_criteria, double& max_P3kW);
+    static double get_max_P3kW( const charge_profile_simulation_factories& factories, const double time_step_sec, const pev_SE_pair pev_SE, const bool event_driven_integration );
+    static double get_min_P3kW( const EV_EVSE_inventory& inventory, const double max_P3kW, const pev_SE_pair pev_SE );
+    
+    static void get_charge_profile_aux_parameters( const double max_P3kW,
+                                                   const pev_SE_pair pev_SE,
+                                                   std::vector<double>& time_step_sec,
+                                                   std::vector<double>& target_acP3_kW,
+                                                   std::vector<pev_charge_fragment_removal_criteria>& fragment_removal_criteria );
+    
+    // The time steps, setpoints and removal criteria of the profile simulations of one pair.
+    static void get_charge_profile_parameters( const charge_profile_simulation_factories& factories,
+                                               const EV_EVSE_inventory& inventory,
+                                               const pev_SE_pair pev_SE,
+                                               const bool event_driven_integration,
+                                               std::vector<double>& time_step_sec,
+                                               std::vector<double>& target_acP3_kW,
+                                               std::vector<pev_charge_fragment_removal_criteria>& fragment_removal_criteria );
+    
+    static pev_charge_profile get_pev_charge_profile( const EV_EVSE_inventory& inventory,
+                                                      const double max_P3kW,
+                                                      const pev_SE_pair pev_SE,
+                                                      const std::vector<pev_charge_profile_aux>& charge_profiles_aux );
+    
+    static pev_charge_profile_aux get_pev_charge_profile_aux( const charge_profile_simulation_factories& factories,
+                                                              const int charge_event_Id,
+                                                              const bool save_validation_data,
+                                                              const double time_step_sec,
+                                                              const double target_acP3_kW,
+                                                              const pev_SE_pair pev_SE,
+                                                              const pev_charge_fragment_removal_criteria fragment_removal_criteria,
+                                                              const bool event_driven_integration,
+                                                              double& max_P3kW,
+                                                              std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> >& validation_data );
     
 public:
-    factory_charge_profile_library(const EV_EVSE_inventory& inventory) : inventory{ inventory } {};
-    pev_charge_profile_library  get_charge_profile_library(bool save_validation_data, bool create_charge_profile_library);
+    // The profile simulations of all (EV, EVSE) pairs and setpoints run in parallel (OpenMP).
+    // The result is the same for any number of threads, since every profile is simulated on
+    // its own and the downsampling breaks ties by fragment order.
+    //
+    // With event_driven_integration the simulations step over the time a charge draws
+    // constant power in one step, from event to event (a change of the limiting P2_vs_soc
+    // segment, the start of a ramp, the stop of the charge), instead of every time step.
+    // Ramps and the taper along a sloped P2_vs_soc segment are still simulated every time
+    // step: there the ramping trails the moving limit by a few 1e-4 of P2 on average, which
+    // a closed form jump along the limit would not.  A merged step is written out as the
+    // time steps it stands for, with the soc interpolated along the stretch, so the
+    // downsampling sees the same fragments and the library matches the fixed step one up
+    // to round off.
+    static pev_charge_profile_library get_charge_profile_library( const EV_EVSE_inventory& inventory,
+                                                                  const bool save_validation_data,
+                                                                  const bool create_charge_profile_library,
+                                                                  std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> >& validation_data,
+                                                                  const bool event_driven_integration = false );
+    
+    // The profile of one (EV, EVSE) pair, the same as the one in get_charge_profile_library.
+    // The setpoint simulations run one after the other.
+    static pev_charge_profile get_charge_profile( const charge_profile_simulation_factories& factories,
+                                                  const EV_EVSE_inventory& inventory,
+                                                  const pev_SE_pair pev_SE,
+                                                  const bool event_driven_integration = false );
+    
+    // A library that builds the profile of a pair the first time a charge event asks for
+    // it (see pev_charge_profile_library), so a simulation that uses a few of the pairs of
+    // a large inventory only pays for those.  The inventory must outlive the library.
+    static pev_charge_profile_library get_lazy_charge_profile_library( const EV_EVSE_inventory& inventory,
+                                                                       const bool event_driven_integration = false );
     
-    std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > get_validation_data();
-    std::vector<pev_charge_fragment> USE_FOR_DEBUG_PURPOSES_ONLY_get_raw_charge_profile(double time_step_sec, double target_acP3_kW, EV_type pev_type, EVSE_type SE_type);
+    static std::vector<pev_charge_fragment> USE_FOR_DEBUG_PURPOSES_ONLY_get_raw_charge_profile( const EV_EVSE_inventory& inventory,
+                                                                                                const double time_step_sec,
+                                                                                                const double target_acP3_kW,
+                                                                                                const EV_type pev_type,
+                                                                                                const EVSE_type SE_type );
 };
 
 
@@ -50,26 +143,53 @@ public:
 
 class factory_charge_profile_library_v2
 {
-private:
-    const EV_EVSE_inventory& inventory;
-    EV_ramping_map ramping_by_pevType_only;
-    EV_EVSE_ramping_map ramping_by_pevType_seType;
-    
 public:
-
-    factory_charge_profile_library_v2(const EV_EVSE_inventory& inventory,
-                                      const EV_ramping_map& ramping_by_pevType_only,
-                                      const EV_EVSE_ramping_map& ramping_by_pevType_seType)
-        : inventory{ inventory },
-        ramping_by_pevType_only{ ramping_by_pevType_only },
-        ramping_by_pevType_seType{ ramping_by_pevType_seType }
-    {
-    }
+    // With event_driven_integration the constant power stretches are simulated in one step
+    // (see factory_charge_profile_library::get_charge_profile_library) and written out as
+    // time_step_sec steps, with the soc interpolated along the stretch.
+    static void create_charge_profile( const charge_profile_simulation_factories& factories,
+                                       const double time_step_sec,
+                                       const pev_SE_pair pev_SE,
+                                       const double start_soc,
+                                       const double end_soc,
+                                       const double target_acP3_kW,
+                                       std::vector<double>& soc,
+                                       std::vector<ac_power_metrics>& charge_profile,
+                                       const bool event_driven_integration = false );
+    
+    // Builds the factories for this one profile, prefer the overload above for many profiles.
+    static void create_charge_profile( const EV_EVSE_inventory& inventory,
+                                       const double time_step_sec,
+                                       const pev_SE_pair pev_SE,
+                                       const double start_soc,
+                                       const double end_soc,
+                                       const double target_acP3_kW,
+                                       std::vector<double>& soc,
+                                       std::vector<ac_power_metrics>& charge_profile,
+                                       const double c_rate_scale_factor = 1.0 );
+    
+    static pev_charge_profile_library_v2 get_charge_profile_library( const EV_EVSE_inventory& inventory,
+                                                                     const double L1_timestep_sec,
+                                                                     const double L2_timestep_sec,
+                                                                     const double HPC_timestep_sec,
+                                                                     const std::vector<double> c_rate_scale_factor_levels = { 1.0 },
+                                                                     const bool event_driven_integration = false );
     
-    void create_charge_profile(double time_step_sec, pev_SE_pair pev_SE, double start_soc, double end_soc, double target_acP3_kW, std::vector<double>& soc, std::vector<ac_power_metrics>& charge_profile);
-    //void initialize_custome_parameters(std::map<EV_type, pev_charge_ramping> ramping_by_pevType_only_, std::map< std::tuple<EV_type, EVSE_type>, pev_charge_ramping> ramping_by_pevType_seType_);
+    static all_charge_profile_data build_all_charge_profile_data_for_specific_pev_SE_pair( const charge_profile_simulation_factories& factories,
+                                                                                           const double timestep_sec,
+                                                                                           pev_SE_pair pev_SE,
+                                                                                           const double start_soc,
+                                                                                           const double end_soc,
+                                                                                           const double target_acP3_kW );
     
-    pev_charge_profile_library_v2 get_charge_profile_library(double L1_timestep_sec, double L2_timestep_sec, double HPC_timestep_sec);
+    static void collect_power_profiles( const EV_EVSE_inventory& inventory,
+                                        const double timestep_sec,
+                                        const pev_SE_pair pev_SE,
+                                        const double start_soc,
+                                        const double end_soc,
+                                        const double target_acP3_kW,
+                                        const std::vector<double> c_rate_scale_factor_levels,
+                                        std::vector< all_charge_profile_data >& all_charge_profile_data_vec );
 };
 
 #endif
@@ -41,6 +41,16 @@ double ac_to_dc_converter::get_P3_from_P2( const double P2 )
 }
 
 
+double ac_to_dc_converter::get_dP3_dP2( const double P2 )
+{
+    // P3 = P2/inv_eff(P2)
+    double inv_eff = this->inv_eff_from_P2.get_val(P2);
+    double dinv_eff_dP2 = this->inv_eff_from_P2.get_derivative(P2);
+    
+    return (inv_eff - P2*dinv_eff_dP2) / (inv_eff*inv_eff);
+}
+
+
 double ac_to_dc_converter::get_approximate_P2_from_P3( const double P3 )
 {
     double approx_P2 = P3 * this->inv_eff_from_P2.get_val(P3);
@@ -98,6 +108,12 @@ void ac_to_dc_converter::set_target_Q3_kVAR( const double target_Q3_kVAR_ )
 }
 
 
+double ac_to_dc_converter::get_target_Q3_kVAR() const
+{
+    return this->target_Q3_kVAR;
+}
+
+
 //===================================================================
 //                     ac_to_dc_converter_pf
 //===================================================================
@@ -125,6 +141,26 @@ ac_to_dc_converter* ac_to_dc_converter_pf::clone() const
 }
 
 
+double ac_to_dc_converter_pf::get_dQ3_dP3( const double P3_kW )
+{
+    // Q3 = P3*g(pf), g = sqrt(1/pf^2 - 1), pf = inv_pf(P3)
+    double pf = this->inv_pf_from_P3.get_val(P3_kW);
+    double dpf_dP3 = this->inv_pf_from_P3.get_derivative(P3_kW);
+    double g = std::sqrt(-1 + 1/(pf*pf));
+    
+    // At unity power factor the slope of g is unbounded, Q3 is pinned at zero there.
+    if( g < 1e-9 )
+        return 0;
+    
+    double dQ3_dP3 = g - P3_kW*dpf_dP3/(pf*pf*pf*g);
+    
+    if( pf < 0 && P3_kW*g > 0 )
+        dQ3_dP3 = -1*dQ3_dP3;
+    
+    return dQ3_dP3;
+}
+
+
 void ac_to_dc_converter_pf::get_next( const double time_step_duration_hrs,
                                       const double P1_kW,
                                       const double P2_kW,
@@ -173,6 +209,23 @@ ac_to_dc_converter* ac_to_dc_converter_Q_setpoint::clone() const
 }
 
 
+double ac_to_dc_converter_Q_setpoint::get_dQ3_dP3( const double P3_kW )
+{
+	double ac_kVA_limit = get_max_nominal_S3kVA();
+    
+    if( ac_kVA_limit < P3_kW )
+        return 0;
+    
+    double Q3_limit = std::sqrt( ac_kVA_limit*ac_kVA_limit - P3_kW*P3_kW );
+    
+    // Q3 only moves with P3 when the kVA limit clips target_Q3_kVAR.
+    if( std::abs(this->target_Q3_kVAR) < Q3_limit || Q3_limit < 1e-9 )
+        return 0;
+    
+    return (0 <= this->target_Q3_kVAR) ? -P3_kW/Q3_limit : P3_kW/Q3_limit;
+}
+
+
 void ac_to_dc_converter_Q_setpoint::get_next( double time_step_duration_hrs,
                                               double P1_kW,
                                               double P2_kW,
@@ -36,6 +36,12 @@ public:
     double get_P3_from_P2( const double P2 );
     double get_approximate_P2_from_P3( const double P3 );
     void set_target_Q3_kVAR( const double target_Q3_kVAR_ );
+    double get_target_Q3_kVAR() const;
+    
+    // Slopes of the converter curves, used to chain dP2/dpuVrms of the battery
+    // through to the ac side.
+    double get_dP3_dP2( const double P2 );
+    virtual double get_dQ3_dP3( const double P3 ) = 0;
     
     virtual void get_next( const double time_step_duration_hrs,
                            const double P1_kW,
@@ -61,6 +67,8 @@ public:
     virtual ~ac_to_dc_converter_pf() override final;
     ac_to_dc_converter* clone() const override;
     
+    virtual double get_dQ3_dP3( const double P3 ) override final;
+    
     virtual void get_next( const double time_step_duration_hrs,
                            const double P1_kW,
                            const double P2_kW,
@@ -82,6 +90,8 @@ public:
     virtual ~ac_to_dc_converter_Q_setpoint() override final;
     ac_to_dc_converter* clone() const override;
     
+    virtual double get_dQ3_dP3( const double P3 ) override final;
+    
     virtual void get_next( const double time_step_duration_hrs,
                            const double P1_kW,
                            const double P2_kW,
@@ -30,9 +30,9 @@ std::ostream& operator<<(std::ostream& out, battery_state& x)
 //###########################################
 
 battery::battery( const vehicle_charge_model_inputs& inputs )
-    : get_E1_limits_charging{ calculate_E1_energy_limit{ battery_charge_mode::charging, inputs } },
-    get_E1_limits_discharging{ calculate_E1_energy_limit{ battery_charge_mode::discharging, inputs } },
-    get_next_P2{ inputs.CT_factory.get_charging_transitions(inputs.EV, inputs.EVSE) },
+    : get_E1_limits_charging{ inputs },
+    get_E1_limits_discharging{ inputs },
+    get_next_P2{ inputs.CT_factory.get_charging_transitions(inputs.EV_id, inputs.EVSE_id) },
     battery_size_kWh{ inputs.battery_size_kWh },
     soc{ inputs.CE.arrival_SOC },
     soc_to_energy{ this->battery_size_kWh / 100.0 },
@@ -41,8 +41,8 @@ battery::battery( const vehicle_charge_model_inputs& inputs )
     will_never_discharge{ true },
     soc_of_full_battery{ 100 },
     soc_of_empty_battery{ 0.0 },
-    bat_eff_vs_P2_charging{ inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV, battery_charge_mode::charging).curve },
-    bat_eff_vs_P2_discharging{ inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV, battery_charge_mode::discharging).curve },
+    bat_eff_vs_P2_charging{ inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV_id, battery_charge_mode::charging).curve },
+    bat_eff_vs_P2_discharging{ inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV_id, battery_charge_mode::discharging).curve },
     max_E1_limit{ 0.0 },
     min_E1_limit{ 0.0 },
     print_debug_info{ false }
@@ -51,8 +51,8 @@ battery::battery( const vehicle_charge_model_inputs& inputs )
 
 double battery::get_zero_slope_threshold_bat_eff_vs_P2( const vehicle_charge_model_inputs& inputs )
 {
-    double charging_zst = inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV, battery_charge_mode::charging).zero_slope_threshold;
-    double discharging_zst = inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV, battery_charge_mode::discharging).zero_slope_threshold;
+    double charging_zst = inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV_id, battery_charge_mode::charging).zero_slope_threshold;
+    double discharging_zst = inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV_id, battery_charge_mode::discharging).zero_slope_threshold;
 
     return (charging_zst < discharging_zst) ? charging_zst : discharging_zst;
 }
@@ -69,17 +69,165 @@ void battery::set_P2_kW( const double P2_kW )
     this->get_next_P2.set_init_state(P2_kW);
 }
 
+void battery::set_arrival_soc( const double arrival_soc ) 
+{
+    this->soc = arrival_soc;
+}
+
 void battery::set_target_P2_kW( const double target_P2_kW_ ) 
 {
     this->target_P2_kW = target_P2_kW_;
 }
 
-double battery::get_target_P2_kW() 
+double battery::get_target_P2_kW() const
 {
     return this->target_P2_kW;
 }
 
 
+void battery::get_step_state( battery_step_state& state ) const
+{
+    this->get_E1_limits_charging.get_step_state(state.E1_limits_charging);
+    this->get_E1_limits_discharging.get_step_state(state.E1_limits_discharging);
+    this->get_next_P2.get_step_state(state.P2);
+    
+    state.soc = this->soc;
+    state.target_P2_kW = this->target_P2_kW;
+    state.min_E1_limit = this->min_E1_limit;
+    state.max_E1_limit = this->max_E1_limit;
+}
+
+void battery::set_step_state( const battery_step_state& state )
+{
+    this->get_E1_limits_charging.set_step_state(state.E1_limits_charging);
+    this->get_E1_limits_discharging.set_step_state(state.E1_limits_discharging);
+    this->get_next_P2.set_step_state(state.P2);
+    
+    this->soc = state.soc;
+    this->target_P2_kW = state.target_P2_kW;
+    this->min_E1_limit = state.min_E1_limit;
+    this->max_E1_limit = state.max_E1_limit;
+}
+
+void battery::write_step_state( std::ostream& out ) const
+{
+    this->get_E1_limits_charging.write_step_state(out);
+    this->get_E1_limits_discharging.write_step_state(out);
+    this->get_next_P2.write_step_state(out);
+    
+    write_pod<double>(out, this->soc);
+    write_pod<double>(out, this->target_P2_kW);
+    write_pod<double>(out, this->min_E1_limit);
+    write_pod<double>(out, this->max_E1_limit);
+}
+
+void battery::read_step_state( std::istream& in )
+{
+    this->get_E1_limits_charging.read_step_state(in);
+    this->get_E1_limits_discharging.read_step_state(in);
+    this->get_next_P2.read_step_state(in);
+    
+    const double soc_ = read_pod<double>(in);
+    const double target_P2_kW_ = read_pod<double>(in);
+    const double min_E1_limit_ = read_pod<double>(in);
+    const double max_E1_limit_ = read_pod<double>(in);
+    
+    if(!in.good())
+        return;
+    
+    this->soc = soc_;
+    this->target_P2_kW = target_P2_kW_;
+    this->min_E1_limit = min_E1_limit_;
+    this->max_E1_limit = max_E1_limit_;
+}
+
+
+double battery::get_dP2_dpuVrms( const double pu_Vrms, 
+                                 const double P2_kW ) const
+{
+    if(P2_kW > 0)
+    {
+        if(this->max_E1_limit == 0)
+            return 0;
+        
+        return this->get_E1_limits_charging.get_dP2_limit_dpuVrms(pu_Vrms, P2_kW);
+    }
+    else if(P2_kW < 0)
+    {
+        if(this->will_never_discharge || this->min_E1_limit == 0)
+            return 0;
+        
+        return this->get_E1_limits_discharging.get_dP2_limit_dpuVrms(pu_Vrms, P2_kW);
+    }
+    
+    return 0;
+}
+
+
+double battery::get_time_at_constant_P2_hrs( const double soc_limit ) const
+{
+    const double P2_tolerance_kW = 0.001;
+    
+    if(!this->get_next_P2.is_on_steady_state())
+        return 0;
+    
+    const double P2_kW = this->get_next_P2.get_X();
+    
+    if(P2_kW <= 0 || this->target_P2_kW + P2_tolerance_kW < P2_kW)
+        return 0;
+    
+    const double c = this->bat_eff_vs_P2_charging.a;
+    const double d = this->bat_eff_vs_P2_charging.b;
+    const double P1_kW = (c*P2_kW + d)*P2_kW;
+    
+    if(P1_kW <= 0)
+        return 0;
+    
+    // P2 below the target is held there by the limit, and follows the limit once it is
+    // no longer flat.  Otherwise P2 is the target and holds until the limit drops below it.
+    const bool P2_held_by_limit = (P2_kW + P2_tolerance_kW < this->target_P2_kW);
+    
+    double soc_event = (soc_limit < this->soc_of_full_battery) ? soc_limit : this->soc_of_full_battery;
+    double soc_checked = this->soc;
+    
+    for(const line_segment& seg : this->get_E1_limits_charging.get_cur_P2_vs_soc_segments())
+    {
+        if(seg.x_UB <= soc_checked)
+            continue;
+        
+        if(soc_event <= soc_checked || soc_checked < seg.x_LB)
+            break;
+        
+        if(P2_held_by_limit)
+        {
+            if(P2_tolerance_kW < std::abs(seg.y(soc_checked) - P2_kW) || P2_tolerance_kW < std::abs(seg.y_UB() - P2_kW))
+                break;
+        }
+        else
+        {
+            if(seg.y(soc_checked) < P2_kW - P2_tolerance_kW)
+                break;
+            
+            if(seg.y_UB() < P2_kW - P2_tolerance_kW)
+            {
+                soc_checked = (P2_kW - P2_tolerance_kW - seg.b)/seg.a;
+                break;
+            }
+        }
+        
+        soc_checked = seg.x_UB;
+    }
+    
+    if(soc_checked < soc_event)
+        soc_event = soc_checked;
+    
+    if(soc_event <= this->soc)
+        return 0;
+    
+    return (soc_event - this->soc)*this->soc_to_energy/P1_kW;
+}
+
+
 void battery::get_next( const double prev_unix_time, 
                         const double now_unix_time, 
                         const double target_soc, 
@@ -25,11 +25,25 @@ struct battery_state
 
 std::ostream& operator<<(std::ostream& out, battery_state& x);
 
+// The part of a battery that get_next changes.
+struct battery_step_state
+{
+    calculate_E1_energy_limit_step_state E1_limits_charging;
+    calculate_E1_energy_limit_step_state E1_limits_discharging;
+    integrate_X_through_time_step_state P2;
+    
+    double soc;
+    double target_P2_kW;
+    double min_E1_limit;
+    double max_E1_limit;
+};
+
+
 class battery
 {
 private:
-    calculate_E1_energy_limit  get_E1_limits_charging;
-    calculate_E1_energy_limit  get_E1_limits_discharging;
+    calculate_E1_energy_limit<battery_charge_mode::charging>  get_E1_limits_charging;
+    calculate_E1_energy_limit<battery_charge_mode::discharging>  get_E1_limits_discharging;
     integrate_X_through_time   get_next_P2;
     
     double battery_size_kWh;
@@ -62,14 +76,40 @@ public:
     // This should only be used for debugging purposes or maybe by battery_factory
     void set_P2_kW(double P2_kW);
     
+    // Only for a battery that has not been stepped yet, e.g. one copied from a prototype
+    // in factory_EV_charge_model.
+    void set_arrival_soc(const double arrival_soc);
+    
     void set_target_P2_kW( const double target_P2_kW_ );
-    double get_target_P2_kW();
+    double get_target_P2_kW() const;
+    
+    void get_step_state( battery_step_state& state ) const;
+    void set_step_state( const battery_step_state& state );
+    
+    // Binary form of the step state, for a battery built from the same inputs.
+    // read_step_state leaves 'in' failed on bad data, with the battery partly read.
+    void write_step_state( std::ostream& out ) const;
+    void read_step_state( std::istream& in );
+    
     void get_next( const double prev_unix_time, 
                    const double now_unix_time, 
                    const double target_soc, 
                    const double pu_Vrms, 
                    const bool stop_charging_at_target_soc, 
                    battery_state& return_val );
+    
+    // Sensitivity of P2 to the voltage after get_next returned P2_kW at pu_Vrms.
+    // Only the P2_vs_puVrms limit depends on the voltage, so this is zero unless that
+    // limit is what holds P2 (and the E1 limit in that direction is not zero).
+    double get_dP2_dpuVrms( const double pu_Vrms, 
+                            const double P2_kW ) const;
+    
+    // Time over which get_next keeps returning the current P2 while charging, as long as
+    // the target and pu_Vrms do not change.  P2 stays constant while the ramping is on
+    // steady state and the P2_vs_soc limit stays at or above P2, or while P2 sits on a
+    // flat part of the limit.  The time ends when soc reaches soc_limit.  Returns zero
+    // when P2 may change during the next time step.
+    double get_time_at_constant_P2_hrs( const double soc_limit ) const;
 };
 
 
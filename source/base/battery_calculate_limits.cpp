@@ -36,177 +36,19 @@ std::ostream& operator<<(std::ostream& out,
 //                 Algroithm soc_t1 from (t1-t0) and soc_t0  
 //#############################################################################
 
-//##############################
-//        Parent Class
-//##############################
-
-double algorithm_P2_vs_soc::get_soc_to_energy() const
-{
-	return this->soc_to_energy;
-}
-
-double algorithm_P2_vs_soc::get_soc_UB() const
-{
-	return this->P2_vs_soc->at(seg_index).x_UB;
-}
-
-double algorithm_P2_vs_soc::get_soc_LB() const
-{
-	return this->P2_vs_soc->at(seg_index).x_LB;
-}
-
-algorithm_P2_vs_soc::algorithm_P2_vs_soc(const vehicle_charge_model_inputs& inputs)
-    :P2_vs_soc{ std::make_shared<std::vector<line_segment> >() },
+algorithm_P2_vs_soc::algorithm_P2_vs_soc(const battery_charge_mode& mode, 
+                                         const vehicle_charge_model_inputs& inputs)
+    :P2_vs_soc{ inputs.SOCP_factory.get_P2_vs_soc_segments( inputs.SOCP_factory.get_SOC_vs_P2_curves( inputs.EV_id, inputs.EVSE_id, inputs.CE.arrival_battery_temperature_C, inputs.CE.arrival_SOC ) ) },
+    bat_eff_vs_P2{ &inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV_id, mode).curve },
     seg_index{ 0 },
     ref_seg_index{ -1 },
     soc_to_energy{ inputs.battery_size_kWh / 100.0 },
     prev_exp_val{ -1 },
     exp_term{ std::exp(this->prev_exp_val) },
     recalc_exponent_threshold{ 0.00000001 },
-    zero_slope_threshold_P2_vs_soc{ inputs.SOCP_factory.get_SOC_vs_P2_curves( inputs.EV, inputs.EVSE, inputs.CE.arrival_battery_temperature_C, inputs.CE.arrival_SOC ).zero_slope_threshold },
+    zero_slope_threshold_P2_vs_soc{ inputs.SOCP_factory.get_SOC_vs_P2_curves( inputs.EV_id, inputs.EVSE_id, inputs.CE.arrival_battery_temperature_C, inputs.CE.arrival_SOC ).zero_slope_threshold },
     segment_is_flat_P2_vs_soc{ false },
-    P2_vs_soc_segments_changed{ false }
-{
-}
-
-void algorithm_P2_vs_soc::set_P2_vs_soc(std::shared_ptr<std::vector<line_segment> > P2_vs_soc)
-{
-	this->P2_vs_soc_segments_changed = true;
-	this->P2_vs_soc = P2_vs_soc;
-}
-
-
-void algorithm_P2_vs_soc::find_line_segment_index(double init_soc, 
-                                                  bool &line_segment_not_found)
-{
-    this->seg_index = -1;
-    for(int i=0; i< this->P2_vs_soc->size(); i++)
-    {
-        if(init_soc <= this->P2_vs_soc->at(i).x_UB)
-        {
-            this->seg_index = i;
-            break;
-        }
-    }
-
-    line_segment_not_found = (this->seg_index == -1);
-}
-
-
-void algorithm_P2_vs_soc::get_next_line_segment(bool is_charging_not_discharging, 
-                                                bool &next_line_segment_exists)
-{
-    if(is_charging_not_discharging)
-    {
-        this->seg_index++;
-        next_line_segment_exists = (this->seg_index < this->P2_vs_soc->size());
-    }
-    else
-    {
-        this->seg_index--;
-        next_line_segment_exists = (this->seg_index >= 0);
-    }
-}
-
-
-//##############################
-//   Child Class  (No Losses)
-//##############################
-
-algorithm_P2_vs_soc_no_losses::algorithm_P2_vs_soc_no_losses(const battery_charge_mode& mode, 
-                                                             const vehicle_charge_model_inputs& inputs)
-    :algorithm_P2_vs_soc{ inputs },
-    a{ 0.0 },
-    b{ 0.0 },
-    A{ 0.0 }
-{
-}
-
-double algorithm_P2_vs_soc_no_losses::get_soc_t1(double t1_minus_t0_hrs, 
-                                                 double soc_t0)
-{
-	bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);	
-	this->P2_vs_soc_segments_changed = false;
-
-    if(update_vals)
-    {
-        this->ref_seg_index = this->seg_index;
-        this->a = this->P2_vs_soc->at(this->seg_index).a;
-        this->b = this->P2_vs_soc->at(this->seg_index).b;
-        this->A = this->a/this->soc_to_energy;
-        this->segment_is_flat_P2_vs_soc = std::abs(this->a) < this->zero_slope_threshold_P2_vs_soc;
-        
-        this->prev_exp_val = this->A*t1_minus_t0_hrs;
-        this->exp_term = std::exp(this->prev_exp_val);
-    }
-    
-    //-------------
-    
-    double soc_t1;
-    
-    if(this->segment_is_flat_P2_vs_soc)
-    {
-    	double P2_soc_t0 = this->a*soc_t0 + this->b;
-        soc_t1 = soc_t0 + P2_soc_t0*t1_minus_t0_hrs/this->soc_to_energy;
-    }
-    else
-    {
-    	double cur_exp_val = this->A*t1_minus_t0_hrs;
-    	
-        if(this->recalc_exponent_threshold < std::abs(this->prev_exp_val - cur_exp_val))
-        {
-        	this->prev_exp_val = cur_exp_val;
-            this->exp_term = std::exp(cur_exp_val);
-        }
-        
-        double P2_soc_t1;
-        
-        P2_soc_t1 = this->exp_term*(this->a*soc_t0 + this->b);
-        soc_t1 = (P2_soc_t1-this->b)/this->a;
-    }
-    
-    return soc_t1;
-}
-
-double algorithm_P2_vs_soc_no_losses::get_time_to_soc_t1_hrs(double soc_t0, 
-                                                             double soc_t1)
-{
-	bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);
-	this->P2_vs_soc_segments_changed = false;
-
-    if(update_vals)
-    {
-        this->ref_seg_index = this->seg_index;
-        this->a = this->P2_vs_soc->at(this->seg_index).a;
-        this->b = this->P2_vs_soc->at(this->seg_index).b;
-        this->A = this->a/this->soc_to_energy;
-        this->segment_is_flat_P2_vs_soc = std::abs(this->a) < this->zero_slope_threshold_P2_vs_soc;
-    }
-    
-    //-------------
-    
-    double tmp_hrs;
-    
-    if(this->segment_is_flat_P2_vs_soc)
-    {
-    	double P2_soc_t0 = this->a*soc_t0 + this->b;
-        tmp_hrs = (soc_t1 - soc_t0)*this->soc_to_energy/P2_soc_t0;
-    }
-    else
-        tmp_hrs = std::log((this->a*soc_t1 + this->b)/(this->a*soc_t0 + this->b))/this->A;
-                          
-    return tmp_hrs;
-}
-
-
-//##############################
-//   Child Class  (Losses)
-//##############################
-
-algorithm_P2_vs_soc_losses::algorithm_P2_vs_soc_losses(const battery_charge_mode& mode, 
-                                                       const vehicle_charge_model_inputs& inputs)
-    :algorithm_P2_vs_soc{ inputs },
-    bat_eff_vs_P2{ inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV, mode).curve },
+    P2_vs_soc_segments_changed{ false },
     a{ 0.0 },
     b{ 0.0 },
     c{ 0.0 },
@@ -219,353 +61,51 @@ algorithm_P2_vs_soc_losses::algorithm_P2_vs_soc_losses(const battery_charge_mode
 {
 }
 
-
-double algorithm_P2_vs_soc_losses::get_soc_t1(double t1_minus_t0_hrs, 
-                                              double soc_t0)
-{
-    bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);
-    this->P2_vs_soc_segments_changed = false;
-
-    if(update_vals)
-    {
-        this->ref_seg_index = this->seg_index;
-        this->a = this->P2_vs_soc->at(this->seg_index).a;
-        this->b = this->P2_vs_soc->at(this->seg_index).b;
-        this->c = this->bat_eff_vs_P2.a;
-        this->d = this->bat_eff_vs_P2.b;
-        
-        this->A = this->a/this->soc_to_energy;
-        this->B = this->b;
-        this->C = this->c*this->a/this->soc_to_energy;
-        this->D = this->c*this->b + this->d;
-        this->z = this->B*this->C - this->A*this->D;
-                
-        this->segment_is_flat_P2_vs_soc = std::abs(this->a) < this->zero_slope_threshold_P2_vs_soc;
-        
-        this->prev_exp_val = this->z*t1_minus_t0_hrs;
-        this->exp_term = std::exp(this->prev_exp_val);
-    }
-    
-    //-------------
-    
-    double soc_t1, e_t0, eff_e_t0;
-        
-    e_t0 = soc_t0*this->soc_to_energy;
-    eff_e_t0 = this->C*e_t0 + this->D;
-    
-    if(this->segment_is_flat_P2_vs_soc)
-    {
-    	double P2_soc_t0 = this->a*soc_t0 + this->b;
-        soc_t1 = soc_t0 + eff_e_t0*P2_soc_t0*t1_minus_t0_hrs/this->soc_to_energy;
-    }
-    else
-    {
-    	double cur_exp_val = this->z*t1_minus_t0_hrs;
-    	
-        if(this->recalc_exponent_threshold < std::abs(this->prev_exp_val - cur_exp_val))
-        {
-        	this->prev_exp_val = cur_exp_val;
-            this->exp_term = std::exp(cur_exp_val);
-        }
-
-        double e_t1, P2_e_t0, X;
-        
-        P2_e_t0 = this->A*e_t0 + this->B;
-        X = this->exp_term * eff_e_t0 / P2_e_t0;
-        e_t1 = (X*this->B - this->D)/(this->C - X*this->A);
-        soc_t1 = e_t1/this->soc_to_energy;
- 	}
-    
-    //-------------
-    
-    return soc_t1;
-}
-
-
-double algorithm_P2_vs_soc_losses::get_time_to_soc_t1_hrs(double soc_t0, 
-                                                          double soc_t1)
-{
-	bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);
-	this->P2_vs_soc_segments_changed = false;
-
-    if(update_vals)
-    {
-        this->ref_seg_index = this->seg_index;
-        this->a = this->P2_vs_soc->at(this->seg_index).a;
-        this->b = this->P2_vs_soc->at(this->seg_index).b;
-        this->c = this->bat_eff_vs_P2.a;
-        this->d = this->bat_eff_vs_P2.b;
-        
-        this->A = this->a/this->soc_to_energy;
-        this->B = this->b;
-        this->C = this->c*this->a/this->soc_to_energy;
-        this->D = this->c*this->b + this->d;
-        this->z = this->B*this->C - this->A*this->D;
-                
-        this->segment_is_flat_P2_vs_soc = std::abs(this->a) < this->zero_slope_threshold_P2_vs_soc;
-    }
-    
-    //-------------
-    
-    double tmp_hrs, e_t0, eff_e_t0;
-    
-    e_t0 = soc_t0*this->soc_to_energy;
-    eff_e_t0 = this->C*e_t0 + this->D;
-    
-    if(this->segment_is_flat_P2_vs_soc)
-    {
-    	double P2_soc_t0 = this->a*soc_t0 + this->b;
-        tmp_hrs = (soc_t1-soc_t0)*this->soc_to_energy/(P2_soc_t0*eff_e_t0);
-    }
-    else
-    {
-        double e_t1, P2_e_t0, P2_e_t1, eff_e_t1;
-        
-        P2_e_t0 = this->A*e_t0 + this->B;
-        e_t1 = soc_t1*this->soc_to_energy;
-        P2_e_t1 = this->A*e_t1 + this->B;
-        eff_e_t1 = this->C*e_t1 + this->D;
-        
-        tmp_hrs = std::log((eff_e_t1*P2_e_t0)/(eff_e_t0*P2_e_t1))/this->z;
-    }
-    return tmp_hrs;
-}
-
-
-//#############################################################################
-//                         Calculate Energy Limits
-//#############################################################################
-
-
-calc_E1_energy_limit::calc_E1_energy_limit(const battery_charge_mode& mode, 
-                                           const bool& are_battery_losses, 
-                                           const vehicle_charge_model_inputs& inputs)
-{
-    if (are_battery_losses)
-    {
-        this->P2_vs_soc_algorithm = std::make_shared<algorithm_P2_vs_soc_losses>(mode, inputs);
-    }
-    else
-    {
-        this->P2_vs_soc_algorithm = std::make_shared<algorithm_P2_vs_soc_no_losses>(mode, inputs);
-    }
-}
-
-//##############################
-//           Charging
-//##############################
-
-calc_E1_energy_limit_charging::calc_E1_energy_limit_charging(const bool& are_battery_losses, 
-                                                             const vehicle_charge_model_inputs& inputs)
-    : calc_E1_energy_limit{ charging, are_battery_losses, inputs }
+void algorithm_P2_vs_soc::set_P2_vs_soc(const shared_P2_vs_soc_segments& P2_vs_soc)
 {
-}
-
-void calc_E1_energy_limit_charging::get_E1_limit(double time_step_sec, 
-                                                 double init_soc, 
-                                                 double target_soc, 
-                                                 bool P2_vs_soc_segments_changed, 
-                                                 std::shared_ptr<std::vector<line_segment> > P2_vs_soc, 
-                                                 E1_energy_limit& E1_limit)
-{
-	if(P2_vs_soc_segments_changed)
-    	this->P2_vs_soc_algorithm->set_P2_vs_soc(P2_vs_soc);
-    
-    bool line_segment_not_found;
-    this->P2_vs_soc_algorithm->find_line_segment_index(init_soc, line_segment_not_found);
-    
-    if(line_segment_not_found)
-    {
-        E1_limit = {100, 0, 0, unknown, 0, -1}; // {target_soc, max_energy_kWh, max_energy_charge_time_hrs, reached_target_status, energy_to_target_soc_kWh, min_time_to_target_soc_hrs}
-    	return;
-    }
-    
-    //----------------------------------
-    //        Calculate
-    //----------------------------------
-    
-    target_soc = (100 < target_soc) ? 100 : target_soc;
-    
-    energy_target_reached_status energy_target_status = unknown;
-    if(target_soc <= init_soc)
-    {
-        energy_target_status = have_passed_energy_target;
-    	target_soc = 100;
-    }
-    
-    double soc_UB, soc_t0, soc_t1, t1_minus_t0_hrs, tmp_hrs;
-    double min_time_to_target_hrs, max_energy_charge_time_hrs;
-    bool break_now, is_charging_not_discharging;
-    bool next_line_segment_exists;
-    is_charging_not_discharging = true;
-    
-    soc_t0 = init_soc;
-    t1_minus_t0_hrs = time_step_sec/3600;
-    max_energy_charge_time_hrs = 0;
-    break_now = false;
-    while(true)
-    {
-        soc_UB = this->P2_vs_soc_algorithm->get_soc_UB();
-        soc_t1 = this->P2_vs_soc_algorithm->get_soc_t1(t1_minus_t0_hrs, soc_t0);                     
-        
-        if(100 < soc_t1)
-        	soc_t1 = 100;
-        
-        // For the last segment (soc_UB > 100)
-        // Since soc_t1 <= 100: if(soc_UB < soc_t1) will never be true for the last segment
-        if(soc_UB < soc_t1)   
-        	soc_t1 = soc_UB;
-        else
-            break_now = true;
-
-        if(energy_target_status == unknown && soc_t0 <= target_soc && target_soc <= soc_t1)
-        {
-            energy_target_status = can_reach_energy_target_this_timestep;
-            tmp_hrs = this->P2_vs_soc_algorithm->get_time_to_soc_t1_hrs(soc_t0, target_soc);
-            min_time_to_target_hrs = max_energy_charge_time_hrs + tmp_hrs;
-        }
-
-        if(break_now)
-        {
-            max_energy_charge_time_hrs += t1_minus_t0_hrs;
-            break;
-        }
-        else
-        {
-            tmp_hrs = this->P2_vs_soc_algorithm->get_time_to_soc_t1_hrs(soc_t0, soc_t1);
-            max_energy_charge_time_hrs += tmp_hrs;
-        
-            t1_minus_t0_hrs -= tmp_hrs;
-            soc_t0 = soc_t1;
-            this->P2_vs_soc_algorithm->get_next_line_segment(is_charging_not_discharging, next_line_segment_exists);
-            
-            if(!next_line_segment_exists)
-                break;
-        }
-    }
-        
-    if(energy_target_status == unknown)
-        energy_target_status = can_not_reach_energy_target_this_timestep;
-    
-    //--------------------------------------------
-    
-    double soc_to_energy = this->P2_vs_soc_algorithm->get_soc_to_energy();
-    
-    E1_limit.target_soc = target_soc;
-    E1_limit.max_E1_energy_charge_time_hrs = max_energy_charge_time_hrs;
-    E1_limit.max_E1_energy_kWh = (soc_t1 - init_soc)*soc_to_energy;
-    E1_limit.reached_target_status = energy_target_status;
-    E1_limit.E1_energy_to_target_soc_kWh = (energy_target_status == can_reach_energy_target_this_timestep) ? (target_soc - init_soc)*soc_to_energy : 0;
-    E1_limit.min_time_to_target_soc_hrs = (energy_target_status == can_reach_energy_target_this_timestep) ? min_time_to_target_hrs : -1;
+	this->P2_vs_soc_segments_changed = true;
+	this->P2_vs_soc = P2_vs_soc;
 }
 
 
-//##############################
-//        Discharging
-//##############################
-
-calc_E1_energy_limit_discharging::calc_E1_energy_limit_discharging(const bool& are_battery_losses, 
-                                                                   const vehicle_charge_model_inputs& inputs)
-    :calc_E1_energy_limit{ discharging, are_battery_losses, inputs }
+void algorithm_P2_vs_soc::get_step_state(algorithm_P2_vs_soc_step_state& state) const
 {
+	state.P2_vs_soc = this->P2_vs_soc;
+	state.seg_index = this->seg_index;
+	state.ref_seg_index = this->ref_seg_index;
+	state.prev_exp_val = this->prev_exp_val;
+	state.exp_term = this->exp_term;
+	state.segment_is_flat_P2_vs_soc = this->segment_is_flat_P2_vs_soc;
+	state.P2_vs_soc_segments_changed = this->P2_vs_soc_segments_changed;
+	state.a = this->a;
+	state.b = this->b;
+	state.c = this->c;
+	state.d = this->d;
+	state.A = this->A;
+	state.B = this->B;
+	state.C = this->C;
+	state.D = this->D;
+	state.z = this->z;
 }
 
-void calc_E1_energy_limit_discharging::get_E1_limit(double time_step_sec, 
-                                                    double init_soc, 
-                                                    double target_soc, 
-                                                    bool P2_vs_soc_segments_changed, 
-                                                    std::shared_ptr<std::vector<line_segment> > P2_vs_soc, 
-                                                    E1_energy_limit& E1_limit)
+void algorithm_P2_vs_soc::set_step_state(const algorithm_P2_vs_soc_step_state& state)
 {
-	if(P2_vs_soc_segments_changed)
-    	this->P2_vs_soc_algorithm->set_P2_vs_soc(P2_vs_soc);
-	
-	bool line_segment_not_found;
-    this->P2_vs_soc_algorithm->find_line_segment_index(init_soc, line_segment_not_found);
-	
-    if(line_segment_not_found)
-    {
-        E1_limit = {0, 0, 0, unknown, 0, -1}; // {target_soc, max_energy_kWh, max_energy_charge_time_hrs, reached_target_status, energy_to_target_soc_kWh, min_time_to_target_soc_hrs}
-        return;
-    }
-	
-    //----------------------------------
-    //        Calculate
-    //----------------------------------
-    
-    target_soc = (target_soc < 0) ? 0 : target_soc;
-    
-    energy_target_reached_status energy_target_status = unknown;
-    if(init_soc <= target_soc)
-    {
-        energy_target_status = have_passed_energy_target;
-    	target_soc = 0;
-    }
-    
-    double soc_LB, soc_t0, soc_t1, t1_minus_t0_hrs, tmp_hrs;
-    double min_time_to_target_hrs, max_energy_charge_time_hrs;
-    bool break_now, is_charging_not_discharging;
-    bool next_line_segment_exists;
-    is_charging_not_discharging = false;
-    
-    soc_t0 = init_soc;
-    t1_minus_t0_hrs = time_step_sec/3600;
-    max_energy_charge_time_hrs = 0;
-    break_now = false;
-    while(true)
-    {
-        soc_LB = this->P2_vs_soc_algorithm->get_soc_LB();
-        soc_t1 = this->P2_vs_soc_algorithm->get_soc_t1(t1_minus_t0_hrs, soc_t0);                     
-        
-        if(soc_t1 < 0)
-        	soc_t1 = 0;
-        
-        // For the first segment (soc_LB < 0)
-        // Since soc_t1 >= 0: if(soc_t1 < soc_LB) will never be true for the first segment
-        if(soc_t1 < soc_LB)  
-            soc_t1 = soc_LB;
-        else
-            break_now = true;
-
-        if(energy_target_status == unknown && soc_t1 <= target_soc && target_soc <= soc_t0)
-        {
-            energy_target_status = can_reach_energy_target_this_timestep;
-            tmp_hrs = this->P2_vs_soc_algorithm->get_time_to_soc_t1_hrs(soc_t0, target_soc);
-            min_time_to_target_hrs = max_energy_charge_time_hrs + tmp_hrs;
-        }
-
-        if(break_now)
-        {
-            max_energy_charge_time_hrs += t1_minus_t0_hrs;
-            break;
-        }
-        else
-        {
-            tmp_hrs = this->P2_vs_soc_algorithm->get_time_to_soc_t1_hrs(soc_t0, soc_t1);
-            max_energy_charge_time_hrs += tmp_hrs;
-        
-            t1_minus_t0_hrs -= tmp_hrs;
-            soc_t0 = soc_t1;
-            this->P2_vs_soc_algorithm->get_next_line_segment(is_charging_not_discharging, next_line_segment_exists);
-            
-            if(!next_line_segment_exists)
-                break;
-        }
-    }
-    
-    if(energy_target_status == unknown)
-        energy_target_status = can_not_reach_energy_target_this_timestep;
-    
-    //--------------------------------------------
-    
-    double soc_to_energy = this->P2_vs_soc_algorithm->get_soc_to_energy();
-    
-    E1_limit.target_soc = target_soc;
-    E1_limit.max_E1_energy_charge_time_hrs = max_energy_charge_time_hrs;
-    E1_limit.max_E1_energy_kWh = (soc_t1 - init_soc)*soc_to_energy;
-    E1_limit.reached_target_status = energy_target_status;
-    E1_limit.E1_energy_to_target_soc_kWh = (energy_target_status == can_reach_energy_target_this_timestep) ? (target_soc - init_soc)*soc_to_energy : 0;
-    E1_limit.min_time_to_target_soc_hrs = (energy_target_status == can_reach_energy_target_this_timestep) ? min_time_to_target_hrs : -1;
+	this->P2_vs_soc = state.P2_vs_soc;
+	this->seg_index = state.seg_index;
+	this->ref_seg_index = state.ref_seg_index;
+	this->prev_exp_val = state.prev_exp_val;
+	this->exp_term = state.exp_term;
+	this->segment_is_flat_P2_vs_soc = state.segment_is_flat_P2_vs_soc;
+	this->P2_vs_soc_segments_changed = state.P2_vs_soc_segments_changed;
+	this->a = state.a;
+	this->b = state.b;
+	this->c = state.c;
+	this->d = state.d;
+	this->A = state.A;
+	this->B = state.B;
+	this->C = state.C;
+	this->D = state.D;
+	this->z = state.z;
 }
 
 
@@ -573,45 +113,22 @@ void calc_E1_energy_limit_discharging::get_E1_limit(double time_step_sec,
 //             Calculate Energy Limit Upper and Lower Bound
 //#############################################################################
 
-calculate_E1_energy_limit::calculate_E1_energy_limit(const battery_charge_mode& mode, 
-                                                     const vehicle_charge_model_inputs& inputs) 
-    : mode{ mode },
-    P2_vs_puVrms{ inputs.VP_factory.get_puVrms_vs_P2(inputs.EVSE, inputs.SE_P2_limit_kW) },
-    max_P2kW_error_before_reappling_P2kW_limit_to_P2_vs_soc_segments{ 0.5 },
-    orig_P2_vs_soc_segments{ inputs.SOCP_factory.get_SOC_vs_P2_curves( inputs.EV, inputs.EVSE, inputs.CE.arrival_battery_temperature_C, inputs.CE.arrival_SOC ).curve }
+template<battery_charge_mode mode, bool are_battery_losses>
+calculate_E1_energy_limit<mode, are_battery_losses>::calculate_E1_energy_limit(const vehicle_charge_model_inputs& inputs) 
+    : P2_vs_puVrms{ inputs.VP_factory.get_puVrms_vs_P2(inputs.EVSE_id, inputs.SE_P2_limit_kW) },
+    max_P2kW_error_before_reappling_P2kW_limit_to_P2_vs_soc_segments{ factory_SOC_vs_P2::P2_limit_resolution_kW },
+    SOCP_factory{ &inputs.SOCP_factory },
+    P2_vs_soc_curve{ &inputs.SOCP_factory.get_SOC_vs_P2_curves( inputs.EV_id, inputs.EVSE_id, inputs.CE.arrival_battery_temperature_C, inputs.CE.arrival_SOC ) },
+    orig_P2_vs_soc_segments{ inputs.SOCP_factory.get_P2_vs_soc_segments( *this->P2_vs_soc_curve ) },
+    P2_vs_soc_algorithm{ mode, inputs }
 {
-    bool are_battery_losses = true;
-    if (this->mode == charging)
-    {
-        this->calc_E1_limit = std::make_shared<calc_E1_energy_limit_charging>(are_battery_losses, inputs);
-    }
-    else
-    {
-        this->calc_E1_limit = std::make_shared<calc_E1_energy_limit_discharging>(are_battery_losses, inputs);
-    }
-
-    double min_soc = 1000;
-    double max_soc = -1000;
-
-    for (line_segment& x : this->orig_P2_vs_soc_segments)
-    {
-        if (x.x_LB < min_soc) min_soc = x.x_LB;
-        if (x.x_UB > max_soc) max_soc = x.x_UB;
-    }
-
-    ASSERT(min_soc >= -0.01 || max_soc <= 100.1, "PROBLEM: The following rule (for the P2_vs_soc_segments datatype) has been broken: min_soc < 0 and 100 < max_soc.");
-
-    //---------------------------------------------
-
-    std::sort(this->orig_P2_vs_soc_segments.begin(), this->orig_P2_vs_soc_segments.end());
-
     this->cur_P2_vs_soc_segments = this->orig_P2_vs_soc_segments;
 
     //---------------------
 
     this->prev_P2_limit_binding = true;
 
-    if (this->mode == charging)
+    if constexpr (mode == battery_charge_mode::charging)
         this->prev_P2_limit = -1000000000;
     else
         this->prev_P2_limit = 1000000000;
@@ -622,12 +139,12 @@ calculate_E1_energy_limit::calculate_E1_energy_limit(const battery_charge_mode&
 
     double val_0, val_1, val_tmp;
 
-    for(const line_segment& seg : this->cur_P2_vs_soc_segments)
+    for(const line_segment& seg : *this->cur_P2_vs_soc_segments)
     {
         val_0 = seg.a * seg.x_LB + seg.b;
         val_1 = seg.a * seg.x_UB + seg.b;
 
-        if (this->mode == charging)
+        if constexpr (mode == battery_charge_mode::charging)
         {	// max(val_0, val_1, this->max_abs_P2_in_P2_vs_soc_segments)
             val_tmp = val_0 < val_1 ? val_1 : val_0;
             this->max_abs_P2_in_P2_vs_soc_segments = val_tmp < this->max_abs_P2_in_P2_vs_soc_segments ? this->max_abs_P2_in_P2_vs_soc_segments : val_tmp;
@@ -640,134 +157,173 @@ calculate_E1_energy_limit::calculate_E1_energy_limit(const battery_charge_mode&
     }
 }
 
-void calculate_E1_energy_limit::apply_P2_limit_to_P2_vs_soc_segments(double P2_limit)
+
+template<battery_charge_mode mode, bool are_battery_losses>
+void calculate_E1_energy_limit<mode, are_battery_losses>::get_step_state(calculate_E1_energy_limit_step_state& state) const
 {
-	double soc_0, soc_1, soc_tmp, P_0, P_1, a, b;
-    double x_LB, x_UB, m, c;
+	state.cur_P2_vs_soc_segments = this->cur_P2_vs_soc_segments;
+	this->P2_vs_soc_algorithm.get_step_state(state.P2_vs_soc_algorithm);
+	state.prev_P2_limit = this->prev_P2_limit;
+	state.max_abs_P2_in_P2_vs_soc_segments = this->max_abs_P2_in_P2_vs_soc_segments;
+	state.prev_P2_limit_binding = this->prev_P2_limit_binding;
+}
 
-    std::vector<line_segment> new_P2_vs_soc_segments;
-	for(int i=0; i<this->cur_P2_vs_soc_segments.size(); i++)
-    {
-        x_LB = this->cur_P2_vs_soc_segments.at(i).x_LB;     // SOC 0
-        x_UB = this->cur_P2_vs_soc_segments.at(i).x_UB;     // SOC 1
-        a = this->cur_P2_vs_soc_segments.at(i).a;
-        b = this->cur_P2_vs_soc_segments.at(i).b;
-
-        soc_0 = x_LB;
-        soc_1 = x_UB;
-        m = a;
-        c = b;
-
-        P_0 = m * soc_0 + c;        // y = mx + c;
-        P_1 = m * soc_1 + c;
-        
-        if(this->mode == charging)
-        {
-		    if(P2_limit <= P_0 && P2_limit <= P_1)
-		    {
-		        a = 0;
-		        b = P2_limit;
-		    }
-		    else if(P_0 < P2_limit && P2_limit < P_1)
-		    {
-		        soc_tmp = (P2_limit - c)/m;
-		        x_UB = soc_tmp;
-		        
-                new_P2_vs_soc_segments.emplace_back(soc_tmp, soc_1, 0, P2_limit);
-		    }
-		    else if(P2_limit < P_0 && P_1 < P2_limit)
-		    {
-		        soc_tmp = (P2_limit - c)/m;
-		        x_LB = soc_tmp;
-		        
-                new_P2_vs_soc_segments.emplace_back(soc_0, soc_tmp, 0, P2_limit);
-		    }
-		}
-		else
-		{
-			if(P_0 <= P2_limit && P_1 <= P2_limit)
-		    {
-		        a = 0;
-		        b = P2_limit;        
-		    }
-		    else if(P2_limit < P_0 && P_1 < P2_limit)
-		    {
-		        soc_tmp = (P2_limit - c)/m;
-		        x_UB = soc_tmp;
-		        
-                new_P2_vs_soc_segments.emplace_back(soc_tmp, soc_1, 0, P2_limit);
-		    }
-		    else if(P_0 < P2_limit && P2_limit < P_1)
-		    {
-		        soc_tmp = (P2_limit - c)/m;
-		        x_LB = soc_tmp;
-
-                new_P2_vs_soc_segments.emplace_back(soc_0, soc_tmp, 0, P2_limit);
-		    }
-		}
-        new_P2_vs_soc_segments.emplace_back(x_LB, x_UB, a, b);
-    }
-    
-    std::sort(new_P2_vs_soc_segments.begin(), new_P2_vs_soc_segments.end());
-    this->cur_P2_vs_soc_segments = new_P2_vs_soc_segments;
+
+template<battery_charge_mode mode, bool are_battery_losses>
+void calculate_E1_energy_limit<mode, are_battery_losses>::set_step_state(const calculate_E1_energy_limit_step_state& state)
+{
+	this->cur_P2_vs_soc_segments = state.cur_P2_vs_soc_segments;
+	this->P2_vs_soc_algorithm.set_step_state(state.P2_vs_soc_algorithm);
+	this->prev_P2_limit = state.prev_P2_limit;
+	this->max_abs_P2_in_P2_vs_soc_segments = state.max_abs_P2_in_P2_vs_soc_segments;
+	this->prev_P2_limit_binding = state.prev_P2_limit_binding;
 }
 
 
-void calculate_E1_energy_limit::get_E1_limit(double time_step_sec, 
-                                             double init_soc, 
-                                             double target_soc, 
-                                             double pu_Vrms, 
-                                             E1_energy_limit& E1_limit)
+template<battery_charge_mode mode, bool are_battery_losses>
+void calculate_E1_energy_limit<mode, are_battery_losses>::log_cur_P2_vs_soc_segments(std::ostream& out)
 {
-	double P2_limit;
-	bool P2_limit_binding, P2_vs_soc_segments_changed;
-	
-	P2_limit = this->P2_vs_puVrms.get_val(pu_Vrms);
-	
-	if(this->mode == charging)
-	{
-		P2_limit_binding = (P2_limit < this->max_abs_P2_in_P2_vs_soc_segments);
-	}
-	else
-	{
-		P2_limit_binding = (this->max_abs_P2_in_P2_vs_soc_segments < P2_limit);
-	}
+	for(line_segment x: *this->cur_P2_vs_soc_segments)
+		out << x;
+		
+	out << "Number segments: " << this->cur_P2_vs_soc_segments->size() << std::endl << std::endl;
+}
 
-	//---------------------------
+
+template<battery_charge_mode mode, bool are_battery_losses>
+const std::vector<line_segment>& calculate_E1_energy_limit<mode, are_battery_losses>::get_cur_P2_vs_soc_segments() const
+{
+	return *this->cur_P2_vs_soc_segments;
+}
+
+
+template<battery_charge_mode mode, bool are_battery_losses>
+double calculate_E1_energy_limit<mode, are_battery_losses>::get_dP2_limit_dpuVrms(double pu_Vrms, double P2_kW) const
+{
+	if(!this->prev_P2_limit_binding)
+		return 0;
 	
-	P2_vs_soc_segments_changed = false;
+	// P2 is held below the voltage limit by something else (soc curve, ramping, target soc).
+	if(this->max_P2kW_error_before_reappling_P2kW_limit_to_P2_vs_soc_segments < std::abs(this->prev_P2_limit - P2_kW))
+		return 0;
 	
-	if(this->max_P2kW_error_before_reappling_P2kW_limit_to_P2_vs_soc_segments < std::abs(this->prev_P2_limit - P2_limit))
-	{
-		this->prev_P2_limit = P2_limit;
+	return this->P2_vs_puVrms.get_derivative(pu_Vrms);
+}
+
 
-		if(P2_limit_binding)
+namespace
+{
+	void write_P2_vs_soc_segments(std::ostream& out, const shared_P2_vs_soc_segments& segments, const shared_P2_vs_soc_segments& orig_segments)
+	{
+		const bool is_orig = (segments == orig_segments);
+		write_pod<bool>(out, is_orig);
+		
+		if(is_orig)
+			return;
+		
+		write_pod<uint64_t>(out, (uint64_t)segments->size());
+		for(const line_segment& seg : *segments)
 		{
-			P2_vs_soc_segments_changed = true;
-			this->cur_P2_vs_soc_segments = this->orig_P2_vs_soc_segments;
-			this->apply_P2_limit_to_P2_vs_soc_segments(P2_limit);
+			write_pod<double>(out, seg.x_LB);
+			write_pod<double>(out, seg.x_UB);
+			write_pod<double>(out, seg.a);
+			write_pod<double>(out, seg.b);
 		}
-		else
+	}
+	
+	shared_P2_vs_soc_segments read_P2_vs_soc_segments(std::istream& in, const shared_P2_vs_soc_segments& orig_segments)
+	{
+		if(read_pod<bool>(in))
+			return orig_segments;
+		
+		const uint64_t num_segments = read_pod<uint64_t>(in);
+		std::vector<line_segment> segments;
+		
+		if(in.good() && has_remaining_bytes(in, num_segments, 4*sizeof(double)))
 		{
-			if(this->prev_P2_limit_binding)
+			segments.reserve(num_segments);
+			for(uint64_t i = 0; i < num_segments; i++)
 			{
-				P2_vs_soc_segments_changed = true;
-				this->cur_P2_vs_soc_segments = this->orig_P2_vs_soc_segments;
+				const double x_LB = read_pod<double>(in);
+				const double x_UB = read_pod<double>(in);
+				const double a = read_pod<double>(in);
+				const double b = read_pod<double>(in);
+				segments.emplace_back(x_LB, x_UB, a, b);
 			}
 		}
 		
-		this->prev_P2_limit_binding = P2_limit_binding;
+		// The algorithm indexes the segments without checks.
+		if(segments.empty())
+			in.setstate(std::ios::failbit);
+		
+		return std::make_shared<const std::vector<line_segment> >(std::move(segments));
 	}
+}
+
+
+template<battery_charge_mode mode, bool are_battery_losses>
+void calculate_E1_energy_limit<mode, are_battery_losses>::write_step_state(std::ostream& out) const
+{
+	calculate_E1_energy_limit_step_state state;
+	this->get_step_state(state);
+	
+	const algorithm_P2_vs_soc_step_state& X = state.P2_vs_soc_algorithm;
+	
+	write_P2_vs_soc_segments(out, state.cur_P2_vs_soc_segments, this->orig_P2_vs_soc_segments);
+	
+	const bool algorithm_has_cur_segments = (X.P2_vs_soc == state.cur_P2_vs_soc_segments);
+	write_pod<bool>(out, algorithm_has_cur_segments);
+	if(!algorithm_has_cur_segments)
+		write_P2_vs_soc_segments(out, X.P2_vs_soc, this->orig_P2_vs_soc_segments);
 	
-    std::shared_ptr<std::vector<line_segment>> P2_vs_soc_ptr = std::make_shared<std::vector<line_segment> >(this->cur_P2_vs_soc_segments);
-	this->calc_E1_limit->get_E1_limit(time_step_sec, init_soc, target_soc, P2_vs_soc_segments_changed, P2_vs_soc_ptr, E1_limit);
+	write_pod<int32_t>(out, X.seg_index);
+	write_pod<int32_t>(out, X.ref_seg_index);
+	write_pod<double>(out, X.prev_exp_val);
+	write_pod<double>(out, X.exp_term);
+	write_pod<bool>(out, X.segment_is_flat_P2_vs_soc);
+	write_pod<bool>(out, X.P2_vs_soc_segments_changed);
+	for(const double val : { X.a, X.b, X.c, X.d, X.A, X.B, X.C, X.D, X.z })
+		write_pod<double>(out, val);
+	
+	write_pod<double>(out, state.prev_P2_limit);
+	write_pod<double>(out, state.max_abs_P2_in_P2_vs_soc_segments);
+	write_pod<bool>(out, state.prev_P2_limit_binding);
 }
 
 
-void calculate_E1_energy_limit::log_cur_P2_vs_soc_segments(std::ostream& out)
+template<battery_charge_mode mode, bool are_battery_losses>
+void calculate_E1_energy_limit<mode, are_battery_losses>::read_step_state(std::istream& in)
 {
-	for(line_segment x: this->cur_P2_vs_soc_segments)
-		out << x;
-		
-	out << "Number segments: " << this->cur_P2_vs_soc_segments.size() << std::endl << std::endl;
-}
\ No newline at end of file
+	calculate_E1_energy_limit_step_state state;
+	algorithm_P2_vs_soc_step_state& X = state.P2_vs_soc_algorithm;
+	
+	state.cur_P2_vs_soc_segments = read_P2_vs_soc_segments(in, this->orig_P2_vs_soc_segments);
+	X.P2_vs_soc = read_pod<bool>(in) ? state.cur_P2_vs_soc_segments : read_P2_vs_soc_segments(in, this->orig_P2_vs_soc_segments);
+	
+	X.seg_index = read_pod<int32_t>(in);
+	X.ref_seg_index = read_pod<int32_t>(in);
+	X.prev_exp_val = read_pod<double>(in);
+	X.exp_term = read_pod<double>(in);
+	X.segment_is_flat_P2_vs_soc = read_pod<bool>(in);
+	X.P2_vs_soc_segments_changed = read_pod<bool>(in);
+	for(double* val : { &X.a, &X.b, &X.c, &X.d, &X.A, &X.B, &X.C, &X.D, &X.z })
+		*val = read_pod<double>(in);
+	
+	state.prev_P2_limit = read_pod<double>(in);
+	state.max_abs_P2_in_P2_vs_soc_segments = read_pod<double>(in);
+	state.prev_P2_limit_binding = read_pod<bool>(in);
+	
+	if(!in.good() || X.seg_index < 0 || X.seg_index >= (int)X.P2_vs_soc->size() || X.ref_seg_index >= (int)X.P2_vs_soc->size())
+	{
+		in.setstate(std::ios::failbit);
+		return;
+	}
+	
+	this->set_step_state(state);
+}
+
+
+template class calculate_E1_energy_limit<battery_charge_mode::charging, false>;
+template class calculate_E1_energy_limit<battery_charge_mode::charging, true>;
+template class calculate_E1_energy_limit<battery_charge_mode::discharging, false>;
+template class calculate_E1_energy_limit<battery_charge_mode::discharging, true>;
@@ -6,6 +6,7 @@
 #include <vector>
 #include <iostream>   	// Stream to consol (may be needed for files too???)
 #include <memory>
+#include <cmath>    	// abs, exp, log
 
 #include "inputs.h"							// vehicle_charge_model_inputs
 #include "helper.h"                         // line_segment
@@ -39,22 +40,43 @@ std::ostream& operator<<(std::ostream& out, E1_energy_limit& x);
 //                 Algroithm soc_t1 from (t1-t0) and soc_t0  
 //#############################################################################
 
+// The soc reached after (t1-t0) and the time to reach a soc, on the P2_vs_soc segment
+// the soc is on.  The formulas with and without battery losses are specializations of
+// get_soc_t1 and get_time_to_soc_t1_hrs, so calc_E1_energy_limit gets them inlined
+// instead of calling them through a virtual function on every segment.
+
+// The part of algorithm_P2_vs_soc that changes while it is used.
+struct algorithm_P2_vs_soc_step_state
+{
+    shared_P2_vs_soc_segments P2_vs_soc;
+    int seg_index, ref_seg_index;
+    double prev_exp_val, exp_term;
+    bool segment_is_flat_P2_vs_soc, P2_vs_soc_segments_changed;
+    double a, b, c, d, A, B, C, D, z;
+};
+
+
 class algorithm_P2_vs_soc
 {
 private:
-	
-protected:
 
-    std::shared_ptr<std::vector<line_segment> > P2_vs_soc;
+    shared_P2_vs_soc_segments P2_vs_soc;
+    const line_segment* bat_eff_vs_P2;
 
     int seg_index, ref_seg_index;
     double soc_to_energy, prev_exp_val, exp_term;
 	double recalc_exponent_threshold, zero_slope_threshold_P2_vs_soc;
 	bool segment_is_flat_P2_vs_soc, P2_vs_soc_segments_changed;
+    
+    double a, b, c, d, A, B, C, D, z;
+
+    template<bool are_battery_losses>
+    void update_segment_vals();
 
 public:
 
-    algorithm_P2_vs_soc(const vehicle_charge_model_inputs& inputs);
+    algorithm_P2_vs_soc(const battery_charge_mode& mode, 
+                        const vehicle_charge_model_inputs& inputs);
     
     void find_line_segment_index(double init_soc, 
                                  bool &line_segment_not_found);    
@@ -63,102 +85,409 @@ public:
     double get_soc_to_energy() const;
     void get_next_line_segment(bool is_charging_not_discharging, 
                                bool &next_line_segment_exists);
-    void set_P2_vs_soc(std::shared_ptr<std::vector<line_segment> > P2_vs_soc);
-    virtual double get_soc_t1(double t1_minus_t0_hrs, 
-                              double soc_t0) = 0;
-    virtual double get_time_to_soc_t1_hrs(double soc_t0, 
-                                          double soc_t1) = 0;
+    void set_P2_vs_soc(const shared_P2_vs_soc_segments& P2_vs_soc);
+    
+    void get_step_state(algorithm_P2_vs_soc_step_state& state) const;
+    void set_step_state(const algorithm_P2_vs_soc_step_state& state);
+    
+    template<bool are_battery_losses>
+    double get_soc_t1(double t1_minus_t0_hrs, 
+                      double soc_t0);
+    
+    template<bool are_battery_losses>
+    double get_time_to_soc_t1_hrs(double soc_t0, 
+                                  double soc_t1);
 };
 
 
-class algorithm_P2_vs_soc_no_losses:public algorithm_P2_vs_soc
+inline double algorithm_P2_vs_soc::get_soc_to_energy() const
 {
-private:
+	return this->soc_to_energy;
+}
 
-    double a, b, A;
+inline double algorithm_P2_vs_soc::get_soc_UB() const
+{
+	return (*this->P2_vs_soc)[this->seg_index].x_UB;
+}
+
+inline double algorithm_P2_vs_soc::get_soc_LB() const
+{
+	return (*this->P2_vs_soc)[this->seg_index].x_LB;
+}
+
+inline void algorithm_P2_vs_soc::find_line_segment_index(double init_soc, 
+                                                         bool &line_segment_not_found)
+{
+    const std::vector<line_segment>& segments = *this->P2_vs_soc;
+    const int num_segments = (int)segments.size();
     
-public:
-    algorithm_P2_vs_soc_no_losses(const battery_charge_mode& mode, 
-                                  const vehicle_charge_model_inputs& inputs);
+    // The first segment with init_soc <= x_UB.  The soc moves little between time steps, so
+    // the search starts from the segment of the last step instead of the first segment.
+    int i = this->seg_index;
+    i = (i < 0) ? 0 : i;
+    i = (num_segments <= i) ? num_segments - 1 : i;
     
-    virtual double get_soc_t1(double t1_minus_t0_hrs, 
-                              double soc_t0) override final;
-    virtual double get_time_to_soc_t1_hrs(double soc_t0, 
-                                          double soc_t1) override final;
-};
+    while(0 < i && init_soc <= segments[i-1].x_UB)
+        i--;
+    
+    while(0 <= i && i < num_segments && !(init_soc <= segments[i].x_UB))
+        i++;
+    
+    this->seg_index = (0 <= i && i < num_segments) ? i : -1;
+    line_segment_not_found = (this->seg_index == -1);
+}
 
 
-class algorithm_P2_vs_soc_losses:public algorithm_P2_vs_soc
+inline void algorithm_P2_vs_soc::get_next_line_segment(bool is_charging_not_discharging, 
+                                                       bool &next_line_segment_exists)
 {
-private:
+    if(is_charging_not_discharging)
+    {
+        this->seg_index++;
+        next_line_segment_exists = (this->seg_index < (int)this->P2_vs_soc->size());
+    }
+    else
+    {
+        this->seg_index--;
+        next_line_segment_exists = (this->seg_index >= 0);
+    }
+}
+
+
+//##############################
+//          No Losses
+//##############################
+
+template<>
+inline void algorithm_P2_vs_soc::update_segment_vals<false>()
+{
+    this->ref_seg_index = this->seg_index;
+    this->a = (*this->P2_vs_soc)[this->seg_index].a;
+    this->b = (*this->P2_vs_soc)[this->seg_index].b;
+    this->A = this->a/this->soc_to_energy;
+    this->segment_is_flat_P2_vs_soc = std::abs(this->a) < this->zero_slope_threshold_P2_vs_soc;
+}
+
+template<>
+inline double algorithm_P2_vs_soc::get_soc_t1<false>(double t1_minus_t0_hrs, 
+                                                     double soc_t0)
+{
+	bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);	
+	this->P2_vs_soc_segments_changed = false;
 
-    double a, b, c, d, A, B, C, D, z;
-    const line_segment& bat_eff_vs_P2;
+    if(update_vals)
+    {
+        this->update_segment_vals<false>();
+        
+        this->prev_exp_val = this->A*t1_minus_t0_hrs;
+        this->exp_term = std::exp(this->prev_exp_val);
+    }
+    
+    //-------------
+    
+    double soc_t1;
+    
+    if(this->segment_is_flat_P2_vs_soc)
+    {
+    	double P2_soc_t0 = this->a*soc_t0 + this->b;
+        soc_t1 = soc_t0 + P2_soc_t0*t1_minus_t0_hrs/this->soc_to_energy;
+    }
+    else
+    {
+    	double cur_exp_val = this->A*t1_minus_t0_hrs;
+    	
+        if(this->recalc_exponent_threshold < std::abs(this->prev_exp_val - cur_exp_val))
+        {
+        	this->prev_exp_val = cur_exp_val;
+            this->exp_term = std::exp(cur_exp_val);
+        }
+        
+        double P2_soc_t1;
+        
+        P2_soc_t1 = this->exp_term*(this->a*soc_t0 + this->b);
+        soc_t1 = (P2_soc_t1-this->b)/this->a;
+    }
+    
+    return soc_t1;
+}
 
-public:
-    algorithm_P2_vs_soc_losses(const battery_charge_mode& mode, 
-                               const vehicle_charge_model_inputs& inputs);
-	
-    virtual double get_soc_t1(double t1_minus_t0_hrs, 
-                              double soc_t0) override final;
-    virtual double get_time_to_soc_t1_hrs(double soc_t0, 
-                                          double soc_t1) override final;
-};
+template<>
+inline double algorithm_P2_vs_soc::get_time_to_soc_t1_hrs<false>(double soc_t0, 
+                                                                 double soc_t1)
+{
+	bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);
+	this->P2_vs_soc_segments_changed = false;
 
+    if(update_vals)
+        this->update_segment_vals<false>();
+    
+    //-------------
+    
+    double tmp_hrs;
+    
+    if(this->segment_is_flat_P2_vs_soc)
+    {
+    	double P2_soc_t0 = this->a*soc_t0 + this->b;
+        tmp_hrs = (soc_t1 - soc_t0)*this->soc_to_energy/P2_soc_t0;
+    }
+    else
+        tmp_hrs = std::log((this->a*soc_t1 + this->b)/(this->a*soc_t0 + this->b))/this->A;
+                          
+    return tmp_hrs;
+}
+
+
+//##############################
+//            Losses
+//##############################
+
+template<>
+inline void algorithm_P2_vs_soc::update_segment_vals<true>()
+{
+    this->ref_seg_index = this->seg_index;
+    this->a = (*this->P2_vs_soc)[this->seg_index].a;
+    this->b = (*this->P2_vs_soc)[this->seg_index].b;
+    this->c = this->bat_eff_vs_P2->a;
+    this->d = this->bat_eff_vs_P2->b;
+    
+    this->A = this->a/this->soc_to_energy;
+    this->B = this->b;
+    this->C = this->c*this->a/this->soc_to_energy;
+    this->D = this->c*this->b + this->d;
+    this->z = this->B*this->C - this->A*this->D;
+            
+    this->segment_is_flat_P2_vs_soc = std::abs(this->a) < this->zero_slope_threshold_P2_vs_soc;
+}
+
+template<>
+inline double algorithm_P2_vs_soc::get_soc_t1<true>(double t1_minus_t0_hrs, 
+                                                    double soc_t0)
+{
+    bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);
+    this->P2_vs_soc_segments_changed = false;
 
-//#############################################################################
-//                         Calculate Energy Limit
-//#############################################################################
+    if(update_vals)
+    {
+        this->update_segment_vals<true>();
+        
+        this->prev_exp_val = this->z*t1_minus_t0_hrs;
+        this->exp_term = std::exp(this->prev_exp_val);
+    }
+    
+    //-------------
+    
+    double soc_t1, e_t0, eff_e_t0;
+        
+    e_t0 = soc_t0*this->soc_to_energy;
+    eff_e_t0 = this->C*e_t0 + this->D;
+    
+    if(this->segment_is_flat_P2_vs_soc)
+    {
+    	double P2_soc_t0 = this->a*soc_t0 + this->b;
+        soc_t1 = soc_t0 + eff_e_t0*P2_soc_t0*t1_minus_t0_hrs/this->soc_to_energy;
+    }
+    else
+    {
+    	double cur_exp_val = this->z*t1_minus_t0_hrs;
+    	
+        if(this->recalc_exponent_threshold < std::abs(this->prev_exp_val - cur_exp_val))
+        {
+        	this->prev_exp_val = cur_exp_val;
+            this->exp_term = std::exp(cur_exp_val);
+        }
+
+        double e_t1, P2_e_t0, X;
+        
+        P2_e_t0 = this->A*e_t0 + this->B;
+        X = this->exp_term * eff_e_t0 / P2_e_t0;
+        e_t1 = (X*this->B - this->D)/(this->C - X*this->A);
+        soc_t1 = e_t1/this->soc_to_energy;
+ 	}
+    
+    //-------------
+    
+    return soc_t1;
+}
 
-class calc_E1_energy_limit
+template<>
+inline double algorithm_P2_vs_soc::get_time_to_soc_t1_hrs<true>(double soc_t0, 
+                                                                double soc_t1)
 {
-private:
+	bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);
+	this->P2_vs_soc_segments_changed = false;
 
-protected:
-    std::shared_ptr<algorithm_P2_vs_soc> P2_vs_soc_algorithm;
-	
-public:
-
-    calc_E1_energy_limit(const battery_charge_mode& mode, 
-                         const bool& are_battery_losses, 
-                         const vehicle_charge_model_inputs& inputs);
+    if(update_vals)
+        this->update_segment_vals<true>();
     
-    virtual void get_E1_limit(double time_step_sec, double init_soc, double target_soc, bool P2_vs_soc_segments_changed, std::shared_ptr<std::vector<line_segment> > P2_vs_soc, E1_energy_limit& E1_limit) = 0;
-};
+    //-------------
+    
+    double tmp_hrs, e_t0, eff_e_t0;
+    
+    e_t0 = soc_t0*this->soc_to_energy;
+    eff_e_t0 = this->C*e_t0 + this->D;
+    
+    if(this->segment_is_flat_P2_vs_soc)
+    {
+    	double P2_soc_t0 = this->a*soc_t0 + this->b;
+        tmp_hrs = (soc_t1-soc_t0)*this->soc_to_energy/(P2_soc_t0*eff_e_t0);
+    }
+    else
+    {
+        double e_t1, P2_e_t0, P2_e_t1, eff_e_t1;
+        
+        P2_e_t0 = this->A*e_t0 + this->B;
+        e_t1 = soc_t1*this->soc_to_energy;
+        P2_e_t1 = this->A*e_t1 + this->B;
+        eff_e_t1 = this->C*e_t1 + this->D;
+        
+        tmp_hrs = std::log((eff_e_t1*P2_e_t0)/(eff_e_t0*P2_e_t1))/this->z;
+    }
+    return tmp_hrs;
+}
 
 
-class calc_E1_energy_limit_charging:public calc_E1_energy_limit
-{
-private:
-        
-public:
-    calc_E1_energy_limit_charging(const bool& are_battery_losses, 
-                                  const vehicle_charge_model_inputs& inputs);
-    
-    virtual void get_E1_limit(double time_step_sec, 
-                              double init_soc, 
-                              double target_soc, 
-                              bool P2_vs_soc_segments_changed, 
-                              std::shared_ptr<std::vector<line_segment> > P2_vs_soc, 
-                              E1_energy_limit& E1_limit) override final;
-};
 
+//#############################################################################
+//                         Calculate Energy Limit
+//#############################################################################
 
-class calc_E1_energy_limit_discharging:public calc_E1_energy_limit
-{
-private:
+// The energy E1 the battery can take (charging) or give (discharging) in time_step_sec
+// starting at init_soc, and whether target_soc is reached in that time.
 
-public:
-    calc_E1_energy_limit_discharging(const bool& are_battery_losses, 
-                                     const vehicle_charge_model_inputs& inputs);
-
-    virtual void get_E1_limit(double time_step_sec, 
-                              double init_soc, 
-                              double target_soc, 
-                              bool P2_vs_soc_segments_changed, 
-                              std::shared_ptr<std::vector<line_segment> > P2_vs_soc, 
-                              E1_energy_limit& E1_limit) override final;
-};
+template<battery_charge_mode mode, bool are_battery_losses>
+inline void calc_E1_energy_limit(algorithm_P2_vs_soc& P2_vs_soc_algorithm, 
+                                 double time_step_sec, 
+                                 double init_soc, 
+                                 double target_soc, 
+                                 E1_energy_limit& E1_limit)
+{
+    constexpr bool is_charging_not_discharging = (mode == battery_charge_mode::charging);
+    
+    bool line_segment_not_found;
+    P2_vs_soc_algorithm.find_line_segment_index(init_soc, line_segment_not_found);
+    
+    if(line_segment_not_found)
+    {
+        if constexpr (is_charging_not_discharging)
+            E1_limit = {100, 0, 0, unknown, 0, -1}; // {target_soc, max_energy_kWh, max_energy_charge_time_hrs, reached_target_status, energy_to_target_soc_kWh, min_time_to_target_soc_hrs}
+        else
+            E1_limit = {0, 0, 0, unknown, 0, -1};
+    	return;
+    }
+    
+    //----------------------------------
+    //        Calculate
+    //----------------------------------
+    
+    energy_target_reached_status energy_target_status = unknown;
+    
+    if constexpr (is_charging_not_discharging)
+    {
+        target_soc = (100 < target_soc) ? 100 : target_soc;
+        
+        if(target_soc <= init_soc)
+        {
+            energy_target_status = have_passed_energy_target;
+            target_soc = 100;
+        }
+    }
+    else
+    {
+        target_soc = (target_soc < 0) ? 0 : target_soc;
+        
+        if(init_soc <= target_soc)
+        {
+            energy_target_status = have_passed_energy_target;
+            target_soc = 0;
+        }
+    }
+    
+    double soc_bound, soc_t0, soc_t1, t1_minus_t0_hrs, tmp_hrs;
+    double min_time_to_target_hrs, max_energy_charge_time_hrs;
+    bool break_now, target_is_in_this_segment;
+    bool next_line_segment_exists;
+    
+    soc_t0 = init_soc;
+    t1_minus_t0_hrs = time_step_sec/3600;
+    max_energy_charge_time_hrs = 0;
+    break_now = false;
+    while(true)
+    {
+        soc_t1 = P2_vs_soc_algorithm.get_soc_t1<are_battery_losses>(t1_minus_t0_hrs, soc_t0);
+        
+        if constexpr (is_charging_not_discharging)
+        {
+            soc_bound = P2_vs_soc_algorithm.get_soc_UB();
+            
+            if(100 < soc_t1)
+                soc_t1 = 100;
+            
+            // For the last segment (soc_UB > 100)
+            // Since soc_t1 <= 100: if(soc_UB < soc_t1) will never be true for the last segment
+            if(soc_bound < soc_t1)
+                soc_t1 = soc_bound;
+            else
+                break_now = true;
+            
+            target_is_in_this_segment = (soc_t0 <= target_soc && target_soc <= soc_t1);
+        }
+        else
+        {
+            soc_bound = P2_vs_soc_algorithm.get_soc_LB();
+            
+            if(soc_t1 < 0)
+                soc_t1 = 0;
+            
+            // For the first segment (soc_LB < 0)
+            // Since soc_t1 >= 0: if(soc_t1 < soc_LB) will never be true for the first segment
+            if(soc_t1 < soc_bound)
+                soc_t1 = soc_bound;
+            else
+                break_now = true;
+            
+            target_is_in_this_segment = (soc_t1 <= target_soc && target_soc <= soc_t0);
+        }
+
+        if(energy_target_status == unknown && target_is_in_this_segment)
+        {
+            energy_target_status = can_reach_energy_target_this_timestep;
+            tmp_hrs = P2_vs_soc_algorithm.get_time_to_soc_t1_hrs<are_battery_losses>(soc_t0, target_soc);
+            min_time_to_target_hrs = max_energy_charge_time_hrs + tmp_hrs;
+        }
+
+        if(break_now)
+        {
+            max_energy_charge_time_hrs += t1_minus_t0_hrs;
+            break;
+        }
+        else
+        {
+            tmp_hrs = P2_vs_soc_algorithm.get_time_to_soc_t1_hrs<are_battery_losses>(soc_t0, soc_t1);
+            max_energy_charge_time_hrs += tmp_hrs;
+        
+            t1_minus_t0_hrs -= tmp_hrs;
+            soc_t0 = soc_t1;
+            P2_vs_soc_algorithm.get_next_line_segment(is_charging_not_discharging, next_line_segment_exists);
+            
+            if(!next_line_segment_exists)
+                break;
+        }
+    }
+        
+    if(energy_target_status == unknown)
+        energy_target_status = can_not_reach_energy_target_this_timestep;
+    
+    //--------------------------------------------
+    
+    double soc_to_energy = P2_vs_soc_algorithm.get_soc_to_energy();
+    
+    E1_limit.target_soc = target_soc;
+    E1_limit.max_E1_energy_charge_time_hrs = max_energy_charge_time_hrs;
+    E1_limit.max_E1_energy_kWh = (soc_t1 - init_soc)*soc_to_energy;
+    E1_limit.reached_target_status = energy_target_status;
+    E1_limit.E1_energy_to_target_soc_kWh = (energy_target_status == can_reach_energy_target_this_timestep) ? (target_soc - init_soc)*soc_to_energy : 0;
+    E1_limit.min_time_to_target_soc_hrs = (energy_target_status == can_reach_energy_target_this_timestep) ? min_time_to_target_hrs : -1;
+}
 
 
 //#############################################################################
@@ -166,28 +495,43 @@ public:
 //#############################################################################
 
 
+// The part of calculate_E1_energy_limit that get_E1_limit changes.
+struct calculate_E1_energy_limit_step_state
+{
+    shared_P2_vs_soc_segments cur_P2_vs_soc_segments;
+    algorithm_P2_vs_soc_step_state P2_vs_soc_algorithm;
+    double prev_P2_limit, max_abs_P2_in_P2_vs_soc_segments;
+    bool prev_P2_limit_binding;
+};
+
+
+// The charge mode and the battery losses flag are template parameters, so get_E1_limit calls
+// the calc_E1_energy_limit of the battery without choosing it on every step.  The members
+// other than get_E1_limit are instantiated for every mode and flag in the .cpp.
+
+template<battery_charge_mode mode, bool are_battery_losses = true>
 class calculate_E1_energy_limit
 {
 private:
-    battery_charge_mode mode;
-
     poly_function_of_x  P2_vs_puVrms;
     double max_P2kW_error_before_reappling_P2kW_limit_to_P2_vs_soc_segments;
 
-    std::vector<line_segment> orig_P2_vs_soc_segments;
-    std::shared_ptr<calc_E1_energy_limit> calc_E1_limit;
-    std::vector<line_segment> cur_P2_vs_soc_segments;
+    // The segments are shared with every battery of the same curve, the P2 limited ones
+    // come from the cache in factory_SOC_vs_P2.
+    const factory_SOC_vs_P2* SOCP_factory;
+    const SOC_vs_P2* P2_vs_soc_curve;
+    shared_P2_vs_soc_segments orig_P2_vs_soc_segments;
+    shared_P2_vs_soc_segments cur_P2_vs_soc_segments;
+    
+    algorithm_P2_vs_soc P2_vs_soc_algorithm;
 
     double prev_P2_limit, max_abs_P2_in_P2_vs_soc_segments;
     bool prev_P2_limit_binding;
-
-	void apply_P2_limit_to_P2_vs_soc_segments(double P2_limit);
 	
 
 public:
 
-    calculate_E1_energy_limit(const battery_charge_mode& mode, 
-                              const vehicle_charge_model_inputs& inputs);
+    calculate_E1_energy_limit(const vehicle_charge_model_inputs& inputs);
 
 	void get_E1_limit(double time_step_sec, 
                       double init_soc, 
@@ -195,7 +539,80 @@ public:
                       double pu_Vrms, 
                       E1_energy_limit& E1_limit);
 	
+	void get_step_state(calculate_E1_energy_limit_step_state& state) const;
+	void set_step_state(const calculate_E1_energy_limit_step_state& state);
+	
+	// Binary form of the step state.  The segments are written by value unless they are
+	// the original ones of the curve, so a read battery holds its own P2 limited segments
+	// until the limit moves again.  read_step_state leaves 'in' failed on bad data.
+	void write_step_state(std::ostream& out) const;
+	void read_step_state(std::istream& in);
+	
 	void log_cur_P2_vs_soc_segments(std::ostream& out);
+	
+	// The P2_vs_soc segments with the P2 limit applied in the last get_E1_limit.
+	const std::vector<line_segment>& get_cur_P2_vs_soc_segments() const;
+	
+	// dP2_limit/dpuVrms of the P2_vs_puVrms curve when the voltage limit applied in the
+	// last get_E1_limit is binding and P2_kW sits on it, otherwise zero.  get_E1_limit
+	// only reapplies the limit once it moves by more than
+	// max_P2kW_error_before_reappling_P2kW_limit_to_P2_vs_soc_segments (0.5 kW), so the
+	// simulated P2 is flat for smaller voltage changes.  This is the slope of the curve
+	// the limit follows, not of that hysteresis.
+	double get_dP2_limit_dpuVrms(double pu_Vrms, double P2_kW) const;
 };
 
-#endif
\ No newline at end of file
+
+template<battery_charge_mode mode, bool are_battery_losses>
+inline void calculate_E1_energy_limit<mode, are_battery_losses>::get_E1_limit(double time_step_sec, 
+                                                                           double init_soc, 
+                                                                           double target_soc, 
+                                                                           double pu_Vrms, 
+                                                                           E1_energy_limit& E1_limit)
+{
+	double P2_limit;
+	bool P2_limit_binding, P2_vs_soc_segments_changed;
+	
+	P2_limit = this->P2_vs_puVrms.get_val(pu_Vrms);
+	
+	if constexpr (mode == battery_charge_mode::charging)
+	{
+		P2_limit_binding = (P2_limit < this->max_abs_P2_in_P2_vs_soc_segments);
+	}
+	else
+	{
+		P2_limit_binding = (this->max_abs_P2_in_P2_vs_soc_segments < P2_limit);
+	}
+
+	//---------------------------
+	
+	P2_vs_soc_segments_changed = false;
+	
+	if(this->max_P2kW_error_before_reappling_P2kW_limit_to_P2_vs_soc_segments < std::abs(this->prev_P2_limit - P2_limit))
+	{
+		this->prev_P2_limit = P2_limit;
+
+		if(P2_limit_binding)
+		{
+			P2_vs_soc_segments_changed = true;
+			this->cur_P2_vs_soc_segments = this->SOCP_factory->get_P2_limited_P2_vs_soc_segments(*this->P2_vs_soc_curve, mode, P2_limit);
+		}
+		else
+		{
+			if(this->prev_P2_limit_binding)
+			{
+				P2_vs_soc_segments_changed = true;
+				this->cur_P2_vs_soc_segments = this->orig_P2_vs_soc_segments;
+			}
+		}
+		
+		this->prev_P2_limit_binding = P2_limit_binding;
+	}
+	
+	if(P2_vs_soc_segments_changed)
+		this->P2_vs_soc_algorithm.set_P2_vs_soc(this->cur_P2_vs_soc_segments);
+	
+	calc_E1_energy_limit<mode, are_battery_losses>(this->P2_vs_soc_algorithm, time_step_sec, init_soc, target_soc, E1_limit);
+}
+
+#endif
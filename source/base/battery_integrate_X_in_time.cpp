@@ -1,5 +1,6 @@
 
 #include "battery_integrate_X_in_time.h"
+#include "helper.h"         // write_pod, read_pod
 
 #include <cmath>        // abs, exp, sqrt
 #include <fstream>        // Stream to files
@@ -107,44 +108,46 @@ transition_of_X_through_time::transition_of_X_through_time( const transition_sta
 }
 
 
-bool transition_of_X_through_time::transition_is_moving_toward_pos_inf()
+bool transition_of_X_through_time::transition_is_moving_toward_pos_inf() const
 {
     return this->transition_moving_toward_pos_inf;
 }
 
 
-void transition_of_X_through_time::init_transition( const double start_of_transition_unix_time,
+void transition_of_X_through_time::init_transition( transition_of_X_through_time_state& state,
+                                                    const double start_of_transition_unix_time,
                                                     const double X_at_beginning_of_transition_,
                                                     const double target_ref_X_,
                                                     const transition_interruption_state trans_interruption_state,
-                                                    const bool transition_just_crossed_zero )
+                                                    const bool transition_just_crossed_zero ) const
 {
-    this->start_of_segment_unix_time = start_of_transition_unix_time;
-    this->end_of_last_interval_unix_time = start_of_transition_unix_time;
-    this->start_of_segment_X_val = X_at_beginning_of_transition_;
-    this->target_ref_X = target_ref_X_;
+    state.start_of_segment_unix_time = start_of_transition_unix_time;
+    state.end_of_last_interval_unix_time = start_of_transition_unix_time;
+    state.start_of_segment_X_val = X_at_beginning_of_transition_;
+    state.target_ref_X = target_ref_X_;
     
     if( transition_just_crossed_zero )
     {
-        this->segment_index = (int)this->goto_next_segment_criteria.size() - 1;
+        state.segment_index = (int)this->goto_next_segment_criteria.size() - 1;
     }
     else if(trans_interruption_state == transition_interruption_state::new_transition_in_opposite_direction)
     {
-        this->segment_index = 1;
+        state.segment_index = 1;
     }
     else if(trans_interruption_state == transition_interruption_state::new_transition_in_same_direction)
     {
-        this->segment_index = 2;
+        state.segment_index = 2;
     }
     else
     {
-        this->segment_index = 0;
+        state.segment_index = 0;
     }
 }
 
-transition_integral_of_X transition_of_X_through_time::get_integral( const double target_X_original_parameter,
+transition_integral_of_X transition_of_X_through_time::get_integral( transition_of_X_through_time_state& state,
+                                                                     const double target_X_original_parameter,
                                                                      const double integrate_to_unix_time,
-                                                                     const bool transition_will_cross_zero )
+                                                                     const bool transition_will_cross_zero ) const
 {
     bool will_reach_target_before_now_time;
     bool target_X_deviation_limit_exceeded;
@@ -165,14 +168,15 @@ transition_integral_of_X transition_of_X_through_time::get_integral( const doubl
     double interval_area_Xsec;
     double interval_duration_sec;
     double segment_slope_;
+    double target_X_deviation_limit_to_interupt_this_transition;
 
     // Set the const parameter to a mutable copy.
     double target_X = target_X_original_parameter;
     
-    start_of_interval_unix_time = this->end_of_last_interval_unix_time;
+    start_of_interval_unix_time = state.end_of_last_interval_unix_time;
     
-    segment_slope_ = this->goto_next_segment_criteria[this->segment_index].segment_slope_X_per_sec;
-    start_of_interval_X_val = this->start_of_segment_X_val + segment_slope_*(start_of_interval_unix_time - this->start_of_segment_unix_time);
+    segment_slope_ = this->goto_next_segment_criteria[state.segment_index].segment_slope_X_per_sec;
+    start_of_interval_X_val = state.start_of_segment_X_val + segment_slope_*(start_of_interval_unix_time - state.start_of_segment_unix_time);
     
     //---------------------------
     //   Transition Interupted
@@ -195,12 +199,12 @@ transition_integral_of_X transition_of_X_through_time::get_integral( const doubl
         // the code calling this class will need to create a new transition to move toward the target but if 
         // the current value is within the deadband then the next state should be Steady State.
 
-    target_X_deviation_limit_to_interupt_this_transition = this->goto_next_segment_criteria[this->segment_index].target_X_deviation_limit_to_interupt_this_transition;
+    target_X_deviation_limit_to_interupt_this_transition = this->goto_next_segment_criteria[state.segment_index].target_X_deviation_limit_to_interupt_this_transition;
     
-    target_X_deviation_limit_exceeded = this->transition_moving_toward_pos_inf ? target_X >= this->target_ref_X + target_X_deviation_limit_to_interupt_this_transition : target_X <= this->target_ref_X - target_X_deviation_limit_to_interupt_this_transition; 
+    target_X_deviation_limit_exceeded = this->transition_moving_toward_pos_inf ? target_X >= state.target_ref_X + target_X_deviation_limit_to_interupt_this_transition : target_X <= state.target_ref_X - target_X_deviation_limit_to_interupt_this_transition; 
     current_X_passed_target_cuz_target_X_moved = this->transition_moving_toward_pos_inf ? start_of_interval_X_val >= target_X + this->X_deadband : start_of_interval_X_val <= target_X - this->X_deadband;
     
-    if(current_X_passed_target_cuz_target_X_moved || (target_X_deviation_limit_exceeded && this->goto_next_segment_criteria[this->segment_index].inturupt_this_transition_if_target_X_deviation_limit_exceeded))
+    if(current_X_passed_target_cuz_target_X_moved || (target_X_deviation_limit_exceeded && this->goto_next_segment_criteria[state.segment_index].inturupt_this_transition_if_target_X_deviation_limit_exceeded))
     {
         interval_area_Xsec = 0;
         interval_duration_sec = 0;
@@ -210,9 +214,9 @@ transition_integral_of_X transition_of_X_through_time::get_integral( const doubl
         return return_val;
     }
     
-    if(!this->goto_next_segment_criteria[this->segment_index].inturupt_this_transition_if_target_X_deviation_limit_exceeded)
+    if(!this->goto_next_segment_criteria[state.segment_index].inturupt_this_transition_if_target_X_deviation_limit_exceeded)
     {
-        this->target_ref_X = target_X;
+        state.target_ref_X = target_X;
     }
     
     //--------------------------------------------
@@ -249,27 +253,27 @@ transition_integral_of_X transition_of_X_through_time::get_integral( const doubl
     
     while(true)
     {
-        start_of_interval_unix_time = this->end_of_last_interval_unix_time;
-        segment_slope_ = this->goto_next_segment_criteria[this->segment_index].segment_slope_X_per_sec;
-        start_of_interval_X_val = this->start_of_segment_X_val + segment_slope_*(start_of_interval_unix_time - this->start_of_segment_unix_time);
+        start_of_interval_unix_time = state.end_of_last_interval_unix_time;
+        segment_slope_ = this->goto_next_segment_criteria[state.segment_index].segment_slope_X_per_sec;
+        start_of_interval_X_val = state.start_of_segment_X_val + segment_slope_*(start_of_interval_unix_time - state.start_of_segment_unix_time);
         
         //-------------------------------------------------------------
         // Calculate end_of_segment_unix_time and end_of_segment_X_val
         //-------------------------------------------------------------
         
-        criteria_type = this->goto_next_segment_criteria[this->segment_index].criteria_type;
-        criteria_value = this->goto_next_segment_criteria[this->segment_index].criteria_value;
+        criteria_type = this->goto_next_segment_criteria[state.segment_index].criteria_type;
+        criteria_value = this->goto_next_segment_criteria[state.segment_index].criteria_value;
         from_final_complete_cuz_target_X_moved = false;
         
         if(criteria_type == transition_criteria_type::time_delay_sec)
         {
-            end_of_segment_unix_time = this->start_of_segment_unix_time + criteria_value;
-            end_of_segment_X_val = this->start_of_segment_X_val + segment_slope_*criteria_value;
+            end_of_segment_unix_time = state.start_of_segment_unix_time + criteria_value;
+            end_of_segment_X_val = state.start_of_segment_X_val + segment_slope_*criteria_value;
         }    
         else if(criteria_type == transition_criteria_type::delta_X)
         {
-            end_of_segment_unix_time = this->start_of_segment_unix_time + std::abs(criteria_value/segment_slope_);
-            end_of_segment_X_val = this->transition_moving_toward_pos_inf ? this->start_of_segment_X_val + criteria_value : this->start_of_segment_X_val - criteria_value;
+            end_of_segment_unix_time = state.start_of_segment_unix_time + std::abs(criteria_value/segment_slope_);
+            end_of_segment_X_val = this->transition_moving_toward_pos_inf ? state.start_of_segment_X_val + criteria_value : state.start_of_segment_X_val - criteria_value;
         }
         else if(criteria_type == transition_criteria_type::from_final_X)
         {
@@ -289,7 +293,7 @@ transition_integral_of_X transition_of_X_through_time::get_integral( const doubl
             }
             else
             {
-                end_of_segment_unix_time = this->start_of_segment_unix_time + std::abs((std::abs(this->start_of_segment_X_val - target_X) - criteria_value)/segment_slope_);
+                end_of_segment_unix_time = state.start_of_segment_unix_time + std::abs((std::abs(state.start_of_segment_X_val - target_X) - criteria_value)/segment_slope_);
             }
         }
         
@@ -304,7 +308,7 @@ transition_integral_of_X transition_of_X_through_time::get_integral( const doubl
             //   Will return in this Segment
             //---------------------------------
             
-            now_X_val = this->start_of_segment_X_val + segment_slope_*(integrate_to_unix_time - this->start_of_segment_unix_time);
+            now_X_val = state.start_of_segment_X_val + segment_slope_*(integrate_to_unix_time - state.start_of_segment_unix_time);
             will_reach_target_before_now_time = this->transition_moving_toward_pos_inf ? target_X <= now_X_val : target_X >= now_X_val;
             
             if(will_reach_target_before_now_time)
@@ -314,7 +318,7 @@ transition_integral_of_X transition_of_X_through_time::get_integral( const doubl
                 
                 if(0.00001 < std::abs(segment_slope_))
                 {
-                    end_of_interval_unix_time_aux = this->start_of_segment_unix_time + std::abs((this->start_of_segment_X_val - target_X)/segment_slope_);
+                    end_of_interval_unix_time_aux = state.start_of_segment_unix_time + std::abs((state.start_of_segment_X_val - target_X)/segment_slope_);
                 }
                 else
                 {
@@ -330,13 +334,13 @@ transition_integral_of_X transition_of_X_through_time::get_integral( const doubl
             
             interval_duration_sec += end_of_interval_unix_time_aux - start_of_interval_unix_time;
             interval_area_Xsec += 0.5*(start_of_interval_X_val + end_of_interval_X_val) * (end_of_interval_unix_time_aux - start_of_interval_unix_time);
-            this->end_of_last_interval_unix_time = end_of_interval_unix_time_aux;
+            state.end_of_last_interval_unix_time = end_of_interval_unix_time_aux;
             
             if(std::abs(end_of_segment_unix_time - end_of_interval_unix_time_aux) < 0.00001)
             {
-                this->start_of_segment_unix_time = end_of_segment_unix_time;
-                this->start_of_segment_X_val = end_of_segment_X_val;
-                this->segment_index += 1;
+                state.start_of_segment_unix_time = end_of_segment_unix_time;
+                state.start_of_segment_X_val = end_of_segment_X_val;
+                state.segment_index += 1;
             }
             
             transition_integral_of_X return_val = {interval_area_Xsec, interval_duration_sec, end_of_interval_unix_time_aux, end_of_interval_X_val, trans_status_val};
@@ -351,12 +355,12 @@ transition_integral_of_X transition_of_X_through_time::get_integral( const doubl
             interval_duration_sec += end_of_segment_unix_time - start_of_interval_unix_time;
             interval_area_Xsec += 0.5*(start_of_interval_X_val + end_of_segment_X_val) * (end_of_segment_unix_time - start_of_interval_unix_time);
             
-            this->end_of_last_interval_unix_time = end_of_segment_unix_time;
-            this->start_of_segment_unix_time = end_of_segment_unix_time;
-            this->start_of_segment_X_val = end_of_segment_X_val;
-            this->segment_index += 1;
+            state.end_of_last_interval_unix_time = end_of_segment_unix_time;
+            state.start_of_segment_unix_time = end_of_segment_unix_time;
+            state.start_of_segment_X_val = end_of_segment_X_val;
+            state.segment_index += 1;
             
-            if(this->goto_next_segment_criteria.size() <= this->segment_index)
+            if(this->goto_next_segment_criteria.size() <= state.segment_index)
             {
                 std::string error_msg = "Caldera PEV transitions must be terminated by a segment where (criteria_type = transition_criteria_type::from_final_X, criteria_value = 0).  Look in class transition_of_X_through_time.";
                 std::cout << error_msg << std::endl;
@@ -367,119 +371,49 @@ transition_integral_of_X transition_of_X_through_time::get_integral( const doubl
 }
 
 //#############################################################################
-//                            integrate_X_through_time
+//                      integrate_X_through_time_definition
 //#############################################################################
 
-integrate_X_through_time::integrate_X_through_time( const double target_deadband_,
-                                                    const double off_deadband_,
-                                                    const bool pos_and_neg_transitions_are_unique_,
-                                                    const transition_of_X_through_time &trans_obj_pos_to_off_,
-                                                    const transition_of_X_through_time &trans_obj_neg_to_off_,
-                                                     const transition_of_X_through_time &trans_obj_off_to_pos_,
-                                                    const transition_of_X_through_time &trans_obj_off_to_neg_,
-                                                    const transition_of_X_through_time &trans_obj_moving_toward_pos_inf_,
-                                                    const transition_of_X_through_time &trans_obj_moving_toward_neg_inf_,
-                                                    const transition_of_X_through_time &trans_obj_pos_moving_toward_pos_inf_,
-                                                    const transition_of_X_through_time &trans_obj_pos_moving_toward_neg_inf_,
-                                                    const transition_of_X_through_time &trans_obj_neg_moving_toward_pos_inf_,
-                                                    const transition_of_X_through_time &trans_obj_neg_moving_toward_neg_inf_ )
+integrate_X_through_time_definition::integrate_X_through_time_definition( const double target_deadband_,
+                                                                          const double off_deadband_,
+                                                                          const bool pos_and_neg_transitions_are_unique_,
+                                                                          const transition_of_X_through_time &trans_obj_pos_to_off_,
+                                                                          const transition_of_X_through_time &trans_obj_neg_to_off_,
+                                                                          const transition_of_X_through_time &trans_obj_off_to_pos_,
+                                                                          const transition_of_X_through_time &trans_obj_off_to_neg_,
+                                                                          const transition_of_X_through_time &trans_obj_moving_toward_pos_inf_,
+                                                                          const transition_of_X_through_time &trans_obj_moving_toward_neg_inf_,
+                                                                          const transition_of_X_through_time &trans_obj_pos_moving_toward_pos_inf_,
+                                                                          const transition_of_X_through_time &trans_obj_pos_moving_toward_neg_inf_,
+                                                                          const transition_of_X_through_time &trans_obj_neg_moving_toward_pos_inf_,
+                                                                          const transition_of_X_through_time &trans_obj_neg_moving_toward_neg_inf_ )
 {
     this->target_deadband = target_deadband_;
     this->off_deadband = off_deadband_;
     this->pos_and_neg_transitions_are_unique = pos_and_neg_transitions_are_unique_;
 
-    this->trans_obj_pos_to_off = trans_obj_pos_to_off_;
-    this->trans_obj_neg_to_off = trans_obj_neg_to_off_;
-    this->trans_obj_off_to_pos = trans_obj_off_to_pos_;
-    this->trans_obj_off_to_neg = trans_obj_off_to_neg_;
-    this->trans_obj_moving_toward_pos_inf = trans_obj_moving_toward_pos_inf_;
-    this->trans_obj_moving_toward_neg_inf = trans_obj_moving_toward_neg_inf_;
-    this->trans_obj_pos_moving_toward_pos_inf = trans_obj_pos_moving_toward_pos_inf_;
-    this->trans_obj_pos_moving_toward_neg_inf = trans_obj_pos_moving_toward_neg_inf_;
-    this->trans_obj_neg_moving_toward_pos_inf = trans_obj_neg_moving_toward_pos_inf_;
-    this->trans_obj_neg_moving_toward_neg_inf = trans_obj_neg_moving_toward_neg_inf_;
-    this->cur_trans_obj = NULL;
-
-    this->X = 0;
-    this->target_ref_X = 0;        
-    this->trans_state = transition_state::off;
-    this->X_has_been_set = false;
-    this->target_set_while_turning_off = false;
-    
-    this->print_debug_info = false;
+    this->transitions[transition_state::pos_to_off] = trans_obj_pos_to_off_;
+    this->transitions[transition_state::neg_to_off] = trans_obj_neg_to_off_;
+    this->transitions[transition_state::off_to_pos] = trans_obj_off_to_pos_;
+    this->transitions[transition_state::off_to_neg] = trans_obj_off_to_neg_;
+    this->transitions[transition_state::moving_toward_pos_inf] = trans_obj_moving_toward_pos_inf_;
+    this->transitions[transition_state::moving_toward_neg_inf] = trans_obj_moving_toward_neg_inf_;
+    this->transitions[transition_state::pos_moving_toward_pos_inf] = trans_obj_pos_moving_toward_pos_inf_;
+    this->transitions[transition_state::pos_moving_toward_neg_inf] = trans_obj_pos_moving_toward_neg_inf_;
+    this->transitions[transition_state::neg_moving_toward_pos_inf] = trans_obj_neg_moving_toward_pos_inf_;
+    this->transitions[transition_state::neg_moving_toward_neg_inf] = trans_obj_neg_moving_toward_neg_inf_;
 }
 
 
-integrate_X_through_time::integrate_X_through_time( const integrate_X_through_time &obj )
+const transition_of_X_through_time* integrate_X_through_time_definition::get_transition( const transition_state trans_state_ ) const
 {
-    this->X = obj.X;
-    this->target_ref_X = obj.target_ref_X;   
-    this->target_deadband = obj.target_deadband;
-    this->off_deadband = obj.off_deadband;
-    this->pos_and_neg_transitions_are_unique = obj.pos_and_neg_transitions_are_unique;
-    this->trans_state = obj.trans_state;
-    this->X_has_been_set = obj.X_has_been_set;
-    this->target_set_while_turning_off = obj.target_set_while_turning_off;
-    
-    //------------------------------------
-    
-    this->trans_obj_pos_to_off = obj.trans_obj_pos_to_off;
-    this->trans_obj_neg_to_off = obj.trans_obj_neg_to_off;
-    this->trans_obj_off_to_pos = obj.trans_obj_off_to_pos;
-    this->trans_obj_off_to_neg = obj.trans_obj_off_to_neg;
-    this->trans_obj_moving_toward_pos_inf = obj.trans_obj_moving_toward_pos_inf;
-    this->trans_obj_moving_toward_neg_inf = obj.trans_obj_moving_toward_neg_inf;
-    this->trans_obj_pos_moving_toward_pos_inf = obj.trans_obj_pos_moving_toward_pos_inf;
-    this->trans_obj_pos_moving_toward_neg_inf = obj.trans_obj_pos_moving_toward_neg_inf;
-    this->trans_obj_neg_moving_toward_pos_inf = obj.trans_obj_neg_moving_toward_pos_inf;
-    this->trans_obj_neg_moving_toward_neg_inf = obj.trans_obj_neg_moving_toward_neg_inf;
-    
-    //------------------------------------
-    
-    if(this->trans_state == transition_state::pos_to_off)
-    {
-        this->cur_trans_obj = &this->trans_obj_pos_to_off;
-    }
-    else if(this->trans_state == transition_state::neg_to_off)
-    {
-        this->cur_trans_obj = &this->trans_obj_neg_to_off;
-    }
-    else if(this->trans_state == transition_state::off_to_pos)
-    {
-        this->cur_trans_obj = &this->trans_obj_off_to_pos;
-    }
-    else if(this->trans_state == transition_state::off_to_neg)
-    {
-        this->cur_trans_obj = &this->trans_obj_off_to_neg;
-    }     
-    else if(this->trans_state == transition_state::moving_toward_pos_inf)
-    {
-        this->cur_trans_obj = &this->trans_obj_moving_toward_pos_inf;
-    }
-    else if(this->trans_state == transition_state::moving_toward_neg_inf)
-    {
-        this->cur_trans_obj = &this->trans_obj_moving_toward_neg_inf;
-    }     
-    else if(this->trans_state == transition_state::pos_moving_toward_pos_inf)
-    {
-        this->cur_trans_obj = &this->trans_obj_pos_moving_toward_pos_inf;
-    }
-    else if(this->trans_state == transition_state::pos_moving_toward_neg_inf)
+    if(trans_state_ == transition_state::off || trans_state_ == transition_state::on_steady_state)
     {
-        this->cur_trans_obj = &this->trans_obj_pos_moving_toward_neg_inf;
+        return NULL;
     }
-    else if(this->trans_state == transition_state::neg_moving_toward_pos_inf)
+    else if(transition_state::pos_to_off <= trans_state_ && trans_state_ <= transition_state::neg_moving_toward_neg_inf)
     {
-        this->cur_trans_obj = &this->trans_obj_neg_moving_toward_pos_inf;
-    }
-    else if(this->trans_state == transition_state::neg_moving_toward_neg_inf)
-    {
-        this->cur_trans_obj = &this->trans_obj_neg_moving_toward_neg_inf;
-    }
-    else if(    this->trans_state == transition_state::on_steady_state
-             || this->trans_state == transition_state::off )
-    {
-        this->cur_trans_obj = NULL;
+        return &this->transitions[trans_state_];
     }
     else
     {
@@ -489,37 +423,58 @@ integrate_X_through_time::integrate_X_through_time( const integrate_X_through_ti
 }
 
 
-bool integrate_X_through_time::transition_moving_toward_pos_inf( const transition_state trans_state_ )
+bool integrate_X_through_time_definition::transition_moving_toward_pos_inf( const transition_state trans_state_ ) const
 {
-    bool return_val = false;
-
-    if(trans_state_ == transition_state::pos_to_off)
-        return_val = this->trans_obj_pos_to_off.transition_is_moving_toward_pos_inf();
-    else if(trans_state_ == transition_state::neg_to_off)
-        return_val = this->trans_obj_neg_to_off.transition_is_moving_toward_pos_inf();
-    else if(trans_state_ == transition_state::off_to_pos)
-        return_val = this->trans_obj_off_to_pos.transition_is_moving_toward_pos_inf();
-    else if(trans_state_ == transition_state::off_to_neg)
-        return_val = this->trans_obj_off_to_neg.transition_is_moving_toward_pos_inf();        
-    else if(trans_state_ == transition_state::moving_toward_pos_inf)
-        return_val = this->trans_obj_moving_toward_pos_inf.transition_is_moving_toward_pos_inf();
-    else if(trans_state_ == transition_state::moving_toward_neg_inf)
-        return_val = this->trans_obj_moving_toward_neg_inf.transition_is_moving_toward_pos_inf();        
-    else if(trans_state_ == transition_state::pos_moving_toward_pos_inf)
-        return_val = this->trans_obj_pos_moving_toward_pos_inf.transition_is_moving_toward_pos_inf();
-    else if(trans_state_ == transition_state::pos_moving_toward_neg_inf)
-        return_val = this->trans_obj_pos_moving_toward_neg_inf.transition_is_moving_toward_pos_inf();
-    else if(trans_state_ == transition_state::neg_moving_toward_pos_inf)
-        return_val = this->trans_obj_neg_moving_toward_pos_inf.transition_is_moving_toward_pos_inf();
-    else if(trans_state_ == transition_state::neg_moving_toward_neg_inf)
-        return_val = this->trans_obj_neg_moving_toward_neg_inf.transition_is_moving_toward_pos_inf();
-    else
+    const transition_of_X_through_time* trans_obj = this->get_transition(trans_state_);
+    
+    if(trans_obj == NULL)
     {
         std::cout << "Error: This shouldn't happen. [6]" << std::endl;
         exit(0);
     }
-        
-    return return_val;
+    
+    return trans_obj->transition_is_moving_toward_pos_inf();
+}
+
+
+//#############################################################################
+//                            integrate_X_through_time
+//#############################################################################
+
+integrate_X_through_time::integrate_X_through_time( const std::shared_ptr<const integrate_X_through_time_definition>& definition_ )
+{
+    this->definition = definition_;
+    this->cur_trans_obj = NULL;
+
+    this->X = 0;
+    this->target_ref_X = 0;        
+    this->trans_state = transition_state::off;
+    this->X_has_been_set = false;
+    this->target_set_while_turning_off = false;
+    
+    this->print_debug_info = false;
+}
+
+
+integrate_X_through_time::integrate_X_through_time( const double target_deadband_,
+                                                    const double off_deadband_,
+                                                    const bool pos_and_neg_transitions_are_unique_,
+                                                    const transition_of_X_through_time &trans_obj_pos_to_off_,
+                                                    const transition_of_X_through_time &trans_obj_neg_to_off_,
+                                                    const transition_of_X_through_time &trans_obj_off_to_pos_,
+                                                    const transition_of_X_through_time &trans_obj_off_to_neg_,
+                                                    const transition_of_X_through_time &trans_obj_moving_toward_pos_inf_,
+                                                    const transition_of_X_through_time &trans_obj_moving_toward_neg_inf_,
+                                                    const transition_of_X_through_time &trans_obj_pos_moving_toward_pos_inf_,
+                                                    const transition_of_X_through_time &trans_obj_pos_moving_toward_neg_inf_,
+                                                    const transition_of_X_through_time &trans_obj_neg_moving_toward_pos_inf_,
+                                                    const transition_of_X_through_time &trans_obj_neg_moving_toward_neg_inf_ )
+    : integrate_X_through_time{ std::make_shared<const integrate_X_through_time_definition>( target_deadband_, off_deadband_, pos_and_neg_transitions_are_unique_,
+                                    trans_obj_pos_to_off_, trans_obj_neg_to_off_, trans_obj_off_to_pos_, trans_obj_off_to_neg_,
+                                    trans_obj_moving_toward_pos_inf_, trans_obj_moving_toward_neg_inf_,
+                                    trans_obj_pos_moving_toward_pos_inf_, trans_obj_pos_moving_toward_neg_inf_,
+                                    trans_obj_neg_moving_toward_pos_inf_, trans_obj_neg_moving_toward_neg_inf_ ) }
+{
 }
 
 
@@ -531,10 +486,22 @@ void integrate_X_through_time::get_debug_data( debug_data &data )
 }
 
 
+bool integrate_X_through_time::is_on_steady_state() const
+{
+    return this->trans_state == transition_state::on_steady_state;
+}
+
+
+double integrate_X_through_time::get_X() const
+{
+    return this->X;
+}
+
+
     // This should only be used by battery_factory::get_pev_battery_control_input
 void integrate_X_through_time::set_init_state(double X_)
 {
-    if(!this->X_has_been_set && std::abs(X_) > this->off_deadband)
+    if(!this->X_has_been_set && std::abs(X_) > this->definition->get_off_deadband())
     {
         this->X_has_been_set = true;
         this->target_set_while_turning_off = false;
@@ -545,6 +512,76 @@ void integrate_X_through_time::set_init_state(double X_)
 }
 
 
+void integrate_X_through_time::get_step_state( integrate_X_through_time_step_state& state ) const
+{
+    state.X = this->X;
+    state.target_ref_X = this->target_ref_X;
+    state.X_has_been_set = this->X_has_been_set;
+    state.target_set_while_turning_off = this->target_set_while_turning_off;
+    state.trans_state = this->trans_state;
+    state.cur_trans_obj = this->cur_trans_obj;
+    state.cur_trans_obj_state = this->cur_trans_obj_state;
+}
+
+
+void integrate_X_through_time::set_step_state( const integrate_X_through_time_step_state& state )
+{
+    this->X = state.X;
+    this->target_ref_X = state.target_ref_X;
+    this->X_has_been_set = state.X_has_been_set;
+    this->target_set_while_turning_off = state.target_set_while_turning_off;
+    this->trans_state = state.trans_state;
+    this->cur_trans_obj = state.cur_trans_obj;
+    this->cur_trans_obj_state = state.cur_trans_obj_state;
+}
+
+
+void integrate_X_through_time::write_step_state( std::ostream& out ) const
+{
+    int32_t cur_trans_obj_index = -1;
+    for(int i = transition_state::pos_to_off; i <= transition_state::neg_moving_toward_neg_inf; i++)
+    {
+        if(this->cur_trans_obj != NULL && this->cur_trans_obj == this->definition->get_transition((transition_state)i))
+            cur_trans_obj_index = i;
+    }
+    
+    write_pod<double>(out, this->X);
+    write_pod<double>(out, this->target_ref_X);
+    write_pod<bool>(out, this->X_has_been_set);
+    write_pod<bool>(out, this->target_set_while_turning_off);
+    write_pod<int32_t>(out, this->trans_state);
+    write_pod<int32_t>(out, cur_trans_obj_index);
+    write_pod<transition_of_X_through_time_state>(out, this->cur_trans_obj_state);
+}
+
+
+void integrate_X_through_time::read_step_state( std::istream& in )
+{
+    integrate_X_through_time_step_state state;
+    state.X = read_pod<double>(in);
+    state.target_ref_X = read_pod<double>(in);
+    state.X_has_been_set = read_pod<bool>(in);
+    state.target_set_while_turning_off = read_pod<bool>(in);
+    const int32_t trans_state_index = read_pod<int32_t>(in);
+    const int32_t cur_trans_obj_index = read_pod<int32_t>(in);
+    state.cur_trans_obj_state = read_pod<transition_of_X_through_time_state>(in);
+    
+    const bool is_valid = transition_state::off <= trans_state_index && trans_state_index <= transition_state::neg_moving_toward_neg_inf &&
+                          (cur_trans_obj_index == -1 || (transition_state::pos_to_off <= cur_trans_obj_index && cur_trans_obj_index <= transition_state::neg_moving_toward_neg_inf));
+    
+    if(!in.good() || !is_valid)
+    {
+        in.setstate(std::ios::failbit);
+        return;
+    }
+    
+    state.trans_state = (transition_state)trans_state_index;
+    state.cur_trans_obj = (cur_trans_obj_index == -1) ? NULL : this->definition->get_transition((transition_state)cur_trans_obj_index);
+    
+    this->set_step_state(state);
+}
+
+
 integral_of_X integrate_X_through_time::get_next( const double target_X_original_parameter,
                                                   const double integrate_from_unix_time,
                                                   const double integrate_to_unix_time )
@@ -565,7 +602,7 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
     //
     // Target_X is always assumed to change at integrate_from_unix_time
     
-    // If (this->pos_and_neg_transitions_are_unique == True)
+    // If (this->definition->get_pos_and_neg_transitions_are_unique() == True)
     //         Due too zero crossings there are limitations to the following transitions:
     //            pos_moving_toward_neg_inf
     //            neg_moving_toward_pos_inf
@@ -581,7 +618,7 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
     //              'slow down' or flatten out significantly as the transition approaches zero and then have a large
     //              ramp rate once it is past zero.  This is not a realistic behavior.
     //
-    // Else If(this->pos_and_neg_transitions_are_unique == False)
+    // Else If(this->definition->get_pos_and_neg_transitions_are_unique() == False)
     //        - Limitations mentioned above do not apply.
     //        - Charging and Discharging will have the same slew rates
     //        - Can have unique slew rates for the following:
@@ -596,8 +633,8 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
     //-------------------------------------------------
     
     bool target_has_changed = false;
-    //if(this->target_deadband < std::abs(target_X - this->target_ref_X))
-    if(this->target_deadband < std::abs(target_X - this->target_ref_X) || std::abs(this->target_ref_X) <= this->target_deadband)
+    //if(this->definition->get_target_deadband() < std::abs(target_X - this->target_ref_X))
+    if(this->definition->get_target_deadband() < std::abs(target_X - this->target_ref_X) || std::abs(this->target_ref_X) <= this->definition->get_target_deadband())
     {
         target_has_changed = true;
         this->target_ref_X = target_X;
@@ -611,7 +648,7 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
     
     // if(this->print_debug_info)
     // {
-    //     std::cout << "target_deadband: " << this->target_deadband << "  target_ref_X: " << this->target_ref_X << "  target_X: " << target_X << std::endl;
+    //     std::cout << "target_deadband: " << this->definition->get_target_deadband() << "  target_ref_X: " << this->target_ref_X << "  target_X: " << target_X << std::endl;
     // }
     
     //-------------------------------------------------------------
@@ -625,7 +662,7 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
     
     if(this->trans_state == transition_state::pos_to_off || this->trans_state == transition_state::neg_to_off)
     {
-        if(this->off_deadband < std::abs(target_X))
+        if(this->definition->get_off_deadband() < std::abs(target_X))
         {
             this->target_set_while_turning_off = true;
         }
@@ -640,18 +677,18 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
     {
         if(this->trans_state == transition_state::off)
         {
-            if(this->off_deadband < target_X)
+            if(this->definition->get_off_deadband() < target_X)
             {
                 transition_state_has_changed = true;
                 new_trans_state = transition_state::off_to_pos;
             }
-            else if(target_X < -this->off_deadband)
+            else if(target_X < -this->definition->get_off_deadband())
             {
                 transition_state_has_changed = true;
                 new_trans_state = transition_state::off_to_neg;
             }
         }
-        else if(std::abs(target_X) < this->off_deadband)
+        else if(std::abs(target_X) < this->definition->get_off_deadband())
         {
             target_X = 0;
             transition_state_has_changed = true;
@@ -675,22 +712,22 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
                 {
                     if(bool_moving_toward_pos_inf)
                     {
-                        new_trans_state = this->pos_and_neg_transitions_are_unique ? transition_state::pos_moving_toward_pos_inf : transition_state::moving_toward_pos_inf;
+                        new_trans_state = this->definition->get_pos_and_neg_transitions_are_unique() ? transition_state::pos_moving_toward_pos_inf : transition_state::moving_toward_pos_inf;
                     }
                     else
                     {
-                        new_trans_state = this->pos_and_neg_transitions_are_unique ? transition_state::pos_moving_toward_neg_inf : transition_state::moving_toward_neg_inf;
+                        new_trans_state = this->definition->get_pos_and_neg_transitions_are_unique() ? transition_state::pos_moving_toward_neg_inf : transition_state::moving_toward_neg_inf;
                     }
                 }
                 else
                 {
                     if(bool_moving_toward_pos_inf)
                     {
-                        new_trans_state = this->pos_and_neg_transitions_are_unique ? transition_state::neg_moving_toward_pos_inf : transition_state::moving_toward_pos_inf;
+                        new_trans_state = this->definition->get_pos_and_neg_transitions_are_unique() ? transition_state::neg_moving_toward_pos_inf : transition_state::moving_toward_pos_inf;
                     }
                     else
                     {
-                        new_trans_state = this->pos_and_neg_transitions_are_unique ? transition_state::neg_moving_toward_neg_inf : transition_state::moving_toward_neg_inf;
+                        new_trans_state = this->definition->get_pos_and_neg_transitions_are_unique() ? transition_state::neg_moving_toward_neg_inf : transition_state::moving_toward_neg_inf;
                     }
                 }
             }
@@ -701,7 +738,7 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
                     if(!bool_moving_toward_pos_inf)
                     {
                         transition_state_has_changed = true;
-                        new_trans_state = this->pos_and_neg_transitions_are_unique ? transition_state::pos_moving_toward_neg_inf : transition_state::moving_toward_neg_inf;
+                        new_trans_state = this->definition->get_pos_and_neg_transitions_are_unique() ? transition_state::pos_moving_toward_neg_inf : transition_state::moving_toward_neg_inf;
                     }
                 }
                 else if(this->trans_state == transition_state::off_to_neg)
@@ -709,7 +746,7 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
                     if(bool_moving_toward_pos_inf)
                     {
                         transition_state_has_changed = true;
-                        new_trans_state = this->pos_and_neg_transitions_are_unique ? transition_state::neg_moving_toward_pos_inf : transition_state::moving_toward_pos_inf;
+                        new_trans_state = this->definition->get_pos_and_neg_transitions_are_unique() ? transition_state::neg_moving_toward_pos_inf : transition_state::moving_toward_pos_inf;
                     }
                 }
                 else if(this->trans_state == transition_state::moving_toward_neg_inf)
@@ -777,8 +814,8 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
     
     if(transition_state_has_changed && !(this->trans_state == transition_state::off || this->trans_state == transition_state::on_steady_state))
     {    
-        bool previous_trans_moving_toward_pos_inf = this->transition_moving_toward_pos_inf(this->trans_state);
-        bool current_trans_moving_toward_pos_inf = this->transition_moving_toward_pos_inf(new_trans_state);
+        bool previous_trans_moving_toward_pos_inf = this->definition->transition_moving_toward_pos_inf(this->trans_state);
+        bool current_trans_moving_toward_pos_inf = this->definition->transition_moving_toward_pos_inf(new_trans_state);
     
         if(previous_trans_moving_toward_pos_inf != current_trans_moving_toward_pos_inf)
         {
@@ -829,11 +866,11 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
         transition_will_cross_zero = false;
         transition_just_crossed_zero = false;
         
-        if(this->pos_and_neg_transitions_are_unique)
+        if(this->definition->get_pos_and_neg_transitions_are_unique())
         {
             if(this->trans_state == transition_state::pos_moving_toward_neg_inf)
             {
-                if(X0 < this->off_deadband)
+                if(X0 < this->definition->get_off_deadband())
                 {
                     transition_state_has_changed = true;                
                     trans_interruption_state = transition_interruption_state::not_interupted;
@@ -845,7 +882,7 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
             }
             else if(this->trans_state == transition_state::neg_moving_toward_pos_inf)
             {
-                if(-this->off_deadband < X0)
+                if(-this->definition->get_off_deadband() < X0)
                 {
                     transition_state_has_changed = true;
                     trans_interruption_state = transition_interruption_state::not_interupted;
@@ -865,59 +902,11 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
         
         if(transition_state_has_changed)
         {
-            if(this->trans_state == transition_state::off || this->trans_state == transition_state::on_steady_state)
-            {
-                this->cur_trans_obj = NULL;
-            }
-            else
-            {
-                if(this->trans_state == transition_state::pos_to_off)
-                {
-                    this->cur_trans_obj = &this->trans_obj_pos_to_off;
-                }
-                else if(this->trans_state == transition_state::neg_to_off)
-                {
-                    this->cur_trans_obj = &this->trans_obj_neg_to_off;
-                }
-                else if(this->trans_state == transition_state::off_to_pos)
-                {
-                    this->cur_trans_obj = &this->trans_obj_off_to_pos;
-                }
-                else if(this->trans_state == transition_state::off_to_neg)
-                {
-                    this->cur_trans_obj = &this->trans_obj_off_to_neg;
-                }
-                else if(this->trans_state == transition_state::moving_toward_pos_inf)
-                {
-                    this->cur_trans_obj = &this->trans_obj_moving_toward_pos_inf;
-                }
-                else if(this->trans_state == transition_state::moving_toward_neg_inf)
-                {
-                    this->cur_trans_obj = &this->trans_obj_moving_toward_neg_inf;
-                }
-                else if(this->trans_state == transition_state::pos_moving_toward_pos_inf)
-                {
-                    this->cur_trans_obj = &this->trans_obj_pos_moving_toward_pos_inf;
-                }
-                else if(this->trans_state == transition_state::pos_moving_toward_neg_inf)
-                {
-                    this->cur_trans_obj = &this->trans_obj_pos_moving_toward_neg_inf;
-                }
-                else if(this->trans_state == transition_state::neg_moving_toward_pos_inf)
-                {
-                    this->cur_trans_obj = &this->trans_obj_neg_moving_toward_pos_inf;
-                }
-                else if(this->trans_state == transition_state::neg_moving_toward_neg_inf)
-                {
-                    this->cur_trans_obj = &this->trans_obj_neg_moving_toward_neg_inf;
-                }
-                else
-                {
-                    std::cout << "Error: This shouldn't happen. [102]" << std::endl;
-                    exit(0);
-                }
+            this->cur_trans_obj = this->definition->get_transition(this->trans_state);
             
-                this->cur_trans_obj->init_transition(t0_unix_time, X0, this->target_ref_X, trans_interruption_state, transition_just_crossed_zero);
+            if(this->cur_trans_obj != NULL)
+            {
+                this->cur_trans_obj->init_transition(this->cur_trans_obj_state, t0_unix_time, X0, this->target_ref_X, trans_interruption_state, transition_just_crossed_zero);
                 trans_interruption_state = transition_interruption_state::not_interupted;
             }
         }
@@ -948,11 +937,13 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
         else
         {
             transition_to_onSteadyState_or_off = false;
-            integral = this->cur_trans_obj->get_integral(target_X, integrate_to_unix_time, transition_will_cross_zero);
+            integral = this->cur_trans_obj->get_integral(this->cur_trans_obj_state, target_X, integrate_to_unix_time, transition_will_cross_zero);
         
             duration_sec += integral.interval_duration_sec;
             area_Xsec += integral.interval_area_Xsec;
-            this->debug_trans_status_vec.push_back(integral.status_val);
+            
+            if(this->print_debug_info)
+                this->debug_trans_status_vec.push_back(integral.status_val);
             
             if(integral.status_val == transition_status::transition_reached_nowTime_not_target)
             {
@@ -972,7 +963,7 @@ integral_of_X integrate_X_through_time::get_next( const double target_X_original
                 
                 bool_moving_toward_pos_inf = integral.end_of_interval_X_val < target_X;
                 
-                if(this->pos_and_neg_transitions_are_unique)
+                if(this->definition->get_pos_and_neg_transitions_are_unique())
                 {
                     if(0 < integral.end_of_interval_X_val)
                     {
@@ -3,6 +3,7 @@
 #define _inl_battery_integrate_X_in_time_H
 
 #include <vector>
+#include <memory>     // shared_ptr
 #include <iostream>   // Stream to consol (may be needed for files too???)
 #include <string>
 
@@ -88,29 +89,36 @@ struct transition_integral_of_X
 };
 
 
+// The part of a transition that changes while it is integrated.  Only the transition
+// integrate_X_through_time is currently on has state, so it keeps one of these.
+struct transition_of_X_through_time_state
+{
+    double start_of_segment_X_val;
+    double target_ref_X;
+    double start_of_segment_unix_time;
+    double end_of_last_interval_unix_time;
+    int segment_index;
+};
+
+
+// Immutable, shared by every charge event using the transition.
 class transition_of_X_through_time
 {
 private:
-    double start_of_segment_X_val, target_ref_X, X_deadband;
-    double start_of_segment_unix_time, end_of_last_interval_unix_time;
-    int segment_index;
+    double X_deadband;
     bool transition_moving_toward_pos_inf;
     transition_state trans_state;
     
     std::vector<transition_goto_next_segment_criteria> goto_next_segment_criteria;
-    
-    	// Dealing with inturrupting transitions
-    int start_segment_index_when_this_transition_interupts_another_transition;
-    double target_X_deviation_limit_to_interupt_this_transition;
 
 public:
     transition_of_X_through_time(){}
     transition_of_X_through_time(transition_state trans_state_, double X_deadband_,
                                  const std::vector<transition_goto_next_segment_criteria> &goto_next_segment_criteria_);
 
-    bool transition_is_moving_toward_pos_inf();
-    void init_transition(double start_of_transition_unix_time, double X_at_beginning_of_transition_, double target_ref_X_, transition_interruption_state trans_interruption_state, bool transition_just_crossed_zero);
-    transition_integral_of_X get_integral(double target_X, double integrate_to_unix_time, bool transition_will_cross_zero);
+    bool transition_is_moving_toward_pos_inf() const;
+    void init_transition(transition_of_X_through_time_state& state, double start_of_transition_unix_time, double X_at_beginning_of_transition_, double target_ref_X_, transition_interruption_state trans_interruption_state, bool transition_just_crossed_zero) const;
+    transition_integral_of_X get_integral(transition_of_X_through_time_state& state, double target_X, double integrate_to_unix_time, bool transition_will_cross_zero) const;
 };
 
 
@@ -133,42 +141,78 @@ struct debug_data
 };
 
 
+// The transitions and deadbands of an EV/EVSE pair.  Built once by
+// factory_charging_transitions and shared by every integrate_X_through_time of the pair.
+class integrate_X_through_time_definition
+{
+private:
+    double target_deadband;
+    double off_deadband;
+    bool pos_and_neg_transitions_are_unique;
+    
+    // Indexed by transition_state, the off and on_steady_state entries are not used.
+    transition_of_X_through_time transitions[12];
+
+public:
+    integrate_X_through_time_definition(double target_deadband_, double off_deadband_, bool pos_and_neg_transitions_are_unique_,
+                const transition_of_X_through_time  &trans_obj_pos_to_off_, const transition_of_X_through_time  &trans_obj_neg_to_off_,
+                const transition_of_X_through_time  &trans_obj_off_to_pos_, const transition_of_X_through_time  &trans_obj_off_to_neg_,
+                const transition_of_X_through_time  &trans_obj_moving_toward_pos_inf_, const transition_of_X_through_time  &trans_obj_moving_toward_neg_inf_,
+                const transition_of_X_through_time  &trans_obj_pos_moving_toward_pos_inf_, const transition_of_X_through_time  &trans_obj_pos_moving_toward_neg_inf_,
+                const transition_of_X_through_time  &trans_obj_neg_moving_toward_pos_inf_, const transition_of_X_through_time  &trans_obj_neg_moving_toward_neg_inf_
+                       );
+    
+    double get_target_deadband() const { return this->target_deadband; }
+    double get_off_deadband() const { return this->off_deadband; }
+    bool get_pos_and_neg_transitions_are_unique() const { return this->pos_and_neg_transitions_are_unique; }
+    
+        // NULL for off and on_steady_state.
+    const transition_of_X_through_time* get_transition(transition_state trans_state_) const;
+    bool transition_moving_toward_pos_inf(transition_state trans_state_) const;
+};
+
+
+// The part of integrate_X_through_time that get_next changes.
+struct integrate_X_through_time_step_state
+{
+    double X;
+    double target_ref_X;
+    bool X_has_been_set;
+    bool target_set_while_turning_off;
+    transition_state trans_state;
+    const transition_of_X_through_time *cur_trans_obj;
+    transition_of_X_through_time_state cur_trans_obj_state;
+};
+
+
+// Copying only copies the state of the integration, the definition is shared.
 class integrate_X_through_time
 {
 
 private:
     
+    std::shared_ptr<const integrate_X_through_time_definition> definition;
+    
     double X;
     double target_ref_X;
-    double target_deadband;
-    double off_deadband;
     
     bool X_has_been_set;
     bool target_set_while_turning_off;
-    bool pos_and_neg_transitions_are_unique;
     
     transition_state trans_state;
     
-    std::vector<transition_status> debug_trans_status_vec;
-    
-    transition_of_X_through_time  trans_obj_pos_to_off;
-    transition_of_X_through_time  trans_obj_neg_to_off;
-    transition_of_X_through_time  trans_obj_off_to_pos;
-    transition_of_X_through_time  trans_obj_off_to_neg;
-    transition_of_X_through_time  trans_obj_moving_toward_pos_inf;
-    transition_of_X_through_time  trans_obj_moving_toward_neg_inf;
-    transition_of_X_through_time  trans_obj_pos_moving_toward_pos_inf;
-    transition_of_X_through_time  trans_obj_pos_moving_toward_neg_inf;
-    transition_of_X_through_time  trans_obj_neg_moving_toward_pos_inf;
-    transition_of_X_through_time  trans_obj_neg_moving_toward_neg_inf;
-    transition_of_X_through_time *cur_trans_obj;
+        // cur_trans_obj points into the definition, cur_trans_obj_state is its state.
+    const transition_of_X_through_time *cur_trans_obj;
+    transition_of_X_through_time_state cur_trans_obj_state;
     
-    bool transition_moving_toward_pos_inf(transition_state trans_state_);
+        // Only filled when print_debug_info is true.
+    std::vector<transition_status> debug_trans_status_vec;
     
 public:
     bool print_debug_info;
 
 	integrate_X_through_time() {};
+    integrate_X_through_time(const std::shared_ptr<const integrate_X_through_time_definition>& definition_);
     integrate_X_through_time(double target_deadband_, double off_deadband_, bool pos_and_neg_transitions_are_unique_,
                 const transition_of_X_through_time  &trans_obj_pos_to_off_, const transition_of_X_through_time  &trans_obj_neg_to_off_,
                 const transition_of_X_through_time  &trans_obj_off_to_pos_, const transition_of_X_through_time  &trans_obj_off_to_neg_,
@@ -176,12 +220,24 @@ public:
                 const transition_of_X_through_time  &trans_obj_pos_moving_toward_pos_inf_, const transition_of_X_through_time  &trans_obj_pos_moving_toward_neg_inf_,
                 const transition_of_X_through_time  &trans_obj_neg_moving_toward_pos_inf_, const transition_of_X_through_time  &trans_obj_neg_moving_toward_neg_inf_
                        );
-    integrate_X_through_time(const integrate_X_through_time &obj);
     
     void get_debug_data(debug_data &data);
     
+        // While on steady state X does not change until the target moves out of the target deadband.
+    bool is_on_steady_state() const;
+    double get_X() const;
+    
         // This should only be used by battery_factory::get_pev_battery_control_input
     void set_init_state(double X_);
+    
+    void get_step_state(integrate_X_through_time_step_state& state) const;
+    void set_step_state(const integrate_X_through_time_step_state& state);
+    
+        // Binary form of the step state.  cur_trans_obj is written as the transition_state
+        // it is stored under in the definition.  read_step_state leaves 'in' failed on bad data.
+    void write_step_state(std::ostream& out) const;
+    void read_step_state(std::istream& in);
+    
     integral_of_X get_next(double target_X, double integrate_from_unix_time, double integrate_to_unix_time);
 };
 
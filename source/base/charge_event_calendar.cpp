@@ -0,0 +1,192 @@
+#include "charge_event_calendar.h"
+
+#include <cmath>            // floor
+#include <algorithm>        // min
+#include <stdexcept>        // invalid_argument
+
+
+charge_event_calendar::charge_event_calendar()
+    : charge_event_calendar(60.0, 4096)
+{
+}
+
+
+charge_event_calendar::charge_event_calendar(const double bucket_width_sec, const int num_buckets)
+    : bucket_width_sec{ bucket_width_sec },
+    num_buckets{ num_buckets },
+    origin_is_set{ false },
+    origin_unix_time{ 0 },
+    cur_slot{ 0 },
+    num_entries{ 0 },
+    buckets(num_buckets)
+{
+}
+
+
+void charge_event_calendar::clear()
+{
+    for(std::vector<calendar_entry>& bucket : this->buckets)
+        bucket.clear();
+
+    this->overflow = decltype(this->overflow)();
+    this->origin_is_set = false;
+    this->cur_slot = 0;
+    this->num_entries = 0;
+}
+
+
+bool charge_event_calendar::empty() const
+{
+    return this->num_entries == 0;
+}
+
+
+int charge_event_calendar::size() const
+{
+    return this->num_entries;
+}
+
+
+int64_t charge_event_calendar::get_slot(const double unix_time) const
+{
+    return (int64_t)std::floor((unix_time - this->origin_unix_time) / this->bucket_width_sec);
+}
+
+
+void charge_event_calendar::add_to_wheel(const int64_t slot, const calendar_entry& entry)
+{
+    // Anything already due goes in the current bucket so the next pop_due picks it up.
+    const int64_t wheel_slot = (slot < this->cur_slot) ? this->cur_slot : slot;
+    const int bucket_index = (int)(wheel_slot % this->num_buckets);
+
+    this->buckets[bucket_index].push_back(entry);
+}
+
+
+void charge_event_calendar::add(const double arrival_unix_time, supply_equipment* SE_ptr)
+{
+    if(!this->origin_is_set)
+    {
+        this->origin_unix_time = arrival_unix_time;
+        this->origin_is_set = true;
+    }
+
+    const calendar_entry entry = std::make_pair(arrival_unix_time, SE_ptr);
+    const int64_t slot = this->get_slot(arrival_unix_time);
+
+    if(slot < this->cur_slot + this->num_buckets)
+        this->add_to_wheel(slot, entry);
+    else
+        this->overflow.push(entry);
+
+    this->num_entries++;
+}
+
+
+void charge_event_calendar::pop_due(const double unix_time, std::vector<supply_equipment*>& due_SEs)
+{
+    if(this->num_entries == 0 || !this->origin_is_set)
+        return;
+
+    const int64_t target_slot = std::max(this->get_slot(unix_time), this->cur_slot);
+
+    //---------------------------------
+    //  Walk the buckets up to now
+    //---------------------------------
+    // Buckets before target_slot only hold due entries.  The bucket of target_slot
+    // can also hold entries later in the same bucket, those stay where they are.
+
+    const int64_t num_slots_to_visit = std::min<int64_t>(target_slot - this->cur_slot + 1, this->num_buckets);
+
+    for(int64_t i = 0; i < num_slots_to_visit; i++)
+    {
+        std::vector<calendar_entry>& bucket = this->buckets[(int)((this->cur_slot + i) % this->num_buckets)];
+
+        int num_kept = 0;
+        for(int j = 0; j < (int)bucket.size(); j++)
+        {
+            if(bucket[j].first <= unix_time)
+            {
+                due_SEs.push_back(bucket[j].second);
+                this->num_entries--;
+            }
+            else
+                bucket[num_kept++] = bucket[j];
+        }
+        bucket.resize(num_kept);
+    }
+
+    this->cur_slot = target_slot;
+
+    //---------------------------------
+    //  Move overflow onto the wheel
+    //---------------------------------
+
+    while(!this->overflow.empty())
+    {
+        const calendar_entry entry = this->overflow.top();
+        const int64_t slot = this->get_slot(entry.first);
+
+        if(slot >= this->cur_slot + this->num_buckets)
+            break;
+
+        this->overflow.pop();
+
+        if(entry.first <= unix_time)
+        {
+            due_SEs.push_back(entry.second);
+            this->num_entries--;
+        }
+        else
+            this->add_to_wheel(slot, entry);
+    }
+}
+
+
+void charge_event_calendar::get_state(const std::unordered_map<const supply_equipment*, int>& SE_ptr_to_SE_index, charge_event_calendar_state& state) const
+{
+    state.origin_is_set = this->origin_is_set;
+    state.origin_unix_time = this->origin_unix_time;
+    state.cur_slot = this->cur_slot;
+
+    state.buckets.assign(this->num_buckets, std::vector<std::pair<double, int> >());
+    for(int i = 0; i < this->num_buckets; i++)
+    {
+        for(const calendar_entry& entry : this->buckets[i])
+            state.buckets[i].emplace_back(entry.first, SE_ptr_to_SE_index.at(entry.second));
+    }
+
+    state.overflow.clear();
+    decltype(this->overflow) overflow_copy = this->overflow;
+    while(!overflow_copy.empty())
+    {
+        state.overflow.emplace_back(overflow_copy.top().first, SE_ptr_to_SE_index.at(overflow_copy.top().second));
+        overflow_copy.pop();
+    }
+}
+
+
+void charge_event_calendar::set_state(const charge_event_calendar_state& state, const std::vector<supply_equipment*>& SE_ptrs)
+{
+    if((int)state.buckets.size() != this->num_buckets)
+        throw std::invalid_argument("CALDERA ERROR: charge_event_calendar::set_state was given the state of a calendar with another number of buckets.");
+
+    this->clear();
+
+    this->origin_is_set = state.origin_is_set;
+    this->origin_unix_time = state.origin_unix_time;
+    this->cur_slot = state.cur_slot;
+
+    for(int i = 0; i < this->num_buckets; i++)
+    {
+        for(const std::pair<double, int>& entry : state.buckets[i])
+            this->buckets[i].emplace_back(entry.first, SE_ptrs.at(entry.second));
+
+        this->num_entries += this->buckets[i].size();
+    }
+
+    for(const std::pair<double, int>& entry : state.overflow)
+        this->overflow.emplace(entry.first, SE_ptrs.at(entry.second));
+
+    this->num_entries += state.overflow.size();
+}
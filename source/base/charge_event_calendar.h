@@ -0,0 +1,82 @@
+
+#ifndef inl_charge_event_calendar_H
+#define inl_charge_event_calendar_H
+
+#include <vector>
+#include <queue>            // priority_queue
+#include <functional>       // greater
+#include <utility>          // pair
+#include <cstdint>          // int64_t
+#include <unordered_map>
+
+class supply_equipment;
+
+
+//#############################################################################
+//                          Charge Event Calendar
+//#############################################################################
+
+// Calendar queue (timing wheel) of supply equipment waiting for their next charge
+// event arrival.  The wheel has num_buckets buckets of bucket_width_sec each.
+// Arrivals further out than the wheel span wait in an overflow heap and move onto
+// the wheel as the clock gets closer.  Adding an entry and taking the due entries
+// are O(1) per entry, so a full year of arrivals can be loaded up front.
+//
+// The calendar only decides when an SE has to be woken up.  The charge events
+// themselves stay in the charge_event_handler of the SE, which applies the
+// queuing_mode_enum rules when events are added.
+
+// Copy of a charge_event_calendar with every SE given by its index in an SE vector
+// instead of its pointer, so checkpoints do not hold pointers into the interface.
+// The overflow heap is listed in the order it pops.
+struct charge_event_calendar_state
+{
+    bool origin_is_set;
+    double origin_unix_time;
+    int64_t cur_slot;
+    std::vector<std::vector<std::pair<double, int> > > buckets;
+    std::vector<std::pair<double, int> > overflow;
+};
+
+
+class charge_event_calendar
+{
+private:
+    typedef std::pair<double, supply_equipment*> calendar_entry;
+
+    double bucket_width_sec;
+    int num_buckets;
+
+    bool origin_is_set;
+    double origin_unix_time;
+    int64_t cur_slot;
+    int num_entries;
+
+    std::vector<std::vector<calendar_entry> > buckets;
+    std::priority_queue<calendar_entry, std::vector<calendar_entry>, std::greater<calendar_entry> > overflow;
+
+    int64_t get_slot(const double unix_time) const;
+    void add_to_wheel(const int64_t slot, const calendar_entry& entry);
+
+public:
+    charge_event_calendar();
+    charge_event_calendar(const double bucket_width_sec, const int num_buckets);
+
+    void clear();
+    bool empty() const;
+    int size() const;
+
+    void add(const double arrival_unix_time, supply_equipment* SE_ptr);
+
+    // Removes every entry with arrival_unix_time <= unix_time and appends its SE to due_SEs.
+    void pop_due(const double unix_time, std::vector<supply_equipment*>& due_SEs);
+
+    // SE_ptr_to_SE_index must hold every SE on the calendar.  set_state takes the SEs
+    // back from SE_ptrs and needs a calendar with the same number of buckets.
+    void get_state(const std::unordered_map<const supply_equipment*, int>& SE_ptr_to_SE_index, charge_event_calendar_state& state) const;
+    void set_state(const charge_event_calendar_state& state, const std::vector<supply_equipment*>& SE_ptrs);
+};
+
+
+#endif
+
@@ -2,8 +2,8 @@
 #include "charge_profile_downsample_fragments.h"
 
 #include <cmath>            // max, round, pow
-#include <algorithm>        // sort
-#include <iterator>
+#include <algorithm>        // sort, max
+#include <utility>          // swap
 #include <unordered_set>
 
 
@@ -34,93 +34,159 @@ std::vector<pev_charge_fragment_variation> downsample_charge_fragment_vector::ge
 }
 
 
-int64_t downsample_charge_fragment_vector::calculate_variation_rank(std::list<pev_charge_fragment_variation>::iterator it, std::mt19937& gen, std::uniform_int_distribution<>& dis)
+int64_t downsample_charge_fragment_vector::calculate_variation_rank(int index) const
 {
-    std::list<pev_charge_fragment_variation>::iterator it_next, it_prev;
-    
-    it_next = std::next(it);
-    it_prev = std::prev(it);
+    const pev_charge_fragment_variation& cur = this->charge_fragment_variations[index];
+    const pev_charge_fragment_variation& prev = this->charge_fragment_variations[this->prev_index[index]];
+    const pev_charge_fragment_variation& next = this->charge_fragment_variations[this->next_index[index]];
     
     double P3kW_delta_A, P3kW_delta_B, P3kW_delta_C, P3kW_delta;
     
-    P3kW_delta_A = std::abs(it->P3_kW - it_prev->P3_kW);
-    P3kW_delta_B = std::abs(it_next->P3_kW - it->P3_kW);
-    P3kW_delta_C = std::abs(it_next->P3_kW - it_prev->P3_kW);    
+    P3kW_delta_A = std::abs(cur.P3_kW - prev.P3_kW);
+    P3kW_delta_B = std::abs(next.P3_kW - cur.P3_kW);
+    P3kW_delta_C = std::abs(next.P3_kW - prev.P3_kW);
     P3kW_delta = std::max({P3kW_delta_A, P3kW_delta_B, P3kW_delta_C});
-        
+    
     //-----------------------------------------------------------------------------------
     // max int64_t = 9,223,372.036,854,780,000
-    //        Random Part -> Smallest 9 digits, [0, 999,999,999]
-    //        kW_change_metric -> Next 8 digits given the following format x,xxx.xxx kW
-    //        change_metric_multiplier = 9 digit + 3 digits = 10^12
+    //        kW_change_metric -> change_metric_multiplier = 10^12
+    //        A rank <= change_metric_multiplier means the change is below kW_change_threshold
     //-----------------------------------------------------------------------------------
     
     double kW_change_metric = P3kW_delta / this->fragment_removal_criteria.kW_change_threshold;
-    int64_t tmp_variation_rank = (int64_t)((kW_change_metric)*this->change_metric_multiplier);
-    int64_t variation_rank;
-    while(true)
-    {
-        variation_rank = tmp_variation_rank + dis(gen);
-        if(this->variationRank_to_fragmentVariationIt_map.count(variation_rank) == 0)
-            break;
-    }
-    
-    return variation_rank;
+    return (int64_t)((kW_change_metric)*this->change_metric_multiplier);
 }
 
 
-int downsample_charge_fragment_vector::get_index_of_elbow(int start_index, int end_index, std::list<pev_charge_fragment_variation>& fragment_variations)
+int downsample_charge_fragment_vector::get_index_of_elbow(int start_index, int end_index) const
 {
-    std::list<pev_charge_fragment_variation>::iterator it;
+    const std::vector<pev_charge_fragment_variation>& fragment_variations = this->charge_fragment_variations;
     
-    it = fragment_variations.begin();
-    it = std::next(it, start_index);
-    double soc_0 = it->soc;
-    double P3kW_0 = it->P3_kW;
+    double soc_0 = fragment_variations[start_index].soc;
+    double P3kW_0 = fragment_variations[start_index].P3_kW;
     
-    it = std::next(it, end_index - start_index);
-    double soc_1 = it->soc;
-    double P3kW_1 = it->P3_kW;
+    double soc_1 = fragment_variations[end_index].soc;
+    double P3kW_1 = fragment_variations[end_index].P3_kW;
     
     double m = (P3kW_1 - P3kW_0) / (soc_1 - soc_0);
     double b = P3kW_1 - m*soc_1;
     
     //----------------------
     
-    it = fragment_variations.begin();
-    it = std::next(it, start_index);
-        
     double tmp_diff, max_diff_P3kW = 0;
     int index_of_elbow = 0;
     
     for(int i=start_index; i<end_index; i++)
     {
-        tmp_diff = std::abs(it->P3_kW - (m*it->soc + b));
+        tmp_diff = std::abs(fragment_variations[i].P3_kW - (m*fragment_variations[i].soc + b));
         if(tmp_diff > max_diff_P3kW)
         {
             max_diff_P3kW = tmp_diff;
-            index_of_elbow = it->original_charge_fragment_index;
+            index_of_elbow = fragment_variations[i].original_charge_fragment_index;
         }
-        
-        it = std::next(it);
     }
     
     return index_of_elbow;
 }
 
 
+//------------------------------------
+//      Indexed Binary Min-Heap
+//------------------------------------
+
+bool downsample_charge_fragment_vector::heap_less(int index_A, int index_B) const
+{
+    const int64_t rank_A = this->charge_fragment_variations[index_A].variation_rank;
+    const int64_t rank_B = this->charge_fragment_variations[index_B].variation_rank;
+    
+    return (rank_A < rank_B) || (rank_A == rank_B && index_A < index_B);
+}
+
+
+void downsample_charge_fragment_vector::heap_swap(int position_A, int position_B)
+{
+    std::swap(this->heap[position_A], this->heap[position_B]);
+    this->heap_position[this->heap[position_A]] = position_A;
+    this->heap_position[this->heap[position_B]] = position_B;
+}
+
+
+void downsample_charge_fragment_vector::heap_sift_up(int position)
+{
+    while(position > 0)
+    {
+        const int parent = (position - 1)/2;
+        
+        if(!this->heap_less(this->heap[position], this->heap[parent]))
+            break;
+        
+        this->heap_swap(position, parent);
+        position = parent;
+    }
+}
+
+
+void downsample_charge_fragment_vector::heap_sift_down(int position)
+{
+    const int heap_size = (int)this->heap.size();
+    
+    while(true)
+    {
+        const int left = 2*position + 1;
+        const int right = left + 1;
+        int smallest = position;
+        
+        if(left < heap_size && this->heap_less(this->heap[left], this->heap[smallest]))
+            smallest = left;
+        
+        if(right < heap_size && this->heap_less(this->heap[right], this->heap[smallest]))
+            smallest = right;
+        
+        if(smallest == position)
+            break;
+        
+        this->heap_swap(position, smallest);
+        position = smallest;
+    }
+}
+
+
+void downsample_charge_fragment_vector::heap_pop()
+{
+    const int last_position = (int)this->heap.size() - 1;
+    
+    this->heap_swap(0, last_position);
+    this->heap_position[this->heap[last_position]] = -1;
+    this->heap.pop_back();
+    
+    if(!this->heap.empty())
+        this->heap_sift_down(0);
+}
+
+
+void downsample_charge_fragment_vector::heap_update(int index)
+{
+    const int position = this->heap_position[index];
+    
+    this->heap_sift_up(position);
+    this->heap_sift_down(this->heap_position[index]);
+}
+
+
+//------------------------------------
+
+
 void downsample_charge_fragment_vector::downsample(std::vector<pev_charge_fragment>& original_charge_fragments, std::vector<pev_charge_fragment>& downsampled_charge_fragments)
 {
     downsampled_charge_fragments.clear();
-    this->variationRank_to_fragmentVariationIt_map.clear();
     this->charge_fragment_variations.clear();
+    this->prev_index.clear();
+    this->next_index.clear();
+    this->heap.clear();
+    this->heap_position.clear();
     this->removed_fragments.clear();
     this->retained_fragments.clear();
     
-    std::random_device rd;  
-    std::mt19937 gen(rd()); 
-    std::uniform_int_distribution<> dis(0, 999999999);
-    
     //---------------------------------------------
     //   Create pev_charge_fragment_variation List
     //---------------------------------------------
@@ -128,6 +194,8 @@ void downsample_charge_fragment_vector::downsample(std::vector<pev_charge_fragme
     std::sort(original_charge_fragments.begin(), original_charge_fragments.end());
     int num_original_fragments = original_charge_fragments.size();
     
+    this->charge_fragment_variations.reserve(num_original_fragments);
+    
     pev_charge_fragment* fragment_ptr;
     double P3_kW;    
     int i = 0;
@@ -152,6 +220,15 @@ void downsample_charge_fragment_vector::downsample(std::vector<pev_charge_fragme
         this->charge_fragment_variations.emplace_back(i, fragment_ptr->time_since_charge_began_hrs, fragment_ptr->soc, P3_kW);
     }
     
+    this->prev_index.resize(num_original_fragments);
+    this->next_index.resize(num_original_fragments);
+    
+    for(i=0; i<num_original_fragments; i++)
+    {
+        this->prev_index[i] = i - 1;
+        this->next_index[i] = (i + 1 < num_original_fragments) ? i + 1 : -1;
+    }
+    
     //----------------------------------------------------------------------
     //             Create  unremovable_charge_fragment_indexes
     //----------------------------------------------------------------------
@@ -161,19 +238,17 @@ void downsample_charge_fragment_vector::downsample(std::vector<pev_charge_fragme
     //----------------------------------------------------------------------
     //   Identify Charge Fragments on 'flat peak' that are not 'Removable'
     //----------------------------------------------------------------------
-   
-    std::list<pev_charge_fragment_variation>::iterator it;
     
     std::vector<pev_charge_fragment_variation> fragments_with_max_P3_kW;
     double max_P3_kW = -1;
    
-    for(it=this->charge_fragment_variations.begin(); it!=this->charge_fragment_variations.end(); it++)
-        if(it->P3_kW > max_P3_kW)
-            max_P3_kW = it->P3_kW;
+    for(const pev_charge_fragment_variation& X : this->charge_fragment_variations)
+        if(X.P3_kW > max_P3_kW)
+            max_P3_kW = X.P3_kW;
 
-    for(it=this->charge_fragment_variations.begin(); it!=this->charge_fragment_variations.end(); it++)
-        if(std::abs(max_P3_kW - it->P3_kW) < this->fragment_removal_criteria.threshold_to_determine_not_removable_fragments_on_flat_peak_kW)
-            fragments_with_max_P3_kW.push_back(*it);
+    for(const pev_charge_fragment_variation& X : this->charge_fragment_variations)
+        if(std::abs(max_P3_kW - X.P3_kW) < this->fragment_removal_criteria.threshold_to_determine_not_removable_fragments_on_flat_peak_kW)
+            fragments_with_max_P3_kW.push_back(X);
     
     int not_removable_fragment_index_flat_LB = fragments_with_max_P3_kW[0].original_charge_fragment_index;
     int not_removable_fragment_index_flat_UB = fragments_with_max_P3_kW[fragments_with_max_P3_kW.size()-1].original_charge_fragment_index;
@@ -198,11 +273,11 @@ void downsample_charge_fragment_vector::downsample(std::vector<pev_charge_fragme
         int index_LB = -1;
         double start_P3_kW = max_P3_kW * this->fragment_removal_criteria.perc_of_max_starting_point_to_determine_not_removable_fragments_on_low_elbow/100.0;
         
-        for(it=this->charge_fragment_variations.begin(); it!=this->charge_fragment_variations.end(); it++)
+        for(const pev_charge_fragment_variation& X : this->charge_fragment_variations)
         {
-            if(it->P3_kW > start_P3_kW)
+            if(X.P3_kW > start_P3_kW)
             {
-                index_LB = it->original_charge_fragment_index;
+                index_LB = X.original_charge_fragment_index;
                 break;
             }
         }
@@ -210,9 +285,9 @@ void downsample_charge_fragment_vector::downsample(std::vector<pev_charge_fragme
         //------------------------
         //    Find  Elbows
         //------------------------
-        int elbow_center = get_index_of_elbow(index_LB, index_UB, this->charge_fragment_variations);
-        int elbow_lower = get_index_of_elbow(index_LB, elbow_center, this->charge_fragment_variations);
-        int elbow_upper = get_index_of_elbow(elbow_center, index_UB, this->charge_fragment_variations);
+        int elbow_center = get_index_of_elbow(index_LB, index_UB);
+        int elbow_lower = get_index_of_elbow(index_LB, elbow_center);
+        int elbow_upper = get_index_of_elbow(elbow_center, index_UB);
         
         if(unremovable_charge_fragment_indexes.count(elbow_center) == 0)
             unremovable_charge_fragment_indexes.insert(elbow_center);
@@ -226,88 +301,88 @@ void downsample_charge_fragment_vector::downsample(std::vector<pev_charge_fragme
     
     //------------------------------------------------------------------
     //    Calculate:   variation_rank
-    //     Populate:   this->variationRank_to_fragmentVariationIt_map
+    //     Populate:   this->heap
     //------------------------------------------------------------------
 
-    int64_t variation_rank;
-
-    for(it=this->charge_fragment_variations.begin(); it!=this->charge_fragment_variations.end(); it++)
+    this->heap_position.assign(num_original_fragments, -1);
+    this->heap.reserve(num_original_fragments);
+    
+    for(i=0; i<num_original_fragments; i++)
     {
-        if(unremovable_charge_fragment_indexes.count(it->original_charge_fragment_index) == 0)
+        pev_charge_fragment_variation& X = this->charge_fragment_variations[i];
+        
+        if(unremovable_charge_fragment_indexes.count(X.original_charge_fragment_index) == 0)
         {
-            it->is_removable = true;
-            variation_rank = calculate_variation_rank(it, gen, dis);                //  Calculate variation_rank
-            it->variation_rank = variation_rank;                                    //  Update List with variation_rank
-            this->variationRank_to_fragmentVariationIt_map[variation_rank] = it;    //  Update Map with variation_rank
+            X.is_removable = true;
+            X.variation_rank = calculate_variation_rank(i);
+            this->heap_position[i] = (int)this->heap.size();
+            this->heap.push_back(i);
         }
         else
-            it->is_removable = false;
+            X.is_removable = false;
     }
     
+    // Heapify
+    for(int position = (int)this->heap.size()/2 - 1; position >= 0; position--)
+        this->heap_sift_down(position);
 
     //------------------------------------------------------------
     //             Determine Indexes to Remove
     //------------------------------------------------------------
     
-    std::list<pev_charge_fragment_variation>::iterator it_prev, it_next;
-    std::unordered_set<int> indexes_to_remove;
-        
+    std::vector<bool> is_removed(num_original_fragments, false);
+    int num_removed_fragments = 0;
+    
     int max_number_of_fragments_that_can_be_removed = (int)num_original_fragments*this->fragment_removal_criteria.max_percent_of_fragments_that_can_be_removed/100;
-    int64_t min_variation_rank;    
 
-    while(true)
+    while(!this->heap.empty())
     {
-        min_variation_rank = this->variationRank_to_fragmentVariationIt_map.begin()->first;
+        const int index = this->heap[0];
         
-        if(min_variation_rank > (int64_t)this->change_metric_multiplier)
+        if(this->charge_fragment_variations[index].variation_rank > (int64_t)this->change_metric_multiplier)
             break;
         
-        //--------------------
-        
-        it = this->variationRank_to_fragmentVariationIt_map[min_variation_rank];
-        it_prev = std::prev(it);
-        it_next = std::next(it);
+        const int index_prev = this->prev_index[index];
+        const int index_next = this->next_index[index];
         
         //--------------------------------------
         //    Remove Current List Element
         //--------------------------------------
-        indexes_to_remove.insert(it->original_charge_fragment_index);                   //  Log Charge Fragment Index to Remove
-        removed_fragments.push_back(*it);                                               //  Bookeeping (Saving removed fragments)
-        this->variationRank_to_fragmentVariationIt_map.erase(min_variation_rank);       //  Erase Fragment from Map
-        this->charge_fragment_variations.erase(it);                                     //  Erase Fragment from List 
+        is_removed[index] = true;                                                       //  Log Charge Fragment Index to Remove
+        num_removed_fragments += 1;
+        this->removed_fragments.push_back(this->charge_fragment_variations[index]);    //  Bookeeping (Saving removed fragments)
+        this->heap_pop();                                                               //  Erase Fragment from Heap
+        this->next_index[index_prev] = index_next;                                      //  Erase Fragment from List
+        this->prev_index[index_next] = index_prev;
         
         //--------------------------------------
         //    Update Previous List Element
         //--------------------------------------
-        if(it_prev->is_removable)
+        if(this->charge_fragment_variations[index_prev].is_removable)
         {
-            this->variationRank_to_fragmentVariationIt_map.erase(it_prev->variation_rank);  //  Erase from Map Old variation_rank
-            variation_rank = calculate_variation_rank(it_prev, gen, dis);                   //  Recalculating variation_rank
-            it_prev->variation_rank = variation_rank;                                       //  Update List with new variation_rank
-            this->variationRank_to_fragmentVariationIt_map[variation_rank] = it_prev;       //  Update map with new variation_rank 
+            this->charge_fragment_variations[index_prev].variation_rank = calculate_variation_rank(index_prev);
+            this->heap_update(index_prev);
         }
             
         //--------------------------------------
         //    Update Next List Element
         //--------------------------------------
-        if(it_next->is_removable)
+        if(this->charge_fragment_variations[index_next].is_removable)
         {
-            this->variationRank_to_fragmentVariationIt_map.erase(it_next->variation_rank);  //  Erase Pevious variation_rank from Map
-            variation_rank = calculate_variation_rank(it_next, gen, dis);                   //  Recalculating variation_rank
-            it_next->variation_rank = variation_rank;                                       //  Update List with new variation_rank
-            this->variationRank_to_fragmentVariationIt_map[variation_rank] = it_next;       //  Update map with new variation_rank 
+            this->charge_fragment_variations[index_next].variation_rank = calculate_variation_rank(index_next);
+            this->heap_update(index_next);
         }
         
         //--------------------
         
-        if(indexes_to_remove.size() >= max_number_of_fragments_that_can_be_removed)
+        if(num_removed_fragments >= max_number_of_fragments_that_can_be_removed)
             break;
     }
    
     //------------------------------------
     
-    for(it=this->charge_fragment_variations.begin(); it != this->charge_fragment_variations.end(); it++)
-        this->retained_fragments.push_back(*it);
+    for(i=0; i != -1; i = this->next_index[i])
+        this->retained_fragments.push_back(this->charge_fragment_variations[i]);
     
     //------------------------------------------------------------
     //               Downsample Charge Fragments
@@ -315,8 +390,7 @@ void downsample_charge_fragment_vector::downsample(std::vector<pev_charge_fragme
 
     for(int i=0; i<num_original_fragments; i++)
     {
-        if(indexes_to_remove.count(i) == 0)
+        if(!is_removed[i])
             downsampled_charge_fragments.push_back(original_charge_fragments[i]);
     }
 }
-
@@ -5,33 +5,49 @@
 #include "datatypes_global.h"   // pev_charge_fragment_removal_criteria
 
 #include <vector>
-#include <map>
-#include <list>
 #include <cstdint>          // int64_t
-#include <random>           // Uniform random number generator
 
 //====================================
 
+// Removes the charge fragments whose P3 changes least relative to their neighbours, one
+// at a time, until the smallest change reaches kW_change_threshold or the maximum number
+// of fragments is removed.
+//
+// The fragments still in the profile are a doubly linked list over contiguous arrays, and
+// the removable ones sit in an indexed binary min-heap ordered by variation_rank, so each
+// removal and the update of its two neighbours is O(log n).  Ties in the variation rank
+// go to the earlier fragment, so the result does not depend on anything but the input.
 
 class downsample_charge_fragment_vector
 {
 private:
     pev_charge_fragment_removal_criteria fragment_removal_criteria;
     double change_metric_multiplier;
-    
-    std::list<pev_charge_fragment_variation> charge_fragment_variations;
-    std::map<int64_t, std::list<pev_charge_fragment_variation>::iterator> variationRank_to_fragmentVariationIt_map;
+
+    std::vector<pev_charge_fragment_variation> charge_fragment_variations;
+    std::vector<int> prev_index;        // -1 before the first fragment still in the profile
+    std::vector<int> next_index;        // -1 after the last fragment still in the profile
+
+    std::vector<int> heap;              // Indexes into charge_fragment_variations
+    std::vector<int> heap_position;     // Position in heap, -1 when not in the heap
 
     std::vector<pev_charge_fragment_variation> removed_fragments;
     std::vector<pev_charge_fragment_variation> retained_fragments;
-    
-    int64_t calculate_variation_rank(std::list<pev_charge_fragment_variation>::iterator it, std::mt19937& gen, std::uniform_int_distribution<>& dis);
-    int get_index_of_elbow(int start_index, int end_index, std::list<pev_charge_fragment_variation>& fragment_variations);
-    
+
+    int64_t calculate_variation_rank(int index) const;
+    int get_index_of_elbow(int start_index, int end_index) const;
+
+    bool heap_less(int index_A, int index_B) const;
+    void heap_swap(int position_A, int position_B);
+    void heap_sift_up(int position);
+    void heap_sift_down(int position);
+    void heap_pop();
+    void heap_update(int index);
+
 public:
     downsample_charge_fragment_vector() {};
     downsample_charge_fragment_vector(pev_charge_fragment_removal_criteria fragment_removal_criteria_);
-    
+
     std::vector<pev_charge_fragment_variation> get_removed_fragments();
     std::vector<pev_charge_fragment_variation> get_retained_fragments();
 
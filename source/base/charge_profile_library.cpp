@@ -25,30 +25,43 @@ void search_vector_of_doubles( const double search_value,
                                int& LB_index,
                                int& UB_index )
 {
-    const std::vector<double>::const_iterator it_UB = std::upper_bound(search_vector.begin(), search_vector.end(), search_value);
+    search_array_of_doubles(search_value, search_vector.data(), (int)search_vector.size(), LB_index, UB_index);
+}
+
+
+void search_array_of_doubles( const double search_value,
+                              const double* search_array,
+                              const int search_array_size,
+                              int& LB_index,
+                              int& UB_index )
+{
+    // Branch free std::upper_bound (same predicate), the searches of a batch overlap.
+    const double* base = search_array;
+    int n = search_array_size;
+    
+    while(n > 1)
+    {
+        const int half = n/2;
+        base = (search_value < base[half]) ? base : base + half;
+        n -= half;
+    }
     
-    if(it_UB == search_vector.begin())
+    const int num_not_greater = (int)(base - search_array) + ((search_array_size > 0 && !(search_value < *base)) ? 1 : 0);
+    
+    if(num_not_greater == 0)
     {
         LB_index = 0;
         UB_index = 0;
     }
-    else if(it_UB == search_vector.end())
+    else if(num_not_greater == search_array_size)
     {
-        LB_index = search_vector.size() - 1;
+        LB_index = search_array_size - 1;
         UB_index = LB_index;
     }
     else
     {
-        UB_index = std::distance(search_vector.begin(), it_UB);
-
-        if(UB_index == 0)
-        {
-            LB_index = 0;
-        }
-        else
-        {
-            LB_index = UB_index - 1;
-        }
+        UB_index = num_not_greater;
+        LB_index = UB_index - 1;
     }
 }
 
@@ -80,19 +93,28 @@ pev_charge_profile_aux::pev_charge_profile_aux( const EV_type pev_type_,
     this->pev_type = pev_type_;
     this->SE_type = SE_type_;
     this->setpoint_P3kW = setpoint_P3kW_;
-    this->charge_fragments = charge_fragments_;
     
-    std::sort(this->charge_fragments.begin(), this->charge_fragments.end());
+    std::vector<pev_charge_fragment> charge_fragments = charge_fragments_;
+    std::sort(charge_fragments.begin(), charge_fragments.end());
     
-    const int num_charge_fragments = this->charge_fragments.size();
+    this->num_charge_fragments = (int)charge_fragments.size();
+    this->fragment_data.resize(num_fragment_columns*this->num_charge_fragments);
     
-    this->soc_search.resize(num_charge_fragments);
-    this->charge_time_search.resize(num_charge_fragments);
+    double* soc = &this->fragment_data[soc_column*this->num_charge_fragments];
+    double* E1_kWh = &this->fragment_data[E1_kWh_column*this->num_charge_fragments];
+    double* E2_kWh = &this->fragment_data[E2_kWh_column*this->num_charge_fragments];
+    double* E3_kWh = &this->fragment_data[E3_kWh_column*this->num_charge_fragments];
+    double* cumQ3_kVARh = &this->fragment_data[cumQ3_kVARh_column*this->num_charge_fragments];
+    double* time_hrs = &this->fragment_data[time_column*this->num_charge_fragments];
     
-    for(int i=0; i<num_charge_fragments; i++)
+    for(int i=0; i<this->num_charge_fragments; i++)
     {
-        this->soc_search[i] = this->charge_fragments.at(i).soc;
-        this->charge_time_search[i] = this->charge_fragments.at(i).time_since_charge_began_hrs;
+        soc[i] = charge_fragments[i].soc;
+        E1_kWh[i] = charge_fragments[i].E1_kWh;
+        E2_kWh[i] = charge_fragments[i].E2_kWh;
+        E3_kWh[i] = charge_fragments[i].E3_kWh;
+        cumQ3_kVARh[i] = charge_fragments[i].cumQ3_kVARh;
+        time_hrs[i] = charge_fragments[i].time_since_charge_began_hrs;
     }
 }
 
@@ -103,9 +125,20 @@ double pev_charge_profile_aux::get_setpoint_P3kW() const
 }
 
 
+pev_charge_fragment pev_charge_profile_aux::get_charge_fragment( const int index ) const
+{
+    return pev_charge_fragment( this->get_column(soc_column)[index],
+                                this->get_column(E1_kWh_column)[index],
+                                this->get_column(E2_kWh_column)[index],
+                                this->get_column(E3_kWh_column)[index],
+                                this->get_column(cumQ3_kVARh_column)[index],
+                                this->get_column(time_column)[index] );
+}
+
+
 pev_charge_fragment pev_charge_profile_aux::get_last_chargeFragment() const
 {
-    return this->charge_fragments.at( this->charge_fragments.size() - 1 );
+    return this->get_charge_fragment( this->num_charge_fragments - 1 );
 }
 
 
@@ -130,33 +163,19 @@ pev_charge_fragment pev_charge_profile_aux::get_chargeFragment( const bool searc
 {
     int UB_index, LB_index;
     
-    if(search_value_is_soc_not_timeHrs)
-    {
-        search_vector_of_doubles(search_value, this->soc_search, LB_index, UB_index);
-    }
-    else
-    {
-        search_vector_of_doubles(search_value, this->charge_time_search, LB_index, UB_index);
-    }
+    const double* search_column = this->get_column(search_value_is_soc_not_timeHrs ? soc_column : time_column);
+    search_array_of_doubles(search_value, search_column, this->num_charge_fragments, LB_index, UB_index);
     
-    const pev_charge_fragment &LB = this->charge_fragments.at(LB_index);
-    const pev_charge_fragment &UB = this->charge_fragments.at(UB_index);
+    const pev_charge_fragment LB = this->get_charge_fragment(LB_index);
+    const pev_charge_fragment UB = this->get_charge_fragment(UB_index);
     
     //---------------------
     
-    double w, LB_val, UB_val;
-    if(search_value_is_soc_not_timeHrs)
-    {
-        LB_val = LB.soc;
-        UB_val = UB.soc;
-    }
-    else
-    {
-        LB_val = LB.time_since_charge_began_hrs;
-        UB_val = UB.time_since_charge_began_hrs;
-    }
+    double w;
+    const double LB_val = search_column[LB_index];
+    const double UB_val = search_column[UB_index];
     
-    if(abs(LB_val - UB_val) < 0.000001)
+    if(std::abs(LB_val - UB_val) < 0.000001)
     {
         w = 1.0;
     }
@@ -281,6 +300,84 @@ pev_charge_profile_result pev_charge_profile_aux::find_result_given_startSOC_and
 }
 
 
+void pev_charge_profile_aux::find_results_given_startSOC_and_endSOC( const int num_queries,
+                                                                     const int* query_indexes,
+                                                                     const double* startSOC,
+                                                                     const double* endSOC,
+                                                                     pev_charge_profile_result* results ) const
+{
+    // The queries are done in chunks that fit in L1.  In a chunk, search values
+    // 0 .. chunk_size-1 are the start socs and the rest the end socs.
+    const int max_chunk_size = 256;
+    
+    int LB_index[2*max_chunk_size], UB_index[2*max_chunk_size];
+    double w[2*max_chunk_size];
+    double values[num_fragment_columns][2*max_chunk_size];
+    
+    const double* soc = this->get_column(soc_column);
+    
+    for(int chunk_begin=0; chunk_begin<num_queries; chunk_begin+=max_chunk_size)
+    {
+        const int chunk_size = std::min(max_chunk_size, num_queries - chunk_begin);
+        const int num_values = 2*chunk_size;
+        
+        for(int i=0; i<num_values; i++)
+        {
+            const int k = chunk_begin + ((i < chunk_size) ? i : i - chunk_size);
+            const int q = (query_indexes == nullptr) ? k : query_indexes[k];
+            const double search_value = (i < chunk_size) ? startSOC[q] : endSOC[q];
+            search_array_of_doubles(search_value, soc, this->num_charge_fragments, LB_index[i], UB_index[i]);
+            
+            const double LB_val = soc[LB_index[i]];
+            const double UB_val = soc[UB_index[i]];
+            
+            w[i] = (std::abs(LB_val - UB_val) < 0.000001) ? 1.0 : (search_value - LB_val)/(UB_val - LB_val);
+        }
+        
+        //---------------------
+        
+        for(int column=0; column<num_fragment_columns; column++)
+        {
+            const double* X = this->get_column(column);
+            double* Y = values[column];
+            
+            #pragma omp simd
+            for(int i=0; i<num_values; i++)
+            {
+                Y[i] = (1.0-w[i])*X[LB_index[i]] + w[i]*X[UB_index[i]];
+            }
+        }
+        
+        //---------------------
+        
+        for(int i=0; i<chunk_size; i++)
+        {
+            const int start = i;
+            const int end = chunk_size + i;
+            const int q = (query_indexes == nullptr) ? chunk_begin + i : query_indexes[chunk_begin + i];
+            pev_charge_profile_result& obj = results[q];
+            
+            if(values[soc_column][end] < values[soc_column][start])
+            {
+                pev_charge_fragment start_fragment, end_fragment;
+                start_fragment.soc = values[soc_column][start];
+                end_fragment.soc = values[soc_column][end];
+                obj = this->get_pev_charge_profile_result(start_fragment, end_fragment);
+                continue;
+            }
+            
+            obj.soc_increase = values[soc_column][end] - values[soc_column][start];
+            obj.E1_kWh = values[E1_kWh_column][end] - values[E1_kWh_column][start];
+            obj.E2_kWh = values[E2_kWh_column][end] - values[E2_kWh_column][start];
+            obj.E3_kWh = values[E3_kWh_column][end] - values[E3_kWh_column][start];
+            obj.cumQ3_kVARh = values[cumQ3_kVARh_column][end] - values[cumQ3_kVARh_column][start];
+            obj.total_charge_time_hrs = values[time_column][end] - values[time_column][start];
+            obj.incremental_chage_time_hrs = NAN;
+        }
+    }
+}
+
+
 pev_charge_profile_result pev_charge_profile_aux::find_result_given_startSOC_and_chargeTime( const double startSOC,
                                                                                              const double charge_time_hrs ) const
 {
@@ -361,6 +458,84 @@ pev_charge_profile_result pev_charge_profile::find_result_given_startSOC_and_end
 }
 
 
+void pev_charge_profile::find_results_given_startSOC_and_endSOC(
+    const std::vector<double>& setpoint_P3kW,
+    const std::vector<double>& startSOC,
+    const std::vector<double>& endSOC,
+    std::vector<pev_charge_profile_result>& results
+) const
+{
+    ASSERT(setpoint_P3kW.size() == startSOC.size() && startSOC.size() == endSOC.size(), "setpoint_P3kW, startSOC and endSOC must have the same size.");
+    
+    const int num_queries = (int)setpoint_P3kW.size();
+    const int num_profiles = (int)this->charge_profiles.size();
+    
+    results.resize(num_queries);
+    
+    //-----------------------------------
+    //  Group the queries by profile
+    //-----------------------------------
+    
+    std::vector<int> profile_index(num_queries);
+    std::vector<int> group_begin(num_profiles + 1, 0);
+    
+    for(int i=0; i<num_queries; i++)
+    {
+        if(setpoint_P3kW[i] <= 0)
+        {
+            std::cout << "ERROR A5: In pev_charge_profile (setpoint_P3kW <= 0)." << std::endl;
+            results.clear();
+            exit(0);
+            return;
+        }
+        
+        int LB_index, UB_index;
+        search_vector_of_doubles(setpoint_P3kW[i], this->setpoint_P3kW_search, LB_index, UB_index);
+        
+        profile_index[i] = UB_index;
+        group_begin[UB_index + 1] += 1;
+    }
+    
+    // All queries in one profile, the usual case.
+    for(int j=0; j<num_profiles; j++)
+    {
+        if(group_begin[j + 1] == num_queries)
+        {
+            this->charge_profiles[j].find_results_given_startSOC_and_endSOC(num_queries, nullptr, startSOC.data(), endSOC.data(), results.data());
+            return;
+        }
+    }
+    
+    for(int j=0; j<num_profiles; j++)
+    {
+        group_begin[j + 1] += group_begin[j];
+    }
+    
+    std::vector<int> query_order(num_queries);
+    std::vector<int> next_position(group_begin.begin(), group_begin.end() - 1);
+    
+    for(int i=0; i<num_queries; i++)
+    {
+        query_order[next_position[profile_index[i]]++] = i;
+    }
+    
+    //-----------------------------------
+    //  One batch per profile
+    //-----------------------------------
+    
+    for(int j=0; j<num_profiles; j++)
+    {
+        const int begin = group_begin[j];
+        const int num_group_queries = group_begin[j + 1] - begin;
+        
+        if(num_group_queries > 0)
+        {
+            this->charge_profiles[j].find_results_given_startSOC_and_endSOC(num_group_queries, &query_order[begin], startSOC.data(), endSOC.data(), results.data());
+        }
+    }
+}
+
+
 pev_charge_profile_result pev_charge_profile::find_result_given_startSOC_and_chargeTime( 
     const double setpoint_P3kW,
     const double startSOC,
@@ -430,7 +605,11 @@ void pev_charge_profile::find_chargeProfile_given_startSOC_and_chargeTimes(
 //==============================================================================
 
 pev_charge_profile_library::pev_charge_profile_library(const EV_EVSE_inventory& inventory)
-    : inventory(inventory)
+    : inventory(inventory),
+    charge_profile(inventory.get_num_EV_EVSE_pairs()),
+    charge_profile_is_set(inventory.get_num_EV_EVSE_pairs(), 0),
+    builder{ nullptr },
+    build_once{ nullptr }
 {
     // Dummy Values for default profile
     EV_type pev_type = inventory.get_default_EV();
@@ -465,15 +644,48 @@ pev_charge_profile_library::pev_charge_profile_library(const EV_EVSE_inventory&
 }
 
 
+pev_charge_profile_library::pev_charge_profile_library( const EV_EVSE_inventory& inventory,
+                                                        const charge_profile_builder& builder )
+    : pev_charge_profile_library(inventory)
+{
+    this->builder = builder;
+    this->build_once.reset(new std::once_flag[inventory.get_num_EV_EVSE_pairs()]);
+}
+
+
 void pev_charge_profile_library::add_charge_profile_to_library( const EV_type pev_type,
                                                                 const EVSE_type SE_type,
                                                                 const pev_charge_profile& charge_profile )
 {
-    const std::pair<EV_type, EVSE_type> key = std::make_pair(pev_type, SE_type);
+    const EV_type_id EV_id = this->inventory.get_EV_type_id(pev_type);
+    const EVSE_type_id EVSE_id = this->inventory.get_EVSE_type_id(SE_type);
     
-    if(this->charge_profile.count(key) == 0)
+    if(EV_id < 0 || EVSE_id < 0)
     {
-        this->charge_profile[key] = charge_profile;
+        std::cout << "ERROR:  Charge profile added to pev_charge_profile_library for types not in the inventory. (pev_type:" << pev_type << "  SE_type:" << SE_type << ")" << std::endl;
+        exit(0);
+    }
+    
+    this->add_charge_profile_to_library(EV_id, EVSE_id, charge_profile);
+}
+
+
+void pev_charge_profile_library::add_charge_profile_to_library( const EV_type_id EV_id,
+                                                                const EVSE_type_id EVSE_id,
+                                                                const pev_charge_profile& charge_profile )
+{
+    if(this->is_lazy())
+    {
+        std::cout << "ERROR:  Charge profile added to a lazy pev_charge_profile_library, its profiles are built on demand." << std::endl;
+        exit(0);
+    }
+    
+    const int index = this->inventory.get_EV_EVSE_pair_index(EV_id, EVSE_id);
+    
+    if(!this->charge_profile_is_set[index])
+    {
+        this->charge_profile[index] = charge_profile;
+        this->charge_profile_is_set[index] = 1;
     }
     else
     {
@@ -488,14 +700,87 @@ const pev_charge_profile& pev_charge_profile_library::get_charge_profile(
     const EVSE_type SE_type
 ) const
 {
-    const std::pair<EV_type, EVSE_type> key = std::make_pair(pev_type, SE_type);
-    if (this->charge_profile.count(key) == 0)
+    const EV_type_id EV_id = this->inventory.get_EV_type_id(pev_type);
+    const EVSE_type_id EVSE_id = this->inventory.get_EVSE_type_id(SE_type);
+    
+    if (!this->has_charge_profile(EV_id, EVSE_id))
     {
         std::cout << "ERROR:  Charge profile not in pev_charge_profile_library. (pev_type:" << pev_type << "  SE_type:" << SE_type << ")" << std::endl;
         exit(0);
         return this->default_profile;
     }
-    return this->charge_profile.at(key);
+    return this->get_charge_profile_by_index(this->inventory.get_EV_EVSE_pair_index(EV_id, EVSE_id));
+}
+
+
+const pev_charge_profile& pev_charge_profile_library::get_charge_profile(
+    const EV_type_id EV_id,
+    const EVSE_type_id EVSE_id
+) const
+{
+    if (!this->has_charge_profile(EV_id, EVSE_id))
+    {
+        std::cout << "ERROR:  Charge profile not in pev_charge_profile_library. (EV_id:" << EV_id << "  EVSE_id:" << EVSE_id << ")" << std::endl;
+        exit(0);
+        return this->default_profile;
+    }
+    return this->get_charge_profile_by_index(this->inventory.get_EV_EVSE_pair_index(EV_id, EVSE_id));
+}
+
+
+const pev_charge_profile& pev_charge_profile_library::get_charge_profile_by_index( const int index ) const
+{
+    if(this->is_lazy())
+    {
+        // call_once also makes the profile written by the thread that built it visible
+        // to every thread that returns from call_once.
+        std::call_once(this->build_once[index], [this, index]()
+        {
+            const int num_EVSE_types = this->inventory.get_num_EVSE_types();
+            const pev_SE_pair pev_SE{ this->inventory.get_EV_type(index / num_EVSE_types),
+                                      this->inventory.get_EVSE_type(index % num_EVSE_types) };
+            
+            this->charge_profile[index] = this->builder(pev_SE);
+            this->charge_profile_is_set[index] = 1;
+        });
+    }
+    
+    return this->charge_profile[index];
+}
+
+
+void pev_charge_profile_library::build_charge_profiles( const std::vector<pev_SE_pair>& pev_SE_pairs ) const
+{
+    if(!this->is_lazy())
+        return;
+    
+    std::vector<char> is_listed(this->charge_profile.size(), 0);
+    std::vector<int> indexes;
+    
+    for(const pev_SE_pair& pev_SE : pev_SE_pairs)
+    {
+        const EV_type_id EV_id = this->inventory.get_EV_type_id(pev_SE.ev_type);
+        const EVSE_type_id EVSE_id = this->inventory.get_EVSE_type_id(pev_SE.se_type);
+        
+        if(!this->has_charge_profile(EV_id, EVSE_id))
+            continue;
+        
+        const int index = this->inventory.get_EV_EVSE_pair_index(EV_id, EVSE_id);
+        
+        if(!is_listed[index])
+        {
+            is_listed[index] = 1;
+            indexes.push_back(index);
+        }
+    }
+    
+    const int num_indexes = (int)indexes.size();
+    
+    #pragma omp parallel for schedule(dynamic, 1)
+    for(int i = 0; i < num_indexes; i++)
+    {
+        this->get_charge_profile_by_index(indexes[i]);
+    }
 }
 
 /*
@@ -526,6 +811,128 @@ const pev_charge_profile* pev_charge_profile_library::get_charge_profile( const
 }
 */
 
+//==============================================================================
+//                      Binary form of the charge profiles
+//==============================================================================
+// Native byte order.  Only the inputs of the constructors are written, the search
+// vectors are rebuilt when reading.
+
+void pev_charge_profile_aux::write_binary( std::ostream& out ) const
+{
+    write_string(out, this->pev_type);
+    write_string(out, this->SE_type);
+    write_pod<double>(out, this->setpoint_P3kW);
+    write_pod<uint64_t>(out, (uint64_t)this->num_charge_fragments);
+    
+    std::vector<pev_charge_fragment> charge_fragments(this->num_charge_fragments);
+    for(int i=0; i<this->num_charge_fragments; i++)
+        charge_fragments[i] = this->get_charge_fragment(i);
+    
+    out.write(reinterpret_cast<const char*>(charge_fragments.data()), charge_fragments.size()*sizeof(pev_charge_fragment));
+}
+
+
+pev_charge_profile_aux pev_charge_profile_aux::read_binary( std::istream& in )
+{
+    const EV_type pev_type = read_string(in);
+    const EVSE_type SE_type = read_string(in);
+    const double setpoint_P3kW = read_pod<double>(in);
+    const uint64_t num_charge_fragments = read_pod<uint64_t>(in);
+    
+    std::vector<pev_charge_fragment> charge_fragments;
+    
+    if(in.good() && has_remaining_bytes(in, num_charge_fragments, sizeof(pev_charge_fragment)))
+    {
+        charge_fragments.resize(num_charge_fragments);
+        in.read(reinterpret_cast<char*>(charge_fragments.data()), num_charge_fragments*sizeof(pev_charge_fragment));
+    }
+    
+    return pev_charge_profile_aux(pev_type, SE_type, setpoint_P3kW, charge_fragments);
+}
+
+
+void pev_charge_profile::write_binary( std::ostream& out ) const
+{
+    write_string(out, this->pev_type);
+    write_string(out, this->SE_type);
+    write_pod<double>(out, this->CE_P3kW_limits.min_P3kW);
+    write_pod<double>(out, this->CE_P3kW_limits.max_P3kW);
+    write_pod<uint64_t>(out, (uint64_t)this->charge_profiles.size());
+    
+    for(const pev_charge_profile_aux& X : this->charge_profiles)
+        X.write_binary(out);
+}
+
+
+pev_charge_profile pev_charge_profile::read_binary( std::istream& in )
+{
+    const EV_type pev_type = read_string(in);
+    const EVSE_type SE_type = read_string(in);
+    
+    charge_event_P3kW_limits CE_P3kW_limits;
+    CE_P3kW_limits.min_P3kW = read_pod<double>(in);
+    CE_P3kW_limits.max_P3kW = read_pod<double>(in);
+    
+    const uint64_t num_charge_profiles = read_pod<uint64_t>(in);
+    
+    std::vector<pev_charge_profile_aux> charge_profiles;
+    
+    for(uint64_t i = 0; i < num_charge_profiles && in.good(); i++)
+        charge_profiles.push_back(pev_charge_profile_aux::read_binary(in));
+    
+    return pev_charge_profile(pev_type, SE_type, CE_P3kW_limits, charge_profiles);
+}
+
+
+void pev_charge_profile_library::write_binary( std::ostream& out ) const
+{
+    // Other threads may be building profiles of a lazy library.  Once every profile is
+    // built no entry is written again, so they are read here without a race.
+    this->build_charge_profiles(this->inventory.get_all_compatible_pev_SE_combinations());
+    
+    write_pod<uint64_t>(out, (uint64_t)this->charge_profile.size());
+    
+    for(int i = 0; i < (int)this->charge_profile.size(); i++)
+    {
+        write_pod<uint8_t>(out, this->charge_profile_is_set[i] ? 1 : 0);
+        
+        if(this->charge_profile_is_set[i])
+            this->charge_profile[i].write_binary(out);
+    }
+}
+
+
+bool pev_charge_profile_library::read_binary( std::istream& in )
+{
+    if(this->is_lazy())
+        return false;
+    
+    const uint64_t num_pairs = read_pod<uint64_t>(in);
+    
+    if(!in.good() || num_pairs != this->charge_profile.size())
+        return false;
+    
+    std::vector<pev_charge_profile> charge_profile_tmp(num_pairs);
+    std::vector<char> charge_profile_is_set_tmp(num_pairs, 0);
+    
+    for(uint64_t i = 0; i < num_pairs && in.good(); i++)
+    {
+        charge_profile_is_set_tmp[i] = (read_pod<uint8_t>(in) != 0) ? 1 : 0;
+        
+        if(charge_profile_is_set_tmp[i])
+            charge_profile_tmp[i] = pev_charge_profile::read_binary(in);
+    }
+    
+    if(!in.good())
+        return false;
+    
+    this->charge_profile = std::move(charge_profile_tmp);
+    this->charge_profile_is_set = std::move(charge_profile_is_set_tmp);
+    
+    return true;
+}
+
+
 //==============================================================================
 //                          pev_charge_profile_library_v2
 //==============================================================================
@@ -11,6 +11,10 @@
 #include <map>
 #include <cstdint>      // int64_t
 #include <utility>      // pair
+#include <iostream>     // istream, ostream
+#include <functional>   // function
+#include <memory>       // unique_ptr
+#include <mutex>        // once_flag
 
 #include "EV_characteristics.h"
 #include "EVSE_characteristics.h"
@@ -21,6 +25,12 @@ void search_vector_of_doubles( const double search_value,
                                int& LB_index,
                                int& UB_index );
 
+void search_array_of_doubles( const double search_value,
+                              const double* search_array,
+                              const int search_array_size,
+                              int& LB_index,
+                              int& UB_index );
+
 pev_charge_profile_result get_default_charge_profile_result();
 
 
@@ -31,10 +41,26 @@ private:
     EVSE_type SE_type;
     double setpoint_P3kW;
     
-    std::vector<pev_charge_fragment> charge_fragments;
-    std::vector<double> soc_search; 
-    std::vector<double> charge_time_search;
+    // The charge fragments, sorted by time, stored column by column in one block:
+    // num_charge_fragments values of soc, then of E1_kWh, E2_kWh, E3_kWh, cumQ3_kVARh
+    // and time_since_charge_began_hrs.  The soc and time columns are searched directly.
+    enum fragment_column
+    {
+        soc_column = 0,
+        E1_kWh_column,
+        E2_kWh_column,
+        E3_kWh_column,
+        cumQ3_kVARh_column,
+        time_column,
+        num_fragment_columns
+    };
+    
+    int num_charge_fragments;
+    std::vector<double> fragment_data;
+    
+    const double* get_column( const int column ) const { return this->fragment_data.data() + column*this->num_charge_fragments; }
     
+    pev_charge_fragment get_charge_fragment( const int index ) const;
     pev_charge_fragment get_last_chargeFragment() const;
     
     pev_charge_fragment get_chargeFragment( const bool search_value_is_soc_not_timeHrs,
@@ -66,6 +92,16 @@ public:
     
     pev_charge_profile_result find_result_given_startSOC_and_endSOC( const double startSOC, const double endSOC ) const;
 
+    // find_result_given_startSOC_and_endSOC for num_queries (startSOC, endSOC) pairs.  The
+    // searches are done first, then each column is interpolated for all queries in one
+    // loop the compiler can vectorize.  Query k is startSOC[q], endSOC[q] -> results[q]
+    // with q = query_indexes[k], or q = k when query_indexes is nullptr.
+    void find_results_given_startSOC_and_endSOC( const int num_queries,
+                                                 const int* query_indexes,
+                                                 const double* startSOC,
+                                                 const double* endSOC,
+                                                 pev_charge_profile_result* results ) const;
+
     pev_charge_profile_result find_result_given_startSOC_and_chargeTime( const double startSOC, const double charge_time_hrs ) const;
     
     void find_chargeProfile_given_startSOC_and_endSOCs( const double startSOC,
@@ -76,6 +112,12 @@ public:
                                                             const std::vector<double>& charge_time_hrs,
                                                             std::vector<pev_charge_profile_result>& charge_profile ) const;
     
+    // Binary form used by the charge profile library cache.  read_binary leaves 'in' failed
+    // when the data is truncated or a count is larger than the bytes left in 'in', which
+    // must be seekable.
+    void write_binary( std::ostream& out ) const;
+    static pev_charge_profile_aux read_binary( std::istream& in );
+    
     bool operator<(const pev_charge_profile_aux& x) const
 	{
 		return this->setpoint_P3kW < x.setpoint_P3kW;
@@ -117,6 +159,16 @@ public:
         const double endSOC 
     ) const;
 
+    // find_result_given_startSOC_and_endSOC for many (setpoint_P3kW, startSOC, endSOC)
+    // triples at once.  The queries are grouped by the setpoint profile they fall in and
+    // each group is evaluated in one batch (see pev_charge_profile_aux).
+    void find_results_given_startSOC_and_endSOC(
+        const std::vector<double>& setpoint_P3kW,
+        const std::vector<double>& startSOC,
+        const std::vector<double>& endSOC,
+        std::vector<pev_charge_profile_result>& results
+    ) const;
+
     pev_charge_profile_result find_result_given_startSOC_and_chargeTime( 
         const double setpoint_P3kW,
         const double startSOC,
@@ -136,35 +188,95 @@ public:
         const std::vector<double>& charge_time_hrs,
         std::vector<pev_charge_profile_result>& charge_profile 
     ) const;
+    
+    void write_binary( std::ostream& out ) const;
+    static pev_charge_profile read_binary( std::istream& in );
 };
 
 
 class pev_charge_profile_library
 {
+public:
+    // Builds the profile of one compatible (EV, EVSE) pair of the inventory.
+    typedef std::function<pev_charge_profile( const pev_SE_pair& )> charge_profile_builder;
+
 private:
-    // Using map because there is no specialization of std::hash for std::pair in the c++ standard library.
-    std::map< std::pair<EV_type, EVSE_type>, pev_charge_profile> charge_profile;
-    pev_charge_profile default_profile;
-    
     const EV_EVSE_inventory& inventory;
 
+    // Indexed by inventory.get_EV_EVSE_pair_index(EV_type_id, EVSE_type_id).  In a lazy
+    // library the profiles are filled in by get_charge_profile, from several threads at
+    // once, so charge_profile_is_set is a vector<char> (no shared bits between entries).
+    mutable std::vector<pev_charge_profile> charge_profile;
+    mutable std::vector<char> charge_profile_is_set;
+    pev_charge_profile default_profile;
+
+    // Lazy library only (see the constructor taking a builder).
+    charge_profile_builder builder;
+    std::unique_ptr<std::once_flag[]> build_once;
+
+    const pev_charge_profile& get_charge_profile_by_index( const int index ) const;
+
 public:
     pev_charge_profile_library( const EV_EVSE_inventory& inventory );
-    
+
+    // Lazy library.  The profile of a compatible pair is built by builder the first time
+    // it is asked for, exactly once even when several threads ask for it at the same
+    // time, and the other threads wait for it.  Pairs that are never used are never built.
+    pev_charge_profile_library( const EV_EVSE_inventory& inventory,
+                                const charge_profile_builder& builder );
+
+    pev_charge_profile_library( pev_charge_profile_library&& ) = default;
+    pev_charge_profile_library( const pev_charge_profile_library& ) = delete;
+    pev_charge_profile_library& operator=( const pev_charge_profile_library& ) = delete;
+
+    bool is_lazy() const { return (bool)this->builder; }
+
     void add_charge_profile_to_library( const EV_type pev_type,
                                         const EVSE_type SE_type,
                                         const pev_charge_profile& charge_profile );
 
+    void add_charge_profile_to_library( const EV_type_id EV_id,
+                                        const EVSE_type_id EVSE_id,
+                                        const pev_charge_profile& charge_profile );
+
     const pev_charge_profile& get_charge_profile(
         const EV_type pev_type,
         const EVSE_type SE_type
     ) const;
 
+    const pev_charge_profile& get_charge_profile(
+        const EV_type_id EV_id,
+        const EVSE_type_id EVSE_id
+    ) const;
+
+    // In a lazy library every compatible pair has a profile, built or not.
     bool has_charge_profile( const EV_type pev_type, const EVSE_type SE_type) const
     {
-        std::pair<EV_type, EVSE_type> key = {pev_type, SE_type};
-        return this->charge_profile.find(key) != this->charge_profile.end(); 
+        return this->has_charge_profile(this->inventory.get_EV_type_id(pev_type), this->inventory.get_EVSE_type_id(SE_type));
+    }
+
+    bool has_charge_profile( const EV_type_id EV_id, const EVSE_type_id EVSE_id ) const
+    {
+        if(EV_id < 0 || EVSE_id < 0)
+            return false;
+        
+        if(this->is_lazy())
+            return this->inventory.pev_is_compatible_with_supply_equipment(EV_id, EVSE_id);
+        
+        return this->charge_profile_is_set[this->inventory.get_EV_EVSE_pair_index(EV_id, EVSE_id)] != 0;
     }
+    
+    // Lazy library only.  Builds the profiles of the given pairs that are not built yet,
+    // in parallel, so the first charge events of a simulation do not wait on them.
+    // Incompatible pairs and types not in the inventory are skipped.
+    void build_charge_profiles( const std::vector<pev_SE_pair>& pev_SE_pairs ) const;
+    
+    // Profiles in inventory pair order.  read_binary returns false, leaving the library
+    // unchanged, when the data is truncated or was written for a different inventory size,
+    // and always for a lazy library.  A lazy library builds the profiles it has not built
+    // yet before it writes, so it writes the same as the full library.
+    void write_binary( std::ostream& out ) const;
+    bool read_binary( std::istream& in );
 };
 
 
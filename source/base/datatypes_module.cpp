@@ -1,5 +1,6 @@
 
 #include "datatypes_module.h"
+#include "helper.h"     // write_pod, read_pod, write_string, read_string
 
 
 //===================================================================
@@ -39,3 +40,45 @@ std::ostream& operator<<(std::ostream& out, ac_power_metrics& x)
 }
 
 
+//===========================================
+//         CE_status & SE_status 
+//===========================================
+
+void CE_status::write_binary(std::ostream& out) const
+{
+	write_pod<int32_t>(out, this->charge_event_id);
+	write_pod<int32_t>(out, this->vehicle_id);
+	write_string(out, this->vehicle_type);
+	write_pod<stop_charging_criteria>(out, this->stop_charge);
+	write_pod<double>(out, this->arrival_unix_time);
+	write_pod<double>(out, this->departure_unix_time);
+	write_pod<double>(out, this->arrival_SOC);
+	write_pod<double>(out, this->departure_SOC);
+	write_pod<double>(out, this->now_unix_time);
+	write_pod<double>(out, this->now_soc);
+	write_pod<double>(out, this->now_charge_energy_E3kWh);
+	write_pod<double>(out, this->now_dcPkW);
+	write_pod<double>(out, this->now_acPkW);
+	write_pod<double>(out, this->now_acQkVAR);
+}
+
+
+CE_status CE_status::read_binary(std::istream& in)
+{
+	CE_status x;
+	x.charge_event_id = read_pod<int32_t>(in);
+	x.vehicle_id = read_pod<int32_t>(in);
+	x.vehicle_type = read_string(in);
+	x.stop_charge = read_pod<stop_charging_criteria>(in);
+	x.arrival_unix_time = read_pod<double>(in);
+	x.departure_unix_time = read_pod<double>(in);
+	x.arrival_SOC = read_pod<double>(in);
+	x.departure_SOC = read_pod<double>(in);
+	x.now_unix_time = read_pod<double>(in);
+	x.now_soc = read_pod<double>(in);
+	x.now_charge_energy_E3kWh = read_pod<double>(in);
+	x.now_dcPkW = read_pod<double>(in);
+	x.now_acPkW = read_pod<double>(in);
+	x.now_acQkVAR = read_pod<double>(in);
+	return x;
+}
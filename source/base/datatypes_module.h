@@ -49,6 +49,9 @@ struct CE_status
     double now_acQkVAR;
     
     CE_status() {};
+    
+    void write_binary(std::ostream& out) const;
+    static CE_status read_binary(std::istream& in);
 };
 
 
@@ -0,0 +1,582 @@
+
+#include "factory_registry.h"
+#include "SE_EV_factory_charge_profile.h"           // factory_charge_profile_library
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>                                  // hex, hexfloat
+#include <cstdint>                                  // uint64_t
+#include <cstring>                                  // memcmp
+#include <filesystem>
+#include <iostream>
+#include <atomic>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/mman.h>                               // mmap
+#include <sys/stat.h>                               // fstat
+#include <fcntl.h>                                  // open
+#include <unistd.h>                                 // close, getpid
+#define CALDERA_HAS_MMAP
+#elif defined(_WIN32)
+#include <process.h>                                // _getpid
+#endif
+
+
+std::mutex factory_registry::registry_mutex;
+
+std::map<std::string, std::shared_ptr<const load_EV_EVSE_inventory> > factory_registry::inventories;
+std::map<std::string, std::shared_ptr<const factory_EV_charge_model> > factory_registry::EV_charge_model_factories;
+std::map<std::string, std::shared_ptr<const factory_ac_to_dc_converter> > factory_registry::ac_to_dc_converter_factories;
+std::map<std::string, std::shared_future<std::shared_ptr<const pev_charge_profile_library> > > factory_registry::charge_profile_libraries;
+std::string factory_registry::charge_profile_library_cache_dir;
+
+
+namespace
+{
+    // Objects that reference the inventory are stored next to it, and handed out through
+    // an aliasing shared_ptr so the inventory lives as long as any user of the object.
+
+    struct EV_charge_model_factory_entry
+    {
+        std::shared_ptr<const load_EV_EVSE_inventory> loader;
+        factory_EV_charge_model factory;
+    };
+
+    struct ac_to_dc_converter_factory_entry
+    {
+        std::shared_ptr<const load_EV_EVSE_inventory> loader;
+        factory_ac_to_dc_converter factory;
+    };
+
+    struct charge_profile_library_entry
+    {
+        std::shared_ptr<const load_EV_EVSE_inventory> loader;
+        pev_charge_profile_library library;
+    };
+
+    const char charge_profile_library_cache_magic[8] = { 'C', 'L', 'D', 'R', 'C', 'P', 'L', '2' };
+
+    // Read only view of a whole file.  The file is memory mapped where the platform
+    // supports it, otherwise it is read into memory.
+    class read_only_file_view
+    {
+    private:
+        const char* data;
+        size_t size;
+        std::vector<char> buffer;
+#ifdef CALDERA_HAS_MMAP
+        void* mapped_data;
+#endif
+
+    public:
+        read_only_file_view( const std::string& file ) : data{ nullptr }, size{ 0 }
+        {
+#ifdef CALDERA_HAS_MMAP
+            this->mapped_data = MAP_FAILED;
+
+            const int fd = ::open(file.c_str(), O_RDONLY);
+            if(fd < 0)
+                return;
+
+            struct stat file_stat;
+            if(::fstat(fd, &file_stat) == 0 && file_stat.st_size > 0)
+            {
+                this->mapped_data = ::mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+                if(this->mapped_data != MAP_FAILED)
+                {
+                    this->data = static_cast<const char*>(this->mapped_data);
+                    this->size = (size_t)file_stat.st_size;
+                }
+            }
+
+            ::close(fd);
+#else
+            std::ifstream f(file, std::ios::in | std::ios::binary | std::ios::ate);
+            if(!f.is_open())
+                return;
+
+            this->buffer.resize((size_t)f.tellg());
+            f.seekg(0);
+
+            if(f.read(this->buffer.data(), this->buffer.size()))
+            {
+                this->data = this->buffer.data();
+                this->size = this->buffer.size();
+            }
+#endif
+        }
+
+        ~read_only_file_view()
+        {
+#ifdef CALDERA_HAS_MMAP
+            if(this->mapped_data != MAP_FAILED)
+                ::munmap(this->mapped_data, this->size);
+#endif
+        }
+
+        read_only_file_view( const read_only_file_view& ) = delete;
+        read_only_file_view& operator=( const read_only_file_view& ) = delete;
+
+        const char* get_data() const { return this->data; }
+        size_t get_size() const { return this->size; }
+    };
+
+    // istream over a block of memory, so the mapped file is parsed without a copy.
+    // Seekable, since read_binary checks counts against the bytes left.
+    class memory_streambuf : public std::streambuf
+    {
+    public:
+        memory_streambuf( const char* data, const size_t size )
+        {
+            char* begin = const_cast<char*>(data);
+            this->setg(begin, begin, begin + size);
+        }
+
+    protected:
+        pos_type seekoff( off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which ) override
+        {
+            const off_type size = this->egptr() - this->eback();
+            off_type pos = off;
+
+            if(dir == std::ios_base::cur)
+                pos += this->gptr() - this->eback();
+            else if(dir == std::ios_base::end)
+                pos += size;
+
+            if(!(which & std::ios_base::in) || pos < 0 || pos > size)
+                return pos_type(off_type(-1));
+
+            this->setg(this->eback(), this->eback() + pos, this->egptr());
+            return pos_type(pos);
+        }
+
+        pos_type seekpos( pos_type pos, std::ios_base::openmode which ) override
+        {
+            return this->seekoff(off_type(pos), std::ios_base::beg, which);
+        }
+    };
+
+    // Cache files written at the same time by several threads or processes get different
+    // temporary files.
+    std::atomic<uint64_t> tmp_file_counter{ 0 };
+
+    long get_process_id()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        return (long)::getpid();
+#elif defined(_WIN32)
+        return (long)::_getpid();
+#else
+        return 0;
+#endif
+    }
+}
+
+
+//-----------------------------------------
+//              Fingerprints
+//-----------------------------------------
+
+// 64 bit FNV-1a.  Pass hash = 0 to start a new hash.
+uint64_t factory_registry::get_hash( const char* data, const size_t num_bytes, uint64_t hash )
+{
+    if(hash == 0)
+        hash = 14695981039346656037ULL;
+
+    for(size_t i = 0; i < num_bytes; i++)
+    {
+        hash ^= (unsigned char)data[i];
+        hash *= 1099511628211ULL;
+    }
+
+    return hash;
+}
+
+
+std::string factory_registry::get_file_fingerprint( const std::string& file )
+{
+    std::ifstream f(file, std::ios::in | std::ios::binary);
+
+    if(!f.is_open())
+        return "missing";
+
+    uint64_t hash = get_hash(nullptr, 0, 0);
+    uint64_t num_bytes = 0;
+    char buffer[65536];
+
+    while(f.read(buffer, sizeof(buffer)) || f.gcount() > 0)
+    {
+        const std::streamsize n = f.gcount();
+        hash = get_hash(buffer, n, hash);
+        num_bytes += n;
+    }
+
+    std::ostringstream out;
+    out << std::hex << std::setw(16) << std::setfill('0') << hash << "-" << std::dec << num_bytes;
+    return out.str();
+}
+
+
+std::string factory_registry::get_ramping_fingerprint( const EV_ramping_map& EV_ramping,
+                                                       const EV_EVSE_ramping_map& EV_EVSE_ramping )
+{
+    // The ramping maps are unordered, sort them so equal maps give equal fingerprints.
+    const std::map<EV_type, pev_charge_ramping> EV_ramping_sorted(EV_ramping.begin(), EV_ramping.end());
+    const std::map<std::pair<EV_type, EVSE_type>, pev_charge_ramping> EV_EVSE_ramping_sorted(EV_EVSE_ramping.begin(), EV_EVSE_ramping.end());
+
+    std::ostringstream out;
+    out << std::hexfloat;
+
+    auto write_ramping = [&out](const pev_charge_ramping& X)
+    {
+        out << X.off_to_on_delay_sec << "," << X.off_to_on_kW_per_sec << ","
+            << X.on_to_off_delay_sec << "," << X.on_to_off_kW_per_sec << ","
+            << X.ramp_up_delay_sec << "," << X.ramp_up_kW_per_sec << ","
+            << X.ramp_down_delay_sec << "," << X.ramp_down_kW_per_sec << ";";
+    };
+
+    for(const std::pair<const EV_type, pev_charge_ramping>& X : EV_ramping_sorted)
+    {
+        out << X.first << ":";
+        write_ramping(X.second);
+    }
+
+    out << "|";
+
+    for(const std::pair<const std::pair<EV_type, EVSE_type>, pev_charge_ramping>& X : EV_EVSE_ramping_sorted)
+    {
+        out << X.first.first << "," << X.first.second << ":";
+        write_ramping(X.second);
+    }
+
+    return out.str();
+}
+
+
+std::string factory_registry::get_inventory_fingerprint( const std::string& input_path )
+{
+    return get_file_fingerprint(input_path + "/EV_inputs.csv") + "_" + get_file_fingerprint(input_path + "/EVSE_inputs.csv");
+}
+
+
+//-----------------------------------------
+//              Registry
+//-----------------------------------------
+
+std::shared_ptr<const load_EV_EVSE_inventory> factory_registry::get_inventory_locked( const std::string& input_path,
+                                                                                      const std::string& inventory_fingerprint )
+{
+    std::shared_ptr<const load_EV_EVSE_inventory>& loader = inventories[inventory_fingerprint];
+
+    if(loader == nullptr)
+        loader = std::make_shared<const load_EV_EVSE_inventory>(input_path);
+
+    return loader;
+}
+
+
+std::shared_ptr<const load_EV_EVSE_inventory> factory_registry::get_inventory( const std::string& input_path )
+{
+    const std::string inventory_fingerprint = get_inventory_fingerprint(input_path);
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return get_inventory_locked(input_path, inventory_fingerprint);
+}
+
+
+std::shared_ptr<const factory_EV_charge_model> factory_registry::get_EV_charge_model_factory( const std::string& input_path,
+                                                                                              const EV_ramping_map& EV_ramping,
+                                                                                              const EV_EVSE_ramping_map& EV_EVSE_ramping,
+                                                                                              const bool model_stochastic_battery_degregation,
+                                                                                              const double c_rate_scale_factor )
+{
+    const std::string inventory_fingerprint = get_inventory_fingerprint(input_path);
+
+    std::ostringstream key;
+    key << inventory_fingerprint << "_" << get_ramping_fingerprint(EV_ramping, EV_EVSE_ramping)
+        << "_" << model_stochastic_battery_degregation << "_" << std::hexfloat << c_rate_scale_factor;
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    std::shared_ptr<const factory_EV_charge_model>& factory = EV_charge_model_factories[key.str()];
+
+    if(factory == nullptr)
+    {
+        std::shared_ptr<const load_EV_EVSE_inventory> loader = get_inventory_locked(input_path, inventory_fingerprint);
+
+        std::shared_ptr<EV_charge_model_factory_entry> entry(new EV_charge_model_factory_entry{ loader,
+            factory_EV_charge_model{ loader->get_EV_EVSE_inventory(), EV_ramping, EV_EVSE_ramping, model_stochastic_battery_degregation, c_rate_scale_factor } });
+
+        factory = std::shared_ptr<const factory_EV_charge_model>(entry, &entry->factory);
+    }
+
+    return factory;
+}
+
+
+std::shared_ptr<const factory_ac_to_dc_converter> factory_registry::get_ac_to_dc_converter_factory( const std::string& input_path )
+{
+    const std::string inventory_fingerprint = get_inventory_fingerprint(input_path);
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    std::shared_ptr<const factory_ac_to_dc_converter>& factory = ac_to_dc_converter_factories[inventory_fingerprint];
+
+    if(factory == nullptr)
+    {
+        std::shared_ptr<const load_EV_EVSE_inventory> loader = get_inventory_locked(input_path, inventory_fingerprint);
+
+        std::shared_ptr<ac_to_dc_converter_factory_entry> entry(new ac_to_dc_converter_factory_entry{ loader,
+            factory_ac_to_dc_converter{ loader->get_EV_EVSE_inventory() } });
+
+        factory = std::shared_ptr<const factory_ac_to_dc_converter>(entry, &entry->factory);
+    }
+
+    return factory;
+}
+
+
+std::shared_ptr<const pev_charge_profile_library> factory_registry::get_charge_profile_library( const std::string& input_path,
+                                                                                                const bool create_charge_profile_library,
+                                                                                                const bool lazy_charge_profile_library,
+                                                                                                const bool event_driven_charge_profile_library )
+{
+    const bool is_lazy = create_charge_profile_library && lazy_charge_profile_library;
+    const bool event_driven_integration = create_charge_profile_library && event_driven_charge_profile_library;
+
+    const std::string inventory_fingerprint = get_inventory_fingerprint(input_path);
+    const std::string integration_key = event_driven_integration ? "_event_driven" : "";
+    const std::string full_key = inventory_fingerprint + "_" + std::to_string(create_charge_profile_library) + integration_key;
+    const std::string key = is_lazy ? inventory_fingerprint + "_lazy" + integration_key : full_key;
+
+    // Only the entry of the library is made while holding the lock.  The first caller
+    // builds the library outside it and the others wait on the entry, also outside it.
+    std::promise<std::shared_ptr<const pev_charge_profile_library> > promise;
+    std::shared_future<std::shared_ptr<const pev_charge_profile_library> > library;
+    std::shared_ptr<const load_EV_EVSE_inventory> loader;
+    std::string cache_dir;
+
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+
+        typedef std::map<std::string, std::shared_future<std::shared_ptr<const pev_charge_profile_library> > >::const_iterator library_iterator;
+
+        if(is_lazy)
+        {
+            const library_iterator it = charge_profile_libraries.find(full_key);
+
+            if(it != charge_profile_libraries.end())
+                library = it->second;
+        }
+
+        if(!library.valid())
+        {
+            const library_iterator it = charge_profile_libraries.find(key);
+
+            if(it != charge_profile_libraries.end())
+                library = it->second;
+        }
+
+        if(!library.valid())
+        {
+            library = promise.get_future().share();
+            charge_profile_libraries[key] = library;
+
+            loader = get_inventory_locked(input_path, inventory_fingerprint);
+            cache_dir = charge_profile_library_cache_dir;
+        }
+    }
+
+    if(loader == nullptr)
+        return library.get();
+
+    try
+    {
+        std::shared_ptr<const pev_charge_profile_library> built_library = build_charge_profile_library(loader, full_key, cache_dir, create_charge_profile_library, is_lazy, event_driven_integration);
+        promise.set_value(built_library);
+        return built_library;
+    }
+    catch(...)
+    {
+        // The callers waiting on this build get the exception, later callers try again.
+        {
+            std::lock_guard<std::mutex> lock(registry_mutex);
+            charge_profile_libraries.erase(key);
+        }
+
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+}
+
+
+std::shared_ptr<const pev_charge_profile_library> factory_registry::build_charge_profile_library( const std::shared_ptr<const load_EV_EVSE_inventory>& loader,
+                                                                                                  const std::string& full_key,
+                                                                                                  const std::string& cache_dir,
+                                                                                                  const bool create_charge_profile_library,
+                                                                                                  const bool is_lazy,
+                                                                                                  const bool event_driven_integration )
+{
+    std::shared_ptr<charge_profile_library_entry> entry;
+
+    //-------------------------
+    //   Disk cache
+    //-------------------------
+
+    std::string cache_file;
+    std::string cache_key;
+    bool read_from_cache = false;
+
+    if(!cache_dir.empty())
+    {
+        cache_key = "build_version_" + std::to_string(charge_profile_library_build_version) + "_" + full_key;
+
+        std::ostringstream file_name;
+        file_name << "charge_profile_library_" << std::hex << std::setw(16) << std::setfill('0')
+                  << get_hash(cache_key.data(), cache_key.size(), 0) << ".bin";
+
+        cache_file = (std::filesystem::path(cache_dir) / file_name.str()).string();
+
+        pev_charge_profile_library cached_library{ loader->get_EV_EVSE_inventory() };
+        read_from_cache = read_charge_profile_library_cache(cache_file, cache_key, cached_library);
+
+        if(read_from_cache)
+            entry.reset(new charge_profile_library_entry{ loader, std::move(cached_library) });
+    }
+
+    if(!read_from_cache && is_lazy)
+    {
+        entry.reset(new charge_profile_library_entry{ loader,
+            factory_charge_profile_library::get_lazy_charge_profile_library(loader->get_EV_EVSE_inventory(), event_driven_integration) });
+    }
+    else if(!read_from_cache)
+    {
+        std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > validation_data;
+        const bool save_validation_data = false;
+
+        entry.reset(new charge_profile_library_entry{ loader,
+            factory_charge_profile_library::get_charge_profile_library(loader->get_EV_EVSE_inventory(), save_validation_data, create_charge_profile_library, validation_data, event_driven_integration) });
+
+        if(!cache_file.empty())
+            write_charge_profile_library_cache(cache_file, cache_key, entry->library);
+    }
+
+    return std::shared_ptr<const pev_charge_profile_library>(entry, &entry->library);
+}
+
+
+bool factory_registry::read_charge_profile_library_cache( const std::string& cache_file,
+                                                          const std::string& cache_key,
+                                                          pev_charge_profile_library& library )
+{
+    const read_only_file_view file_view(cache_file);
+
+    if(file_view.get_data() == nullptr)
+        return false;
+
+    memory_streambuf buffer(file_view.get_data(), file_view.get_size());
+    std::istream in(&buffer);
+
+    char magic[8];
+    uint32_t key_size = 0;
+
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&key_size), sizeof(key_size));
+
+    if(!in.good() || std::memcmp(magic, charge_profile_library_cache_magic, sizeof(magic)) != 0 || key_size != cache_key.size())
+        return false;
+
+    std::string key(key_size, ' ');
+    in.read(&key[0], key_size);
+
+    if(!in.good() || key != cache_key)
+        return false;
+
+    // The payload is checked against its size and hash before it is parsed, so a
+    // corrupt file is rebuilt rather than read.
+    uint64_t payload_size = 0;
+    uint64_t payload_hash = 0;
+
+    in.read(reinterpret_cast<char*>(&payload_size), sizeof(payload_size));
+    in.read(reinterpret_cast<char*>(&payload_hash), sizeof(payload_hash));
+
+    const size_t payload_offset = sizeof(magic) + sizeof(key_size) + key_size + sizeof(payload_size) + sizeof(payload_hash);
+
+    if(!in.good() || payload_size != file_view.get_size() - payload_offset)
+        return false;
+
+    if(get_hash(file_view.get_data() + payload_offset, payload_size, 0) != payload_hash)
+        return false;
+
+    return library.read_binary(in);
+}
+
+
+void factory_registry::write_charge_profile_library_cache( const std::string& cache_file,
+                                                           const std::string& cache_key,
+                                                           const pev_charge_profile_library& library )
+{
+    // Written to a temporary file and renamed, so other processes never map a partial file.
+    const std::string tmp_file = cache_file + ".tmp" + std::to_string(get_process_id()) + "_" + std::to_string(tmp_file_counter++);
+
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(cache_file).parent_path(), ec);
+
+    {
+        std::ofstream f(tmp_file, std::ios::out | std::ios::binary | std::ios::trunc);
+
+        if(!f.is_open())
+        {
+            std::cout << "WARNING: Could not write charge profile library cache " << cache_file << std::endl;
+            return;
+        }
+
+        std::ostringstream payload_stream(std::ios::out | std::ios::binary);
+        library.write_binary(payload_stream);
+        const std::string payload = payload_stream.str();
+
+        const uint32_t key_size = (uint32_t)cache_key.size();
+        const uint64_t payload_size = payload.size();
+        const uint64_t payload_hash = get_hash(payload.data(), payload.size(), 0);
+
+        f.write(charge_profile_library_cache_magic, sizeof(charge_profile_library_cache_magic));
+        f.write(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+        f.write(cache_key.data(), key_size);
+        f.write(reinterpret_cast<const char*>(&payload_size), sizeof(payload_size));
+        f.write(reinterpret_cast<const char*>(&payload_hash), sizeof(payload_hash));
+        f.write(payload.data(), payload.size());
+
+        if(!f.good())
+        {
+            f.close();
+            std::filesystem::remove(tmp_file, ec);
+            std::cout << "WARNING: Could not write charge profile library cache " << cache_file << std::endl;
+            return;
+        }
+    }
+
+    std::filesystem::rename(tmp_file, cache_file, ec);
+
+    if(ec)
+        std::filesystem::remove(tmp_file, ec);
+}
+
+
+void factory_registry::set_charge_profile_library_cache_dir( const std::string& cache_dir )
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    charge_profile_library_cache_dir = cache_dir;
+}
+
+
+void factory_registry::clear()
+{
+    std::lock_guard<std::mutex> lock(registry_mutex);
+
+    inventories.clear();
+    EV_charge_model_factories.clear();
+    ac_to_dc_converter_factories.clear();
+    charge_profile_libraries.clear();
+}
+
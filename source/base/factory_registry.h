@@ -0,0 +1,116 @@
+
+#ifndef inl_factory_registry_H
+#define inl_factory_registry_H
+
+#include "load_EV_EVSE_inventory.h"                 // load_EV_EVSE_inventory
+#include "factory_EV_charge_model.h"                // factory_EV_charge_model
+#include "factory_ac_to_dc_converter.h"             // factory_ac_to_dc_converter
+#include "factory_charging_transitions.h"           // EV_ramping_map, EV_EVSE_ramping_map
+#include "charge_profile_library.h"                 // pev_charge_profile_library
+
+#include <string>
+#include <map>
+#include <memory>                                   // shared_ptr
+#include <mutex>
+#include <future>                                   // shared_future
+#include <cstdint>                                  // uint64_t
+
+
+//#############################################################################
+//                             Factory Registry
+//#############################################################################
+
+// Process wide cache of the immutable objects built from an input folder.  Objects
+// are keyed by a fingerprint of the contents of EV_inputs.csv and EVSE_inputs.csv,
+// plus the ramping and c-rate inputs for the EV charge model factory, so a second
+// interface built from the same inputs shares the objects instead of rebuilding them.
+// Editing the input files changes the fingerprint and builds new objects.
+//
+// Charge profile libraries can also be cached on disk (see
+// set_charge_profile_library_cache_dir), so later processes skip the profile simulations.
+//
+// Every object keeps the inventory it was built from alive.  The registry holds on to
+// the objects until clear() is called; interfaces already holding them are unaffected.
+// All functions are thread safe.  Objects are built while holding the registry lock,
+// except charge profile libraries, which take long to build: the first caller builds
+// the library outside the lock, and other callers asking for the same library wait for
+// that build instead of starting their own.
+
+class factory_registry
+{
+private:
+    static std::mutex registry_mutex;
+
+    static std::map<std::string, std::shared_ptr<const load_EV_EVSE_inventory> > inventories;
+    static std::map<std::string, std::shared_ptr<const factory_EV_charge_model> > EV_charge_model_factories;
+    static std::map<std::string, std::shared_ptr<const factory_ac_to_dc_converter> > ac_to_dc_converter_factories;
+    static std::map<std::string, std::shared_future<std::shared_ptr<const pev_charge_profile_library> > > charge_profile_libraries;
+
+    static std::string charge_profile_library_cache_dir;
+
+    static uint64_t get_hash( const char* data, const size_t num_bytes, uint64_t hash );
+    static std::string get_file_fingerprint( const std::string& file );
+    static std::string get_ramping_fingerprint( const EV_ramping_map& EV_ramping,
+                                                const EV_EVSE_ramping_map& EV_EVSE_ramping );
+
+    static std::shared_ptr<const pev_charge_profile_library> build_charge_profile_library( const std::shared_ptr<const load_EV_EVSE_inventory>& loader,
+                                                                                           const std::string& full_key,
+                                                                                           const std::string& cache_dir,
+                                                                                           const bool create_charge_profile_library,
+                                                                                           const bool is_lazy,
+                                                                                           const bool event_driven_integration );
+
+    static bool read_charge_profile_library_cache( const std::string& cache_file,
+                                                   const std::string& cache_key,
+                                                   pev_charge_profile_library& library );
+    static void write_charge_profile_library_cache( const std::string& cache_file,
+                                                    const std::string& cache_key,
+                                                    const pev_charge_profile_library& library );
+
+    // Caller holds registry_mutex.
+    static std::shared_ptr<const load_EV_EVSE_inventory> get_inventory_locked( const std::string& input_path,
+                                                                               const std::string& inventory_fingerprint );
+
+public:
+    static std::string get_inventory_fingerprint( const std::string& input_path );
+
+    static std::shared_ptr<const load_EV_EVSE_inventory> get_inventory( const std::string& input_path );
+
+    static std::shared_ptr<const factory_EV_charge_model> get_EV_charge_model_factory( const std::string& input_path,
+                                                                                       const EV_ramping_map& EV_ramping,
+                                                                                       const EV_EVSE_ramping_map& EV_EVSE_ramping,
+                                                                                       const bool model_stochastic_battery_degregation,
+                                                                                       const double c_rate_scale_factor = 1.0 );
+
+    static std::shared_ptr<const factory_ac_to_dc_converter> get_ac_to_dc_converter_factory( const std::string& input_path );
+
+    // With lazy_charge_profile_library (and create_charge_profile_library) the library
+    // builds each profile the first time it is used, see
+    // factory_charge_profile_library::get_lazy_charge_profile_library.  A full library
+    // already in the registry or the disk cache is used instead.  Lazy libraries are not
+    // written to the disk cache.
+    //
+    // event_driven_charge_profile_library builds the profiles with event driven integration
+    // (see factory_charge_profile_library::get_charge_profile_library).  The lookups match
+    // the fixed step library only up to round off, so it is cached under its own key.
+    static std::shared_ptr<const pev_charge_profile_library> get_charge_profile_library( const std::string& input_path,
+                                                                                         const bool create_charge_profile_library,
+                                                                                         const bool lazy_charge_profile_library = false,
+                                                                                         const bool event_driven_charge_profile_library = false );
+
+    // Folder of the on-disk charge profile library cache, created if needed.  An empty
+    // string (the default) turns the disk cache off.  Cache files are named after a hash
+    // of the inventory fingerprint and the build parameters, and store the full key, so a
+    // changed input or a new charge_profile_library_build_version is never served from
+    // an old file.
+    static void set_charge_profile_library_cache_dir( const std::string& cache_dir );
+
+    // Bump when a change to the charge profile simulation changes the library contents.
+    static const int charge_profile_library_build_version = 2;
+
+    static void clear();
+};
+
+
+#endif
+
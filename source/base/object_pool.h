@@ -0,0 +1,121 @@
+
+#ifndef inl_object_pool_H
+#define inl_object_pool_H
+
+#include <vector>
+#include <atomic>
+#include <cstdint>          // int64_t
+#include <new>              // placement new
+#include <utility>          // forward
+
+
+//#############################################################################
+//                               Object Pool
+//#############################################################################
+
+// Free list of objects created with new that are handed out again instead of being
+// deleted.  acquire constructs the object in the storage of a released one (placement
+// new), so a charge event reuses the storage of an earlier one and does not go through
+// the global allocator.  Members of T that allocate on their own still do.
+//
+// There is one pool per type and thread, so acquire and release need no lock.  An
+// object can be released on a different thread than it was acquired on; it then goes
+// to the free list of the releasing thread.  A pool keeps at most max_free_objects,
+// the rest are deleted.
+//
+// Objects from acquire can also be deleted, and objects created with new can be
+// released.  Objects that may outlive the simulation threads (e.g. those deleted in a
+// destructor) should be deleted rather than released.
+//
+// The counters are process wide: num_allocated counts the objects created with new by
+// acquire, num_reused the ones constructed in released storage.  A simulation that
+// allocates nothing at steady state stops increasing num_allocated.
+
+template<typename T>
+class object_pool
+{
+private:
+    static const int max_free_objects = 4096;
+
+    static std::atomic<int64_t> num_allocated;
+    static std::atomic<int64_t> num_reused;
+
+    std::vector<T*> free_objects;
+
+    object_pool() {}
+
+    static object_pool& get_thread_pool()
+    {
+        thread_local object_pool pool;
+        return pool;
+    }
+
+public:
+    ~object_pool()
+    {
+        // The objects in the free list are already destroyed.
+        for(T* obj : this->free_objects)
+            ::operator delete(obj);
+    }
+
+    object_pool( const object_pool& ) = delete;
+    object_pool& operator=( const object_pool& ) = delete;
+
+    template<typename... Args>
+    static T* acquire( Args&&... args )
+    {
+        std::vector<T*>& free_objects = get_thread_pool().free_objects;
+
+        if(free_objects.empty())
+        {
+            num_allocated.fetch_add(1, std::memory_order_relaxed);
+            return new T(std::forward<Args>(args)...);
+        }
+
+        T* obj = free_objects.back();
+        free_objects.pop_back();
+
+        try
+        {
+            new (obj) T(std::forward<Args>(args)...);
+        }
+        catch(...)
+        {
+            ::operator delete(obj);
+            throw;
+        }
+
+        num_reused.fetch_add(1, std::memory_order_relaxed);
+        return obj;
+    }
+
+    static void release( T* obj )
+    {
+        if(obj == nullptr)
+            return;
+
+        std::vector<T*>& free_objects = get_thread_pool().free_objects;
+
+        if((int)free_objects.size() >= max_free_objects)
+        {
+            delete obj;
+            return;
+        }
+
+        obj->~T();
+        free_objects.push_back(obj);
+    }
+
+    static int64_t get_num_allocated() { return num_allocated.load(std::memory_order_relaxed); }
+    static int64_t get_num_reused() { return num_reused.load(std::memory_order_relaxed); }
+};
+
+template<typename T>
+std::atomic<int64_t> object_pool<T>::num_allocated{ 0 };
+
+template<typename T>
+std::atomic<int64_t> object_pool<T>::num_reused{ 0 };
+
+
+#endif
+
@@ -3,6 +3,8 @@
 #include "factory_EV_charge_model.h"            // factory_EV_charge_model
 #include "factory_supply_equipment_model.h"     // factory_supply_equipment_model
 
+#include <stdexcept>                            // invalid_argument
+
 
 supply_equipment::supply_equipment( const SE_configuration& SE_config,
                                     const supply_equipment_control& SE_control,
@@ -12,15 +14,30 @@ supply_equipment::supply_equipment( const SE_configuration& SE_config,
     SE_Load{ SE_Load }
 {
 }
+
+
+supply_equipment& supply_equipment::operator=( const supply_equipment& obj )
+{
+    this->SE_control = obj.SE_control;
+    this->SE_Load = obj.SE_Load;
+    
+    return *this;
+}
    
 
+void supply_equipment::set_manage_L2_control( manage_L2_control_strategy_parameters* manage_L2_control )
+{
+    this->SE_control.set_manage_L2_control(manage_L2_control);
+}
+    
+
 bool supply_equipment::is_SE_with_id( const SE_id_type SE_id )
 {
     return (this->SE_config.SE_id == SE_id);
 }
 
 
-SE_configuration supply_equipment::get_SE_configuration()
+SE_configuration supply_equipment::get_SE_configuration() const
 {
     return this->SE_config;
 }
@@ -155,6 +172,97 @@ void supply_equipment::stop_active_CE()
 }
 
 
+void supply_equipment::begin_trial_step( supply_equipment_step_state& state )
+{
+    this->SE_control.get_step_state(state.control);
+    this->SE_Load.begin_trial_step(state.load);
+}
+
+
+void supply_equipment::restore_trial_state( const supply_equipment_step_state& state )
+{
+    this->SE_control.set_step_state(state.control);
+    this->SE_Load.restore_trial_state();
+}
+
+
+void supply_equipment::end_trial_step()
+{
+    this->SE_Load.end_trial_step();
+}
+
+
+// Written in front of the step state, bumped when its binary form changes.
+static const uint32_t SE_step_state_format_version = 1;
+
+void supply_equipment::write_step_state( std::ostream& out ) const
+{
+    write_pod<uint32_t>(out, SE_step_state_format_version);
+    write_pod<int32_t>(out, this->SE_config.SE_id);
+    
+    this->SE_control.write_step_state(out);
+    this->SE_Load.write_step_state(out);
+}
+
+
+void supply_equipment::read_step_state( std::istream& in )
+{
+    const uint32_t format_version = read_pod<uint32_t>(in);
+    const int32_t SE_id = read_pod<int32_t>(in);
+    
+    if(!in.good() || format_version != SE_step_state_format_version || SE_id != this->SE_config.SE_id)
+        throw std::invalid_argument("CALDERA ERROR:  The step state read at SE " + std::to_string(this->SE_config.SE_id) + " is not a step state of this SE.");
+    
+    // Read into a copy, so this SE is left as it was on bad data.
+    supply_equipment X = *this;
+    X.SE_control.read_step_state(in);
+    X.SE_Load.read_step_state(in);
+    
+    if(!in.good())
+        throw std::invalid_argument("CALDERA ERROR:  The step state read at SE " + std::to_string(this->SE_config.SE_id) + " is truncated or corrupt.");
+    
+    *this = X;
+}
+
+
+bool supply_equipment::is_idle( double& next_arrival_unix_time ) const
+{
+    return this->SE_Load.is_idle(next_arrival_unix_time);
+}
+
+
+double supply_equipment::get_time_at_constant_power_sec() const
+{
+    return this->SE_Load.get_time_at_constant_power_sec();
+}
+
+
+void supply_equipment::get_power_sensitivity( const double pu_Vrms,
+                                              double& dP3_dpuVrms,
+                                              double& dQ3_dpuVrms )
+{
+    this->SE_Load.get_power_sensitivity(pu_Vrms, dP3_dpuVrms, dQ3_dpuVrms);
+}
+
+
+double supply_equipment::get_standby_acP_kW() const
+{
+    return this->SE_Load.get_standby_acP_kW();
+}
+
+
+double supply_equipment::get_standby_acQ_kVAR() const
+{
+    return this->SE_Load.get_standby_acQ_kVAR();
+}
+
+
+void supply_equipment::add_charge_event_queue_memory_usage( charge_event_queue_memory_usage& usage ) const
+{
+    this->SE_Load.add_charge_event_queue_memory_usage(usage);
+}
+
+
 void supply_equipment::get_external_control_strategy( std::string& return_val )
 {
     if( this->SE_Load.pev_is_connected_to_SE__ev_charge_model_not_NULL() )
@@ -14,6 +14,14 @@ class factory_EV_charge_model;
 class factory_ac_to_dc_converter;
 
 
+// The part of a supply_equipment that get_next changes.
+struct supply_equipment_step_state
+{
+    supply_equipment_control_step_state control;
+    supply_equipment_load_step_state load;
+};
+
+
 class supply_equipment
 {
 private:
@@ -28,9 +36,14 @@ public:
                       const supply_equipment_control& SE_control_,
                       const supply_equipment_load& SE_Load_ );
     
+    // Restores the control and load state from a copy of the same SE.
+    supply_equipment& operator=( const supply_equipment& obj );
+    
+    void set_manage_L2_control( manage_L2_control_strategy_parameters* manage_L2_control );
+    
     bool is_SE_with_id( const SE_id_type SE_id );
 
-    SE_configuration get_SE_configuration();
+    SE_configuration get_SE_configuration() const;
 
     SE_status get_SE_status();  // Used in SE_EV_factory.cpp line 1211
     
@@ -77,6 +90,34 @@ public:
     
     void stop_active_CE();
     
+    // Trial steps, see supply_equipment_load::begin_trial_step.  state must not move
+    // until end_trial_step.
+    void begin_trial_step( supply_equipment_step_state& state );
+    void restore_trial_state( const supply_equipment_step_state& state );
+    void end_trial_step();
+    
+    // Binary form of the step state, so a warm-up can be written to disk and branched
+    // from later.  read_step_state requires an SE built from the same inputs, factories
+    // and charge profile library, and no open trial step.  It throws invalid_argument
+    // for the state of another SE or bad data and then leaves the SE as it was.  The
+    // random number generators of manage_L2_control are not a part of the state.
+    void write_step_state( std::ostream& out ) const;
+    void read_step_state( std::istream& in );
+    
+    void get_power_sensitivity( const double pu_Vrms,
+                                double& dP3_dpuVrms,
+                                double& dQ3_dpuVrms );
+    
+    bool is_idle( double& next_arrival_unix_time ) const;
+    
+    double get_time_at_constant_power_sec() const;
+    
+    double get_standby_acP_kW() const;
+    
+    double get_standby_acQ_kVAR() const;
+    
+    void add_charge_event_queue_memory_usage( charge_event_queue_memory_usage& usage ) const;
+    
     //------------------------------------------
     
     bool current_CE_is_using_control_strategy( const double unix_time_of_interest,
@@ -2,7 +2,9 @@
 #include "supply_equipment_control.h"
 #include <cmath>                            // fmod,  (may need to include <math.h>
 #include <random>
+#include <set>                              // set
 #include <algorithm>                        // min, max
+#include <type_traits>                      // is_trivially_copyable
 
 
 
@@ -1089,6 +1091,186 @@ supply_equipment_control::supply_equipment_control( const bool building_charge_p
 }
 
 
+supply_equipment_control& supply_equipment_control::operator=( const supply_equipment_control& obj )
+{
+    this->ES100A_obj = obj.ES100A_obj;
+    this->ES100B_obj = obj.ES100B_obj;
+    this->ES110_obj = obj.ES110_obj;
+    this->ES200_obj = obj.ES200_obj;
+    this->ES300_obj = obj.ES300_obj;
+    this->ES400_obj = obj.ES400_obj;
+    this->ES500_obj = obj.ES500_obj;
+    
+    this->VS100_obj = obj.VS100_obj;
+    this->VS200A_obj = obj.VS200A_obj;
+    this->VS200B_obj = obj.VS200B_obj;
+    this->VS200C_obj = obj.VS200C_obj;
+    this->VS300_obj = obj.VS300_obj;
+    
+    this->L2_control_enums = obj.L2_control_enums;
+    this->P3kW_limits = obj.P3kW_limits;
+    this->charge_status = obj.charge_status;
+    
+    this->prev_pu_Vrms = obj.prev_pu_Vrms;
+    this->target_P3kW = obj.target_P3kW;
+    this->must_charge_for_remainder_of_park = obj.must_charge_for_remainder_of_park;
+    
+    this->manage_L2_control = obj.manage_L2_control;
+    this->LPF = obj.LPF;
+    this->building_charge_profile_library = obj.building_charge_profile_library;
+    this->ensure_pev_charge_needs_met_for_ext_control_strategy = obj.ensure_pev_charge_needs_met_for_ext_control_strategy;
+    
+    return *this;
+}
+
+
+void supply_equipment_control::get_step_state( supply_equipment_control_step_state& state ) const
+{
+    state.ES100A_obj = this->ES100A_obj;
+    state.ES100B_obj = this->ES100B_obj;
+    state.ES110_obj = this->ES110_obj;
+    state.ES200_obj = this->ES200_obj;
+    state.ES300_obj = this->ES300_obj;
+    state.ES400_obj = this->ES400_obj;
+    state.ES500_obj = this->ES500_obj;
+    
+    state.VS100_obj = this->VS100_obj;
+    state.VS200A_obj = this->VS200A_obj;
+    state.VS200B_obj = this->VS200B_obj;
+    state.VS200C_obj = this->VS200C_obj;
+    state.VS300_obj = this->VS300_obj;
+    
+    state.L2_control_enums = this->L2_control_enums;
+    state.P3kW_limits = this->P3kW_limits;
+    state.charge_status = this->charge_status;
+    
+    state.prev_pu_Vrms = this->prev_pu_Vrms;
+    state.target_P3kW = this->target_P3kW;
+    state.must_charge_for_remainder_of_park = this->must_charge_for_remainder_of_park;
+    
+    state.LPF = this->LPF;
+}
+
+
+void supply_equipment_control::set_step_state( const supply_equipment_control_step_state& state )
+{
+    this->ES100A_obj = state.ES100A_obj;
+    this->ES100B_obj = state.ES100B_obj;
+    this->ES110_obj = state.ES110_obj;
+    this->ES200_obj = state.ES200_obj;
+    this->ES300_obj = state.ES300_obj;
+    this->ES400_obj = state.ES400_obj;
+    this->ES500_obj = state.ES500_obj;
+    
+    this->VS100_obj = state.VS100_obj;
+    this->VS200A_obj = state.VS200A_obj;
+    this->VS200B_obj = state.VS200B_obj;
+    this->VS200C_obj = state.VS200C_obj;
+    this->VS300_obj = state.VS300_obj;
+    
+    this->L2_control_enums = state.L2_control_enums;
+    this->P3kW_limits = state.P3kW_limits;
+    this->charge_status = state.charge_status;
+    
+    this->prev_pu_Vrms = state.prev_pu_Vrms;
+    this->target_P3kW = state.target_P3kW;
+    this->must_charge_for_remainder_of_park = state.must_charge_for_remainder_of_park;
+    
+    this->LPF = state.LPF;
+}
+
+
+void supply_equipment_control::write_step_state( std::ostream& out ) const
+{
+    static_assert(std::is_trivially_copyable<ES100_control_strategy>::value && std::is_trivially_copyable<ES110_control_strategy>::value &&
+                  std::is_trivially_copyable<ES200_control_strategy>::value && std::is_trivially_copyable<ES300_control_strategy>::value &&
+                  std::is_trivially_copyable<ES400_control_strategy>::value && std::is_trivially_copyable<ES500_control_strategy>::value &&
+                  std::is_trivially_copyable<VS100_control_strategy>::value && std::is_trivially_copyable<VS200_control_strategy>::value &&
+                  std::is_trivially_copyable<VS300_control_strategy>::value, "The control strategies are written as they are in memory.");
+    
+    write_pod<ES100_control_strategy>(out, this->ES100A_obj);
+    write_pod<ES100_control_strategy>(out, this->ES100B_obj);
+    write_pod<ES110_control_strategy>(out, this->ES110_obj);
+    write_pod<ES200_control_strategy>(out, this->ES200_obj);
+    write_pod<ES300_control_strategy>(out, this->ES300_obj);
+    write_pod<ES400_control_strategy>(out, this->ES400_obj);
+    write_pod<ES500_control_strategy>(out, this->ES500_obj);
+    
+    write_pod<VS100_control_strategy>(out, this->VS100_obj);
+    write_pod<VS200_control_strategy>(out, this->VS200A_obj);
+    write_pod<VS200_control_strategy>(out, this->VS200B_obj);
+    write_pod<VS200_control_strategy>(out, this->VS200C_obj);
+    write_pod<VS300_control_strategy>(out, this->VS300_obj);
+    
+    this->L2_control_enums.write_binary(out);
+    write_pod<charge_event_P3kW_limits>(out, this->P3kW_limits);
+    this->charge_status.write_binary(out);
+    
+    write_pod<double>(out, this->prev_pu_Vrms);
+    write_pod<double>(out, this->target_P3kW);
+    write_pod<bool>(out, this->must_charge_for_remainder_of_park);
+    
+    this->LPF.write_binary(out);
+}
+
+
+void supply_equipment_control::read_step_state( std::istream& in )
+{
+    supply_equipment_control_step_state state;
+    this->get_step_state(state);
+    
+    state.ES100A_obj = read_pod<ES100_control_strategy>(in);
+    state.ES100B_obj = read_pod<ES100_control_strategy>(in);
+    state.ES110_obj = read_pod<ES110_control_strategy>(in);
+    state.ES200_obj = read_pod<ES200_control_strategy>(in);
+    state.ES300_obj = read_pod<ES300_control_strategy>(in);
+    state.ES400_obj = read_pod<ES400_control_strategy>(in);
+    state.ES500_obj = read_pod<ES500_control_strategy>(in);
+    
+    state.VS100_obj = read_pod<VS100_control_strategy>(in);
+    state.VS200A_obj = read_pod<VS200_control_strategy>(in);
+    state.VS200B_obj = read_pod<VS200_control_strategy>(in);
+    state.VS200C_obj = read_pod<VS200_control_strategy>(in);
+    state.VS300_obj = read_pod<VS300_control_strategy>(in);
+    
+    state.L2_control_enums = control_strategy_enums::read_binary(in);
+    state.P3kW_limits = read_pod<charge_event_P3kW_limits>(in);
+    state.charge_status = CE_status::read_binary(in);
+    
+    state.prev_pu_Vrms = read_pod<double>(in);
+    state.target_P3kW = read_pod<double>(in);
+    state.must_charge_for_remainder_of_park = read_pod<bool>(in);
+    
+    state.LPF.read_binary(in);
+    
+    if(!in.good())
+        return;
+    
+    this->set_step_state(state);
+    this->set_manage_L2_control(this->manage_L2_control);
+}
+
+
+void supply_equipment_control::set_manage_L2_control( manage_L2_control_strategy_parameters* manage_L2_control_ )
+{
+    this->manage_L2_control = manage_L2_control_;
+    
+    this->ES100A_obj.set_params(manage_L2_control_);
+    this->ES100B_obj.set_params(manage_L2_control_);
+    this->ES110_obj.set_params(manage_L2_control_);
+    this->ES200_obj.set_params(manage_L2_control_);
+    this->ES300_obj.set_params(manage_L2_control_);
+    this->ES400_obj.set_params(manage_L2_control_);
+    this->ES500_obj.set_params(manage_L2_control_);
+    
+    this->VS100_obj.set_params(manage_L2_control_);
+    this->VS200A_obj.set_params(manage_L2_control_);
+    this->VS200B_obj.set_params(manage_L2_control_);
+    this->VS200C_obj.set_params(manage_L2_control_);
+    this->VS300_obj.set_params(manage_L2_control_);
+}
+
+
 control_strategy_enums supply_equipment_control::get_control_strategy_enums()
 {
     return this->L2_control_enums;
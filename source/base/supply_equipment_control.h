@@ -110,6 +110,7 @@ private:
 public:
     ES100_control_strategy(){};
     ES100_control_strategy(L2_control_strategies_enum L2_CS_enum_, manage_L2_control_strategy_parameters* params_);
+    void set_params(manage_L2_control_strategy_parameters* params_) { this->params = params_; }
     void update_parameters_for_CE(double target_P3kW_, const CE_status& charge_status, const pev_charge_profile& charge_profile);
     double get_P3kW_setpoint(double prev_unix_time, double now_unix_time);
 };
@@ -128,6 +129,7 @@ private:
 public:
     ES110_control_strategy(){};
     ES110_control_strategy(manage_L2_control_strategy_parameters* params_);
+    void set_params(manage_L2_control_strategy_parameters* params_) { this->params = params_; }
     void update_parameters_for_CE(double target_P3kW_, const CE_status& charge_status, const pev_charge_profile& charge_profile);
     double get_P3kW_setpoint(double prev_unix_time, double now_unix_time);
 };
@@ -147,6 +149,7 @@ public:
     
     ES200_control_strategy(){};
     ES200_control_strategy( manage_L2_control_strategy_parameters* params_ );
+    void set_params(manage_L2_control_strategy_parameters* params_) { this->params = params_; }
     
     // Called when new a new CE starts on a supply equipment and the new CE has the ES200 control.
     // Paramters:
@@ -177,6 +180,7 @@ private:
 public:
     ES300_control_strategy(){};
     ES300_control_strategy(manage_L2_control_strategy_parameters* params_);
+    void set_params(manage_L2_control_strategy_parameters* params_) { this->params = params_; }
     void update_parameters_for_CE(double target_P3kW_);
     double get_P3kW_setpoint(double prev_unix_time, double now_unix_time);
 };
@@ -199,6 +203,7 @@ private:
 public:
     ES400_control_strategy() {};
     ES400_control_strategy(manage_L2_control_strategy_parameters* params_);
+    void set_params(manage_L2_control_strategy_parameters* params_) { this->params = params_; }
     void update_parameters_for_CE(double target_P3kW_);
     void get_charging_needs(
         double unix_time_now,
@@ -223,6 +228,7 @@ private:
 public:
     ES500_control_strategy(){};
     ES500_control_strategy(manage_L2_control_strategy_parameters* params_);
+    void set_params(manage_L2_control_strategy_parameters* params_) { this->params = params_; }
     void update_parameters_for_CE(double target_P3kW_);
     double get_P3kW_setpoint(double prev_unix_time, double now_unix_time);
     
@@ -247,6 +253,7 @@ private:
 public:
     VS100_control_strategy(){};
     VS100_control_strategy(manage_L2_control_strategy_parameters* params_);
+    void set_params(manage_L2_control_strategy_parameters* params_) { this->params = params_; }
     void update_parameters_for_CE(double max_nominal_S3kVA_);
     double get_P3kW_setpoint(double prev_unix_time, double now_unix_time, double pu_Vrms, double pu_Vrms_SS, double target_P3kW);
 };
@@ -267,6 +274,7 @@ private:
 public:
     VS200_control_strategy(){};
     VS200_control_strategy(L2_control_strategies_enum L2_CS_enum_, manage_L2_control_strategy_parameters* params_);
+    void set_params(manage_L2_control_strategy_parameters* params_) { this->params = params_; }
     void update_parameters_for_CE(double max_nominal_S3kVA_);
     double get_Q3kVAR_setpoint(double prev_unix_time, double now_unix_time, double pu_Vrms, double pu_Vrms_SS, double target_P3kW);
 };
@@ -286,6 +294,7 @@ private:
 public:
     VS300_control_strategy(){};
     VS300_control_strategy(manage_L2_control_strategy_parameters* params_);
+    void set_params(manage_L2_control_strategy_parameters* params_) { this->params = params_; }
     void update_parameters_for_CE(double max_nominal_S3kVA_);
     double get_Q3kVAR_setpoint(double pu_Vrms, double pu_Vrms_SS, double target_P3kW);
 };
@@ -304,6 +313,36 @@ void enforce_ramping(double prev_unix_time, double now_unix_time, double max_del
 //       supply_equipment_control
 //=========================================
 
+// The part of a supply_equipment_control that changes while stepping, saved and
+// restored around trial steps.
+struct supply_equipment_control_step_state
+{
+    ES100_control_strategy ES100A_obj;
+    ES100_control_strategy ES100B_obj;
+    ES110_control_strategy ES110_obj;
+    ES200_control_strategy ES200_obj;
+    ES300_control_strategy ES300_obj;
+    ES400_control_strategy ES400_obj;
+    ES500_control_strategy ES500_obj;
+    
+    VS100_control_strategy VS100_obj;
+    VS200_control_strategy VS200A_obj;
+    VS200_control_strategy VS200B_obj;
+    VS200_control_strategy VS200C_obj;
+    VS300_control_strategy VS300_obj;
+    
+    control_strategy_enums L2_control_enums;
+    charge_event_P3kW_limits P3kW_limits;
+    CE_status charge_status;
+    
+    double prev_pu_Vrms;
+    double target_P3kW;
+    bool must_charge_for_remainder_of_park;
+    
+    LPF_kernel LPF;
+};
+
+
 // Each supply_equipment has its own supply_equipment_control object.
 // NOTE: This class is not currently well written in terms of memory usage
 //       since we have every control_strategy object available in this class.
@@ -367,6 +406,24 @@ public:
                               const get_base_load_forecast& baseLD_forecaster_,
                               manage_L2_control_strategy_parameters* manage_L2_control_ );
     
+    // Copies the control state.  SE_config and baseLD_forecaster are not copied, so obj
+    // must be a copy of the same SE.
+    supply_equipment_control& operator=( const supply_equipment_control& obj );
+    
+    // Points the control strategies at another manage_L2_control, used when an SE is
+    // copied into a different interface.
+    void set_manage_L2_control( manage_L2_control_strategy_parameters* manage_L2_control_ );
+    
+    void get_step_state( supply_equipment_control_step_state& state ) const;
+    void set_step_state( const supply_equipment_control_step_state& state );
+    
+    // Binary form of the step state.  The control strategies are written as they are in
+    // memory and pointed at this->manage_L2_control again after they are read, whose
+    // random number generators are not a part of the state.  read_step_state leaves
+    // 'in' failed on bad data.
+    void write_step_state( std::ostream& out ) const;
+    void read_step_state( std::istream& in );
+    
     control_strategy_enums get_control_strategy_enums();
     std::string get_external_control_strategy();
     L2_control_strategies_enum  get_L2_ES_control_strategy();
@@ -5,6 +5,8 @@
 #include <cmath>
 #include <algorithm>                // sort
 #include <sstream>
+#include <limits>                   // numeric_limits
+#include <stdexcept>                // invalid_argument
 
 #include "factory_EV_charge_model.h"
 #include "factory_ac_to_dc_converter.h"
@@ -14,9 +16,12 @@
 //#############################################################################
 
 
-charge_event_handler::charge_event_handler( const charge_event_queuing_inputs& CE_queuing_inputs_)
+charge_event_handler::charge_event_handler( const charge_event_queuing_inputs& CE_queuing_inputs_, const EV_EVSE_inventory& inventory_ )
 {
+    this->first_charge_event_index = 0;
     this->CE_queuing_inputs = CE_queuing_inputs_;
+    this->inventory = &inventory_;
+    this->trial_step_is_open = false;
 }
 
 
@@ -26,46 +31,166 @@ inline double overlap(double start_A, double end_A, double start_B, double end_B
 }
 
 
+inline bool arrives_before(const packed_charge_event& CE, const double arrival_unix_time)
+{
+    return CE.arrival_unix_time < arrival_unix_time;
+}
+
+
+inline bool arrives_after(const double arrival_unix_time, const packed_charge_event& CE)
+{
+    return arrival_unix_time < CE.arrival_unix_time;
+}
+
+
+uint16_t charge_event_handler::get_string_index( const std::string& str )
+{
+    // Only a handful of external strategies are used at one SE.
+    for(int i = 0; i < (int)this->string_table.size(); i++)
+    {
+        if(this->string_table[i] == str)
+            return (uint16_t)i;
+    }
+    
+    ASSERT(this->string_table.size() < std::numeric_limits<uint16_t>::max(), "Error: more than " << std::numeric_limits<uint16_t>::max() << " different ext_control_strategy values queued at SE.");
+    
+    this->string_table.push_back(str);
+    return (uint16_t)(this->string_table.size() - 1);
+}
+
+
+packed_charge_event charge_event_handler::pack_charge_event( const charge_event_data& CE )
+{
+    packed_charge_event x;
+    x.arrival_unix_time = CE.arrival_unix_time;
+    x.departure_unix_time = CE.departure_unix_time;
+    x.arrival_SOC = CE.arrival_SOC;
+    x.departure_SOC = CE.departure_SOC;
+    x.arrival_battery_temperature_C = CE.arrival_battery_temperature_C;
+    x.soc_block_charging_max_undershoot_percent = CE.stop_charge.soc_block_charging_max_undershoot_percent;
+    x.depart_time_block_charging_max_undershoot_percent = CE.stop_charge.depart_time_block_charging_max_undershoot_percent;
+    
+    x.charge_event_id = CE.charge_event_id;
+    x.SE_group_id = CE.SE_group_id;
+    x.SE_id = CE.SE_id;
+    x.vehicle_id = CE.vehicle_id;
+    
+    // Thrown before anything is queued, so the caller can skip or report the event.
+    const EV_type_id vehicle_type_id = this->inventory->get_EV_type_id(CE.vehicle_type);
+    if(vehicle_type_id < 0 || vehicle_type_id > std::numeric_limits<uint16_t>::max())
+    {
+        throw std::invalid_argument("CALDERA ERROR:  EV_type:" + CE.vehicle_type + " of charge event " + std::to_string(CE.charge_event_id) + " is not in the EV_EVSE_inventory.");
+    }
+    
+    x.vehicle_type_id = (uint16_t)vehicle_type_id;
+    x.ext_control_strategy_index = this->get_string_index(CE.control_enums.ext_control_strategy);
+    x.decision_metric = (uint8_t)CE.stop_charge.decision_metric;
+    x.soc_mode = (uint8_t)CE.stop_charge.soc_mode;
+    x.depart_time_mode = (uint8_t)CE.stop_charge.depart_time_mode;
+    x.ES_control_strategy = (uint8_t)CE.control_enums.ES_control_strategy;
+    x.VS_control_strategy = (uint8_t)CE.control_enums.VS_control_strategy;
+    x.inverter_model_supports_Qsetpoint = CE.control_enums.inverter_model_supports_Qsetpoint;
+    
+    return x;
+}
+
+
+charge_event_data charge_event_handler::unpack_charge_event( const packed_charge_event& CE ) const
+{
+    charge_event_data x;
+    x.charge_event_id = CE.charge_event_id;
+    x.SE_group_id = CE.SE_group_id;
+    x.SE_id = CE.SE_id;
+    x.vehicle_id = CE.vehicle_id;
+    x.vehicle_type = this->inventory->get_EV_type(CE.vehicle_type_id);
+    x.arrival_unix_time = CE.arrival_unix_time;
+    x.departure_unix_time = CE.departure_unix_time;
+    x.arrival_SOC = CE.arrival_SOC;
+    x.departure_SOC = CE.departure_SOC;
+    x.arrival_battery_temperature_C = CE.arrival_battery_temperature_C;
+    
+    x.stop_charge.decision_metric = (stop_charging_decision_metric)CE.decision_metric;
+    x.stop_charge.soc_mode = (stop_charging_mode)CE.soc_mode;
+    x.stop_charge.depart_time_mode = (stop_charging_mode)CE.depart_time_mode;
+    x.stop_charge.soc_block_charging_max_undershoot_percent = CE.soc_block_charging_max_undershoot_percent;
+    x.stop_charge.depart_time_block_charging_max_undershoot_percent = CE.depart_time_block_charging_max_undershoot_percent;
+    
+    x.control_enums.inverter_model_supports_Qsetpoint = CE.inverter_model_supports_Qsetpoint;
+    x.control_enums.ES_control_strategy = (L2_control_strategies_enum)CE.ES_control_strategy;
+    x.control_enums.VS_control_strategy = (L2_control_strategies_enum)CE.VS_control_strategy;
+    x.control_enums.ext_control_strategy = this->string_table[CE.ext_control_strategy_index];
+    
+    return x;
+}
+
+
+std::vector<packed_charge_event>::iterator charge_event_handler::find_charge_event( const double arrival_unix_time )
+{
+    // Returns end() if no queued charge event arrives at exactly arrival_unix_time.
+    std::vector<packed_charge_event>::iterator it = std::lower_bound(this->charge_events.begin() + this->first_charge_event_index, this->charge_events.end(), arrival_unix_time, arrives_before);
+    
+    if(it != this->charge_events.end() && it->arrival_unix_time == arrival_unix_time)
+        return it;
+    
+    return this->charge_events.end();
+}
+
+
+void charge_event_handler::compact_charge_events()
+{
+    // Drop the events that have been taken once they are at least half of the vector.
+    if(this->trial_step_is_open || 2*this->first_charge_event_index < (int)this->charge_events.size())
+        return;
+    
+    this->charge_events.erase(this->charge_events.begin(), this->charge_events.begin() + this->first_charge_event_index);
+    this->first_charge_event_index = 0;
+}
+
+
 void charge_event_handler::add_charge_event( const charge_event_data& CE )
 {
-    // Make a copy so we can edit it a little bit if needed before saving it.
-    charge_event_data mutable_CE = CE;
+    // Pack a copy so we can edit it a little bit if needed before saving it.
+    packed_charge_event mutable_CE = this->pack_charge_event(CE);
     
     double max_allowed_overlap_time_sec = this->CE_queuing_inputs.max_allowed_overlap_time_sec;
     queuing_mode_enum queuing_mode = this->CE_queuing_inputs.queuing_mode;
     
     if(queuing_mode == queuing_mode_enum::overlapLimited_mostRecentlyQueuedHasPriority)
     {
-        std::set<charge_event_data>::iterator it_lb = this->charge_events.upper_bound(mutable_CE);
-        if(it_lb != this->charge_events.begin())
+        std::vector<packed_charge_event>::iterator it_begin = this->charge_events.begin() + this->first_charge_event_index;
+        std::vector<packed_charge_event>::iterator it_lb = std::upper_bound(it_begin, this->charge_events.end(), mutable_CE.arrival_unix_time, arrives_after);
+        if(it_lb != it_begin)
             it_lb--;
-
-        std::vector<std::set<charge_event_data>::iterator> its_to_remove;
+        
+        // Keep the events that do not overlap too much, shifting them over the removed ones.
+        std::vector<packed_charge_event>::iterator it_keep = it_lb;
+        std::vector<packed_charge_event>::iterator it = it_lb;
         double overlap_time_sec;
-
-        for(std::set<charge_event_data>::iterator it = it_lb; it != this->charge_events.end(); it++)
+        
+        for(; it != this->charge_events.end(); it++)
         {
             overlap_time_sec = overlap(it->arrival_unix_time, it->departure_unix_time, mutable_CE.arrival_unix_time, mutable_CE.departure_unix_time);
             
-            if(overlap_time_sec > max_allowed_overlap_time_sec)  
-                its_to_remove.push_back(it);
-            
+            if(overlap_time_sec > max_allowed_overlap_time_sec)
+            {
+                std::string str = "Warning : Charge Event removed due to overlap.  charge_event_id: " + std::to_string(it->charge_event_id);
+                std::cout << str << std::endl;
+                continue;
+            }
             else if(it->arrival_unix_time > mutable_CE.departure_unix_time)
                 break;
+            
+            *it_keep++ = *it;
         }
-
-        for(std::set<charge_event_data>::iterator it : its_to_remove)
-        {
-            this->charge_events.erase(it);
-            std::string str = "Warning : Charge Event removed due to overlap.  charge_event_id: " + std::to_string(it->charge_event_id);
-            std::cout << str << std::endl;
-        }
+        
+        if(it_keep != it)
+            this->charge_events.erase(std::copy(it, this->charge_events.end(), it_keep), this->charge_events.end());
     }
     else if(queuing_mode == queuing_mode_enum::overlapAllowed_earlierArrivalTimeHasPriority)
     {
         while(true)
         {
-            if(this->charge_events.count(mutable_CE) == 0)
+            if(this->find_charge_event(mutable_CE.arrival_unix_time) == this->charge_events.end())
             {
                 break;
             }
@@ -75,8 +200,14 @@ void charge_event_handler::add_charge_event( const charge_event_data& CE )
             }
         }
     }
-
-    this->charge_events.insert(mutable_CE);
+    
+    // Like a std::set keyed on arrival time, an event arriving at the same time as a queued one is not added.
+    std::vector<packed_charge_event>::iterator it_insert = std::lower_bound(this->charge_events.begin() + this->first_charge_event_index, this->charge_events.end(), mutable_CE.arrival_unix_time, arrives_before);
+    
+    if(it_insert != this->charge_events.end() && it_insert->arrival_unix_time == mutable_CE.arrival_unix_time)
+        return;
+    
+    this->charge_events.insert(it_insert, mutable_CE);
 }
 
 
@@ -86,41 +217,32 @@ void charge_event_handler::remove_charge_events_that_are_ending_soon( const doub
     // Delete charge_events if there is less than 'time_limit_seconds' seconds to charge
     //----------------------------------------------------------------------------------
     
-    std::vector<std::set<charge_event_data>::iterator> its_to_remove;
-    
-    for( std::set<charge_event_data>::iterator it = this->charge_events.begin(); it != this->charge_events.end(); it++ )
+    while(this->first_charge_event_index < (int)this->charge_events.size())
     {
-        if(it->departure_unix_time - now_unix_time < time_limit_seconds)
-        {
-            its_to_remove.push_back(it);
-        }
-        else
-        {
+        const packed_charge_event& CE = this->charge_events[this->first_charge_event_index];
+        
+        if(CE.departure_unix_time - now_unix_time >= time_limit_seconds)
             break;
-        }
-    }
-    
-    for(std::set<charge_event_data>::iterator it : its_to_remove)
-    {
+        
         std::stringstream str_ss;
-        str_ss << "Notice : Charge Event removed (a.k.a. concluded early) since *remaining* charge time less than " << time_limit_seconds << " sec.  charge_event_id: " << std::to_string(it->charge_event_id);
-        // Erasing the item after we create the Warning string so that the iterator is still valid.
-        this->charge_events.erase(it);
+        str_ss << "Notice : Charge Event removed (a.k.a. concluded early) since *remaining* charge time less than " << time_limit_seconds << " sec.  charge_event_id: " << std::to_string(CE.charge_event_id);
         std::cout << str_ss.str() << std::endl;
+        
+        this->first_charge_event_index++;
     }
+    
+    this->compact_charge_events();
 }
 
 
 bool charge_event_handler::charge_event_is_available( const double now_unix_time ) const
 {
-    if(this->charge_events.size() == 0)
+    if(this->first_charge_event_index == (int)this->charge_events.size())
     {
         return false;
     }
     
-    std::set<charge_event_data>::iterator it = this->charge_events.begin();
-    
-    if (it->arrival_unix_time - now_unix_time <= 0)
+    if (this->charge_events[this->first_charge_event_index].arrival_unix_time - now_unix_time <= 0)
     {
         return true;
     }
@@ -131,16 +253,123 @@ bool charge_event_handler::charge_event_is_available( const double now_unix_time
 }
 
 
-charge_event_data charge_event_handler::get_next_charge_event( const double now_unix_time )
+charge_event_data charge_event_handler::get_next_charge_event( const double now_unix_time, EV_type_id& vehicle_type_id )
 {
-    std::set<charge_event_data>::iterator it = this->charge_events.begin();
-    charge_event_data x = *it;
-    this->charge_events.erase(it);
+    vehicle_type_id = this->charge_events[this->first_charge_event_index].vehicle_type_id;
+    charge_event_data x = this->unpack_charge_event(this->charge_events[this->first_charge_event_index]);
+    this->first_charge_event_index++;
+    this->compact_charge_events();
     
     return x;
 }
 
 
+double charge_event_handler::get_next_arrival_unix_time() const
+{
+    if(this->first_charge_event_index == (int)this->charge_events.size())
+    {
+        return std::numeric_limits<double>::max();
+    }
+    
+    return this->charge_events[this->first_charge_event_index].arrival_unix_time;
+}
+
+
+void charge_event_handler::add_charge_event_queue_memory_usage( charge_event_queue_memory_usage& usage ) const
+{
+    const double bytes_per_MB = 1024.0*1024.0;
+    
+    // Capacity of a std::string that does not need a heap allocation (libstdc++).
+    const size_t small_string_capacity = 15;
+    
+    // A std::set node holds the color and three pointers in front of the value.
+    const size_t set_node_overhead_bytes = 4*sizeof(void*);
+    
+    size_t packed_bytes = this->charge_events.capacity()*sizeof(packed_charge_event);
+    for(const std::string& str : this->string_table)
+        packed_bytes += sizeof(std::string) + (str.size() > small_string_capacity ? str.capacity() + 1 : 0);
+    
+    size_t unpacked_bytes = 0;
+    for(int i = this->first_charge_event_index; i < (int)this->charge_events.size(); i++)
+    {
+        const packed_charge_event& CE = this->charge_events[i];
+        const size_t vehicle_type_size = this->inventory->get_EV_type(CE.vehicle_type_id).size();
+        const size_t ext_control_strategy_size = this->string_table[CE.ext_control_strategy_index].size();
+        
+        unpacked_bytes += sizeof(charge_event_data) + set_node_overhead_bytes;
+        unpacked_bytes += (vehicle_type_size > small_string_capacity) ? vehicle_type_size + 1 : 0;
+        unpacked_bytes += (ext_control_strategy_size > small_string_capacity) ? ext_control_strategy_size + 1 : 0;
+    }
+    
+    usage.num_queued_charge_events += (int)this->charge_events.size() - this->first_charge_event_index;
+    usage.packed_MB += packed_bytes / bytes_per_MB;
+    usage.unpacked_MB += unpacked_bytes / bytes_per_MB;
+}
+
+
+void charge_event_handler::set_trial_step_is_open( const bool trial_step_is_open_ )
+{
+    this->trial_step_is_open = trial_step_is_open_;
+    this->compact_charge_events();
+}
+
+
+int charge_event_handler::get_first_charge_event_index() const
+{
+    return this->first_charge_event_index;
+}
+
+
+void charge_event_handler::set_first_charge_event_index( const int first_charge_event_index_ )
+{
+    this->first_charge_event_index = first_charge_event_index_;
+}
+
+
+void charge_event_handler::write_binary( std::ostream& out ) const
+{
+    write_pod<uint64_t>(out, (uint64_t)this->string_table.size());
+    for(const std::string& str : this->string_table)
+        write_string(out, str);
+    
+    // The events already taken are not a part of the state.
+    const std::vector<packed_charge_event> queued_events(this->charge_events.begin() + this->first_charge_event_index, this->charge_events.end());
+    write_pod_vector<packed_charge_event>(out, queued_events);
+}
+
+
+void charge_event_handler::read_binary( std::istream& in )
+{
+    const uint64_t num_strings = read_pod<uint64_t>(in);
+    std::vector<std::string> string_table_;
+    
+    if(in.good() && has_remaining_bytes(in, num_strings, sizeof(uint32_t)))
+    {
+        for(uint64_t i = 0; i < num_strings; i++)
+            string_table_.push_back(read_string(in));
+    }
+    
+    std::vector<packed_charge_event> charge_events_ = read_pod_vector<packed_charge_event>(in);
+    
+    if(!in.good())
+        return;
+    
+    const int num_EV_types = this->inventory->get_num_EV_types();
+    for(const packed_charge_event& CE : charge_events_)
+    {
+        if(CE.vehicle_type_id >= num_EV_types || CE.ext_control_strategy_index >= string_table_.size())
+        {
+            in.setstate(std::ios::failbit);
+            return;
+        }
+    }
+    
+    this->string_table = std::move(string_table_);
+    this->charge_events = std::move(charge_events_);
+    this->first_charge_event_index = 0;
+}
+
+
 //#############################################################################
 //                           Supply Equipment 
 //#############################################################################
@@ -160,19 +389,26 @@ supply_equipment_load::supply_equipment_load(
     standby_acQ_kVAR{ standby_acQ_kVAR }, 
     SE_config{ SE_config },
     SE_stat{ -1, SE_config, SE_charging_status::no_ev_plugged_in, false },
-    event_handler{ CE_queuing_inputs },
+    SE_type_id{ PEV_charge_factory.get_EV_EVSE_inventory().get_EVSE_type_id(SE_config.supply_equipment_type) },
+    ev_type_id{ -1 },
+    event_handler{ CE_queuing_inputs, PEV_charge_factory.get_EV_EVSE_inventory() },
     PEV_charge_factory{ PEV_charge_factory },
     ac_to_dc_converter_factory{ ac_to_dc_converter_factory },
     charge_profile_library{ charge_profile_library }
 {    
+    if(this->SE_type_id < 0)
+        throw std::invalid_argument("CALDERA ERROR:  SE_type:" + SE_config.supply_equipment_type + " of SE " + std::to_string(SE_config.SE_id) + " is not in the EV_EVSE_inventory.");
     
     this->ac_to_dc_converter_obj = NULL;
     this->ev_charge_model = NULL;
+    this->trial_state = NULL;
 }
 
 
 supply_equipment_load::~supply_equipment_load()
 {    
+    // Deleted rather than released to the object pools, an SE can be destroyed after
+    // the thread pools are gone (e.g. at exit).
     if(this->ac_to_dc_converter_obj != NULL)
     {
         delete this->ac_to_dc_converter_obj;
@@ -186,39 +422,59 @@ supply_equipment_load::~supply_equipment_load()
     }
 }
 
-/*
-supply_equipment_load::supply_equipment_load(const supply_equipment_load& obj)
+supply_equipment_load::supply_equipment_load(const supply_equipment_load& obj) :
+    P2_limit_kW{ obj.P2_limit_kW },
+    standby_acP_kW{ obj.standby_acP_kW },
+    standby_acQ_kVAR{ obj.standby_acQ_kVAR },
+    SE_config{ obj.SE_config },
+    SE_stat{ obj.SE_stat },
+    control_enums{ obj.control_enums },
+    SE_type_id{ obj.SE_type_id },
+    ev_type_id{ obj.ev_type_id },
+    event_handler{ obj.event_handler },
+    ac_to_dc_converter_obj{ (obj.ac_to_dc_converter_obj != NULL) ? obj.ac_to_dc_converter_obj->clone() : NULL },
+    ev_charge_model{ (obj.ev_charge_model != NULL) ? obj.ev_charge_model->clone() : NULL },
+    PEV_charge_factory{ obj.PEV_charge_factory },
+    ac_to_dc_converter_factory{ obj.ac_to_dc_converter_factory },
+    charge_profile_library{ obj.charge_profile_library },
+    trial_state{ NULL }
 {
-    *this = obj;
 }
 
 
 supply_equipment_load& supply_equipment_load::operator=(const supply_equipment_load& obj)
-{    
+{
+    if(this == &obj)
+        return *this;
+    
     this->P2_limit_kW = obj.P2_limit_kW;
     this->standby_acP_kW = obj.standby_acP_kW;
     this->standby_acQ_kVAR = obj.standby_acQ_kVAR;
     this->SE_config = obj.SE_config;
     this->SE_stat = obj.SE_stat;
+    this->control_enums = obj.control_enums;
+    this->SE_type_id = obj.SE_type_id;
+    this->ev_type_id = obj.ev_type_id;
     this->event_handler = obj.event_handler;
     
-    this->PEV_charge_factory = obj.PEV_charge_factory;
-    
+    if(this->ac_to_dc_converter_obj != NULL)
+        delete this->ac_to_dc_converter_obj;
     
     if(obj.ac_to_dc_converter_obj != NULL)
         this->ac_to_dc_converter_obj = obj.ac_to_dc_converter_obj->clone();
     else
         this->ac_to_dc_converter_obj = NULL;
     
+    if(this->ev_charge_model != NULL)
+        delete this->ev_charge_model;
     
     if(obj.ev_charge_model != NULL)
-        this->ev_charge_model = new vehicle_charge_model(*obj.ev_charge_model);
+        this->ev_charge_model = obj.ev_charge_model->clone();
     else
         this->ev_charge_model = NULL;
         
     return *this;
 }
-*/
 
 
 void supply_equipment_load::set_target_acP3_kW(double target_acP3_kW_)
@@ -298,10 +554,8 @@ void supply_equipment_load::get_active_charge_profile_forecast_allInfo(double se
         }
 
         double startSOC = this->SE_stat.current_charge.now_soc;
-        const EVSE_type& SE_type = this->SE_config.supply_equipment_type;
-        const EV_type& pev_type = this->SE_stat.current_charge.vehicle_type;
 
-        const pev_charge_profile& cur_charge_profile = this->charge_profile_library.get_charge_profile(pev_type, SE_type);
+        const pev_charge_profile& cur_charge_profile = this->charge_profile_library.get_charge_profile(this->ev_type_id, this->SE_type_id);
 
         cur_charge_profile.find_chargeProfile_given_startSOC_and_chargeTimes(setpoint_P3kW, startSOC, charge_time_hrs, charge_profile);
     }
@@ -330,10 +584,7 @@ void supply_equipment_load::get_CE_forecast_on_interval(double setpoint_P3kW, do
     pev_charge_profile_result target_soc_val, depart_time_val;
     bool return_val_is_zero = false;
     
-    const EVSE_type& SE_type = this->SE_config.supply_equipment_type;
-    const EV_type& pev_type = this->SE_stat.current_charge.vehicle_type;
-
-    const pev_charge_profile& cur_charge_profile = this->charge_profile_library.get_charge_profile(pev_type, SE_type);
+    const pev_charge_profile& cur_charge_profile = this->charge_profile_library.get_charge_profile(this->ev_type_id, this->SE_type_id);
     
     if(stop_charge_val.decision_metric == stop_charging_decision_metric::stop_charging_using_target_soc || stop_charge_val.decision_metric == stop_charging_decision_metric::stop_charging_using_whatever_happens_first)
     {
@@ -583,10 +834,54 @@ const pev_charge_profile& supply_equipment_load::get_pev_charge_profile()
     // no EV to get pev_charge_profile.
     ASSERT(this->SE_stat.pev_is_connected_to_SE, "This function shouldn't be called when pev is not connected to EVSE");
 
-    const EVSE_type SE_type = this->SE_config.supply_equipment_type;
-    const EV_type pev_type = this->SE_stat.current_charge.vehicle_type;
+    return this->charge_profile_library.get_charge_profile(this->ev_type_id, this->SE_type_id);
+}
+
+
+void supply_equipment_load::release_ev_charge_model()
+{
+    // The corresponding 'acquire' was done in 'factory_EV_charge_model::alloc_get_EV_charge_model'.
+    // The model saved by an open trial step is released by end_trial_step.
+    if(this->trial_state == NULL || this->ev_charge_model != this->trial_state->ev_charge_model)
+        factory_EV_charge_model::release_EV_charge_model(this->ev_charge_model);
+    
+    this->ev_charge_model = NULL;
+}
 
-    return this->charge_profile_library.get_charge_profile(pev_type, SE_type);
+
+void supply_equipment_load::release_ac_to_dc_converter()
+{
+    if(this->trial_state == NULL || this->ac_to_dc_converter_obj != this->trial_state->ac_to_dc_converter_obj)
+        factory_ac_to_dc_converter::release_ac_to_dc_converter(this->ac_to_dc_converter_obj);
+    
+    this->ac_to_dc_converter_obj = NULL;
+}
+
+
+void supply_equipment_load::alloc_ac_to_dc_converter()
+{
+    // For the charge of ev_type_id with control_enums.
+    charge_event_P3kW_limits P3kW_limits;
+    if (this->charge_profile_library.has_charge_profile(this->ev_type_id, this->SE_type_id))
+    {
+        const pev_charge_profile& cur_charge_profile = this->charge_profile_library.get_charge_profile(this->ev_type_id, this->SE_type_id);
+        P3kW_limits = cur_charge_profile.get_charge_event_P3kW_limits();
+    }
+    else
+    {
+        P3kW_limits.min_P3kW = 0;
+        P3kW_limits.max_P3kW = 1;
+    }
+    
+    ac_to_dc_converter_enum converter_type = ac_to_dc_converter_enum::pf;
+    if(this->control_enums.inverter_model_supports_Qsetpoint)
+    {
+        converter_type = ac_to_dc_converter_enum::Q_setpoint;
+    }
+    
+    this->release_ac_to_dc_converter();
+    
+    this->ac_to_dc_converter_obj = this->ac_to_dc_converter_factory.alloc_get_ac_to_dc_converter(converter_type, this->SE_type_id, P3kW_limits);
 }
 
 
@@ -606,14 +901,15 @@ bool supply_equipment_load::get_next(double prev_unix_time, double now_unix_time
         // If there is another event available, process it.
         if( this->event_handler.charge_event_is_available(now_unix_time) )
         {
-            charge_event_data charge_event = this->event_handler.get_next_charge_event(now_unix_time);
-            EVSE_type SE_type = this->SE_config.supply_equipment_type;
+            EV_type_id ev_type_id;
+            charge_event_data charge_event = this->event_handler.get_next_charge_event(now_unix_time, ev_type_id);
 
-            this->ev_charge_model = this->PEV_charge_factory.alloc_get_EV_charge_model(charge_event, SE_type, this->P2_limit_kW);
+            this->ev_charge_model = this->PEV_charge_factory.alloc_get_EV_charge_model(charge_event, ev_type_id, this->SE_type_id, this->P2_limit_kW);
 
             // ev_charge_model == NULL when there is a compatibility issue between the PEV and Supply Equipment
             if(this->ev_charge_model != NULL)
             {
+                this->ev_type_id = ev_type_id;
                 this->SE_stat.current_charge.charge_event_id = charge_event.charge_event_id;
                 this->SE_stat.current_charge.vehicle_id = charge_event.vehicle_id;
                 this->SE_stat.current_charge.vehicle_type = charge_event.vehicle_type;
@@ -632,40 +928,10 @@ bool supply_equipment_load::get_next(double prev_unix_time, double now_unix_time
                 is_new_CE__update_control_strategies = true;
                 this->control_enums = charge_event.control_enums;
                 
-                //--------------------------------
-                //  Update Charge Profile
-                //--------------------------------
-                EV_type pev_type = charge_event.vehicle_type;
-                
-                charge_event_P3kW_limits P3kW_limits;
-                if (this->charge_profile_library.has_charge_profile(pev_type, SE_type))
-                {
-                    const pev_charge_profile& cur_charge_profile = this->charge_profile_library.get_charge_profile(pev_type, SE_type);
-                    P3kW_limits = cur_charge_profile.get_charge_event_P3kW_limits();
-
-                }
-                else
-                {
-                    P3kW_limits.min_P3kW = 0;
-                    P3kW_limits.max_P3kW = 1;
-                }
                 //--------------------------------
                 //  Create ac_to_dc_converter_obj
                 //--------------------------------
-
-                ac_to_dc_converter_enum converter_type = ac_to_dc_converter_enum::pf;
-                if(this->control_enums.inverter_model_supports_Qsetpoint)
-                {
-                    converter_type = ac_to_dc_converter_enum::Q_setpoint;
-                }
-                
-                if(this->ac_to_dc_converter_obj != NULL)
-                {
-                    delete this->ac_to_dc_converter_obj;
-                    this->ac_to_dc_converter_obj = NULL;
-                }
-                
-                this->ac_to_dc_converter_obj = this->ac_to_dc_converter_factory.alloc_get_ac_to_dc_converter(converter_type, SE_type, pev_type, P3kW_limits);                
+                this->alloc_ac_to_dc_converter();
             
                 //----------------------------------------
                 //          Set P3, Q3 Targets 
@@ -744,9 +1010,7 @@ bool supply_equipment_load::get_next(double prev_unix_time, double now_unix_time
 
             SE_charge_status = SE_charging_status::ev_charge_complete;
             
-            // The corresponding 'new' command was done in 'factory_EV_charge_model::alloc_get_EV_charge_model'
-            delete this->ev_charge_model;
-            this->ev_charge_model = NULL;
+            this->release_ev_charge_model();
             
             CE_status x = this->SE_stat.current_charge;
             this->SE_stat.completed_charges.push_back(x);
@@ -790,14 +1054,219 @@ bool supply_equipment_load::get_next(double prev_unix_time, double now_unix_time
 }
 
 
+void supply_equipment_load::begin_trial_step(supply_equipment_load_step_state& state)
+{
+    state.now_unix_time = this->SE_stat.now_unix_time;
+    state.SE_charging_status_val = this->SE_stat.SE_charging_status_val;
+    state.pev_is_connected_to_SE = this->SE_stat.pev_is_connected_to_SE;
+    state.current_charge = this->SE_stat.current_charge;
+    state.num_completed_charges = this->SE_stat.completed_charges.size();
+    state.control_enums = this->control_enums;
+    state.first_charge_event_index = this->event_handler.get_first_charge_event_index();
+    
+    state.ac_to_dc_converter_obj = this->ac_to_dc_converter_obj;
+    state.target_Q3_kVAR = (this->ac_to_dc_converter_obj != NULL) ? this->ac_to_dc_converter_obj->get_target_Q3_kVAR() : 0;
+    
+    state.ev_charge_model = this->ev_charge_model;
+    if(this->ev_charge_model != NULL)
+        this->ev_charge_model->get_step_state(state.ev_charge_model_state);
+    state.ev_type_id = this->ev_type_id;
+    
+    this->event_handler.set_trial_step_is_open(true);
+    this->trial_state = &state;
+}
+
+
+void supply_equipment_load::restore_trial_state()
+{
+    const supply_equipment_load_step_state& state = *this->trial_state;
+    
+    // A charge model or converter taken during the trial step goes back to the pools.
+    if(this->ev_charge_model != state.ev_charge_model)
+        this->release_ev_charge_model();
+    
+    if(this->ac_to_dc_converter_obj != state.ac_to_dc_converter_obj)
+        this->release_ac_to_dc_converter();
+    
+    this->SE_stat.now_unix_time = state.now_unix_time;
+    this->SE_stat.SE_charging_status_val = state.SE_charging_status_val;
+    this->SE_stat.pev_is_connected_to_SE = state.pev_is_connected_to_SE;
+    this->SE_stat.current_charge = state.current_charge;
+    this->SE_stat.completed_charges.resize(state.num_completed_charges);
+    this->control_enums = state.control_enums;
+    this->event_handler.set_first_charge_event_index(state.first_charge_event_index);
+    
+    this->ac_to_dc_converter_obj = state.ac_to_dc_converter_obj;
+    if(this->ac_to_dc_converter_obj != NULL)
+        this->ac_to_dc_converter_obj->set_target_Q3_kVAR(state.target_Q3_kVAR);
+    
+    this->ev_charge_model = state.ev_charge_model;
+    if(this->ev_charge_model != NULL)
+        this->ev_charge_model->set_step_state(state.ev_charge_model_state);
+    this->ev_type_id = state.ev_type_id;
+}
+
+
+void supply_equipment_load::end_trial_step()
+{
+    const supply_equipment_load_step_state& state = *this->trial_state;
+    this->trial_state = NULL;
+    
+    // The saved charge model and converter were kept for restore_trial_state.
+    if(state.ev_charge_model != NULL && state.ev_charge_model != this->ev_charge_model)
+        factory_EV_charge_model::release_EV_charge_model(state.ev_charge_model);
+    
+    if(state.ac_to_dc_converter_obj != NULL && state.ac_to_dc_converter_obj != this->ac_to_dc_converter_obj)
+        factory_ac_to_dc_converter::release_ac_to_dc_converter(state.ac_to_dc_converter_obj);
+    
+    this->event_handler.set_trial_step_is_open(false);
+}
+
+
+void supply_equipment_load::write_step_state(std::ostream& out) const
+{
+    write_pod<double>(out, this->SE_stat.now_unix_time);
+    write_pod<SE_charging_status>(out, this->SE_stat.SE_charging_status_val);
+    write_pod<bool>(out, this->SE_stat.pev_is_connected_to_SE);
+    this->SE_stat.current_charge.write_binary(out);
+    
+    write_pod<uint64_t>(out, (uint64_t)this->SE_stat.completed_charges.size());
+    for(const CE_status& x : this->SE_stat.completed_charges)
+        x.write_binary(out);
+    
+    this->control_enums.write_binary(out);
+    this->event_handler.write_binary(out);
+    
+    write_pod<bool>(out, this->ev_charge_model != NULL);
+    if(this->ev_charge_model != NULL)
+    {
+        write_pod<int32_t>(out, this->ev_type_id);
+        this->ev_charge_model->get_charge_event().write_binary(out);
+        this->ev_charge_model->write_step_state(out);
+        write_pod<double>(out, this->ac_to_dc_converter_obj->get_target_Q3_kVAR());
+    }
+}
+
+
+void supply_equipment_load::read_step_state(std::istream& in)
+{
+    if(this->trial_state != NULL)
+        throw std::invalid_argument("CALDERA ERROR:  supply_equipment_load::read_step_state called while a trial step is open at SE " + std::to_string(this->SE_config.SE_id) + ".");
+    
+    this->release_ev_charge_model();
+    this->release_ac_to_dc_converter();
+    this->ev_type_id = -1;
+    
+    this->SE_stat.now_unix_time = read_pod<double>(in);
+    this->SE_stat.SE_charging_status_val = read_pod<SE_charging_status>(in);
+    this->SE_stat.pev_is_connected_to_SE = read_pod<bool>(in);
+    this->SE_stat.current_charge = CE_status::read_binary(in);
+    
+    const uint64_t num_completed_charges = read_pod<uint64_t>(in);
+    this->SE_stat.completed_charges.clear();
+    for(uint64_t i = 0; i < num_completed_charges && in.good(); i++)
+        this->SE_stat.completed_charges.push_back(CE_status::read_binary(in));
+    
+    this->control_enums = control_strategy_enums::read_binary(in);
+    this->event_handler.read_binary(in);
+    
+    if(!read_pod<bool>(in) || !in.good())
+        return;
+    
+    const EV_type_id ev_type_id_ = read_pod<int32_t>(in);
+    const charge_event_data charge_event = charge_event_data::read_binary(in);
+    
+    if(!in.good() || ev_type_id_ < 0 || ev_type_id_ >= this->PEV_charge_factory.get_EV_EVSE_inventory().get_num_EV_types())
+    {
+        in.setstate(std::ios::failbit);
+        return;
+    }
+    
+    this->ev_charge_model = this->PEV_charge_factory.alloc_get_EV_charge_model(charge_event, ev_type_id_, this->SE_type_id, this->P2_limit_kW);
+    if(this->ev_charge_model == NULL)
+    {
+        in.setstate(std::ios::failbit);
+        return;
+    }
+    
+    this->ev_type_id = ev_type_id_;
+    this->ev_charge_model->read_step_state(in);
+    
+    this->alloc_ac_to_dc_converter();
+    this->ac_to_dc_converter_obj->set_target_Q3_kVAR(read_pod<double>(in));
+}
+
+
+void supply_equipment_load::get_power_sensitivity(double pu_Vrms, double& dP3_dpuVrms, double& dQ3_dpuVrms)
+{
+    dP3_dpuVrms = 0;
+    dQ3_dpuVrms = 0;
+    
+    // Standby power does not depend on the voltage.
+    if(this->ev_charge_model == NULL || this->SE_stat.current_charge.now_acPkW <= this->standby_acP_kW)
+        return;
+    
+    const double P2_kW = this->SE_stat.current_charge.now_dcPkW;
+    const double P3_kW = this->SE_stat.current_charge.now_acPkW;
+    
+    const double dP2_dpuVrms = this->ev_charge_model->get_dP2_dpuVrms(pu_Vrms, P2_kW);
+    
+    if(dP2_dpuVrms == 0)
+        return;
+    
+    dP3_dpuVrms = this->ac_to_dc_converter_obj->get_dP3_dP2(P2_kW) * dP2_dpuVrms;
+    
+    // While charging get_next reports the Q3 of either converter, standby Q3 is only
+    // reported below standby power.
+    dQ3_dpuVrms = this->ac_to_dc_converter_obj->get_dQ3_dP3(P3_kW) * dP3_dpuVrms;
+}
+
+
+bool supply_equipment_load::is_idle(double& next_arrival_unix_time) const
+{
+    next_arrival_unix_time = this->event_handler.get_next_arrival_unix_time();
+    
+    return this->ev_charge_model == NULL && this->SE_stat.SE_charging_status_val == SE_charging_status::no_ev_plugged_in;
+}
+
+
+double supply_equipment_load::get_time_at_constant_power_sec() const
+{
+    if(this->ev_charge_model == NULL || this->SE_stat.SE_charging_status_val != SE_charging_status::ev_charging)
+        return 0;
+    
+    if(this->control_enums.ES_control_strategy != L2_control_strategies_enum::NA || this->control_enums.VS_control_strategy != L2_control_strategies_enum::NA || this->control_enums.ext_control_strategy != "NA")
+        return 0;
+    
+    return this->ev_charge_model->get_time_at_constant_power_sec(this->SE_stat.now_unix_time);
+}
+
+
+double supply_equipment_load::get_standby_acP_kW() const
+{
+    return this->standby_acP_kW;
+}
+
+
+double supply_equipment_load::get_standby_acQ_kVAR() const
+{
+    return this->standby_acQ_kVAR;
+}
+
+
+void supply_equipment_load::add_charge_event_queue_memory_usage(charge_event_queue_memory_usage& usage) const
+{
+    this->event_handler.add_charge_event_queue_memory_usage(usage);
+}
+
+
 void supply_equipment_load::stop_active_CE()
 {
     if(this->ev_charge_model != NULL)
     {
         this->SE_stat.SE_charging_status_val = SE_charging_status::ev_charge_ended_early;
         
-        delete this->ev_charge_model;
-        this->ev_charge_model = NULL;
+        this->release_ev_charge_model();
         
         CE_status x = this->SE_stat.current_charge;
         this->SE_stat.completed_charges.push_back(x);
@@ -9,7 +9,8 @@
 #include "charge_profile_library.h"                 // pev_charge_profile, pev_charge_profile_library
 
 #include<vector>
-#include <set>
+#include <string>
+#include <cstdint>                                  // uint8_t, uint16_t
 #include <iostream>
 
 
@@ -17,15 +18,56 @@ class factory_EV_charge_model;
 class factory_ac_to_dc_converter;
 
 
+// Queued charge event without any strings.  vehicle_type is the EV_type_id of the
+// inventory, ext_control_strategy an index into the string table of the
+// charge_event_handler that owns the event.
+struct packed_charge_event
+{
+    double arrival_unix_time;
+    double departure_unix_time;
+    double arrival_SOC;
+    double departure_SOC;
+    double arrival_battery_temperature_C;
+    double soc_block_charging_max_undershoot_percent;
+    double depart_time_block_charging_max_undershoot_percent;
+    
+    int charge_event_id;
+    int SE_group_id;
+    SupplyEquipmentId SE_id;
+    vehicle_id_type vehicle_id;
+    
+    uint16_t vehicle_type_id;
+    uint16_t ext_control_strategy_index;
+    uint8_t decision_metric;
+    uint8_t soc_mode;
+    uint8_t depart_time_mode;
+    uint8_t ES_control_strategy;
+    uint8_t VS_control_strategy;
+    bool inverter_model_supports_Qsetpoint;
+};
+
+
 class charge_event_handler
 {
 private:
-    std::set<charge_event_data> charge_events;
+    // Sorted by arrival_unix_time.  Events before first_charge_event_index have
+    // already been taken and are dropped in bulk by compact_charge_events.
+    std::vector<packed_charge_event> charge_events;
+    int first_charge_event_index;
+    std::vector<std::string> string_table;
     charge_event_queuing_inputs CE_queuing_inputs;
+    const EV_EVSE_inventory* inventory;
+    bool trial_step_is_open;
+    
+    uint16_t get_string_index( const std::string& str );
+    packed_charge_event pack_charge_event( const charge_event_data& CE );
+    charge_event_data unpack_charge_event( const packed_charge_event& CE ) const;
+    std::vector<packed_charge_event>::iterator find_charge_event( const double arrival_unix_time );
+    void compact_charge_events();
     
 public:
-    charge_event_handler() {};
-    charge_event_handler( const charge_event_queuing_inputs& CE_queuing_inputs_ );
+    charge_event_handler() : first_charge_event_index{ 0 }, inventory{ NULL }, trial_step_is_open{ false } {};
+    charge_event_handler( const charge_event_queuing_inputs& CE_queuing_inputs_, const EV_EVSE_inventory& inventory_ );
     
     void add_charge_event( const charge_event_data& CE );
     
@@ -33,7 +75,44 @@ public:
     
     bool charge_event_is_available( const double now_unix_time ) const;
     
-    charge_event_data get_next_charge_event( const double now_unix_time );
+    // vehicle_type_id is set to the EV_type_id of the returned charge event.
+    charge_event_data get_next_charge_event( const double now_unix_time, EV_type_id& vehicle_type_id );
+    
+    // Arrival time of the earliest queued charge event, or std::numeric_limits<double>::max() if there are none.
+    double get_next_arrival_unix_time() const;
+    
+    void add_charge_event_queue_memory_usage( charge_event_queue_memory_usage& usage ) const;
+    
+    // While a trial step is open the taken events are not dropped, so that
+    // set_first_charge_event_index can put them back in the queue.
+    void set_trial_step_is_open( const bool trial_step_is_open_ );
+    int get_first_charge_event_index() const;
+    void set_first_charge_event_index( const int first_charge_event_index_ );
+    
+    // Binary form of the queued charge events.  read_binary replaces the queue of a
+    // handler built for the same inventory and leaves 'in' failed on bad data.
+    void write_binary( std::ostream& out ) const;
+    void read_binary( std::istream& in );
+};
+
+
+// The part of a supply_equipment_load that get_next changes, saved by begin_trial_step.
+struct supply_equipment_load_step_state
+{
+    double now_unix_time;
+    SE_charging_status SE_charging_status_val;
+    bool pev_is_connected_to_SE;
+    CE_status current_charge;
+    int num_completed_charges;
+    control_strategy_enums control_enums;
+    int first_charge_event_index;
+    
+    ac_to_dc_converter* ac_to_dc_converter_obj;
+    double target_Q3_kVAR;
+    
+    vehicle_charge_model* ev_charge_model;
+    vehicle_charge_model_step_state ev_charge_model_state;
+    EV_type_id ev_type_id;
 };
 
 
@@ -46,6 +125,12 @@ private:
     SE_status SE_stat;
     control_strategy_enums control_enums;
     
+    // SE_config.supply_equipment_type and the vehicle_type of the current charge, resolved
+    // once so that get_next only indexes the id tables.  ev_type_id is only valid while
+    // ev_charge_model is not NULL.
+    EVSE_type_id SE_type_id;
+    EV_type_id ev_type_id;
+    
     charge_event_handler event_handler;
     
     // Both pointer are local to this class.
@@ -57,8 +142,14 @@ private:
     
     const pev_charge_profile_library& charge_profile_library;
     
+    // The state saved by begin_trial_step, NULL when no trial step is open.
+    const supply_equipment_load_step_state* trial_state;
+    
     //----------------------------
     
+    void release_ev_charge_model();
+    void release_ac_to_dc_converter();
+    void alloc_ac_to_dc_converter();
     void get_CE_forecast_on_interval(double setpoint_P3kW, double nowSOC, double endSOC, double now_unix_time, double end_unix_time, pev_charge_profile_result& return_val);
 
 public:
@@ -73,8 +164,11 @@ public:
         const pev_charge_profile_library& charge_profile_library
     );
     ~supply_equipment_load();
-    //supply_equipment_load& operator=(const supply_equipment_load& obj);
-    //supply_equipment_load(const supply_equipment_load& obj);
+    
+    // Deep copies of the converter and the charge model.  The factories and the charge
+    // profile library are shared, so operator= requires obj to use the same ones.
+    supply_equipment_load(const supply_equipment_load& obj);
+    supply_equipment_load& operator=(const supply_equipment_load& obj);
     
     void get_CE_stats_at_end_of_charge(double setpoint_P3kW, double nowSOC, double now_unix_time, bool& pev_is_connected_to_SE, pev_charge_profile_result& return_val);
     void get_CE_FICE(FICE_inputs inputs, double nowSOC, double now_unix_time, bool& pev_is_connected_to_SE, CE_FICE& return_val);
@@ -100,6 +194,39 @@ public:
     bool get_next(double prev_unix_time, double now_unix_time, double pu_Vrms, double& soc, ac_power_metrics& ac_power);
     void stop_active_CE();
     
+    // Trial steps.  begin_trial_step saves the state to state, which must not move until
+    // end_trial_step.  Until then the charge model and converter in use are not released
+    // and the taken charge events are kept, so restore_trial_state can go back to the
+    // saved state in place after any number of get_next.  end_trial_step keeps the
+    // current state.
+    void begin_trial_step(supply_equipment_load_step_state& state);
+    void restore_trial_state();
+    void end_trial_step();
+    
+    // Binary form of the state that get_next changes, for a supply_equipment_load built
+    // from the same inputs and factories.  The charge model and converter are allocated
+    // again from the factories and given the written state.  read_step_state must not be
+    // called while a trial step is open and leaves 'in' failed on bad data.
+    void write_step_state(std::ostream& out) const;
+    void read_step_state(std::istream& in);
+    
+    // Analytic dP3/dpuVrms and dQ3/dpuVrms of the power returned by the last get_next,
+    // which must have been called with the same pu_Vrms.
+    void get_power_sensitivity(double pu_Vrms, double& dP3_dpuVrms, double& dQ3_dpuVrms);
+    
+    // True when no PEV is connected and the last call to get_next already reported
+    // no_ev_plugged_in, so get_next returns standby power until the next arrival.
+    bool is_idle(double& next_arrival_unix_time) const;
+    
+    // Time after the last get_next over which the active charge draws constant power, so
+    // get_next can step over it at once.  Zero when there is no active charge, a control
+    // strategy is in use or the power may change during the next step.  The ac targets
+    // must not change in the meantime.
+    double get_time_at_constant_power_sec() const;
+    double get_standby_acP_kW() const;
+    double get_standby_acQ_kVAR() const;
+    void add_charge_event_queue_memory_usage(charge_event_queue_memory_usage& usage) const;
+    
     control_strategy_enums get_control_strategy_enums();
     const pev_charge_profile& get_pev_charge_profile();
  };
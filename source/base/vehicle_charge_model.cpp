@@ -8,23 +8,10 @@
 //###########################################
 
 vehicle_charge_model::vehicle_charge_model(const vehicle_charge_model_inputs& inputs)
-    : charge_event{ inputs.CE },
-    charge_event_id{ inputs.CE.charge_event_id },
-    EV{ inputs.EV },
-    arrival_unix_time{ inputs.CE.arrival_unix_time },
-    depart_unix_time{ inputs.CE.departure_unix_time },
-    arrival_soc{ inputs.CE.arrival_SOC },
-    requested_depart_soc{ inputs.CE.departure_SOC },
-    decision_metric{ inputs.CE.stop_charge.decision_metric },
-    soc_mode{ inputs.CE.stop_charge.soc_mode },
-    depart_time_mode{ inputs.CE.stop_charge.depart_time_mode },
-    soc_block_charging_max_undershoot_percent{ inputs.CE.stop_charge.soc_block_charging_max_undershoot_percent },
-    depart_time_block_charging_max_undershoot_percent{ inputs.CE.stop_charge.depart_time_block_charging_max_undershoot_percent },
-    bat{ battery{inputs} },
+    : bat{ battery{inputs} },
     soc_of_full_battery{ 99.8 },
     charge_has_completed_{ false },
     charge_needs_met_{ false },
-    prev_soc_t1{ this->arrival_soc },
     target_P2_kW{ 0.0 }
 {
 
@@ -34,11 +21,46 @@ vehicle_charge_model::vehicle_charge_model(const vehicle_charge_model_inputs& in
 
     //-------------------------
 
+    this->set_charge_event(inputs.CE);
+}
+
+
+vehicle_charge_model::vehicle_charge_model(const vehicle_charge_model& prototype, const charge_event_data& CE)
+    : vehicle_charge_model{ prototype }
+{
+    this->set_charge_event(CE);
+}
+
+
+void vehicle_charge_model::set_charge_event(const charge_event_data& CE)
+{
+    this->charge_event = CE;
+    this->charge_event_id = CE.charge_event_id;
+    this->EV = CE.vehicle_type;
+    this->arrival_unix_time = CE.arrival_unix_time;
+    this->depart_unix_time = CE.departure_unix_time;
+    this->arrival_soc = CE.arrival_SOC;
+    this->requested_depart_soc = CE.departure_SOC;
+    this->decision_metric = CE.stop_charge.decision_metric;
+    this->soc_mode = CE.stop_charge.soc_mode;
+    this->depart_time_mode = CE.stop_charge.depart_time_mode;
+    this->soc_block_charging_max_undershoot_percent = CE.stop_charge.soc_block_charging_max_undershoot_percent;
+    this->depart_time_block_charging_max_undershoot_percent = CE.stop_charge.depart_time_block_charging_max_undershoot_percent;
+    this->prev_soc_t1 = this->arrival_soc;
+    
+    this->bat.set_arrival_soc(this->arrival_soc);
+
     this->stop_charging_at_target_soc = (this->soc_mode == stop_charging_mode::target_charging && this->decision_metric != stop_charging_decision_metric::stop_charging_using_depart_time);
     this->depart_soc = (this->requested_depart_soc < this->soc_of_full_battery) ? this->requested_depart_soc : this->soc_of_full_battery;
 }
 
 
+vehicle_charge_model* vehicle_charge_model::clone() const
+{
+    return new vehicle_charge_model(*this);
+}
+
+
 void vehicle_charge_model::set_target_P2_kW(double target_P2_kW_) 
 { 
     this->target_P2_kW = target_P2_kW_; 
@@ -49,6 +71,57 @@ double vehicle_charge_model::get_target_P2_kW() const
     return this->target_P2_kW;
 }
 
+
+void vehicle_charge_model::get_step_state( vehicle_charge_model_step_state& state ) const
+{
+    this->bat.get_step_state(state.bat);
+    state.target_P2_kW = this->target_P2_kW;
+    state.prev_soc_t1 = this->prev_soc_t1;
+    state.charge_has_completed_ = this->charge_has_completed_;
+    state.charge_needs_met_ = this->charge_needs_met_;
+}
+
+void vehicle_charge_model::set_step_state( const vehicle_charge_model_step_state& state )
+{
+    this->bat.set_step_state(state.bat);
+    this->target_P2_kW = state.target_P2_kW;
+    this->prev_soc_t1 = state.prev_soc_t1;
+    this->charge_has_completed_ = state.charge_has_completed_;
+    this->charge_needs_met_ = state.charge_needs_met_;
+}
+
+void vehicle_charge_model::write_step_state( std::ostream& out ) const
+{
+    this->bat.write_step_state(out);
+    write_pod<double>(out, this->target_P2_kW);
+    write_pod<double>(out, this->prev_soc_t1);
+    write_pod<bool>(out, this->charge_has_completed_);
+    write_pod<bool>(out, this->charge_needs_met_);
+}
+
+void vehicle_charge_model::read_step_state( std::istream& in )
+{
+    this->bat.read_step_state(in);
+    
+    const double target_P2_kW_ = read_pod<double>(in);
+    const double prev_soc_t1_ = read_pod<double>(in);
+    const bool charge_has_completed = read_pod<bool>(in);
+    const bool charge_needs_met = read_pod<bool>(in);
+    
+    if(!in.good())
+        return;
+    
+    this->target_P2_kW = target_P2_kW_;
+    this->prev_soc_t1 = prev_soc_t1_;
+    this->charge_has_completed_ = charge_has_completed;
+    this->charge_needs_met_ = charge_needs_met;
+}
+
+const charge_event_data& vehicle_charge_model::get_charge_event() const
+{
+    return this->charge_event;
+}
+
 bool vehicle_charge_model::charge_has_completed() const
 {
     return this->charge_has_completed_;
@@ -74,6 +147,58 @@ void vehicle_charge_model::get_E1_battery_limits(double& max_E1_limit, double& m
 }
 
 
+double vehicle_charge_model::get_dP2_dpuVrms(const double pu_Vrms, const double P2_kW) const
+{
+    return this->bat.get_dP2_dpuVrms(pu_Vrms, P2_kW);
+}
+
+
+double vehicle_charge_model::get_time_at_constant_power_sec( const double now_unix_time ) const
+{
+    if(now_unix_time < this->arrival_unix_time || this->charge_needs_met_ || this->soc_of_full_battery <= this->prev_soc_t1)
+        return 0;
+    
+    // The battery keeps the target of the last get_next until the next one.
+    if(this->target_P2_kW != this->bat.get_target_P2_kW())
+        return 0;
+    
+    //-------------------------------
+    //  soc where charging may stop
+    //-------------------------------
+    double soc_limit = this->soc_of_full_battery;
+    
+    if(this->decision_metric != stop_charging_decision_metric::stop_charging_using_depart_time)
+    {
+        if(this->soc_mode == stop_charging_mode::block_charging)
+        {
+            // The boundary soc is extrapolated from the soc change over the whole step.
+            soc_limit = this->prev_soc_t1 + (this->depart_soc - this->prev_soc_t1)/(1 + this->soc_block_charging_max_undershoot_percent/100.0);
+        }
+        else
+        {
+            soc_limit = this->depart_soc;
+        }
+    }
+    
+    //-------------------------------
+    //  time where charging may stop
+    //-------------------------------
+    double time_to_depart_sec = this->depart_unix_time - now_unix_time;
+    
+    if(this->decision_metric != stop_charging_decision_metric::stop_charging_using_target_soc && this->depart_time_mode == stop_charging_mode::block_charging)
+    {
+        time_to_depart_sec /= (1 + this->depart_time_block_charging_max_undershoot_percent/100.0);
+    }
+    
+    //-------------------------------
+    
+    const double time_sec = 3600*this->bat.get_time_at_constant_P2_hrs(soc_limit);
+    const double return_val = (time_sec < time_to_depart_sec) ? time_sec : time_to_depart_sec;
+    
+    return (return_val > 0) ? return_val : 0;
+}
+
+
 void vehicle_charge_model::get_next( const double prev_unix_time,
                                      const double now_unix_time,
                                      const double pu_Vrms,
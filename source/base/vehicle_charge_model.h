@@ -12,6 +12,18 @@
 
 //---------------------------------
 
+// The part of a vehicle_charge_model that get_next and set_target_P2_kW change.  A
+// trial step saves it and restores it in place instead of copying the model.
+struct vehicle_charge_model_step_state
+{
+    battery_step_state bat;
+    double target_P2_kW;
+    double prev_soc_t1;
+    bool charge_has_completed_;
+    bool charge_needs_met_;
+};
+
+
 class vehicle_charge_model
 {
 private:
@@ -46,13 +58,35 @@ private:
     
     vehicle_charge_model& operator=(const vehicle_charge_model& obj) = default;
     vehicle_charge_model(const vehicle_charge_model& obj) = default;
+    
+    void set_charge_event( const charge_event_data& CE );
 
 public:
 
     vehicle_charge_model( const vehicle_charge_model_inputs& inputs );
     
+    // Copy of a model that has not been stepped yet, for the charge event CE.  Everything
+    // that does not depend on the charge event (the battery, its curves and transitions)
+    // is copied from prototype, so CE must be for the same EV, EVSE, SE P2 limit and
+    // battery size.  Used by the prototype cache in factory_EV_charge_model.
+    vehicle_charge_model( const vehicle_charge_model& prototype, 
+                          const charge_event_data& CE );
+    
+    vehicle_charge_model* clone() const;
+    
     void set_target_P2_kW( const double target_P2_kW_ );
     double get_target_P2_kW() const;
+    
+    void get_step_state( vehicle_charge_model_step_state& state ) const;
+    void set_step_state( const vehicle_charge_model_step_state& state );
+    
+    // Binary form of the step state, for a model allocated for the same charge event.
+    // read_step_state leaves 'in' failed on bad data.
+    void write_step_state( std::ostream& out ) const;
+    void read_step_state( std::istream& in );
+    
+    const charge_event_data& get_charge_event() const;
+    
     bool pev_has_arrived_at_SE( const double now_unix_time ) const;
     bool pev_is_connected_to_SE( const double now_unix_time ) const;
     bool charge_has_completed() const;
@@ -60,6 +94,14 @@ public:
     void get_E1_battery_limits( double& max_E1_limit, 
                                 double& min_E1_limit ) const;
     
+    double get_dP2_dpuVrms( const double pu_Vrms, 
+                            const double P2_kW ) const;
+    
+    // Time after now_unix_time over which the charge keeps a constant power and can not
+    // meet its charge needs, so it can be stepped in one call to get_next with the same
+    // result as in many.  Returns zero when the power may change during the next step.
+    double get_time_at_constant_power_sec( const double now_unix_time ) const;
+    
     void get_next( 
         const double prev_unix_time, 
         const double now_unix_time, 
@@ -9,7 +9,13 @@ EV_EVSE_inventory::EV_EVSE_inventory(const EV_inventory& EV_inv,
     all_EVSEs{ load_all_EVSEs() },
     default_EV{ load_default_EV() },
     default_EVSE{ load_default_EVSE() },
-    compatible_EV_EVSE_pair{ load_compatible_EV_EVSE_pair() }
+    compatible_EV_EVSE_pair{ load_compatible_EV_EVSE_pair() },
+    EV_type_ids{ load_EV_type_ids() },
+    EVSE_type_ids{ load_EVSE_type_ids() },
+    EV_characteristics_by_id{ load_EV_characteristics_by_id() },
+    EVSE_characteristics_by_id{ load_EVSE_characteristics_by_id() },
+    EVSE_levels{ load_EVSE_levels() },
+    compatible_EV_EVSE_pair_index{ load_compatible_EV_EVSE_pair_index() }
 {
 }
 
@@ -71,6 +77,66 @@ const std::vector<pev_SE_pair> EV_EVSE_inventory::load_compatible_EV_EVSE_pair()
     return return_val;
 }
 
+const std::unordered_map<EV_type, EV_type_id> EV_EVSE_inventory::load_EV_type_ids() const
+{
+    std::unordered_map<EV_type, EV_type_id> return_val;
+    for (int i = 0; i < (int)this->all_EVs.size(); i++)
+    {
+        return_val.emplace(this->all_EVs[i], i);
+    }
+    return return_val;
+}
+
+const std::unordered_map<EVSE_type, EVSE_type_id> EV_EVSE_inventory::load_EVSE_type_ids() const
+{
+    std::unordered_map<EVSE_type, EVSE_type_id> return_val;
+    for (int i = 0; i < (int)this->all_EVSEs.size(); i++)
+    {
+        return_val.emplace(this->all_EVSEs[i], i);
+    }
+    return return_val;
+}
+
+const std::vector<EV_characteristics> EV_EVSE_inventory::load_EV_characteristics_by_id() const
+{
+    std::vector<EV_characteristics> return_val;
+    for (const EV_type& EV : this->all_EVs)
+    {
+        return_val.push_back(this->EV_inv.at(EV));
+    }
+    return return_val;
+}
+
+const std::vector<EVSE_characteristics> EV_EVSE_inventory::load_EVSE_characteristics_by_id() const
+{
+    std::vector<EVSE_characteristics> return_val;
+    for (const EVSE_type& EVSE : this->all_EVSEs)
+    {
+        return_val.push_back(this->EVSE_inv.at(EVSE));
+    }
+    return return_val;
+}
+
+const std::vector<EVSE_level> EV_EVSE_inventory::load_EVSE_levels() const
+{
+    std::vector<EVSE_level> return_val;
+    for (const EVSE_type& EVSE : this->all_EVSEs)
+    {
+        return_val.push_back(this->EVSE_inv.at(EVSE).get_level());
+    }
+    return return_val;
+}
+
+const std::vector<bool> EV_EVSE_inventory::load_compatible_EV_EVSE_pair_index() const
+{
+    std::vector<bool> return_val(this->get_num_EV_EVSE_pairs(), false);
+    for (const pev_SE_pair& pair : this->compatible_EV_EVSE_pair)
+    {
+        return_val[this->get_EV_EVSE_pair_index(this->EV_type_ids.at(pair.ev_type), this->EVSE_type_ids.at(pair.se_type))] = true;
+    }
+    return return_val;
+}
+
 
 const EV_inventory& EV_EVSE_inventory::get_EV_inventory() const 
 {
@@ -129,6 +195,23 @@ const bool EV_EVSE_inventory::is_valid_EVSE_type( const EVSE_type& se_type ) con
     return this->EVSE_inv.find(se_type) != this->EVSE_inv.end();
 }
 
+EV_type_id EV_EVSE_inventory::get_EV_type_id( const EV_type& ev_type ) const
+{
+    auto it = this->EV_type_ids.find(ev_type);
+    return (it == this->EV_type_ids.end()) ? -1 : it->second;
+}
+
+EVSE_type_id EV_EVSE_inventory::get_EVSE_type_id( const EVSE_type& se_type ) const
+{
+    auto it = this->EVSE_type_ids.find(se_type);
+    return (it == this->EVSE_type_ids.end()) ? -1 : it->second;
+}
+
+bool EV_EVSE_inventory::pev_is_compatible_with_supply_equipment( const EV_type_id EV_id, const EVSE_type_id EVSE_id ) const
+{
+    return this->compatible_EV_EVSE_pair_index[this->get_EV_EVSE_pair_index(EV_id, EVSE_id)];
+}
+
 std::ostream& operator<<(std::ostream& os, const EV_EVSE_inventory& inventory) 
 {
     os << inventory.get_EV_inventory();
@@ -9,6 +9,12 @@
 typedef std::unordered_map<EV_type, EV_characteristics> EV_inventory;
 typedef std::unordered_map<EVSE_type, EVSE_characteristics> EVSE_inventory;
 
+// Dense integer ids for the EV and EVSE types in the inventory.  The id of a type is
+// its position in get_all_EVs() / get_all_EVSEs().  The strings are only needed at
+// the boundary; internal tables are flat arrays indexed by these ids.
+typedef int EV_type_id;
+typedef int EVSE_type_id;
+
 struct pev_SE_pair
 {
     EV_type ev_type;
@@ -41,11 +47,24 @@ private:
 
     const std::vector<pev_SE_pair> compatible_EV_EVSE_pair;
 
+    const std::unordered_map<EV_type, EV_type_id> EV_type_ids;
+    const std::unordered_map<EVSE_type, EVSE_type_id> EVSE_type_ids;
+    const std::vector<EV_characteristics> EV_characteristics_by_id;       // indexed by EV_type_id
+    const std::vector<EVSE_characteristics> EVSE_characteristics_by_id;   // indexed by EVSE_type_id
+    const std::vector<EVSE_level> EVSE_levels;                     // indexed by EVSE_type_id
+    const std::vector<bool> compatible_EV_EVSE_pair_index;         // indexed by get_EV_EVSE_pair_index
+
     const std::vector<EV_type> load_all_EVs() const;
     const std::vector<EVSE_type> load_all_EVSEs() const;
     const EV_type load_default_EV() const;
     const EVSE_type load_default_EVSE() const;
     const std::vector<pev_SE_pair> load_compatible_EV_EVSE_pair() const;
+    const std::unordered_map<EV_type, EV_type_id> load_EV_type_ids() const;
+    const std::unordered_map<EVSE_type, EVSE_type_id> load_EVSE_type_ids() const;
+    const std::vector<EV_characteristics> load_EV_characteristics_by_id() const;
+    const std::vector<EVSE_characteristics> load_EVSE_characteristics_by_id() const;
+    const std::vector<EVSE_level> load_EVSE_levels() const;
+    const std::vector<bool> load_compatible_EV_EVSE_pair_index() const;
 
 public:
     EV_EVSE_inventory(const EV_inventory& EV_inv,
@@ -71,7 +90,30 @@ public:
     // Returns true if the given EVSE_type is a part of the inventory.
     // Otherwise, returns false. 
     const bool is_valid_EVSE_type( const EVSE_type& se_type ) const;
-    
+
+    //--------------------------
+    //   Interned type ids
+    //--------------------------
+
+    int get_num_EV_types() const { return (int)this->all_EVs.size(); }
+    int get_num_EVSE_types() const { return (int)this->all_EVSEs.size(); }
+
+    // Returns -1 if the type is not a part of the inventory.
+    EV_type_id get_EV_type_id( const EV_type& ev_type ) const;
+    EVSE_type_id get_EVSE_type_id( const EVSE_type& se_type ) const;
+
+    const EV_type& get_EV_type( const EV_type_id EV_id ) const { return this->all_EVs[EV_id]; }
+    const EVSE_type& get_EVSE_type( const EVSE_type_id EVSE_id ) const { return this->all_EVSEs[EVSE_id]; }
+    const EVSE_level& get_EVSE_level( const EVSE_type_id EVSE_id ) const { return this->EVSE_levels[EVSE_id]; }
+
+    const EV_characteristics& get_EV_characteristics( const EV_type_id EV_id ) const { return this->EV_characteristics_by_id[EV_id]; }
+    const EVSE_characteristics& get_EVSE_characteristics( const EVSE_type_id EVSE_id ) const { return this->EVSE_characteristics_by_id[EVSE_id]; }
+
+    // Index into flat tables holding one entry per (EV, EVSE) combination.
+    int get_num_EV_EVSE_pairs() const { return this->get_num_EV_types() * this->get_num_EVSE_types(); }
+    int get_EV_EVSE_pair_index( const EV_type_id EV_id, const EVSE_type_id EVSE_id ) const { return EV_id * this->get_num_EVSE_types() + EVSE_id; }
+
+    bool pev_is_compatible_with_supply_equipment( const EV_type_id EV_id, const EVSE_type_id EVSE_id ) const;
 };
 
 std::ostream& operator<<(std::ostream& os, const EV_EVSE_inventory& inventory);
@@ -1,6 +1,7 @@
 #include "factory_EV_charge_model.h"
 
 #include "helper.h"                             //poly_segment
+#include "object_pool.h"                        // object_pool
 
 #include <vector>
 
@@ -31,19 +32,34 @@ vehicle_charge_model* factory_EV_charge_model::alloc_get_EV_charge_model(const c
 {
     const EV_type& EV = event.vehicle_type;
 
+    const EV_type_id EV_id = this->inventory.get_EV_type_id(EV);
+    const EVSE_type_id EVSE_id = this->inventory.get_EVSE_type_id(EVSE);
+    ASSERT(EV_id >= 0 && EVSE_id >= 0, "Error: EV_type:" << EV << " or SE_type:" << EVSE << " is not in the EV_EVSE_inventory." << std::endl);
+
+    return this->alloc_get_EV_charge_model(event, EV_id, EVSE_id, SE_P2_limit_kW);
+}
+
+
+vehicle_charge_model* factory_EV_charge_model::alloc_get_EV_charge_model(const charge_event_data& event,
+                                                                         const EV_type_id EV_id,
+                                                                         const EVSE_type_id EVSE_id,
+                                                                         const double SE_P2_limit_kW) const
+{
+    const EV_characteristics& EV_char = this->inventory.get_EV_characteristics(EV_id);
+
     double final_bat_size_kWh;
     if (this->model_stochastic_battery_degregation)
     {
-        final_bat_size_kWh = this->inventory.get_EV_inventory().at(EV).get_battery_size_with_stochastic_degradation_kWh();
+        final_bat_size_kWh = EV_char.get_battery_size_with_stochastic_degradation_kWh();
     }
     else
     {
-        final_bat_size_kWh = this->inventory.get_EV_inventory().at(EV).get_usable_battery_size_kWh();
+        final_bat_size_kWh = EV_char.get_usable_battery_size_kWh();
     }
     vehicle_charge_model_inputs inputs{
         event,
-        EV,
-        EVSE,
+        EV_id,
+        EVSE_id,
         SE_P2_limit_kW,
         final_bat_size_kWh,
         this->charging_transitions_obj,
@@ -52,8 +68,78 @@ vehicle_charge_model* factory_EV_charge_model::alloc_get_EV_charge_model(const c
         this->P2_vs_battery_eff_obj
     };
 
-    // The corresponding "delete" is done in 'supply_equipment_load::get_next' when the charge is completed.
-    return new vehicle_charge_model(inputs);
+    // The corresponding 'release_EV_charge_model' is done in 'supply_equipment_load::get_next' when the charge is completed.
+    if (this->model_stochastic_battery_degregation)
+    {
+        return object_pool<vehicle_charge_model>::acquire(inputs);
+    }
+
+    const SOC_vs_P2& curve = this->SOC_vs_P2_obj.get_SOC_vs_P2_curves(EV_id, EVSE_id, event.arrival_battery_temperature_C, event.arrival_SOC);
+    const EV_charge_model_prototype_key key{ EV_id, EVSE_id, SE_P2_limit_kW, final_bat_size_kWh, &curve };
+
+    // Charge events mostly hit a prototype, so lookups share the lock and only inserts take
+    // it exclusively.  A missing prototype is built outside of the lock; if another thread
+    // inserted the same key meanwhile, that one is used.  Once the cache is full a missing
+    // prototype is not built, the model is built directly.
+    std::shared_ptr<const vehicle_charge_model> prototype;
+    bool cache_is_full;
+    {
+        std::shared_lock<std::shared_mutex> lock(this->prototypes_mutex);
+
+        std::map<EV_charge_model_prototype_key, std::shared_ptr<const vehicle_charge_model> >::const_iterator it = this->prototypes.find(key);
+        if (it != this->prototypes.end())
+        {
+            prototype = it->second;
+        }
+
+        cache_is_full = (this->prototypes.size() >= max_num_EV_charge_model_prototypes);
+    }
+
+    if (prototype == nullptr)
+    {
+        if (cache_is_full)
+        {
+            return object_pool<vehicle_charge_model>::acquire(inputs);
+        }
+
+        std::shared_ptr<const vehicle_charge_model> new_prototype = std::make_shared<const vehicle_charge_model>(inputs);
+
+        std::unique_lock<std::shared_mutex> lock(this->prototypes_mutex);
+
+        std::map<EV_charge_model_prototype_key, std::shared_ptr<const vehicle_charge_model> >::const_iterator it = this->prototypes.find(key);
+        if (it != this->prototypes.end())
+        {
+            prototype = it->second;
+        }
+        else
+        {
+            prototype = new_prototype;
+
+            // Other threads may have filled the cache meanwhile.
+            if (this->prototypes.size() < max_num_EV_charge_model_prototypes)
+                this->prototypes.emplace(key, prototype);
+        }
+    }
+
+    return object_pool<vehicle_charge_model>::acquire(*prototype, event);
+}
+
+
+void factory_EV_charge_model::release_EV_charge_model(vehicle_charge_model* EV_charge_model)
+{
+    object_pool<vehicle_charge_model>::release(EV_charge_model);
+}
+
+
+int64_t factory_EV_charge_model::get_num_EV_charge_models_allocated()
+{
+    return object_pool<vehicle_charge_model>::get_num_allocated();
+}
+
+
+int64_t factory_EV_charge_model::get_num_EV_charge_models_reused()
+{
+    return object_pool<vehicle_charge_model>::get_num_reused();
 }
 
 
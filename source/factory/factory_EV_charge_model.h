@@ -3,6 +3,10 @@
 
 #include <unordered_map>
 #include <map>
+#include <memory>                                   // shared_ptr
+#include <shared_mutex>
+#include <tuple>
+#include <cstdint>                                  // int64_t
 
 #include "EV_EVSE_inventory.h"
 
@@ -31,16 +35,43 @@ private:
 
     const bool model_stochastic_battery_degregation;
 
+    // A model built for the first charge event of each (EV, EVSE, SE P2 limit, battery size,
+    // SOC_vs_P2 curve).  Later charge events with the same key are copied from it and only
+    // get their charge event fields set, without going through the factory lookups.  Not
+    // used with stochastic battery degradation, where every battery size differs.
+    typedef std::tuple<EV_type_id, EVSE_type_id, double, double, const SOC_vs_P2*> EV_charge_model_prototype_key;
+    static const int max_num_EV_charge_model_prototypes = 1024;
+
+    mutable std::shared_mutex prototypes_mutex;
+    mutable std::map<EV_charge_model_prototype_key, std::shared_ptr<const vehicle_charge_model> > prototypes;
+
 public:
 	factory_EV_charge_model(const EV_EVSE_inventory& inventory,
                             const EV_ramping_map& EV_ramping,
                             const EV_EVSE_ramping_map& EV_EVSE_ramping,
-                            const bool model_stochastic_battery_degregation);
+                            const bool model_stochastic_battery_degregation,
+                            const double c_rate_scale_factor = 1.0);
+    
+    const EV_EVSE_inventory& get_EV_EVSE_inventory() const { return this->inventory; }
     
     vehicle_charge_model* alloc_get_EV_charge_model(const charge_event_data& event, 
                                                     const EVSE_type& EVSE, 
                                                     const double SE_P2_limit_kW) const;
 
+    // Same as above with the types already resolved, used by the supply equipment every charge event.
+    vehicle_charge_model* alloc_get_EV_charge_model(const charge_event_data& event,
+                                                    const EV_type_id EV_id,
+                                                    const EVSE_type_id EVSE_id,
+                                                    const double SE_P2_limit_kW) const;
+
+    // EV charge models come from a per thread pool (see object_pool).  Release them here
+    // instead of deleting them so the next charge event reuses their storage.
+    static void release_EV_charge_model(vehicle_charge_model* EV_charge_model);
+
+    // Process wide counts of EV charge models created with new and reused from the pools.
+    static int64_t get_num_EV_charge_models_allocated();
+    static int64_t get_num_EV_charge_models_reused();
+
     void write_charge_profile(const std::string& output_path) const;
 };
 
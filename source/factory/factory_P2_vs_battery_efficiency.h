@@ -2,7 +2,6 @@
 #define FACTORY_P2_VS_BATTERY_EFFICIENCY_H
 
 #include <vector>
-#include <unordered_map>
 
 #include "factory_SOC_vs_P2.h"
 #include "EV_characteristics.h"
@@ -18,21 +17,23 @@ struct P2_vs_battery_efficiency
 							 const double& zero_slope_threshold);
 };
 
-typedef std::unordered_map<EV_type, std::unordered_map< battery_charge_mode, P2_vs_battery_efficiency> > P2_vs_battery_efficiency_map;
-
 class factory_P2_vs_battery_efficiency
 {
 private:
 	const EV_EVSE_inventory& inventory;
 
- 	const P2_vs_battery_efficiency_map P2_vs_battery_eff;
+	// Indexed by 2*EV_type_id + battery_charge_mode.
+	const std::vector<P2_vs_battery_efficiency> P2_vs_battery_eff_by_EV_id;
 
-	const P2_vs_battery_efficiency_map load_P2_vs_battery_eff();
+	const std::vector<P2_vs_battery_efficiency> load_P2_vs_battery_eff_by_EV_id() const;
 
 public:
 	factory_P2_vs_battery_efficiency(const EV_EVSE_inventory& inventory);
 
 	const P2_vs_battery_efficiency& get_P2_vs_battery_eff(const EV_type& EV, 
 														  const battery_charge_mode& mode) const;
+
+	const P2_vs_battery_efficiency& get_P2_vs_battery_eff(const EV_type_id EV_id, 
+														  const battery_charge_mode& mode) const;
 };
 #endif
\ No newline at end of file
@@ -1,7 +1,8 @@
 #include "factory_SOC_vs_P2.h"
 #include <fstream>
 #include <algorithm>
-#include <unordered_set>
+#include <functional>   // less
+#include <cmath>        // floor, ceil
 
 
 
@@ -793,10 +794,10 @@ factory_SOC_vs_P2::factory_SOC_vs_P2( const EV_EVSE_inventory& inventory, const
     LMO_charge{ this->load_LMO_charge() },
     NMC_charge{ this->load_NMC_charge() },
     LTO_charge{ this->load_LTO_charge() },
-    L1_L2_curves{ this->load_L1_L2_curves() },
-    DCFC_curves{ this->load_DCFC_curves( c_rate_scale_factor ) }
+    L1_L2_curves_by_EV_id{ this->load_L1_L2_curves_by_EV_id() },
+    DCFC_curves_by_pair_index{ this->load_DCFC_curves_by_pair_index( c_rate_scale_factor ) }
 #if TURN_ON_TEMPERATURE_AWARE_PROFILE_TESTING
-    , TA_DCFC_curves{ this->load_temperature_aware_DCFC_curves( c_rate_scale_factor, // const double max_c_rate_scale_factor,
+    , TA_DCFC_curves_by_pair_index{ this->load_temperature_aware_DCFC_curves_by_pair_index( c_rate_scale_factor, // const double max_c_rate_scale_factor,
                                                                    20,                  // const int n_curve_levels, 
                                                                    -20.0,               // const double min_start_temperature_C,
                                                                    40.0,                // const double max_start_temperature_C,
@@ -806,6 +807,8 @@ factory_SOC_vs_P2::factory_SOC_vs_P2( const EV_EVSE_inventory& inventory, const
                                                                    6.0                  // const double start_SOC_step
                                                                ) }
 #endif
+    , L1_L2_segments_by_EV_id{ this->load_P2_vs_soc_segments( this->L1_L2_curves_by_EV_id ) }
+    , DCFC_segments_by_pair_index{ this->load_P2_vs_soc_segments( this->DCFC_curves_by_pair_index ) }
 {
 }
 
@@ -815,48 +818,69 @@ const SOC_vs_P2& factory_SOC_vs_P2::get_SOC_vs_P2_curves( const EV_type& EV,
                                                           const double charge_start_battery_temperature_C,
                                                           const double charge_start_SOC ) const
 {
-    const EVSE_level& level = this->inventory.get_EVSE_inventory().at(EVSE).get_level();
+    const EV_type_id EV_id = this->inventory.get_EV_type_id(EV);
+    const EVSE_type_id EVSE_id = this->inventory.get_EVSE_type_id(EVSE);
+
+    if (EV_id < 0 || EVSE_id < 0)
+    {
+        ASSERT(false, "Error: P2_vs_soc is not defined in the EV_charge_model_factory for EV_type:" << EV << " and SE_type:" << EVSE << std::endl);
+        return this->error_case_curve;
+    }
+
+    return this->get_SOC_vs_P2_curves(EV_id, EVSE_id, charge_start_battery_temperature_C, charge_start_SOC);
+}
+
+
+// charge_start_battery_temperature_C and charge_start_SOC are only read by the
+// temperature aware DCFC curves.
+const SOC_vs_P2& factory_SOC_vs_P2::get_SOC_vs_P2_curves( const EV_type_id EV_id, 
+                                                          const EVSE_type_id EVSE_id,
+                                                          [[maybe_unused]] const double charge_start_battery_temperature_C,
+                                                          [[maybe_unused]] const double charge_start_SOC ) const
+{
+    const EVSE_level& level = this->inventory.get_EVSE_level(EVSE_id);
 
     if (level == EVSE_level::L1 || level == EVSE_level::L2)
     {
-        if (this->L1_L2_curves.find(EV) != this->L1_L2_curves.end())
+        const SOC_vs_P2& curve = this->L1_L2_curves_by_EV_id[EV_id];
+
+        if (!curve.curve.empty())
         {
-            return this->L1_L2_curves.at(EV);
+            return curve;
         }
         else
         {
-            ASSERT(false, "Error: P2_vs_soc is not defined in the EV_charge_model_factory for EV_type:" << EV << " and SE_type:" << EVSE << std::endl);
+            ASSERT(false, "Error: P2_vs_soc is not defined in the EV_charge_model_factory for EV_type:" << this->inventory.get_EV_type(EV_id) << " and SE_type:" << this->inventory.get_EVSE_type(EVSE_id) << std::endl);
             return this->error_case_curve;
         }
     }
 #if TURN_ON_TEMPERATURE_AWARE_PROFILE_TESTING
     else if (level == EVSE_level::DCFC)
     {
-        const std::pair<EV_type, EVSE_type> key = std::make_pair(EV, EVSE);
+        const temperature_aware::temperature_aware_profiles_data_store& ta_data_store = this->TA_DCFC_curves_by_pair_index[this->inventory.get_EV_EVSE_pair_index(EV_id, EVSE_id)];
 
-        if (this->TA_DCFC_curves.find(key) != this->TA_DCFC_curves.end())
+        if (!ta_data_store.temperatureSOCpair_to_power_profile_map.empty())
         {
-            const temperature_aware::temperature_aware_profiles_data_store& ta_data_store = this->TA_DCFC_curves.at(key);
             return ta_data_store.lookup_profile( charge_start_battery_temperature_C, charge_start_SOC );
         }
         else
         {
-            ASSERT(false, "Error: [TURN_ON_TEMPERATURE_AWARE_PROFILE_TESTING IS TRUE] P2_vs_soc is not defined in the EV_charge_model_factory for EV_type:" << EV << " and SE_type:" << EVSE << std::endl);
+            ASSERT(false, "Error: [TURN_ON_TEMPERATURE_AWARE_PROFILE_TESTING IS TRUE] P2_vs_soc is not defined in the EV_charge_model_factory for EV_type:" << this->inventory.get_EV_type(EV_id) << " and SE_type:" << this->inventory.get_EVSE_type(EVSE_id) << std::endl);
             return this->error_case_curve;
         }
     }
 #else
     else if (level == EVSE_level::DCFC)
     {
-        const std::pair<EV_type, EVSE_type> key = std::make_pair(EV, EVSE);
+        const SOC_vs_P2& curve = this->DCFC_curves_by_pair_index[this->inventory.get_EV_EVSE_pair_index(EV_id, EVSE_id)];
 
-        if (this->DCFC_curves.find(key) != this->DCFC_curves.end())
+        if (!curve.curve.empty())
         {
-            return this->DCFC_curves.at(key);
+            return curve;
         }
         else
         {
-            ASSERT(false, "Error: P2_vs_soc is not defined in the EV_charge_model_factory for EV_type:" << EV << " and SE_type:" << EVSE << std::endl);
+            ASSERT(false, "Error: P2_vs_soc is not defined in the EV_charge_model_factory for EV_type:" << this->inventory.get_EV_type(EV_id) << " and SE_type:" << this->inventory.get_EVSE_type(EVSE_id) << std::endl);
             return this->error_case_curve;
         }
     }
@@ -869,6 +893,169 @@ const SOC_vs_P2& factory_SOC_vs_P2::get_SOC_vs_P2_curves( const EV_type& EV,
 }
 
 
+namespace
+{
+    shared_P2_vs_soc_segments sort_P2_vs_soc_segments( const SOC_vs_P2& curve )
+    {
+        double min_soc = 1000;
+        double max_soc = -1000;
+
+        for (const line_segment& x : curve.curve)
+        {
+            if (x.x_LB < min_soc) min_soc = x.x_LB;
+            if (x.x_UB > max_soc) max_soc = x.x_UB;
+        }
+
+        ASSERT(min_soc >= -0.01 || max_soc <= 100.1, "PROBLEM: The following rule (for the P2_vs_soc_segments datatype) has been broken: min_soc < 0 and 100 < max_soc.");
+
+        std::vector<line_segment> segments = curve.curve;
+        std::sort(segments.begin(), segments.end());
+
+        return std::make_shared<const std::vector<line_segment> >(std::move(segments));
+    }
+}
+
+
+std::vector<line_segment> apply_P2_limit_to_P2_vs_soc_segments( const std::vector<line_segment>& P2_vs_soc_segments,
+                                                                const battery_charge_mode& mode,
+                                                                const double P2_limit )
+{
+	double soc_0, soc_1, soc_tmp, P_0, P_1, a, b;
+    double x_LB, x_UB, m, c;
+
+    std::vector<line_segment> new_P2_vs_soc_segments;
+	for(int i=0; i<P2_vs_soc_segments.size(); i++)
+    {
+        x_LB = P2_vs_soc_segments.at(i).x_LB;     // SOC 0
+        x_UB = P2_vs_soc_segments.at(i).x_UB;     // SOC 1
+        a = P2_vs_soc_segments.at(i).a;
+        b = P2_vs_soc_segments.at(i).b;
+
+        soc_0 = x_LB;
+        soc_1 = x_UB;
+        m = a;
+        c = b;
+
+        P_0 = m * soc_0 + c;        // y = mx + c;
+        P_1 = m * soc_1 + c;
+        
+        if(mode == battery_charge_mode::charging)
+        {
+		    if(P2_limit <= P_0 && P2_limit <= P_1)
+		    {
+		        a = 0;
+		        b = P2_limit;
+		    }
+		    else if(P_0 < P2_limit && P2_limit < P_1)
+		    {
+		        soc_tmp = (P2_limit - c)/m;
+		        x_UB = soc_tmp;
+		        
+                new_P2_vs_soc_segments.emplace_back(soc_tmp, soc_1, 0, P2_limit);
+		    }
+		    else if(P2_limit < P_0 && P_1 < P2_limit)
+		    {
+		        soc_tmp = (P2_limit - c)/m;
+		        x_LB = soc_tmp;
+		        
+                new_P2_vs_soc_segments.emplace_back(soc_0, soc_tmp, 0, P2_limit);
+		    }
+		}
+		else
+		{
+			if(P_0 <= P2_limit && P_1 <= P2_limit)
+		    {
+		        a = 0;
+		        b = P2_limit;        
+		    }
+		    else if(P2_limit < P_0 && P_1 < P2_limit)
+		    {
+		        soc_tmp = (P2_limit - c)/m;
+		        x_UB = soc_tmp;
+		        
+                new_P2_vs_soc_segments.emplace_back(soc_tmp, soc_1, 0, P2_limit);
+		    }
+		    else if(P_0 < P2_limit && P2_limit < P_1)
+		    {
+		        soc_tmp = (P2_limit - c)/m;
+		        x_LB = soc_tmp;
+
+                new_P2_vs_soc_segments.emplace_back(soc_0, soc_tmp, 0, P2_limit);
+		    }
+		}
+        new_P2_vs_soc_segments.emplace_back(x_LB, x_UB, a, b);
+    }
+    
+    std::sort(new_P2_vs_soc_segments.begin(), new_P2_vs_soc_segments.end());
+    return new_P2_vs_soc_segments;
+}
+
+
+const std::vector<shared_P2_vs_soc_segments> factory_SOC_vs_P2::load_P2_vs_soc_segments( const std::vector<SOC_vs_P2>& curves ) const
+{
+    std::vector<shared_P2_vs_soc_segments> return_val;
+    return_val.reserve(curves.size());
+
+    for (const SOC_vs_P2& curve : curves)
+        return_val.push_back(sort_P2_vs_soc_segments(curve));
+
+    return return_val;
+}
+
+
+shared_P2_vs_soc_segments factory_SOC_vs_P2::get_P2_vs_soc_segments( const SOC_vs_P2& curve ) const
+{
+    const std::less<const SOC_vs_P2*> less;
+
+    const SOC_vs_P2* L1_L2_begin = this->L1_L2_curves_by_EV_id.data();
+    if (!less(&curve, L1_L2_begin) && less(&curve, L1_L2_begin + this->L1_L2_curves_by_EV_id.size()))
+        return this->L1_L2_segments_by_EV_id[&curve - L1_L2_begin];
+
+    const SOC_vs_P2* DCFC_begin = this->DCFC_curves_by_pair_index.data();
+    if (!less(&curve, DCFC_begin) && less(&curve, DCFC_begin + this->DCFC_curves_by_pair_index.size()))
+        return this->DCFC_segments_by_pair_index[&curve - DCFC_begin];
+
+    // Temperature aware and error case curves are not shared.
+    return sort_P2_vs_soc_segments(curve);
+}
+
+
+shared_P2_vs_soc_segments factory_SOC_vs_P2::get_P2_limited_P2_vs_soc_segments( const SOC_vs_P2& curve,
+                                                                                const battery_charge_mode& mode,
+                                                                                const double P2_limit ) const
+{
+    // The limit is rounded to P2_limit_resolution_kW away from the curve, down when charging
+    // and up when discharging, so the battery never goes past the unrounded limit.
+    const double P2_limit_steps = P2_limit / P2_limit_resolution_kW;
+    const int64_t P2_limit_index = (int64_t)((mode == battery_charge_mode::charging) ? std::floor(P2_limit_steps) : std::ceil(P2_limit_steps));
+
+    const P2_limited_segments_key key{ &curve, mode, P2_limit_index };
+    bool cache_is_full;
+    {
+        std::shared_lock<std::shared_mutex> lock(this->P2_limited_segments_mutex);
+
+        std::map<P2_limited_segments_key, shared_P2_vs_soc_segments>::const_iterator it = this->P2_limited_segments_cache.find(key);
+        if (it != this->P2_limited_segments_cache.end())
+            return it->second;
+
+        cache_is_full = (this->P2_limited_segments_cache.size() >= max_num_cached_P2_limited_segments);
+    }
+
+    shared_P2_vs_soc_segments return_val = std::make_shared<const std::vector<line_segment> >(apply_P2_limit_to_P2_vs_soc_segments(*this->get_P2_vs_soc_segments(curve), mode, P2_limit_index * P2_limit_resolution_kW));
+
+    if (cache_is_full)
+        return return_val;
+
+    // Another thread may have inserted the same key meanwhile, then its segments are used.
+    std::unique_lock<std::shared_mutex> lock(this->P2_limited_segments_mutex);
+
+    if (this->P2_limited_segments_cache.size() >= max_num_cached_P2_limited_segments)
+        return return_val;
+
+    return this->P2_limited_segments_cache.emplace(key, return_val).first->second;
+}
+
+
 const create_dcPkW_from_soc factory_SOC_vs_P2::load_LMO_charge()
 {
     std::map<SOC, std::pair<power, point_type> > points;
@@ -1109,104 +1296,82 @@ const create_dcPkW_from_soc factory_SOC_vs_P2::load_LTO_charge()
 }
 
 
-const std::unordered_map<EV_type, SOC_vs_P2 > factory_SOC_vs_P2::load_L1_L2_curves()
+const std::vector<SOC_vs_P2> factory_SOC_vs_P2::load_L1_L2_curves_by_EV_id()
 {
-    std::unordered_map<EV_type, SOC_vs_P2 > return_val;
+    std::vector<SOC_vs_P2> return_val;
+    return_val.reserve(this->inventory.get_num_EV_types());
 
-    const EV_inventory& EV_inv = this->inventory.get_EV_inventory();
-    
-    for (const auto& EVs : EV_inv)
+    for (EV_type_id EV_id = 0; EV_id < this->inventory.get_num_EV_types(); EV_id++)
     {
-        const EV_type& EV = EVs.first;
-        const EV_characteristics& EV_char = EVs.second;
+        const EV_type& EV = this->inventory.get_EV_type(EV_id);
+        const EV_characteristics& EV_char = this->inventory.get_EV_characteristics(EV_id);
 
         const battery_chemistry& chemistry = EV_char.get_chemistry();
 
         if (chemistry == battery_chemistry::LMO)
         {
-            return_val.emplace(EV, this->LMO_charge.get_L1_or_L2_charge_profile(EV));
+            return_val.push_back(this->LMO_charge.get_L1_or_L2_charge_profile(EV));
         }
         else if (chemistry == battery_chemistry::NMC)
         {
-            return_val.emplace(EV, this->NMC_charge.get_L1_or_L2_charge_profile(EV));
+            return_val.push_back(this->NMC_charge.get_L1_or_L2_charge_profile(EV));
         }
         else if (chemistry == battery_chemistry::LTO)
         {
-            return_val.emplace(EV, this->LTO_charge.get_L1_or_L2_charge_profile(EV));
+            return_val.push_back(this->LTO_charge.get_L1_or_L2_charge_profile(EV));
         }
         else
         {
             ASSERT(false, "Error: Invalid battery chemistry for EV_type:" << EV << std::endl);
+            return_val.emplace_back();
         }
     }
     return return_val;
 }
 
 
-const std::unordered_map< std::pair<EV_type, EVSE_type>, SOC_vs_P2, pair_hash > factory_SOC_vs_P2::load_DCFC_curves( const double c_rate_scale_factor )
+// Pairs that are not DCFC, or with an EV that is not DCFC capable, hold an empty curve.
+const std::vector<SOC_vs_P2> factory_SOC_vs_P2::load_DCFC_curves_by_pair_index( const double c_rate_scale_factor )
 {
-    std::unordered_map< std::pair<EV_type, EVSE_type>, SOC_vs_P2, pair_hash > return_val;
+    std::vector<SOC_vs_P2> return_val;
+    return_val.reserve(this->inventory.get_num_EV_EVSE_pairs());
 
-    const EV_inventory& EV_inv = this->inventory.get_EV_inventory();
-    const EVSE_inventory& EVSE_inv = this->inventory.get_EVSE_inventory();
+    const battery_charge_mode mode = battery_charge_mode::charging;
 
-    for (const auto& EVSE_elem : EVSE_inv)
+    // Pushed in EV_EVSE_pair_index order, EVSE_type_id varies fastest.
+    for (EV_type_id EV_id = 0; EV_id < this->inventory.get_num_EV_types(); EV_id++)
     {
-        const EVSE_type& EVSE = EVSE_elem.first;
-        const EVSE_characteristics& EVSE_char = EVSE_elem.second;
-        const EVSE_level& level = EVSE_char.get_level();
+        const EV_type& EV = this->inventory.get_EV_type(EV_id);
+        const EV_characteristics& EV_char = this->inventory.get_EV_characteristics(EV_id);
+        const battery_chemistry& chemistry = EV_char.get_chemistry();
 
-        if (level == EVSE_level::DCFC)
+        for (EVSE_type_id EVSE_id = 0; EVSE_id < this->inventory.get_num_EVSE_types(); EVSE_id++)
         {
-            for (const auto& EV_elem : EV_inv)
-            {
-                const EV_type& EV = EV_elem.first;
-                const EV_characteristics& EV_char = EV_elem.second;
-                const bool& DCFC_capable = EV_char.get_DCFC_capable();
+            const EVSE_type& EVSE = this->inventory.get_EVSE_type(EVSE_id);
 
-                if (DCFC_capable == true)
-                {
-                    const battery_chemistry& chemistry = EV_char.get_chemistry();
-                    // // NOTE: I commentted these out because these are not being used here.
-                    //const double& battery_size_kWh = EV_char.get_battery_size_kWh();
-                    //const double& bat_size_Ah_1C = EV_char.get_battery_size_Ah_1C();
-                    //const double& max_c_rate = EV_char.get_max_c_rate();
-                    //const double& power_limit_kW = EVSE_char.get_power_limit_kW();
-                    //const double& DC_current_limit = EVSE_char.get_current_limit_A();
-
-                    const battery_charge_mode mode = battery_charge_mode::charging;
-
-                    // charge profile is not a reference because the data is not stored by the object.
-                    if (chemistry == battery_chemistry::LMO)
-                    {
-                        return_val.emplace(std::make_pair(EV, EVSE), this->LMO_charge.get_dcfc_charge_profile(mode, EV, EVSE, c_rate_scale_factor));
-                    }
-                    else if (chemistry == battery_chemistry::NMC)
-                    {
-                        return_val.emplace(std::make_pair(EV, EVSE), this->NMC_charge.get_dcfc_charge_profile(mode, EV, EVSE, c_rate_scale_factor));
-                    }
-                    else if (chemistry == battery_chemistry::LTO)
-                    {
-                        return_val.emplace(std::make_pair(EV, EVSE), this->LTO_charge.get_dcfc_charge_profile(mode, EV, EVSE, c_rate_scale_factor));
-                    }
-                    else
-                    {
-                        ASSERT(false, "Error: Invalid battery chemistry for EV_type:" << EV << std::endl);
-                    }
-                    //constraints = factory_obj.get_constraints()
-                }
-                else
-                {
-                    continue;
-                }
+            if (this->inventory.get_EVSE_level(EVSE_id) != EVSE_level::DCFC || !EV_char.get_DCFC_capable())
+            {
+                return_val.emplace_back();
+            }
+            else if (chemistry == battery_chemistry::LMO)
+            {
+                return_val.push_back(this->LMO_charge.get_dcfc_charge_profile(mode, EV, EVSE, c_rate_scale_factor));
+            }
+            else if (chemistry == battery_chemistry::NMC)
+            {
+                return_val.push_back(this->NMC_charge.get_dcfc_charge_profile(mode, EV, EVSE, c_rate_scale_factor));
+            }
+            else if (chemistry == battery_chemistry::LTO)
+            {
+                return_val.push_back(this->LTO_charge.get_dcfc_charge_profile(mode, EV, EVSE, c_rate_scale_factor));
+            }
+            else
+            {
+                ASSERT(false, "Error: Invalid battery chemistry for EV_type:" << EV << std::endl);
+                return_val.emplace_back();
             }
-        }
-        else
-        {
-            continue;
         }
     }
-
     return return_val;
 }
 
@@ -1214,8 +1379,8 @@ const std::unordered_map< std::pair<EV_type, EVSE_type>, SOC_vs_P2, pair_hash >
 
 
 
-const std::unordered_map< std::pair<EV_type, EVSE_type>, temperature_aware::temperature_aware_profiles_data_store, pair_hash >&
-factory_SOC_vs_P2::load_temperature_aware_DCFC_curves( 
+const std::vector< temperature_aware::temperature_aware_profiles_data_store >&
+factory_SOC_vs_P2::load_temperature_aware_DCFC_curves_by_pair_index( 
                                             const double max_c_rate_scale_factor,
                                             const int n_curve_levels,
                                             const double min_start_temperature_C,
@@ -1229,7 +1394,7 @@ factory_SOC_vs_P2::load_temperature_aware_DCFC_curves(
     const EVSE_inventory& EVSE_inv = this->inventory.get_EVSE_inventory();
     
     // ---- helper function ----
-    // Generate unique key for this call to 'load_temperature_aware_DCFC_curves' based on the parameters.
+    // Generate unique key for this call to 'load_temperature_aware_DCFC_curves_by_pair_index' based on the parameters.
     auto generate_unique_key_string = [&] () -> std::string {
         std::stringstream ss;
         for (const auto& EVSE_elem : EVSE_inv)
@@ -1261,7 +1426,8 @@ factory_SOC_vs_P2::load_temperature_aware_DCFC_curves(
     // in the static variable.
     if( TA_DCFC_CURVES_CACHE.find( data_store_identifier_key ) == TA_DCFC_CURVES_CACHE.end() )
     {
-        std::unordered_map< std::pair<EV_type, EVSE_type>, temperature_aware::temperature_aware_profiles_data_store, pair_hash > return_value;
+        // Pairs without DCFC curves hold an empty data store.
+        std::vector< temperature_aware::temperature_aware_profiles_data_store > return_value( this->inventory.get_num_EV_EVSE_pairs() );
     
         // For each (EV_type,EVSE_type) pair, we generate a matrix of 'SOC_vs_P2' profiles, one for each (start_temperature_C,start_SOC) pair.
         // We store these in the 'temperature_aware::temperature_aware_profiles_data_store'.
@@ -1271,17 +1437,11 @@ factory_SOC_vs_P2::load_temperature_aware_DCFC_curves(
         // Step 1: Load 'n_curve_levels' curves at different c-rate levels.
         // ---------------------------------------------------------------------------------------------------
         
-        std::vector< std::unordered_map< std::pair<EV_type, EVSE_type>, SOC_vs_P2, pair_hash > > curves_each_level_array;
-        std::unordered_set< std::pair<EV_type, EVSE_type>, pair_hash > ev_evse_pairs_set;
+        std::vector< std::vector< SOC_vs_P2 > > curves_each_level_array;
         for( int i = 0; i < n_curve_levels; i++ )
         {
             const double adjusted_c_rate_scale_factor = max_c_rate_scale_factor * ((double)(i+1))/((double)n_curve_levels);
-            const std::unordered_map< std::pair<EV_type, EVSE_type>, SOC_vs_P2, pair_hash >& curves_for_level_i = factory_SOC_vs_P2::load_DCFC_curves( adjusted_c_rate_scale_factor );
-            curves_each_level_array.push_back( curves_for_level_i );
-            for( const auto& evevsepair_curve_pair : curves_for_level_i )
-            {
-                ev_evse_pairs_set.insert( evevsepair_curve_pair.first );
-            }
+            curves_each_level_array.push_back( factory_SOC_vs_P2::load_DCFC_curves_by_pair_index( adjusted_c_rate_scale_factor ) );
         }
         
         // ---------------------------------------------
@@ -1372,8 +1532,16 @@ factory_SOC_vs_P2::load_temperature_aware_DCFC_curves(
         // We always end with SOC=100
         const double end_soc = 100;
 
-        for( const auto& ev_evse_pair : ev_evse_pairs_set )
+        for( int pair_index = 0; pair_index < this->inventory.get_num_EV_EVSE_pairs(); pair_index++ )
         {
+            // Every level has curves for the same pairs.
+            if( curves_each_level_array.empty() || curves_each_level_array.at(0).at( pair_index ).curve.empty() )
+                continue;
+
+            const EV_type_id EV_id = pair_index / this->inventory.get_num_EVSE_types();
+            const EVSE_type_id EVSE_id = pair_index % this->inventory.get_num_EVSE_types();
+            const std::pair<EV_type, EVSE_type> ev_evse_pair = std::make_pair( this->inventory.get_EV_type(EV_id), this->inventory.get_EVSE_type(EVSE_id) );
+
             // Create an instance of 'temperature_aware::temperature_aware_profiles_data_store'
             temperature_aware::temperature_aware_profiles_data_store TAP_data_store;
             
@@ -1382,14 +1550,14 @@ factory_SOC_vs_P2::load_temperature_aware_DCFC_curves(
                 std::vector< SOC_vs_P2 > power_profiles_sorted_low_to_high;
                 for( int i = 0; i < n_curve_levels; i++ )
                 {
-                    const SOC_vs_P2& socvsp2_for_level_i = curves_each_level_array.at(i).at( ev_evse_pair );
+                    const SOC_vs_P2& socvsp2_for_level_i = curves_each_level_array.at(i).at( pair_index );
                     power_profiles_sorted_low_to_high.push_back( socvsp2_for_level_i );
                 }
                 return power_profiles_sorted_low_to_high;
             }();
             
             // Other parameters
-            const double battery_capacity_kWh = EV_inv.at(ev_evse_pair.first).get_usable_battery_size_kWh();
+            const double battery_capacity_kWh = this->inventory.get_EV_characteristics(EV_id).get_usable_battery_size_kWh();
             
             // Loop over each pair of values in the matrix, and build the profile for each.
             for( double start_temperature_C = min_start_temperature_C; start_temperature_C <= (max_start_temperature_C + 1e-8); start_temperature_C += start_temperature_step )
@@ -1512,7 +1680,7 @@ factory_SOC_vs_P2::load_temperature_aware_DCFC_curves(
             //  --------------------------------------------------------
             //  Saving the result in the 'return_value' data structure.
             //  --------------------------------------------------------
-            return_value.emplace( ev_evse_pair, TAP_data_store );
+            return_value.at( pair_index ) = TAP_data_store;
         }
         
         // Save the value in the static variable.
@@ -1561,11 +1729,14 @@ void factory_SOC_vs_P2::write_charge_profile(const std::string& output_path) con
         
         std::vector<std::vector<double> > all_dcfc_profiles;
 
-        for (const auto& curves : this->DCFC_curves)
+        for (int pair_index = 0; pair_index < (int)this->DCFC_curves_by_pair_index.size(); pair_index++)
         {
-            const EV_type& EV = curves.first.first;
-            const EVSE_type& EVSE = curves.first.second;
-            const std::vector<line_segment>& profile = curves.second.curve;
+            const std::vector<line_segment>& profile = this->DCFC_curves_by_pair_index[pair_index].curve;
+            if (profile.empty())
+                continue;
+
+            const EV_type& EV = this->inventory.get_EV_type(pair_index / this->inventory.get_num_EVSE_types());
+            const EVSE_type& EVSE = this->inventory.get_EVSE_type(pair_index % this->inventory.get_num_EVSE_types());
 
             header += EV + "_" + EVSE + ", ";
 
@@ -1625,10 +1796,10 @@ void factory_SOC_vs_P2::write_charge_profile(const std::string& output_path) con
 
         std::vector<std::vector<double> > all_L1_L2_profiles;
 
-        for (const auto& curves : this->L1_L2_curves)
+        for (EV_type_id EV_id = 0; EV_id < (int)this->L1_L2_curves_by_EV_id.size(); EV_id++)
         {
-            const EV_type& EV = curves.first;
-            const std::vector<line_segment>& profile = curves.second.curve;
+            const EV_type& EV = this->inventory.get_EV_type(EV_id);
+            const std::vector<line_segment>& profile = this->L1_L2_curves_by_EV_id[EV_id].curve;
 
             header += EV + ", ";
 
@@ -3,6 +3,10 @@
 
 #include <map>
 #include <unordered_map>
+#include <memory>       // shared_ptr
+#include <shared_mutex>
+#include <tuple>
+#include <cstdint>      // int64_t
 
 #include "EV_EVSE_inventory.h"
 
@@ -16,7 +20,8 @@ typedef double power;
 
 #define TURN_ON_TEMPERATURE_AWARE_PROFILE_TESTING 0
 
-static std::map< std::string, std::unordered_map< std::pair<EV_type, EVSE_type>, temperature_aware::temperature_aware_profiles_data_store, pair_hash > > TA_DCFC_CURVES_CACHE;
+// Indexed by EV_EVSE_pair_index, see factory_SOC_vs_P2::load_temperature_aware_DCFC_curves_by_pair_index.
+static std::map< std::string, std::vector< temperature_aware::temperature_aware_profiles_data_store > > TA_DCFC_CURVES_CACHE;
 
 enum class point_type
 {
@@ -40,6 +45,14 @@ struct bat_objfun_constraints
 
 typedef std::map<c_rate, std::map<SOC, std::pair<power, point_type> >, std::greater<c_rate> > curves_grouping;
 
+// P2_vs_soc segments sorted by soc, shared read only by the batteries using them.
+typedef std::shared_ptr<const std::vector<line_segment> > shared_P2_vs_soc_segments;
+
+// The sorted P2_vs_soc_segments with P2 clipped at P2_limit (a lower bound when discharging).
+std::vector<line_segment> apply_P2_limit_to_P2_vs_soc_segments( const std::vector<line_segment>& P2_vs_soc_segments,
+                                                                const battery_charge_mode& mode,
+                                                                const double P2_limit );
+
 class create_dcPkW_from_soc
 {
 private:
@@ -84,19 +97,35 @@ private:
 
     std::vector<bat_objfun_constraints> constraints;
 
-    const std::unordered_map<EV_type, SOC_vs_P2 > L1_L2_curves;
-    const std::unordered_map< std::pair<EV_type, EVSE_type>, SOC_vs_P2, pair_hash > DCFC_curves;
-    const std::unordered_map< std::pair<EV_type, EVSE_type>, temperature_aware::temperature_aware_profiles_data_store, pair_hash > TA_DCFC_curves;
+    // The curves indexed by EV_type_id and by EV_EVSE_pair_index.  Combinations without a
+    // curve hold an empty curve (an empty data store for the temperature aware curves).
+    const std::vector<SOC_vs_P2> L1_L2_curves_by_EV_id;
+    const std::vector<SOC_vs_P2> DCFC_curves_by_pair_index;
+    const std::vector< temperature_aware::temperature_aware_profiles_data_store > TA_DCFC_curves_by_pair_index;
     const SOC_vs_P2 error_case_curve; // <-- empty data structure the reference to which is returned in error cases.
 
+    // The curves above sorted by soc, built once and shared by the batteries using them.
+    const std::vector<shared_P2_vs_soc_segments> L1_L2_segments_by_EV_id;
+    const std::vector<shared_P2_vs_soc_segments> DCFC_segments_by_pair_index;
+
+    // The sorted curves with a P2 limit applied, keyed by the curve, the mode and the limit
+    // in steps of P2_limit_resolution_kW.  Past max_num_cached_P2_limited_segments they are
+    // built for the caller only.
+    typedef std::tuple<const SOC_vs_P2*, battery_charge_mode, int64_t> P2_limited_segments_key;
+    static const int max_num_cached_P2_limited_segments = 4096;
+
+    mutable std::shared_mutex P2_limited_segments_mutex;
+    mutable std::map<P2_limited_segments_key, shared_P2_vs_soc_segments> P2_limited_segments_cache;
+
     const create_dcPkW_from_soc load_LMO_charge();
     const create_dcPkW_from_soc load_NMC_charge();
     const create_dcPkW_from_soc load_LTO_charge();
 
-    const std::unordered_map<EV_type, SOC_vs_P2 > load_L1_L2_curves();
-    const std::unordered_map< std::pair<EV_type, EVSE_type>, SOC_vs_P2, pair_hash > load_DCFC_curves( const double c_rate_scale_factor = 1.0 );
+    const std::vector<SOC_vs_P2> load_L1_L2_curves_by_EV_id();
+    const std::vector<SOC_vs_P2> load_DCFC_curves_by_pair_index( const double c_rate_scale_factor = 1.0 );
+    const std::vector<shared_P2_vs_soc_segments> load_P2_vs_soc_segments( const std::vector<SOC_vs_P2>& curves ) const;
     
-    const std::unordered_map< std::pair<EV_type, EVSE_type>, temperature_aware::temperature_aware_profiles_data_store, pair_hash >& load_temperature_aware_DCFC_curves( 
+    const std::vector< temperature_aware::temperature_aware_profiles_data_store >& load_temperature_aware_DCFC_curves_by_pair_index( 
                                                                                                                             const double max_c_rate_scale_factor,
                                                                                                                             const int n_curve_levels,
                                                                                                                             const double min_start_temperature_C,
@@ -115,6 +144,25 @@ public:
                                            const double charge_start_SOC    // <-- In percent a.k.a. 45% SOC is 45.0.
                                       ) const;
 
+    const SOC_vs_P2& get_SOC_vs_P2_curves( const EV_type_id EV_id, 
+                                           const EVSE_type_id EVSE_id,
+                                           const double charge_start_battery_temperature_C,
+                                           const double charge_start_SOC    // <-- In percent a.k.a. 45% SOC is 45.0.
+                                      ) const;
+
+    // The curve sorted by soc.  'curve' must be returned by get_SOC_vs_P2_curves.
+    shared_P2_vs_soc_segments get_P2_vs_soc_segments( const SOC_vs_P2& curve ) const;
+
+    // The limits the curves are clipped at are rounded to this, the same as the change of
+    // the P2 limit calculate_E1_energy_limit waits for before applying it again.
+    static constexpr double P2_limit_resolution_kW = 0.5;
+
+    // The sorted curve with P2 clipped at P2_limit rounded to P2_limit_resolution_kW, down
+    // when charging and up when discharging (a lower bound).
+    shared_P2_vs_soc_segments get_P2_limited_P2_vs_soc_segments( const SOC_vs_P2& curve,
+                                                                 const battery_charge_mode& mode,
+                                                                 const double P2_limit ) const;
+
     void write_charge_profile(const std::string& output_path) const;
 };
 
@@ -1,13 +1,14 @@
 #include "factory_ac_to_dc_converter.h"
 
+#include "object_pool.h"                        // object_pool
+
 //#############################################################################
 //                      AC to DC Converter Factory
 //#############################################################################
 
 ac_to_dc_converter* factory_ac_to_dc_converter::alloc_get_ac_to_dc_converter(
     ac_to_dc_converter_enum converter_type, 
-    EVSE_type EVSE, 
-    EV_type EV, 
+    const EVSE_type_id EVSE_id, 
     charge_event_P3kW_limits& P3kW_limits
 ) const
 {
@@ -17,8 +18,8 @@ ac_to_dc_converter* factory_ac_to_dc_converter::alloc_get_ac_to_dc_converter(
     //=============================================================
     //=============================================================
 
-    const EVSE_level level = this->inventory.get_EVSE_inventory().at(EVSE).get_level();
-    const double power_limit = this->inventory.get_EVSE_inventory().at(EVSE).get_power_limit_kW();
+    const EVSE_level level = this->inventory.get_EVSE_level(EVSE_id);
+    const double power_limit = this->inventory.get_EVSE_characteristics(EVSE_id).get_power_limit_kW();
 
     if (level == EVSE_level::L1)
     {
@@ -201,16 +202,44 @@ ac_to_dc_converter* factory_ac_to_dc_converter::alloc_get_ac_to_dc_converter(
     ac_to_dc_converter* return_val = NULL;
 
     if (converter_type == ac_to_dc_converter_enum::pf)
-        return_val = new ac_to_dc_converter_pf(P3kW_limits, S3kVA_from_max_nominal_P3kW_multiplier, inv_eff_from_P2, inv_pf_from_P3);
+        return_val = object_pool<ac_to_dc_converter_pf>::acquire(P3kW_limits, S3kVA_from_max_nominal_P3kW_multiplier, inv_eff_from_P2, inv_pf_from_P3);
 
     else if (converter_type == ac_to_dc_converter_enum::Q_setpoint)
-        return_val = new ac_to_dc_converter_Q_setpoint(P3kW_limits, S3kVA_from_max_nominal_P3kW_multiplier, inv_eff_from_P2);
+        return_val = object_pool<ac_to_dc_converter_Q_setpoint>::acquire(P3kW_limits, S3kVA_from_max_nominal_P3kW_multiplier, inv_eff_from_P2);
 
     else
     {
         std::cout << "ERROR:  In factory_ac_to_dc_converter undefigned converter_type." << std::endl;
-        return_val = new ac_to_dc_converter_pf(P3kW_limits, S3kVA_from_max_nominal_P3kW_multiplier, inv_eff_from_P2, inv_pf_from_P3);
+        return_val = object_pool<ac_to_dc_converter_pf>::acquire(P3kW_limits, S3kVA_from_max_nominal_P3kW_multiplier, inv_eff_from_P2, inv_pf_from_P3);
     }
 
     return return_val;
 }
+
+
+void factory_ac_to_dc_converter::release_ac_to_dc_converter( ac_to_dc_converter* converter )
+{
+    if(converter == NULL)
+        return;
+
+    if(ac_to_dc_converter_pf* X = dynamic_cast<ac_to_dc_converter_pf*>(converter))
+        object_pool<ac_to_dc_converter_pf>::release(X);
+
+    else if(ac_to_dc_converter_Q_setpoint* X = dynamic_cast<ac_to_dc_converter_Q_setpoint*>(converter))
+        object_pool<ac_to_dc_converter_Q_setpoint>::release(X);
+
+    else
+        delete converter;
+}
+
+
+int64_t factory_ac_to_dc_converter::get_num_converters_allocated()
+{
+    return object_pool<ac_to_dc_converter_pf>::get_num_allocated() + object_pool<ac_to_dc_converter_Q_setpoint>::get_num_allocated();
+}
+
+
+int64_t factory_ac_to_dc_converter::get_num_converters_reused()
+{
+    return object_pool<ac_to_dc_converter_pf>::get_num_reused() + object_pool<ac_to_dc_converter_Q_setpoint>::get_num_reused();
+}
@@ -6,6 +6,8 @@
 #include "EVSE_characteristics.h"
 #include "EV_EVSE_inventory.h"
 
+#include <cstdint>                      // int64_t
+
 //#############################################################################
 //                      AC to DC Converter Factory
 //#############################################################################
@@ -22,10 +24,17 @@ public:
     }
     ac_to_dc_converter* alloc_get_ac_to_dc_converter(
         ac_to_dc_converter_enum converter_type, 
-        EVSE_type EVSE, 
-        EV_type EV, 
+        const EVSE_type_id EVSE_id, 
         charge_event_P3kW_limits& CE_P3kW_limits
     ) const;
+
+    // Converters come from a per thread pool (see object_pool).  Release them here
+    // instead of deleting them so the next charge event reuses their storage.
+    static void release_ac_to_dc_converter( ac_to_dc_converter* converter );
+
+    // Process wide counts of converters created with new and reused from the pools.
+    static int64_t get_num_converters_allocated();
+    static int64_t get_num_converters_reused();
 };
 
 #endif  // FACTORY_AC_TO_DC_CONVERTER_H
\ No newline at end of file
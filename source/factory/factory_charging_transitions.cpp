@@ -2,20 +2,6 @@
 
 #include "battery_integrate_X_in_time.h"		// integrate_X_through_time, transition_goto_next_segment_criteria, transition_of_X_through_time
 
-//###########################################
-//          charging_transitions
-//###########################################
-
-charging_transitions::charging_transitions(const EVSE_level_charging_transitions& charging_transitions_by_EVSE_level,
-										   const EV_charging_transitions& charging_transitions_by_custom_EV,
-										   const EV_EVSE_charging_transitions& charging_transitions_by_custom_EV_EVSE)
-	: charging_transitions_by_EVSE_level{ charging_transitions_by_EVSE_level },
-	charging_transitions_by_custom_EV{ charging_transitions_by_custom_EV },
-	charging_transitions_by_custom_EV_EVSE{ charging_transitions_by_custom_EV_EVSE }
-{
-}
-
-
 //###########################################
 //          factory_charging_transitions
 //###########################################
@@ -24,16 +10,15 @@ factory_charging_transitions::factory_charging_transitions(const EV_EVSE_invento
 														   const EV_ramping_map& custom_EV_ramping,
 														   const EV_EVSE_ramping_map& custom_EV_EVSE_ramping)
     : inventory{ inventory },
-    custom_EV_ramping{ custom_EV_ramping },
-    custom_EV_EVSE_ramping{ custom_EV_EVSE_ramping },
-    charging_transitions_obj{ this->load_charging_transitions() }
+    charging_transitions_by_pair_index{ this->load_charging_transitions_by_pair_index(custom_EV_ramping, custom_EV_EVSE_ramping) }
 {
 }
 
 
-const charging_transitions factory_charging_transitions::load_charging_transitions()
+const std::vector<integrate_X_through_time> factory_charging_transitions::load_charging_transitions_by_pair_index(const EV_ramping_map& custom_EV_ramping,
+                                                                                                                 const EV_EVSE_ramping_map& custom_EV_EVSE_ramping) const
 {
-    EVSE_level_charging_transitions transitions_by_EVSE_level;
+    std::unordered_map<EVSE_level, integrate_X_through_time> transitions_by_EVSE_level;
 
     /*
 	Each transition_of_X_through_time must have at least 3 segments.
@@ -327,56 +312,65 @@ const charging_transitions factory_charging_transitions::load_charging_transitio
             pos_moving_toward_pos_inf_obj, pos_moving_toward_neg_inf_obj, neg_moving_toward_pos_inf_obj, neg_moving_toward_neg_inf_obj };
     };
     
-    EV_charging_transitions charging_transitions_by_custom_EV;
-    
-    for (const std::pair<EV_type, pev_charge_ramping>& custom_ramping : this->custom_EV_ramping)
+    //--------------------------------------------
+    //      transitions by EV_EVSE_pair_index
+    //--------------------------------------------
+
+    // Every pair starts from the transitions of its EVSE level.  For DCFC, a custom ramping of
+    // the EV replaces them and a custom ramping of the EV_EVSE pair replaces both.  Custom
+    // rampings of types that are not in the inventory are ignored.
+    std::vector<integrate_X_through_time> return_val;
+    return_val.reserve(this->inventory.get_num_EV_EVSE_pairs());
+
+    // Pushed in EV_EVSE_pair_index order, EVSE_type_id varies fastest.
+    for (EV_type_id EV_id = 0; EV_id < this->inventory.get_num_EV_types(); EV_id++)
+    {
+        for (EVSE_type_id EVSE_id = 0; EVSE_id < this->inventory.get_num_EVSE_types(); EVSE_id++)
+        {
+            return_val.push_back(transitions_by_EVSE_level.at(this->inventory.get_EVSE_level(EVSE_id)));
+        }
+    }
+
+    for (const std::pair<const EV_type, pev_charge_ramping>& custom_ramping : custom_EV_ramping)
     {
-        const EV_type& EV = custom_ramping.first;
+        const EV_type_id EV_id = this->inventory.get_EV_type_id(custom_ramping.first);
+        if (EV_id < 0)
+            continue;
+
         custom_charge_ramping = custom_ramping.second;
+        const integrate_X_through_time custom_transitions = load_custom_ramping();
 
-        charging_transitions_by_custom_EV.emplace(EV, load_custom_ramping());
+        for (EVSE_type_id EVSE_id = 0; EVSE_id < this->inventory.get_num_EVSE_types(); EVSE_id++)
+        {
+            if (this->inventory.get_EVSE_level(EVSE_id) == DCFC)
+                return_val[this->inventory.get_EV_EVSE_pair_index(EV_id, EVSE_id)] = custom_transitions;
+        }
     }
 
-    //--------------------------------------------
-    //      transition_by_custom_EV_EVSE
-    //--------------------------------------------
-
-    EV_EVSE_charging_transitions charging_transitions_by_custom_EV_EVSE;
-    
-    for (const std::pair<std::pair<EV_type, EVSE_type>, pev_charge_ramping>& custom_ramping : this->custom_EV_EVSE_ramping)
+    for (const std::pair<const std::pair<EV_type, EVSE_type>, pev_charge_ramping>& custom_ramping : custom_EV_EVSE_ramping)
     {
-        const std::pair<EV_type, EVSE_type>& EV_EVSE = custom_ramping.first;
-        custom_charge_ramping = custom_ramping.second;
+        const EV_type_id EV_id = this->inventory.get_EV_type_id(custom_ramping.first.first);
+        const EVSE_type_id EVSE_id = this->inventory.get_EVSE_type_id(custom_ramping.first.second);
+        if (EV_id < 0 || EVSE_id < 0 || this->inventory.get_EVSE_level(EVSE_id) != DCFC)
+            continue;
 
-        charging_transitions_by_custom_EV_EVSE.emplace(EV_EVSE, load_custom_ramping());
+        custom_charge_ramping = custom_ramping.second;
+        return_val[this->inventory.get_EV_EVSE_pair_index(EV_id, EVSE_id)] = load_custom_ramping();
     }
-    
-    return charging_transitions{ transitions_by_EVSE_level, charging_transitions_by_custom_EV, charging_transitions_by_custom_EV_EVSE };
+
+    return return_val;
 }
 
+
 const integrate_X_through_time& factory_charging_transitions::get_charging_transitions(const EV_type& EV, 
                                                                                        const EVSE_type& EVSE) const
 {
-    const EVSE_level& level = this->inventory.get_EVSE_inventory().at(EVSE).get_level();
-    
-    if (level == L1 || level == L2)
-    {
-        return this->charging_transitions_obj.charging_transitions_by_EVSE_level.at(level);
-    }
-    else    // DCFC
-    {
+    return this->get_charging_transitions(this->inventory.get_EV_type_id(EV), this->inventory.get_EVSE_type_id(EVSE));
+}
 
-        if (this->charging_transitions_obj.charging_transitions_by_custom_EV_EVSE.count(std::make_pair( EV, EVSE )) > 0)
-        {
-            return this->charging_transitions_obj.charging_transitions_by_custom_EV_EVSE.at(std::make_pair(EV, EVSE));
-        }
-        else if (this->charging_transitions_obj.charging_transitions_by_custom_EV.count(EV) > 0)
-        {
-            return this->charging_transitions_obj.charging_transitions_by_custom_EV.at(EV);
-        }
-        else
-        {
-            return this->charging_transitions_obj.charging_transitions_by_EVSE_level.at(level);
-        }
-    }
+
+const integrate_X_through_time& factory_charging_transitions::get_charging_transitions(const EV_type_id EV_id, 
+                                                                                       const EVSE_type_id EVSE_id) const
+{
+    return this->charging_transitions_by_pair_index.at(this->inventory.get_EV_EVSE_pair_index(EV_id, EVSE_id));
 }
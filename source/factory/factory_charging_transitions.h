@@ -2,6 +2,7 @@
 #define FACTORY_CHARGING_TRANSITIONS_H
 
 #include <unordered_map>
+#include <vector>
 
 #include "EV_characteristics.h"
 #include "EVSE_characteristics.h"
@@ -14,34 +15,18 @@
 typedef std::unordered_map<EV_type, pev_charge_ramping> EV_ramping_map;
 typedef std::unordered_map<std::pair<EV_type, EVSE_type>, pev_charge_ramping, pair_hash> EV_EVSE_ramping_map;
 
-typedef std::unordered_map<EVSE_level, integrate_X_through_time> EVSE_level_charging_transitions;
-typedef std::unordered_map<EV_type, integrate_X_through_time> EV_charging_transitions;
-typedef std::unordered_map<std::pair<EV_type, EVSE_type>, integrate_X_through_time, pair_hash> EV_EVSE_charging_transitions;
-
-struct charging_transitions
-{
-	const EVSE_level_charging_transitions charging_transitions_by_EVSE_level;
-	const EV_charging_transitions charging_transitions_by_custom_EV;
-	const EV_EVSE_charging_transitions charging_transitions_by_custom_EV_EVSE;
-
-	charging_transitions(const EVSE_level_charging_transitions& charging_transitions_by_EVSE_level,
-						 const EV_charging_transitions& charging_transitions_by_custom_EV,
-						 const EV_EVSE_charging_transitions& charging_transitions_by_custom_EV_EVSE);
-};
-
-
 class factory_charging_transitions
 {
 private:
 	
 	const EV_EVSE_inventory& inventory;
 
-	const EV_ramping_map custom_EV_ramping;
-	const EV_EVSE_ramping_map custom_EV_EVSE_ramping;
+	// Transitions for every EV_EVSE_pair_index, so the lookup per charge event is an array index.
+	// The transition definitions are shared, a copy made for a charge event only holds the integration state.
+	const std::vector<integrate_X_through_time> charging_transitions_by_pair_index;
 
-	const charging_transitions charging_transitions_obj;
-
-	const charging_transitions load_charging_transitions();
+	const std::vector<integrate_X_through_time> load_charging_transitions_by_pair_index(const EV_ramping_map& custom_EV_ramping, 
+																						const EV_EVSE_ramping_map& custom_EV_EVSE_ramping) const;
 
 
 public:
@@ -51,6 +36,9 @@ public:
 
 	const integrate_X_through_time& get_charging_transitions(const EV_type& EV, 
 															 const EVSE_type& EVSE) const;
+
+	const integrate_X_through_time& get_charging_transitions(const EV_type_id EV_id, 
+															 const EVSE_type_id EVSE_id) const;
 };
 
 #endif
\ No newline at end of file
@@ -63,7 +63,17 @@ const std::unordered_map<EVSE_level, std::map<puVrms, P2> > factory_puVrms_vs_P2
 const poly_function_of_x factory_puVrms_vs_P2::get_puVrms_vs_P2(const EVSE_type& EVSE, 
                                                                 const double& SE_P2_limit_atNominalV_kW) const
 {
-    const EVSE_level& level = this->inventory.get_EVSE_inventory().at(EVSE).get_level();
+    const EVSE_type_id EVSE_id = this->inventory.get_EVSE_type_id(EVSE);
+    ASSERT(EVSE_id >= 0, "Error: SE_type:" << EVSE << " is not in the EV_EVSE_inventory." << std::endl);
+
+    return this->get_puVrms_vs_P2(EVSE_id, SE_P2_limit_atNominalV_kW);
+}
+
+
+const poly_function_of_x factory_puVrms_vs_P2::get_puVrms_vs_P2(const EVSE_type_id EVSE_id, 
+                                                                const double& SE_P2_limit_atNominalV_kW) const
+{
+    const EVSE_level& level = this->inventory.get_EVSE_level(EVSE_id);
 
     const std::map<puVrms, P2>& curve = this->puVrms_vs_P2_curves.at(level);
 
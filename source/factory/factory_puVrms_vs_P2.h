@@ -27,6 +27,9 @@ public:
 
 	const poly_function_of_x get_puVrms_vs_P2(const EVSE_type& EVSE, 
 											  const double& SE_P2_limit_atNominalV_kW) const;
+
+	const poly_function_of_x get_puVrms_vs_P2(const EVSE_type_id EVSE_id, 
+											  const double& SE_P2_limit_atNominalV_kW) const;
 };
 
 #endif
\ No newline at end of file
@@ -26,7 +26,7 @@ supply_equipment factory_supply_equipment_model::get_supply_equipment_model(
     const factory_EV_charge_model& PEV_charge_factory,
     const factory_ac_to_dc_converter& ac_to_dc_converter_factory,
     const pev_charge_profile_library& charge_profile_library
-)
+) const
 {
     EVSE_type EVSE = SE_config.supply_equipment_type;
 
@@ -33,7 +33,7 @@ public:
         const factory_EV_charge_model& PEV_charge_factory,
         const factory_ac_to_dc_converter& ac_to_dc_converter_factory,
         const pev_charge_profile_library& charge_profile_library
-    );
+    ) const;
 };
 
 #endif  // FACTORY_SUPPLY_EQUIPMENT_MODEL_H
\ No newline at end of file
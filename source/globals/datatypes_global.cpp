@@ -1,5 +1,6 @@
 
 #include "datatypes_global.h"
+#include "helper.h"     // write_pod, read_pod, write_string, read_string
 #include <cmath>
 #include <stdexcept>    // invalid_argument
 
@@ -367,6 +368,26 @@ control_strategy_enums::control_strategy_enums()
 }
 
 
+void control_strategy_enums::write_binary( std::ostream& out ) const
+{
+    write_pod<bool>(out, this->inverter_model_supports_Qsetpoint);
+    write_pod<L2_control_strategies_enum>(out, this->ES_control_strategy);
+    write_pod<L2_control_strategies_enum>(out, this->VS_control_strategy);
+    write_string(out, this->ext_control_strategy);
+}
+
+
+control_strategy_enums control_strategy_enums::read_binary( std::istream& in )
+{
+    control_strategy_enums x;
+    x.inverter_model_supports_Qsetpoint = read_pod<bool>(in);
+    x.ES_control_strategy = read_pod<L2_control_strategies_enum>(in);
+    x.VS_control_strategy = read_pod<L2_control_strategies_enum>(in);
+    x.ext_control_strategy = read_string(in);
+    return x;
+}
+
+
 //------------------------------------------------------------------
 //                    ES500 Aggregator Structures
 //------------------------------------------------------------------
@@ -494,6 +515,42 @@ charge_event_data::charge_event_data( int charge_event_id_,
 }
 
 
+void charge_event_data::write_binary( std::ostream& out ) const
+{
+    write_pod<int32_t>(out, this->charge_event_id);
+    write_pod<int32_t>(out, this->SE_group_id);
+    write_pod<int32_t>(out, this->SE_id);
+    write_pod<int32_t>(out, this->vehicle_id);
+    write_string(out, this->vehicle_type);
+    write_pod<double>(out, this->arrival_unix_time);
+    write_pod<double>(out, this->departure_unix_time);
+    write_pod<double>(out, this->arrival_SOC);
+    write_pod<double>(out, this->departure_SOC);
+    write_pod<double>(out, this->arrival_battery_temperature_C);
+    write_pod<stop_charging_criteria>(out, this->stop_charge);
+    this->control_enums.write_binary(out);
+}
+
+
+charge_event_data charge_event_data::read_binary( std::istream& in )
+{
+    charge_event_data x;
+    x.charge_event_id = read_pod<int32_t>(in);
+    x.SE_group_id = read_pod<int32_t>(in);
+    x.SE_id = read_pod<int32_t>(in);
+    x.vehicle_id = read_pod<int32_t>(in);
+    x.vehicle_type = read_string(in);
+    x.arrival_unix_time = read_pod<double>(in);
+    x.departure_unix_time = read_pod<double>(in);
+    x.arrival_SOC = read_pod<double>(in);
+    x.departure_SOC = read_pod<double>(in);
+    x.arrival_battery_temperature_C = read_pod<double>(in);
+    x.stop_charge = read_pod<stop_charging_criteria>(in);
+    x.control_enums = control_strategy_enums::read_binary(in);
+    return x;
+}
+
+
 SE_group_charge_event_data::SE_group_charge_event_data(int SE_group_id_, std::vector<charge_event_data> charge_events_)
 {
     this->SE_group_id = SE_group_id_;
@@ -307,6 +307,9 @@ struct control_strategy_enums
     std::string ext_control_strategy;
     
     control_strategy_enums();
+    
+    void write_binary( std::ostream& out ) const;
+    static control_strategy_enums read_binary( std::istream& in );
 };
 
 
@@ -516,6 +519,10 @@ struct charge_event_data
     
     static std::string get_file_header();
     
+    // Binary form used by the SE step states, see supply_equipment::write_step_state.
+    void write_binary( std::ostream& out ) const;
+    static charge_event_data read_binary( std::istream& in );
+    
     bool operator<(const charge_event_data& rhs) const
     {
         return this->arrival_unix_time < rhs.arrival_unix_time;
@@ -744,6 +751,64 @@ struct SE_power
 std::ostream& operator<<(std::ostream& out, const SE_power::PowerType& x);
 
 
+struct grid_nodes_advance_result
+{
+    double start_unix_time;
+    double time_step_sec;
+    int num_steps;
+    int num_grid_nodes;
+    bool has_time_series;
+    
+    // has_time_series == true:  num_steps*num_grid_nodes values, the value for step k
+    //                           and grid node i is at [k*num_grid_nodes + i].
+    // has_time_series == false: num_grid_nodes values from the last step only.
+    std::vector<double> P3_kW;
+    std::vector<double> Q3_kVAR;
+    
+    // Energy over all the steps, one value per grid node.
+    std::vector<double> E3_kWh;
+    std::vector<double> Q3_kVARh;
+    
+    grid_nodes_advance_result() :
+            start_unix_time(0.0),
+            time_step_sec(0.0),
+            num_steps(0),
+            num_grid_nodes(0),
+            has_time_series(false) {}
+};
+
+
+struct charge_event_queue_memory_usage
+{
+    int num_queued_charge_events;
+    double packed_MB;       // Memory used by the queued charge events.
+    double unpacked_MB;     // Estimate for the same events held as charge_event_data in a std::set.
+    
+    charge_event_queue_memory_usage() :
+            num_queued_charge_events(0),
+            packed_MB(0.0),
+            unpacked_MB(0.0) {}
+};
+
+
+// Process wide counts of the EV charge models and ac to dc converters built for charge
+// events.  'allocated' objects were created with new, 'reused' ones were built in the
+// storage of an object released by an earlier charge event.
+struct charge_model_allocation_counters
+{
+    int64_t EV_charge_models_allocated;
+    int64_t EV_charge_models_reused;
+    int64_t ac_to_dc_converters_allocated;
+    int64_t ac_to_dc_converters_reused;
+    
+    charge_model_allocation_counters() :
+            EV_charge_models_allocated(0),
+            EV_charge_models_reused(0),
+            ac_to_dc_converters_allocated(0),
+            ac_to_dc_converters_reused(0) {}
+};
+
+
 enum class ac_to_dc_converter_enum
 {
     pf=0,
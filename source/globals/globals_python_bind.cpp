@@ -56,7 +56,9 @@ PYBIND11_MODULE(Caldera_globals, m)
 	//--------------------------------------------
 
 	py::class_<interface_to_SE_groups_inputs>(m, "interface_to_SE_groups_inputs")
-		.def(py::init< bool, EV_ramping_map, std::vector<pev_charge_ramping_workaround>, charge_event_queuing_inputs, std::vector<SE_group_configuration>, double, int, std::vector<double>, std::vector<double>, double,L2_control_strategy_parameters, bool >());
+		.def(py::init< bool, EV_ramping_map, std::vector<pev_charge_ramping_workaround>, charge_event_queuing_inputs, std::vector<SE_group_configuration>, double, int, std::vector<double>, std::vector<double>, double,L2_control_strategy_parameters, bool >())
+		.def_readwrite("lazy_charge_profile_library", &interface_to_SE_groups_inputs::lazy_charge_profile_library)
+		.def_readwrite("event_driven_charge_profile_library", &interface_to_SE_groups_inputs::event_driven_charge_profile_library);
 
 	//---------------------------------
 	//       Charge Event Data
@@ -443,6 +445,31 @@ PYBIND11_MODULE(Caldera_globals, m)
 			}
 	));
 
+	py::class_<grid_nodes_advance_result>(m, "grid_nodes_advance_result")
+		.def(py::init<>())
+		.def_readwrite("start_unix_time", &grid_nodes_advance_result::start_unix_time)
+		.def_readwrite("time_step_sec", &grid_nodes_advance_result::time_step_sec)
+		.def_readwrite("num_steps", &grid_nodes_advance_result::num_steps)
+		.def_readwrite("num_grid_nodes", &grid_nodes_advance_result::num_grid_nodes)
+		.def_readwrite("has_time_series", &grid_nodes_advance_result::has_time_series)
+		.def_readwrite("P3_kW", &grid_nodes_advance_result::P3_kW)
+		.def_readwrite("Q3_kVAR", &grid_nodes_advance_result::Q3_kVAR)
+		.def_readwrite("E3_kWh", &grid_nodes_advance_result::E3_kWh)
+		.def_readwrite("Q3_kVARh", &grid_nodes_advance_result::Q3_kVARh);
+
+	py::class_<charge_event_queue_memory_usage>(m, "charge_event_queue_memory_usage")
+		.def(py::init<>())
+		.def_readwrite("num_queued_charge_events", &charge_event_queue_memory_usage::num_queued_charge_events)
+		.def_readwrite("packed_MB", &charge_event_queue_memory_usage::packed_MB)
+		.def_readwrite("unpacked_MB", &charge_event_queue_memory_usage::unpacked_MB);
+
+	py::class_<charge_model_allocation_counters>(m, "charge_model_allocation_counters")
+		.def(py::init<>())
+		.def_readwrite("EV_charge_models_allocated", &charge_model_allocation_counters::EV_charge_models_allocated)
+		.def_readwrite("EV_charge_models_reused", &charge_model_allocation_counters::EV_charge_models_reused)
+		.def_readwrite("ac_to_dc_converters_allocated", &charge_model_allocation_counters::ac_to_dc_converters_allocated)
+		.def_readwrite("ac_to_dc_converters_reused", &charge_model_allocation_counters::ac_to_dc_converters_reused);
+
 	py::class_<pev_batterySize_info>(m, "pev_batterySize_info")
 		.def(py::init<>())
 		.def_readwrite("vehicle_type", &pev_batterySize_info::vehicle_type)
@@ -298,10 +298,92 @@ double poly_function_of_x::get_val(double x)
     return -1;
 }
 
+
+double poly_function_of_x::get_derivative(double x) const
+{
+    double sign_of_x = 1;
+    
+    if(this->take_abs_of_x)
+    {
+        sign_of_x = (x < 0) ? -1 : 1;
+        x = std::abs(x);
+    }
+    
+    if(this->segments.size() == 0 || x < this->segments[0].x_LB || this->segments.back().x_UB < x)
+        return 0;
+    
+    for(const poly_segment& seg : this->segments)
+    {
+        if(x <= seg.x_UB)
+        {
+            double dy_dx;
+            
+            if(seg.degree == poly_degree::first)
+                dy_dx = seg.a;
+            else if(seg.degree == poly_degree::second)
+                dy_dx = 2*seg.a*x + seg.b;
+            else if(seg.degree == poly_degree::third)
+                dy_dx = 3*seg.a*x*x + 2*seg.b*x + seg.c;
+            else
+                dy_dx = 4*seg.a*x*x*x + 3*seg.b*x*x + 2*seg.c*x + seg.d;
+            
+            return sign_of_x*dy_dx;
+        }
+    }
+    
+    return 0;
+}
+
 //#############################################################################
 //                              Functions
 //#############################################################################
 
+bool has_remaining_bytes( std::istream& in, const uint64_t num_items, const uint64_t item_size )
+{
+    const std::streampos pos = in.tellg();
+    
+    if(!in.good() || pos < 0)
+    {
+        in.setstate(std::ios::failbit);
+        return false;
+    }
+    
+    in.seekg(0, std::ios::end);
+    const std::streampos end = in.tellg();
+    in.seekg(pos);
+    
+    if(!in.good() || end < pos || num_items > (uint64_t)(end - pos) / item_size)
+    {
+        in.setstate(std::ios::failbit);
+        return false;
+    }
+    
+    return true;
+}
+
+
+void write_string( std::ostream& out, const std::string& x )
+{
+    write_pod<uint32_t>(out, (uint32_t)x.size());
+    out.write(x.data(), x.size());
+}
+
+
+std::string read_string( std::istream& in )
+{
+    const uint32_t size = read_pod<uint32_t>(in);
+    std::string x;
+    
+    if(in.good() && has_remaining_bytes(in, size, 1))
+    {
+        x.resize(size);
+        in.read(&x[0], size);
+    }
+    
+    return x;
+}
+
+
 // splits a 'char' delimited string into tokens
 std::vector<std::string> split(const std::string& line, char delim)
 {
@@ -469,6 +551,35 @@ void LPF_kernel::add_raw_data_value(double next_input_value)
 }
 
 
+void LPF_kernel::write_binary(std::ostream& out) const
+{
+    write_pod<int32_t>(out, this->max_window_size);
+    write_pod_vector<double>(out, this->raw_data);
+    write_pod<int32_t>(out, this->cur_raw_data_index);
+    write_pod<LPF_window_enum>(out, this->window_type);
+    write_pod<int32_t>(out, this->window_size);
+    write_pod_vector<double>(out, this->window);
+    write_pod<double>(out, this->window_area);
+}
+
+
+void LPF_kernel::read_binary(std::istream& in)
+{
+    this->max_window_size = read_pod<int32_t>(in);
+    this->raw_data = read_pod_vector<double>(in);
+    this->cur_raw_data_index = read_pod<int32_t>(in);
+    this->window_type = read_pod<LPF_window_enum>(in);
+    this->window_size = read_pod<int32_t>(in);
+    this->window = read_pod_vector<double>(in);
+    this->window_area = read_pod<double>(in);
+    
+    // get_filtered_value indexes both vectors without checks.
+    if(this->raw_data.empty() || this->cur_raw_data_index < 0 || this->cur_raw_data_index >= (int)this->raw_data.size() ||
+       this->window_size < 0 || this->window_size > (int)this->window.size() || this->window_size > (int)this->raw_data.size())
+        in.setstate(std::ios::failbit);
+}
+
+
 double LPF_kernel::get_filtered_value()
 {
     double X = 0;    
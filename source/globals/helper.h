@@ -12,6 +12,7 @@
 #include <vector>
 #include <string>
 #include <iomanip>
+#include <cstdint>      // uint32_t, uint64_t
 
 struct pair_hash
 {
@@ -34,6 +35,56 @@ struct pair_hash
 std::vector<std::string> tokenize(std::string s, std::string delim = ",");
 
 
+//#############################################################################
+//                               Binary Form
+//#############################################################################
+// Native byte order, used by the charge profile library cache and the SE step
+// states.  The read functions leave 'in' failed instead of throwing.
+
+template <typename T>
+void write_pod( std::ostream& out, const T& x )
+{
+    out.write(reinterpret_cast<const char*>(&x), sizeof(T));
+}
+
+template <typename T>
+T read_pod( std::istream& in )
+{
+    T x{};
+    in.read(reinterpret_cast<char*>(&x), sizeof(T));
+    return x;
+}
+
+// True when 'in' has num_items*item_size bytes left, so a corrupt count fails 'in'
+// before anything is allocated.  'in' must be seekable.
+bool has_remaining_bytes( std::istream& in, const uint64_t num_items, const uint64_t item_size );
+
+void write_string( std::ostream& out, const std::string& x );
+std::string read_string( std::istream& in );
+
+template <typename T>
+void write_pod_vector( std::ostream& out, const std::vector<T>& x )
+{
+    write_pod<uint64_t>(out, (uint64_t)x.size());
+    out.write(reinterpret_cast<const char*>(x.data()), x.size()*sizeof(T));
+}
+
+template <typename T>
+std::vector<T> read_pod_vector( std::istream& in )
+{
+    const uint64_t size = read_pod<uint64_t>(in);
+    std::vector<T> x;
+    
+    if(in.good() && has_remaining_bytes(in, size, sizeof(T)))
+    {
+        x.resize(size);
+        in.read(reinterpret_cast<char*>(x.data()), size*sizeof(T));
+    }
+    
+    return x;
+}
+
+
 //#############################################################################
 //                          linear_regression
 //#############################################################################
@@ -231,6 +282,9 @@ public:
     poly_function_of_x(){}
     poly_function_of_x(double x_tolerance_, bool take_abs_of_x_, bool if_x_is_out_of_bounds_print_warning_message_, const std::vector<poly_segment> &segments_, std::string warning_msg_poly_function_name_);
     double get_val(double x);
+    
+    // Slope of the curve at x.  Zero outside the segments, where get_val clamps x.
+    double get_derivative(double x) const;
 };
 
 //#############################################################################
@@ -289,6 +343,9 @@ public:
     void update_LPF(LPF_parameters& LPF_params);
     void add_raw_data_value(double next_input_value);
     double get_filtered_value();
+    
+    void write_binary(std::ostream& out) const;
+    void read_binary(std::istream& in);
 };
 
 
@@ -9,8 +9,8 @@
 struct vehicle_charge_model_inputs
 {
     const charge_event_data& CE;
-    const EV_type& EV;
-    const EVSE_type& EVSE;
+    const EV_type_id EV_id;
+    const EVSE_type_id EVSE_id;
     const double SE_P2_limit_kW;
     const double battery_size_kWh;
     const factory_charging_transitions& CT_factory;
@@ -19,8 +19,8 @@ struct vehicle_charge_model_inputs
     const factory_P2_vs_battery_efficiency& PE_factory;
 
     vehicle_charge_model_inputs(const charge_event_data& CE, 
-                                const EV_type& EV, 
-                                const EVSE_type& EVSE,
+                                const EV_type_id EV_id,
+                                const EVSE_type_id EVSE_id,
                                 const double SE_P2_limit_kW, 
                                 const double battery_size_kWh, 
                                 const factory_charging_transitions& CT_factory,
@@ -28,8 +28,8 @@ struct vehicle_charge_model_inputs
                                 const factory_SOC_vs_P2& SOCP_factory,
                                 const factory_P2_vs_battery_efficiency& PE_factory)
         : CE{ CE }, 
-        EV{ EV }, 
-        EVSE{ EVSE }, 
+        EV_id{ EV_id },
+        EVSE_id{ EVSE_id },
         SE_P2_limit_kW{ SE_P2_limit_kW }, 
         battery_size_kWh{ battery_size_kWh },
         CT_factory{ CT_factory }, 
@@ -46,6 +46,8 @@ struct interface_to_SE_groups_inputs
 {
     // factory_inputs
     bool create_charge_profile_library;
+    bool lazy_charge_profile_library;       // Build each charge profile on first use, false by default
+    bool event_driven_charge_profile_library;   // Step over constant power stretches when building charge profiles, false by default
     EV_ramping_map ramping_by_pevType_only;
     std::vector<pev_charge_ramping_workaround> ramping_by_pevType_seType;
 
@@ -77,6 +79,8 @@ struct interface_to_SE_groups_inputs
                                    L2_control_strategy_parameters L2_parameters,
                                    bool ensure_pev_charge_needs_met )
         : create_charge_profile_library{ create_charge_profile_library },
+        lazy_charge_profile_library{ false },
+        event_driven_charge_profile_library{ false },
         ramping_by_pevType_only{ ramping_by_pevType_only },
         ramping_by_pevType_seType{ ramping_by_pevType_seType },
         CE_queuing_inputs{ CE_queuing_inputs },
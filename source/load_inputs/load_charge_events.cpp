@@ -0,0 +1,331 @@
+#include "load_charge_events.h"
+#include "helper.h"
+
+#include <filesystem>
+#include <cstring>			// memcmp
+#include <cstdint>			// int32_t, uint8_t, uint16_t
+#include <limits>			// numeric_limits
+
+const char load_charge_events::binary_magic[8] = { 'C', 'L', 'D', 'R', 'A', 'C', 'E', '2' };
+
+// std::stoi and std::stod stop at the first character that is not part of the number,
+// these also reject a field with anything after the number (e.g. "12abc").
+static int field_to_int(const std::string& str)
+{
+	size_t pos;
+	const int return_val = std::stoi(str, &pos);
+	if (pos != str.size())
+		throw std::invalid_argument("Invalid integer " + str);
+	return return_val;
+}
+
+static double field_to_double(const std::string& str)
+{
+	size_t pos;
+	const double return_val = std::stod(str, &pos);
+	if (pos != str.size())
+		throw std::invalid_argument("Invalid number " + str);
+	return return_val;
+}
+
+load_charge_events::load_charge_events(const std::string& charge_events_file) :
+	charge_events_file{ charge_events_file },
+	charge_events_file_handle{},
+	is_binary{ false },
+	line_number{ 0 },
+	next_CE_is_available{ false },
+	next_CE{},
+	next_CE_file_position{ 0 },
+	next_CE_line_number{ 0 }
+{
+	ASSERT(std::filesystem::exists(charge_events_file), charge_events_file << " file does not exist");
+	this->charge_events_file_handle.open(charge_events_file, std::ios::in | std::ios::binary);
+
+	char magic[8];
+	this->charge_events_file_handle.read(magic, sizeof(magic));
+	this->is_binary = (this->charge_events_file_handle.gcount() == sizeof(magic) && std::memcmp(magic, binary_magic, sizeof(magic)) == 0);
+
+	ASSERT(this->is_binary || this->charge_events_file_handle.gcount() != sizeof(magic) || std::memcmp(magic, binary_magic, sizeof(magic) - 1) != 0,
+		charge_events_file << " was written by another version of load_charge_events::write_binary_file, write it again");
+
+	if (!this->is_binary)
+	{
+		this->charge_events_file_handle.clear();
+		this->charge_events_file_handle.seekg(0);
+
+		// column names
+		std::string line;
+		std::getline(this->charge_events_file_handle, line);
+		this->line_number = 1;
+
+		const std::vector<std::string> column_names = tokenize(charge_event_data::get_file_header());
+		const std::vector<std::string> elements_in_line = tokenize(line);
+
+		ASSERT(elements_in_line == column_names, charge_events_file << " column names doesn\'t match. " <<
+			"Expected column names are { " << charge_event_data::get_file_header() << " }");
+	}
+
+	this->read_next();
+}
+
+stop_charging_decision_metric load_charge_events::string_to_stop_charging_decision_metric(const std::string& str)
+{
+	if (str == "stop_charging_using_target_soc")				return stop_charging_decision_metric::stop_charging_using_target_soc;
+	else if (str == "stop_charging_using_depart_time")			return stop_charging_decision_metric::stop_charging_using_depart_time;
+	else if (str == "stop_charging_using_whatever_happens_first")	return stop_charging_decision_metric::stop_charging_using_whatever_happens_first;
+	else
+		throw std::invalid_argument("Invalid stop charging decision metric string");
+}
+
+stop_charging_mode load_charge_events::string_to_stop_charging_mode(const std::string& str)
+{
+	if (str == "target_charging")		return stop_charging_mode::target_charging;
+	else if (str == "block_charging")	return stop_charging_mode::block_charging;
+	else
+		throw std::invalid_argument("Invalid stop charging mode string");
+}
+
+bool load_charge_events::read_next_CSV(charge_event_data& CE)
+{
+	static const size_t num_columns = tokenize(charge_event_data::get_file_header()).size();
+
+	std::string line;
+
+	while (std::getline(this->charge_events_file_handle, line))
+	{
+		this->line_number += 1;
+
+		if (line.find_first_not_of(" \t\r\n") == std::string::npos)
+			continue;
+
+		const std::vector<std::string> elements_in_line = tokenize(line);
+
+		ASSERT(elements_in_line.size() == num_columns, this->charge_events_file << " invalid number of columns. Need "
+			<< num_columns << " columns but " << elements_in_line.size() << " provided in line number "
+			<< this->line_number);
+
+		try
+		{
+			CE = charge_event_data();
+			CE.charge_event_id = field_to_int(elements_in_line[0]);
+			CE.SE_group_id = field_to_int(elements_in_line[1]);
+			CE.SE_id = field_to_int(elements_in_line[2]);
+			CE.vehicle_id = field_to_int(elements_in_line[3]);
+			CE.vehicle_type = elements_in_line[4];
+			CE.arrival_unix_time = field_to_double(elements_in_line[5]);
+			CE.departure_unix_time = field_to_double(elements_in_line[6]);
+			CE.arrival_SOC = field_to_double(elements_in_line[7]);
+			CE.departure_SOC = field_to_double(elements_in_line[8]);
+			CE.stop_charge.decision_metric = this->string_to_stop_charging_decision_metric(elements_in_line[9]);
+			CE.stop_charge.soc_mode = this->string_to_stop_charging_mode(elements_in_line[10]);
+			CE.stop_charge.depart_time_mode = this->string_to_stop_charging_mode(elements_in_line[11]);
+			CE.stop_charge.soc_block_charging_max_undershoot_percent = field_to_double(elements_in_line[12]);
+			CE.stop_charge.depart_time_block_charging_max_undershoot_percent = field_to_double(elements_in_line[13]);
+		}
+		catch (const std::exception& e)
+		{
+			ASSERT(false, this->charge_events_file << " " << e.what() << " in line number " << this->line_number);
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
+bool load_charge_events::read_next_binary(charge_event_data& CE)
+{
+	std::ifstream& f = this->charge_events_file_handle;
+
+	int32_t ids[4];
+	if (!f.read(reinterpret_cast<char*>(ids), sizeof(ids)))
+		return false;
+
+	this->line_number += 1;
+
+	uint16_t vehicle_type_size;
+	double times_and_SOCs[4];
+	uint8_t stop_charge_enums[3];
+	double undershoot_percents[2];
+	double arrival_battery_temperature_C;
+	uint8_t control_enums[3];
+	uint16_t ext_control_strategy_size;
+
+	f.read(reinterpret_cast<char*>(&vehicle_type_size), sizeof(vehicle_type_size));
+	std::string vehicle_type(vehicle_type_size, ' ');
+	f.read(&vehicle_type[0], vehicle_type_size);
+	f.read(reinterpret_cast<char*>(times_and_SOCs), sizeof(times_and_SOCs));
+	f.read(reinterpret_cast<char*>(stop_charge_enums), sizeof(stop_charge_enums));
+	f.read(reinterpret_cast<char*>(undershoot_percents), sizeof(undershoot_percents));
+	f.read(reinterpret_cast<char*>(&arrival_battery_temperature_C), sizeof(arrival_battery_temperature_C));
+	f.read(reinterpret_cast<char*>(control_enums), sizeof(control_enums));
+	f.read(reinterpret_cast<char*>(&ext_control_strategy_size), sizeof(ext_control_strategy_size));
+
+	ASSERT(f.good(), this->charge_events_file << " is truncated in record number " << this->line_number);
+
+	std::string ext_control_strategy(ext_control_strategy_size, ' ');
+	f.read(&ext_control_strategy[0], ext_control_strategy_size);
+
+	ASSERT(f.good(), this->charge_events_file << " is truncated in record number " << this->line_number);
+
+	ASSERT(stop_charge_enums[0] <= (uint8_t)stop_charging_decision_metric::stop_charging_using_whatever_happens_first &&
+		stop_charge_enums[1] <= (uint8_t)stop_charging_mode::block_charging &&
+		stop_charge_enums[2] <= (uint8_t)stop_charging_mode::block_charging,
+		this->charge_events_file << " invalid stop charging criteria in record number " << this->line_number);
+
+	const L2_control_strategies_enum ES_control_strategy = (L2_control_strategies_enum)control_enums[1];
+	const L2_control_strategies_enum VS_control_strategy = (L2_control_strategies_enum)control_enums[2];
+
+	ASSERT(control_enums[0] <= 1 &&
+		(ES_control_strategy == L2_control_strategies_enum::NA || is_L2_ES_control_strategy(ES_control_strategy)) &&
+		(VS_control_strategy == L2_control_strategies_enum::NA || is_L2_VS_control_strategy(VS_control_strategy)),
+		this->charge_events_file << " invalid control strategies in record number " << this->line_number);
+
+	CE = charge_event_data();
+	CE.charge_event_id = ids[0];
+	CE.SE_group_id = ids[1];
+	CE.SE_id = ids[2];
+	CE.vehicle_id = ids[3];
+	CE.vehicle_type = vehicle_type;
+	CE.arrival_unix_time = times_and_SOCs[0];
+	CE.departure_unix_time = times_and_SOCs[1];
+	CE.arrival_SOC = times_and_SOCs[2];
+	CE.departure_SOC = times_and_SOCs[3];
+	CE.stop_charge.decision_metric = (stop_charging_decision_metric)stop_charge_enums[0];
+	CE.stop_charge.soc_mode = (stop_charging_mode)stop_charge_enums[1];
+	CE.stop_charge.depart_time_mode = (stop_charging_mode)stop_charge_enums[2];
+	CE.stop_charge.soc_block_charging_max_undershoot_percent = undershoot_percents[0];
+	CE.stop_charge.depart_time_block_charging_max_undershoot_percent = undershoot_percents[1];
+	CE.arrival_battery_temperature_C = arrival_battery_temperature_C;
+	CE.control_enums.inverter_model_supports_Qsetpoint = (control_enums[0] == 1);
+	CE.control_enums.ES_control_strategy = ES_control_strategy;
+	CE.control_enums.VS_control_strategy = VS_control_strategy;
+	CE.control_enums.ext_control_strategy = ext_control_strategy;
+
+	return true;
+}
+
+void load_charge_events::read_next()
+{
+	const bool has_prev_CE = this->next_CE_is_available;
+	const double prev_arrival_unix_time = this->next_CE.arrival_unix_time;
+
+	this->next_CE_file_position = this->charge_events_file_handle.tellg();
+	this->next_CE_line_number = this->line_number;
+
+	charge_event_data CE;
+	this->next_CE_is_available = this->is_binary ? this->read_next_binary(CE) : this->read_next_CSV(CE);
+
+	if (!this->next_CE_is_available)
+		return;
+
+	ASSERT(!has_prev_CE || prev_arrival_unix_time <= CE.arrival_unix_time, this->charge_events_file <<
+		" charge events are not sorted by arrival_unix_time in " << (this->is_binary ? "record" : "line") <<
+		" number " << this->line_number);
+
+	ASSERT(CE.arrival_unix_time < CE.departure_unix_time, this->charge_events_file <<
+		" arrival_unix_time is not before departure_unix_time in " << (this->is_binary ? "record" : "line") <<
+		" number " << this->line_number);
+
+	ASSERT(0 <= CE.arrival_SOC && CE.arrival_SOC <= 100 && 0 <= CE.departure_SOC && CE.departure_SOC <= 100,
+		this->charge_events_file << " arrival_SOC and departure_SOC must be between 0 and 100 in " <<
+		(this->is_binary ? "record" : "line") << " number " << this->line_number);
+
+	this->next_CE = CE;
+}
+
+const std::string& load_charge_events::get_charge_events_file() const
+{
+	return this->charge_events_file;
+}
+
+load_charge_events_position load_charge_events::get_position()
+{
+	load_charge_events_position position;
+	position.file_position = this->next_CE_file_position;
+	position.line_number = this->next_CE_line_number;
+	position.next_CE_is_available = this->next_CE_is_available;
+
+	return position;
+}
+
+void load_charge_events::set_position(const load_charge_events_position& position)
+{
+	// The stream may already be at eof, which blocks seekg until the flags are cleared.
+	// The next charge event is read again from its saved offset.  A reader that has run
+	// out of events goes to the end instead.
+	this->charge_events_file_handle.clear();
+
+	if (position.next_CE_is_available)
+		this->charge_events_file_handle.seekg(position.file_position);
+	else
+		this->charge_events_file_handle.seekg(0, std::ios::end);
+
+	ASSERT(this->charge_events_file_handle.good(), this->charge_events_file << " could not seek to the saved position");
+
+	this->line_number = position.line_number;
+	this->next_CE_is_available = false;
+
+	if (position.next_CE_is_available)
+	{
+		this->read_next();
+		ASSERT(this->next_CE_is_available, this->charge_events_file << " has no charge event at the saved position");
+	}
+}
+
+bool load_charge_events::has_next() const
+{
+	return this->next_CE_is_available;
+}
+
+double load_charge_events::get_next_arrival_unix_time() const
+{
+	if (!this->next_CE_is_available)
+		return std::numeric_limits<double>::max();
+
+	return this->next_CE.arrival_unix_time;
+}
+
+void load_charge_events::read_until(const double unix_time, std::vector<charge_event_data>& charge_events)
+{
+	while (this->next_CE_is_available && this->next_CE.arrival_unix_time <= unix_time)
+	{
+		charge_events.push_back(this->next_CE);
+		this->read_next();
+	}
+}
+
+void load_charge_events::write_binary_file(const std::string& charge_events_file, const std::vector<charge_event_data>& charge_events)
+{
+	std::ofstream f(charge_events_file, std::ios::out | std::ios::binary | std::ios::trunc);
+	ASSERT(f.is_open(), charge_events_file << " could not be opened for writing");
+
+	f.write(binary_magic, sizeof(binary_magic));
+
+	for (const charge_event_data& CE : charge_events)
+	{
+		ASSERT(CE.vehicle_type.size() <= std::numeric_limits<uint16_t>::max(), charge_events_file << " vehicle_type " << CE.vehicle_type << " is too long");
+		ASSERT(CE.control_enums.ext_control_strategy.size() <= std::numeric_limits<uint16_t>::max(), charge_events_file << " ext_control_strategy " << CE.control_enums.ext_control_strategy << " is too long");
+
+		const int32_t ids[4] = { CE.charge_event_id, CE.SE_group_id, CE.SE_id, CE.vehicle_id };
+		const uint16_t vehicle_type_size = (uint16_t)CE.vehicle_type.size();
+		const double times_and_SOCs[4] = { CE.arrival_unix_time, CE.departure_unix_time, CE.arrival_SOC, CE.departure_SOC };
+		const uint8_t stop_charge_enums[3] = { (uint8_t)CE.stop_charge.decision_metric, (uint8_t)CE.stop_charge.soc_mode, (uint8_t)CE.stop_charge.depart_time_mode };
+		const double undershoot_percents[2] = { CE.stop_charge.soc_block_charging_max_undershoot_percent, CE.stop_charge.depart_time_block_charging_max_undershoot_percent };
+		const uint8_t control_enums[3] = { (uint8_t)CE.control_enums.inverter_model_supports_Qsetpoint, (uint8_t)CE.control_enums.ES_control_strategy, (uint8_t)CE.control_enums.VS_control_strategy };
+		const uint16_t ext_control_strategy_size = (uint16_t)CE.control_enums.ext_control_strategy.size();
+
+		f.write(reinterpret_cast<const char*>(ids), sizeof(ids));
+		f.write(reinterpret_cast<const char*>(&vehicle_type_size), sizeof(vehicle_type_size));
+		f.write(CE.vehicle_type.data(), vehicle_type_size);
+		f.write(reinterpret_cast<const char*>(times_and_SOCs), sizeof(times_and_SOCs));
+		f.write(reinterpret_cast<const char*>(stop_charge_enums), sizeof(stop_charge_enums));
+		f.write(reinterpret_cast<const char*>(undershoot_percents), sizeof(undershoot_percents));
+		f.write(reinterpret_cast<const char*>(&CE.arrival_battery_temperature_C), sizeof(CE.arrival_battery_temperature_C));
+		f.write(reinterpret_cast<const char*>(control_enums), sizeof(control_enums));
+		f.write(reinterpret_cast<const char*>(&ext_control_strategy_size), sizeof(ext_control_strategy_size));
+		f.write(CE.control_enums.ext_control_strategy.data(), ext_control_strategy_size);
+	}
+
+	ASSERT(f.good(), charge_events_file << " error while writing");
+}
@@ -0,0 +1,74 @@
+#ifndef LOAD_CHARGE_EVENTS_H
+#define LOAD_CHARGE_EVENTS_H
+
+#include "datatypes_global.h"       // charge_event_data
+#include <string>
+#include <vector>
+#include <fstream>
+
+// Reads charge events lazily from a file sorted by arrival_unix_time, so only the
+// events up to the requested time are ever held in memory.
+//
+// Two formats are supported:
+//  - CSV with the columns of charge_event_data::get_file_header(), as written by
+//    operator<<(std::ostream&, const charge_event_data&).
+//  - Binary, as written by write_binary_file.  The file starts with the 8 byte magic
+//    "CLDRACE2" followed by one record per charge event in native byte order.  The format
+//    is detected from the magic, not the file extension.
+//
+// The binary records hold every field of charge_event_data.  The CSV has no columns for
+// arrival_battery_temperature_C and control_enums, so those keep their defaults.
+
+// Read position of a load_charge_events, used to checkpoint a simulation.  file_position
+// and line_number are the ones before the next charge event was read.
+struct load_charge_events_position
+{
+	std::streampos file_position;
+	int line_number;
+	bool next_CE_is_available;
+};
+
+class load_charge_events
+{
+private:
+	const std::string charge_events_file;
+	std::ifstream charge_events_file_handle;
+	bool is_binary;
+	int line_number;
+
+	bool next_CE_is_available;
+	charge_event_data next_CE;
+
+	// tellg is -1 once the last line has been read if it has no trailing newline, so the
+	// offset is recorded before each charge event is read.
+	std::streampos next_CE_file_position;
+	int next_CE_line_number;
+
+	static const char binary_magic[8];
+
+	bool read_next_CSV(charge_event_data& CE);
+	bool read_next_binary(charge_event_data& CE);
+	void read_next();
+
+	stop_charging_decision_metric string_to_stop_charging_decision_metric(const std::string& str);
+	stop_charging_mode string_to_stop_charging_mode(const std::string& str);
+
+public:
+	load_charge_events(const std::string& charge_events_file);
+
+	const std::string& get_charge_events_file() const;
+
+	// Reading continues from a position returned by get_position on a reader of the same file.
+	load_charge_events_position get_position();
+	void set_position(const load_charge_events_position& position);
+
+	bool has_next() const;
+	double get_next_arrival_unix_time() const;
+
+	// Appends every remaining charge event with arrival_unix_time <= unix_time.
+	void read_until(const double unix_time, std::vector<charge_event_data>& charge_events);
+
+	static void write_binary_file(const std::string& charge_events_file, const std::vector<charge_event_data>& charge_events);
+};
+
+#endif // LOAD_CHARGE_EVENTS_H
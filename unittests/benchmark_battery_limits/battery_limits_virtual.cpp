@@ -0,0 +1,556 @@
+#include "battery_limits_virtual.h"
+
+#include <cmath>
+
+
+double algorithm_P2_vs_soc_virtual::get_soc_to_energy() const
+{
+	return this->soc_to_energy;
+}
+
+double algorithm_P2_vs_soc_virtual::get_soc_UB() const
+{
+	return this->P2_vs_soc->at(seg_index).x_UB;
+}
+
+double algorithm_P2_vs_soc_virtual::get_soc_LB() const
+{
+	return this->P2_vs_soc->at(seg_index).x_LB;
+}
+
+algorithm_P2_vs_soc_virtual::algorithm_P2_vs_soc_virtual(const vehicle_charge_model_inputs& inputs)
+    :P2_vs_soc{ inputs.SOCP_factory.get_P2_vs_soc_segments( inputs.SOCP_factory.get_SOC_vs_P2_curves( inputs.EV_id, inputs.EVSE_id, inputs.CE.arrival_battery_temperature_C, inputs.CE.arrival_SOC ) ) },
+    seg_index{ 0 },
+    ref_seg_index{ -1 },
+    soc_to_energy{ inputs.battery_size_kWh / 100.0 },
+    prev_exp_val{ -1 },
+    exp_term{ std::exp(this->prev_exp_val) },
+    recalc_exponent_threshold{ 0.00000001 },
+    zero_slope_threshold_P2_vs_soc{ inputs.SOCP_factory.get_SOC_vs_P2_curves( inputs.EV_id, inputs.EVSE_id, inputs.CE.arrival_battery_temperature_C, inputs.CE.arrival_SOC ).zero_slope_threshold },
+    segment_is_flat_P2_vs_soc{ false },
+    P2_vs_soc_segments_changed{ false }
+{
+}
+
+void algorithm_P2_vs_soc_virtual::set_P2_vs_soc(const shared_P2_vs_soc_segments& P2_vs_soc)
+{
+	this->P2_vs_soc_segments_changed = true;
+	this->P2_vs_soc = P2_vs_soc;
+}
+
+
+void algorithm_P2_vs_soc_virtual::find_line_segment_index(double init_soc, 
+                                                  bool &line_segment_not_found)
+{
+    this->seg_index = -1;
+    for(int i=0; i< this->P2_vs_soc->size(); i++)
+    {
+        if(init_soc <= this->P2_vs_soc->at(i).x_UB)
+        {
+            this->seg_index = i;
+            break;
+        }
+    }
+
+    line_segment_not_found = (this->seg_index == -1);
+}
+
+
+void algorithm_P2_vs_soc_virtual::get_next_line_segment(bool is_charging_not_discharging, 
+                                                bool &next_line_segment_exists)
+{
+    if(is_charging_not_discharging)
+    {
+        this->seg_index++;
+        next_line_segment_exists = (this->seg_index < this->P2_vs_soc->size());
+    }
+    else
+    {
+        this->seg_index--;
+        next_line_segment_exists = (this->seg_index >= 0);
+    }
+}
+
+
+//##############################
+//   Child Class  (No Losses)
+//##############################
+
+algorithm_P2_vs_soc_no_losses_virtual::algorithm_P2_vs_soc_no_losses_virtual(const battery_charge_mode& mode, 
+                                                             const vehicle_charge_model_inputs& inputs)
+    :algorithm_P2_vs_soc_virtual{ inputs },
+    a{ 0.0 },
+    b{ 0.0 },
+    A{ 0.0 }
+{
+}
+
+std::shared_ptr<algorithm_P2_vs_soc_virtual> algorithm_P2_vs_soc_no_losses_virtual::clone() const
+{
+    return std::make_shared<algorithm_P2_vs_soc_no_losses_virtual>(*this);
+}
+
+double algorithm_P2_vs_soc_no_losses_virtual::get_soc_t1(double t1_minus_t0_hrs, 
+                                                 double soc_t0)
+{
+	bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);	
+	this->P2_vs_soc_segments_changed = false;
+
+    if(update_vals)
+    {
+        this->ref_seg_index = this->seg_index;
+        this->a = this->P2_vs_soc->at(this->seg_index).a;
+        this->b = this->P2_vs_soc->at(this->seg_index).b;
+        this->A = this->a/this->soc_to_energy;
+        this->segment_is_flat_P2_vs_soc = std::abs(this->a) < this->zero_slope_threshold_P2_vs_soc;
+        
+        this->prev_exp_val = this->A*t1_minus_t0_hrs;
+        this->exp_term = std::exp(this->prev_exp_val);
+    }
+    
+    //-------------
+    
+    double soc_t1;
+    
+    if(this->segment_is_flat_P2_vs_soc)
+    {
+    	double P2_soc_t0 = this->a*soc_t0 + this->b;
+        soc_t1 = soc_t0 + P2_soc_t0*t1_minus_t0_hrs/this->soc_to_energy;
+    }
+    else
+    {
+    	double cur_exp_val = this->A*t1_minus_t0_hrs;
+    	
+        if(this->recalc_exponent_threshold < std::abs(this->prev_exp_val - cur_exp_val))
+        {
+        	this->prev_exp_val = cur_exp_val;
+            this->exp_term = std::exp(cur_exp_val);
+        }
+        
+        double P2_soc_t1;
+        
+        P2_soc_t1 = this->exp_term*(this->a*soc_t0 + this->b);
+        soc_t1 = (P2_soc_t1-this->b)/this->a;
+    }
+    
+    return soc_t1;
+}
+
+double algorithm_P2_vs_soc_no_losses_virtual::get_time_to_soc_t1_hrs(double soc_t0, 
+                                                             double soc_t1)
+{
+	bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);
+	this->P2_vs_soc_segments_changed = false;
+
+    if(update_vals)
+    {
+        this->ref_seg_index = this->seg_index;
+        this->a = this->P2_vs_soc->at(this->seg_index).a;
+        this->b = this->P2_vs_soc->at(this->seg_index).b;
+        this->A = this->a/this->soc_to_energy;
+        this->segment_is_flat_P2_vs_soc = std::abs(this->a) < this->zero_slope_threshold_P2_vs_soc;
+    }
+    
+    //-------------
+    
+    double tmp_hrs;
+    
+    if(this->segment_is_flat_P2_vs_soc)
+    {
+    	double P2_soc_t0 = this->a*soc_t0 + this->b;
+        tmp_hrs = (soc_t1 - soc_t0)*this->soc_to_energy/P2_soc_t0;
+    }
+    else
+        tmp_hrs = std::log((this->a*soc_t1 + this->b)/(this->a*soc_t0 + this->b))/this->A;
+                          
+    return tmp_hrs;
+}
+
+
+//##############################
+//   Child Class  (Losses)
+//##############################
+
+algorithm_P2_vs_soc_losses_virtual::algorithm_P2_vs_soc_losses_virtual(const battery_charge_mode& mode, 
+                                                       const vehicle_charge_model_inputs& inputs)
+    :algorithm_P2_vs_soc_virtual{ inputs },
+    bat_eff_vs_P2{ inputs.PE_factory.get_P2_vs_battery_eff(inputs.EV_id, mode).curve },
+    a{ 0.0 },
+    b{ 0.0 },
+    c{ 0.0 },
+    d{ 0.0 },
+    A{ 0.0 },
+    B{ 0.0 },
+    C{ 0.0 },
+    D{ 0.0 },
+    z{ 0.0 }
+{
+}
+
+std::shared_ptr<algorithm_P2_vs_soc_virtual> algorithm_P2_vs_soc_losses_virtual::clone() const
+{
+    return std::make_shared<algorithm_P2_vs_soc_losses_virtual>(*this);
+}
+
+
+double algorithm_P2_vs_soc_losses_virtual::get_soc_t1(double t1_minus_t0_hrs, 
+                                              double soc_t0)
+{
+    bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);
+    this->P2_vs_soc_segments_changed = false;
+
+    if(update_vals)
+    {
+        this->ref_seg_index = this->seg_index;
+        this->a = this->P2_vs_soc->at(this->seg_index).a;
+        this->b = this->P2_vs_soc->at(this->seg_index).b;
+        this->c = this->bat_eff_vs_P2.a;
+        this->d = this->bat_eff_vs_P2.b;
+        
+        this->A = this->a/this->soc_to_energy;
+        this->B = this->b;
+        this->C = this->c*this->a/this->soc_to_energy;
+        this->D = this->c*this->b + this->d;
+        this->z = this->B*this->C - this->A*this->D;
+                
+        this->segment_is_flat_P2_vs_soc = std::abs(this->a) < this->zero_slope_threshold_P2_vs_soc;
+        
+        this->prev_exp_val = this->z*t1_minus_t0_hrs;
+        this->exp_term = std::exp(this->prev_exp_val);
+    }
+    
+    //-------------
+    
+    double soc_t1, e_t0, eff_e_t0;
+        
+    e_t0 = soc_t0*this->soc_to_energy;
+    eff_e_t0 = this->C*e_t0 + this->D;
+    
+    if(this->segment_is_flat_P2_vs_soc)
+    {
+    	double P2_soc_t0 = this->a*soc_t0 + this->b;
+        soc_t1 = soc_t0 + eff_e_t0*P2_soc_t0*t1_minus_t0_hrs/this->soc_to_energy;
+    }
+    else
+    {
+    	double cur_exp_val = this->z*t1_minus_t0_hrs;
+    	
+        if(this->recalc_exponent_threshold < std::abs(this->prev_exp_val - cur_exp_val))
+        {
+        	this->prev_exp_val = cur_exp_val;
+            this->exp_term = std::exp(cur_exp_val);
+        }
+
+        double e_t1, P2_e_t0, X;
+        
+        P2_e_t0 = this->A*e_t0 + this->B;
+        X = this->exp_term * eff_e_t0 / P2_e_t0;
+        e_t1 = (X*this->B - this->D)/(this->C - X*this->A);
+        soc_t1 = e_t1/this->soc_to_energy;
+ 	}
+    
+    //-------------
+    
+    return soc_t1;
+}
+
+
+double algorithm_P2_vs_soc_losses_virtual::get_time_to_soc_t1_hrs(double soc_t0, 
+                                                          double soc_t1)
+{
+	bool update_vals = (this->ref_seg_index != this->seg_index) || (this->P2_vs_soc_segments_changed);
+	this->P2_vs_soc_segments_changed = false;
+
+    if(update_vals)
+    {
+        this->ref_seg_index = this->seg_index;
+        this->a = this->P2_vs_soc->at(this->seg_index).a;
+        this->b = this->P2_vs_soc->at(this->seg_index).b;
+        this->c = this->bat_eff_vs_P2.a;
+        this->d = this->bat_eff_vs_P2.b;
+        
+        this->A = this->a/this->soc_to_energy;
+        this->B = this->b;
+        this->C = this->c*this->a/this->soc_to_energy;
+        this->D = this->c*this->b + this->d;
+        this->z = this->B*this->C - this->A*this->D;
+                
+        this->segment_is_flat_P2_vs_soc = std::abs(this->a) < this->zero_slope_threshold_P2_vs_soc;
+    }
+    
+    //-------------
+    
+    double tmp_hrs, e_t0, eff_e_t0;
+    
+    e_t0 = soc_t0*this->soc_to_energy;
+    eff_e_t0 = this->C*e_t0 + this->D;
+    
+    if(this->segment_is_flat_P2_vs_soc)
+    {
+    	double P2_soc_t0 = this->a*soc_t0 + this->b;
+        tmp_hrs = (soc_t1-soc_t0)*this->soc_to_energy/(P2_soc_t0*eff_e_t0);
+    }
+    else
+    {
+        double e_t1, P2_e_t0, P2_e_t1, eff_e_t1;
+        
+        P2_e_t0 = this->A*e_t0 + this->B;
+        e_t1 = soc_t1*this->soc_to_energy;
+        P2_e_t1 = this->A*e_t1 + this->B;
+        eff_e_t1 = this->C*e_t1 + this->D;
+        
+        tmp_hrs = std::log((eff_e_t1*P2_e_t0)/(eff_e_t0*P2_e_t1))/this->z;
+    }
+    return tmp_hrs;
+}
+
+
+//#############################################################################
+//                         Calculate Energy Limits
+//#############################################################################
+
+
+calc_E1_energy_limit_virtual::calc_E1_energy_limit_virtual(const battery_charge_mode& mode, 
+                                           const bool& are_battery_losses, 
+                                           const vehicle_charge_model_inputs& inputs)
+{
+    if (are_battery_losses)
+    {
+        this->P2_vs_soc_algorithm = std::make_shared<algorithm_P2_vs_soc_losses_virtual>(mode, inputs);
+    }
+    else
+    {
+        this->P2_vs_soc_algorithm = std::make_shared<algorithm_P2_vs_soc_no_losses_virtual>(mode, inputs);
+    }
+}
+
+//##############################
+//           Charging
+//##############################
+
+calc_E1_energy_limit_charging_virtual::calc_E1_energy_limit_charging_virtual(const bool& are_battery_losses, 
+                                                             const vehicle_charge_model_inputs& inputs)
+    : calc_E1_energy_limit_virtual{ battery_charge_mode::charging, are_battery_losses, inputs }
+{
+}
+
+std::shared_ptr<calc_E1_energy_limit_virtual> calc_E1_energy_limit_charging_virtual::clone() const
+{
+    std::shared_ptr<calc_E1_energy_limit_charging_virtual> return_val = std::make_shared<calc_E1_energy_limit_charging_virtual>(*this);
+    return_val->P2_vs_soc_algorithm = this->P2_vs_soc_algorithm->clone();
+    return return_val;
+}
+
+void calc_E1_energy_limit_charging_virtual::get_E1_limit(double time_step_sec, 
+                                                 double init_soc, 
+                                                 double target_soc, 
+                                                 bool P2_vs_soc_segments_changed, 
+                                                 const shared_P2_vs_soc_segments& P2_vs_soc, 
+                                                 E1_energy_limit& E1_limit)
+{
+	if(P2_vs_soc_segments_changed)
+    	this->P2_vs_soc_algorithm->set_P2_vs_soc(P2_vs_soc);
+    
+    bool line_segment_not_found;
+    this->P2_vs_soc_algorithm->find_line_segment_index(init_soc, line_segment_not_found);
+    
+    if(line_segment_not_found)
+    {
+        E1_limit = {100, 0, 0, unknown, 0, -1}; // {target_soc, max_energy_kWh, max_energy_charge_time_hrs, reached_target_status, energy_to_target_soc_kWh, min_time_to_target_soc_hrs}
+    	return;
+    }
+    
+    //----------------------------------
+    //        Calculate
+    //----------------------------------
+    
+    target_soc = (100 < target_soc) ? 100 : target_soc;
+    
+    energy_target_reached_status energy_target_status = unknown;
+    if(target_soc <= init_soc)
+    {
+        energy_target_status = have_passed_energy_target;
+    	target_soc = 100;
+    }
+    
+    double soc_UB, soc_t0, soc_t1, t1_minus_t0_hrs, tmp_hrs;
+    double min_time_to_target_hrs, max_energy_charge_time_hrs;
+    bool break_now, is_charging_not_discharging;
+    bool next_line_segment_exists;
+    is_charging_not_discharging = true;
+    
+    soc_t0 = init_soc;
+    t1_minus_t0_hrs = time_step_sec/3600;
+    max_energy_charge_time_hrs = 0;
+    break_now = false;
+    while(true)
+    {
+        soc_UB = this->P2_vs_soc_algorithm->get_soc_UB();
+        soc_t1 = this->P2_vs_soc_algorithm->get_soc_t1(t1_minus_t0_hrs, soc_t0);                     
+        
+        if(100 < soc_t1)
+        	soc_t1 = 100;
+        
+        // For the last segment (soc_UB > 100)
+        // Since soc_t1 <= 100: if(soc_UB < soc_t1) will never be true for the last segment
+        if(soc_UB < soc_t1)   
+        	soc_t1 = soc_UB;
+        else
+            break_now = true;
+
+        if(energy_target_status == unknown && soc_t0 <= target_soc && target_soc <= soc_t1)
+        {
+            energy_target_status = can_reach_energy_target_this_timestep;
+            tmp_hrs = this->P2_vs_soc_algorithm->get_time_to_soc_t1_hrs(soc_t0, target_soc);
+            min_time_to_target_hrs = max_energy_charge_time_hrs + tmp_hrs;
+        }
+
+        if(break_now)
+        {
+            max_energy_charge_time_hrs += t1_minus_t0_hrs;
+            break;
+        }
+        else
+        {
+            tmp_hrs = this->P2_vs_soc_algorithm->get_time_to_soc_t1_hrs(soc_t0, soc_t1);
+            max_energy_charge_time_hrs += tmp_hrs;
+        
+            t1_minus_t0_hrs -= tmp_hrs;
+            soc_t0 = soc_t1;
+            this->P2_vs_soc_algorithm->get_next_line_segment(is_charging_not_discharging, next_line_segment_exists);
+            
+            if(!next_line_segment_exists)
+                break;
+        }
+    }
+        
+    if(energy_target_status == unknown)
+        energy_target_status = can_not_reach_energy_target_this_timestep;
+    
+    //--------------------------------------------
+    
+    double soc_to_energy = this->P2_vs_soc_algorithm->get_soc_to_energy();
+    
+    E1_limit.target_soc = target_soc;
+    E1_limit.max_E1_energy_charge_time_hrs = max_energy_charge_time_hrs;
+    E1_limit.max_E1_energy_kWh = (soc_t1 - init_soc)*soc_to_energy;
+    E1_limit.reached_target_status = energy_target_status;
+    E1_limit.E1_energy_to_target_soc_kWh = (energy_target_status == can_reach_energy_target_this_timestep) ? (target_soc - init_soc)*soc_to_energy : 0;
+    E1_limit.min_time_to_target_soc_hrs = (energy_target_status == can_reach_energy_target_this_timestep) ? min_time_to_target_hrs : -1;
+}
+
+
+//##############################
+//        Discharging
+//##############################
+
+calc_E1_energy_limit_discharging_virtual::calc_E1_energy_limit_discharging_virtual(const bool& are_battery_losses, 
+                                                                   const vehicle_charge_model_inputs& inputs)
+    :calc_E1_energy_limit_virtual{ battery_charge_mode::discharging, are_battery_losses, inputs }
+{
+}
+
+std::shared_ptr<calc_E1_energy_limit_virtual> calc_E1_energy_limit_discharging_virtual::clone() const
+{
+    std::shared_ptr<calc_E1_energy_limit_discharging_virtual> return_val = std::make_shared<calc_E1_energy_limit_discharging_virtual>(*this);
+    return_val->P2_vs_soc_algorithm = this->P2_vs_soc_algorithm->clone();
+    return return_val;
+}
+
+void calc_E1_energy_limit_discharging_virtual::get_E1_limit(double time_step_sec, 
+                                                    double init_soc, 
+                                                    double target_soc, 
+                                                    bool P2_vs_soc_segments_changed, 
+                                                    const shared_P2_vs_soc_segments& P2_vs_soc, 
+                                                    E1_energy_limit& E1_limit)
+{
+	if(P2_vs_soc_segments_changed)
+    	this->P2_vs_soc_algorithm->set_P2_vs_soc(P2_vs_soc);
+	
+	bool line_segment_not_found;
+    this->P2_vs_soc_algorithm->find_line_segment_index(init_soc, line_segment_not_found);
+	
+    if(line_segment_not_found)
+    {
+        E1_limit = {0, 0, 0, unknown, 0, -1}; // {target_soc, max_energy_kWh, max_energy_charge_time_hrs, reached_target_status, energy_to_target_soc_kWh, min_time_to_target_soc_hrs}
+        return;
+    }
+	
+    //----------------------------------
+    //        Calculate
+    //----------------------------------
+    
+    target_soc = (target_soc < 0) ? 0 : target_soc;
+    
+    energy_target_reached_status energy_target_status = unknown;
+    if(init_soc <= target_soc)
+    {
+        energy_target_status = have_passed_energy_target;
+    	target_soc = 0;
+    }
+    
+    double soc_LB, soc_t0, soc_t1, t1_minus_t0_hrs, tmp_hrs;
+    double min_time_to_target_hrs, max_energy_charge_time_hrs;
+    bool break_now, is_charging_not_discharging;
+    bool next_line_segment_exists;
+    is_charging_not_discharging = false;
+    
+    soc_t0 = init_soc;
+    t1_minus_t0_hrs = time_step_sec/3600;
+    max_energy_charge_time_hrs = 0;
+    break_now = false;
+    while(true)
+    {
+        soc_LB = this->P2_vs_soc_algorithm->get_soc_LB();
+        soc_t1 = this->P2_vs_soc_algorithm->get_soc_t1(t1_minus_t0_hrs, soc_t0);                     
+        
+        if(soc_t1 < 0)
+        	soc_t1 = 0;
+        
+        // For the first segment (soc_LB < 0)
+        // Since soc_t1 >= 0: if(soc_t1 < soc_LB) will never be true for the first segment
+        if(soc_t1 < soc_LB)  
+            soc_t1 = soc_LB;
+        else
+            break_now = true;
+
+        if(energy_target_status == unknown && soc_t1 <= target_soc && target_soc <= soc_t0)
+        {
+            energy_target_status = can_reach_energy_target_this_timestep;
+            tmp_hrs = this->P2_vs_soc_algorithm->get_time_to_soc_t1_hrs(soc_t0, target_soc);
+            min_time_to_target_hrs = max_energy_charge_time_hrs + tmp_hrs;
+        }
+
+        if(break_now)
+        {
+            max_energy_charge_time_hrs += t1_minus_t0_hrs;
+            break;
+        }
+        else
+        {
+            tmp_hrs = this->P2_vs_soc_algorithm->get_time_to_soc_t1_hrs(soc_t0, soc_t1);
+            max_energy_charge_time_hrs += tmp_hrs;
+        
+            t1_minus_t0_hrs -= tmp_hrs;
+            soc_t0 = soc_t1;
+            this->P2_vs_soc_algorithm->get_next_line_segment(is_charging_not_discharging, next_line_segment_exists);
+            
+            if(!next_line_segment_exists)
+                break;
+        }
+    }
+    
+    if(energy_target_status == unknown)
+        energy_target_status = can_not_reach_energy_target_this_timestep;
+    
+    //--------------------------------------------
+    
+    double soc_to_energy = this->P2_vs_soc_algorithm->get_soc_to_energy();
+    
+    E1_limit.target_soc = target_soc;
+    E1_limit.max_E1_energy_charge_time_hrs = max_energy_charge_time_hrs;
+    E1_limit.max_E1_energy_kWh = (soc_t1 - init_soc)*soc_to_energy;
+    E1_limit.reached_target_status = energy_target_status;
+    E1_limit.E1_energy_to_target_soc_kWh = (energy_target_status == can_reach_energy_target_this_timestep) ? (target_soc - init_soc)*soc_to_energy : 0;
+    E1_limit.min_time_to_target_soc_hrs = (energy_target_status == can_reach_energy_target_this_timestep) ? min_time_to_target_hrs : -1;
+}
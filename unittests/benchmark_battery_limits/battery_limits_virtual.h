@@ -0,0 +1,147 @@
+
+#ifndef inl_battery_limits_virtual_H
+#define inl_battery_limits_virtual_H
+
+#include "battery_calculate_limits.h"   // E1_energy_limit, shared_P2_vs_soc_segments
+
+#include <vector>
+#include <memory>
+
+// The algorithm_P2_vs_soc and calc_E1_energy_limit class hierarchies battery used before
+// the limit algorithms were specialized on the charge mode and the battery losses flag,
+// kept as the reference for the benchmark.  The only change is the '_virtual' suffix.
+// They are defined in battery_limits_virtual.cpp, a translation unit of their own as in
+// the library before, so the compiler can not inline them into the benchmark loop.
+
+class algorithm_P2_vs_soc_virtual
+{
+private:
+	
+protected:
+
+    shared_P2_vs_soc_segments P2_vs_soc;
+
+    int seg_index, ref_seg_index;
+    double soc_to_energy, prev_exp_val, exp_term;
+	double recalc_exponent_threshold, zero_slope_threshold_P2_vs_soc;
+	bool segment_is_flat_P2_vs_soc, P2_vs_soc_segments_changed;
+
+public:
+
+    algorithm_P2_vs_soc_virtual(const vehicle_charge_model_inputs& inputs);
+    
+    void find_line_segment_index(double init_soc, 
+                                 bool &line_segment_not_found);    
+    double get_soc_UB() const;
+    double get_soc_LB() const;
+    double get_soc_to_energy() const;
+    void get_next_line_segment(bool is_charging_not_discharging, 
+                               bool &next_line_segment_exists);
+    void set_P2_vs_soc(const shared_P2_vs_soc_segments& P2_vs_soc);
+    virtual std::shared_ptr<algorithm_P2_vs_soc_virtual> clone() const = 0;
+    virtual double get_soc_t1(double t1_minus_t0_hrs, 
+                              double soc_t0) = 0;
+    virtual double get_time_to_soc_t1_hrs(double soc_t0, 
+                                          double soc_t1) = 0;
+};
+
+
+class algorithm_P2_vs_soc_no_losses_virtual:public algorithm_P2_vs_soc_virtual
+{
+private:
+
+    double a, b, A;
+    
+public:
+    algorithm_P2_vs_soc_no_losses_virtual(const battery_charge_mode& mode, 
+                                  const vehicle_charge_model_inputs& inputs);
+    
+    virtual std::shared_ptr<algorithm_P2_vs_soc_virtual> clone() const override final;
+    virtual double get_soc_t1(double t1_minus_t0_hrs, 
+                              double soc_t0) override final;
+    virtual double get_time_to_soc_t1_hrs(double soc_t0, 
+                                          double soc_t1) override final;
+};
+
+
+class algorithm_P2_vs_soc_losses_virtual:public algorithm_P2_vs_soc_virtual
+{
+private:
+
+    double a, b, c, d, A, B, C, D, z;
+    const line_segment& bat_eff_vs_P2;
+
+public:
+    algorithm_P2_vs_soc_losses_virtual(const battery_charge_mode& mode, 
+                               const vehicle_charge_model_inputs& inputs);
+	
+    virtual std::shared_ptr<algorithm_P2_vs_soc_virtual> clone() const override final;
+    virtual double get_soc_t1(double t1_minus_t0_hrs, 
+                              double soc_t0) override final;
+    virtual double get_time_to_soc_t1_hrs(double soc_t0, 
+                                          double soc_t1) override final;
+};
+
+
+//#############################################################################
+//                         Calculate Energy Limit
+//#############################################################################
+
+class calc_E1_energy_limit_virtual
+{
+private:
+
+protected:
+    std::shared_ptr<algorithm_P2_vs_soc_virtual> P2_vs_soc_algorithm;
+	
+public:
+
+    calc_E1_energy_limit_virtual(const battery_charge_mode& mode, 
+                         const bool& are_battery_losses, 
+                         const vehicle_charge_model_inputs& inputs);
+    
+    // Deep copy, the P2_vs_soc_algorithm is not shared with the copy.
+    virtual std::shared_ptr<calc_E1_energy_limit_virtual> clone() const = 0;
+    
+    virtual void get_E1_limit(double time_step_sec, double init_soc, double target_soc, bool P2_vs_soc_segments_changed, const shared_P2_vs_soc_segments& P2_vs_soc, E1_energy_limit& E1_limit) = 0;
+};
+
+
+class calc_E1_energy_limit_charging_virtual:public calc_E1_energy_limit_virtual
+{
+private:
+        
+public:
+    calc_E1_energy_limit_charging_virtual(const bool& are_battery_losses, 
+                                  const vehicle_charge_model_inputs& inputs);
+    
+    virtual std::shared_ptr<calc_E1_energy_limit_virtual> clone() const override final;
+    
+    virtual void get_E1_limit(double time_step_sec, 
+                              double init_soc, 
+                              double target_soc, 
+                              bool P2_vs_soc_segments_changed, 
+                              const shared_P2_vs_soc_segments& P2_vs_soc, 
+                              E1_energy_limit& E1_limit) override final;
+};
+
+
+class calc_E1_energy_limit_discharging_virtual:public calc_E1_energy_limit_virtual
+{
+private:
+
+public:
+    calc_E1_energy_limit_discharging_virtual(const bool& are_battery_losses, 
+                                     const vehicle_charge_model_inputs& inputs);
+
+    virtual std::shared_ptr<calc_E1_energy_limit_virtual> clone() const override final;
+
+    virtual void get_E1_limit(double time_step_sec, 
+                              double init_soc, 
+                              double target_soc, 
+                              bool P2_vs_soc_segments_changed, 
+                              const shared_P2_vs_soc_segments& P2_vs_soc, 
+                              E1_energy_limit& E1_limit) override final;
+};
+
+#endif
@@ -0,0 +1,209 @@
+#include "load_EV_EVSE_inventory.h"
+#include "factory_charging_transitions.h"
+#include "factory_puVrms_vs_P2.h"
+#include "factory_SOC_vs_P2.h"
+#include "factory_P2_vs_battery_efficiency.h"
+#include "battery_calculate_limits.h"
+#include "battery_limits_virtual.h"
+
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+// Times the calc_E1_energy_limit templates against the virtual class hierarchy they
+// replaced, for every compatible EV / EVSE pair, charge mode and battery losses flag.
+// battery_limits_virtual.h is that hierarchy as it was in battery_calculate_limits
+// before the templates, so it is an independent reference for the energy limits.  It
+// is compiled in battery_limits_virtual.cpp, like it was in the library, while the
+// templates are inlined from battery_calculate_limits.h as they are in battery.
+//
+//    benchmark_battery_limits [input_path] [num_repeats]
+//
+// Fails when an energy limit of the templates differs from the virtual classes by more
+// than a relative 1e-9, so the comparison does not depend on the compiler inlining or
+// contracting the floating point operations differently in the two, and when the
+// templates take longer per step than the virtual classes for any of the combinations.
+
+
+struct step_inputs
+{
+    double time_step_sec;
+    double init_soc;
+    double target_soc;
+};
+
+
+bool are_equal( const double A, const double B )
+{
+    const double tol = 1e-9;
+
+    if( std::isnan(A) || std::isnan(B) )
+        return std::isnan(A) && std::isnan(B);
+
+    return A == B || std::abs(A - B) <= tol * std::max(1.0, std::max(std::abs(A), std::abs(B)));
+}
+
+
+bool are_equal( const E1_energy_limit& A, const E1_energy_limit& B )
+{
+    return are_equal(A.target_soc, B.target_soc) &&
+           are_equal(A.max_E1_energy_kWh, B.max_E1_energy_kWh) &&
+           are_equal(A.max_E1_energy_charge_time_hrs, B.max_E1_energy_charge_time_hrs) &&
+           A.reached_target_status == B.reached_target_status &&
+           are_equal(A.E1_energy_to_target_soc_kWh, B.E1_energy_to_target_soc_kWh) &&
+           are_equal(A.min_time_to_target_soc_hrs, B.min_time_to_target_soc_hrs);
+}
+
+
+template<battery_charge_mode mode, bool are_battery_losses>
+int compare( const vehicle_charge_model_inputs& inputs,
+             const shared_P2_vs_soc_segments& P2_vs_soc,
+             const std::vector<step_inputs>& steps,
+             const int num_repeats,
+             double& template_sec,
+             double& virtual_sec )
+{
+    algorithm_P2_vs_soc P2_vs_soc_algorithm{ mode, inputs };
+    P2_vs_soc_algorithm.set_P2_vs_soc(P2_vs_soc);
+
+    std::shared_ptr<calc_E1_energy_limit_virtual> calc_E1_limit;
+    if(mode == battery_charge_mode::charging)
+        calc_E1_limit = std::make_shared<calc_E1_energy_limit_charging_virtual>(are_battery_losses, inputs);
+    else
+        calc_E1_limit = std::make_shared<calc_E1_energy_limit_discharging_virtual>(are_battery_losses, inputs);
+
+    // The first call hands the segments to the virtual implementation.
+    E1_energy_limit E1_limit;
+    calc_E1_limit->get_E1_limit(60, 50, 50, true, P2_vs_soc, E1_limit);
+
+    std::vector<E1_energy_limit> template_limits(steps.size());
+    std::vector<E1_energy_limit> virtual_limits(steps.size());
+
+    // The fastest of the repeats, so a pass slowed down by the rest of the machine does not
+    // decide the comparison.
+    double min_template_sec = 1e9;
+    double min_virtual_sec = 1e9;
+
+    for( int i = 0; i < num_repeats; i++ )
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        for( int j = 0; j < (int)steps.size(); j++ )
+            calc_E1_energy_limit<mode, are_battery_losses>(P2_vs_soc_algorithm, steps[j].time_step_sec, steps[j].init_soc, steps[j].target_soc, template_limits[j]);
+        auto t1 = std::chrono::steady_clock::now();
+        min_template_sec = std::min(min_template_sec, std::chrono::duration<double>(t1 - t0).count());
+
+        t0 = std::chrono::steady_clock::now();
+        for( int j = 0; j < (int)steps.size(); j++ )
+            calc_E1_limit->get_E1_limit(steps[j].time_step_sec, steps[j].init_soc, steps[j].target_soc, false, P2_vs_soc, virtual_limits[j]);
+        t1 = std::chrono::steady_clock::now();
+        min_virtual_sec = std::min(min_virtual_sec, std::chrono::duration<double>(t1 - t0).count());
+    }
+
+    template_sec += min_template_sec;
+    virtual_sec += min_virtual_sec;
+
+    int num_mismatches = 0;
+    for( int j = 0; j < (int)steps.size(); j++ )
+    {
+        if( !are_equal(template_limits[j], virtual_limits[j]) )
+            num_mismatches += 1;
+    }
+    return num_mismatches;
+}
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+    const int num_repeats = (argc > 2) ? std::stoi(argv[2]) : 20;
+
+    load_EV_EVSE_inventory load_inventory{ input_path };
+    const EV_EVSE_inventory& inventory = load_inventory.get_EV_EVSE_inventory();
+
+    const factory_charging_transitions CT_factory{ inventory, EV_ramping_map{}, EV_EVSE_ramping_map{} };
+    const factory_puVrms_vs_P2 VP_factory{ inventory };
+    const factory_SOC_vs_P2 SOCP_factory{ inventory };
+    const factory_P2_vs_battery_efficiency PE_factory{ inventory };
+
+    // Time steps of one minute to one hour from every soc, to a target a few percent away
+    // in either direction.
+    std::vector<step_inputs> steps;
+    for( const double time_step_sec : { 60.0, 300.0, 900.0, 3600.0 } )
+    {
+        for( double init_soc = 0.5; init_soc < 100; init_soc += 0.5 )
+        {
+            steps.push_back({ time_step_sec, init_soc, init_soc + 4 });
+            steps.push_back({ time_step_sec, init_soc, init_soc - 4 });
+        }
+    }
+
+    const std::vector<std::string> combination_names = { "charging    no losses", "charging    losses   ", "discharging no losses", "discharging losses   " };
+    std::vector<double> template_sec(4, 0);
+    std::vector<double> virtual_sec(4, 0);
+    int num_pairs = 0;
+    int num_mismatches = 0;
+
+    for( const pev_SE_pair& pair : inventory.get_all_compatible_pev_SE_combinations() )
+    {
+        const EV_type_id EV_id = inventory.get_EV_type_id(pair.ev_type);
+        const EVSE_type_id EVSE_id = inventory.get_EVSE_type_id(pair.se_type);
+
+        // The P2 limit is below the EVSE power so the limited segments differ from the curve.
+        const double SE_P2_limit_kW = 0.8 * inventory.get_EVSE_inventory().at(pair.se_type).get_power_limit_kW();
+        const double battery_size_kWh = inventory.get_EV_inventory().at(pair.ev_type).get_usable_battery_size_kWh();
+
+        charge_event_data CE;
+        CE.vehicle_type = pair.ev_type;
+        CE.arrival_SOC = 20;
+
+        const vehicle_charge_model_inputs inputs{ CE, EV_id, EVSE_id, SE_P2_limit_kW, battery_size_kWh, CT_factory, VP_factory, SOCP_factory, PE_factory };
+
+        const SOC_vs_P2& curve = SOCP_factory.get_SOC_vs_P2_curves(EV_id, EVSE_id, CE.arrival_battery_temperature_C, CE.arrival_SOC);
+        const shared_P2_vs_soc_segments charging_segments = std::make_shared<const std::vector<line_segment> >(apply_P2_limit_to_P2_vs_soc_segments(*SOCP_factory.get_P2_vs_soc_segments(curve), battery_charge_mode::charging, SE_P2_limit_kW));
+        const shared_P2_vs_soc_segments discharging_segments = std::make_shared<const std::vector<line_segment> >(apply_P2_limit_to_P2_vs_soc_segments(*SOCP_factory.get_P2_vs_soc_segments(curve), battery_charge_mode::discharging, -SE_P2_limit_kW));
+
+        int pair_mismatches = 0;
+        pair_mismatches += compare<battery_charge_mode::charging, false>(inputs, charging_segments, steps, num_repeats, template_sec[0], virtual_sec[0]);
+        pair_mismatches += compare<battery_charge_mode::charging, true>(inputs, charging_segments, steps, num_repeats, template_sec[1], virtual_sec[1]);
+        pair_mismatches += compare<battery_charge_mode::discharging, false>(inputs, discharging_segments, steps, num_repeats, template_sec[2], virtual_sec[2]);
+        pair_mismatches += compare<battery_charge_mode::discharging, true>(inputs, discharging_segments, steps, num_repeats, template_sec[3], virtual_sec[3]);
+
+        num_pairs += 1;
+        num_mismatches += pair_mismatches;
+
+        if( pair_mismatches > 0 )
+        {
+            std::cout << "Error: different energy limits for EV_type: " << pair.ev_type << "  EVSE_type: " << pair.se_type
+                      << "  mismatches: " << pair_mismatches << std::endl;
+        }
+    }
+
+    const double num_steps = (double)num_pairs * steps.size();
+
+    std::cout << "EV / EVSE pairs: " << num_pairs << "  steps: " << steps.size() << "  repeats: " << num_repeats << std::endl;
+    for( int i = 0; i < 4; i++ )
+    {
+        std::cout << combination_names[i] << "   template: " << 1e9 * template_sec[i] / num_steps << " ns/step"
+                  << "   virtual: " << 1e9 * virtual_sec[i] / num_steps << " ns/step"
+                  << "   speedup: " << virtual_sec[i] / template_sec[i] << std::endl;
+    }
+    std::cout << "mismatches:        " << num_mismatches << std::endl;
+
+    int num_slower = 0;
+    for( int i = 0; i < 4; i++ )
+    {
+        if( virtual_sec[i] <= template_sec[i] )
+        {
+            num_slower += 1;
+            std::cout << "Error: the templates are not faster than the virtual classes for " << combination_names[i] << std::endl;
+        }
+    }
+
+    if( num_mismatches == 0 && num_slower == 0 )
+        std::cout << "Success." << std::endl;
+
+    return num_mismatches + num_slower;
+}
@@ -0,0 +1,103 @@
+#include "load_EV_EVSE_inventory.h"
+#include "SE_EV_factory_charge_profile.h"
+#include "charge_profile_library.h"
+
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <cmath>
+
+// Compares pev_charge_profile::find_results_given_startSOC_and_endSOC (batched) with
+// find_result_given_startSOC_and_endSOC called once per query, on every profile of
+// the charge profile library.
+//
+//    benchmark_charge_profile_queries [input_path] [num_queries_per_profile]
+//
+// Fails when the two give different results.
+
+
+bool results_are_equal( const pev_charge_profile_result& A, const pev_charge_profile_result& B )
+{
+    const double tol = 1e-9;
+    
+    return std::abs(A.soc_increase - B.soc_increase) < tol &&
+           std::abs(A.E1_kWh - B.E1_kWh) < tol &&
+           std::abs(A.E2_kWh - B.E2_kWh) < tol &&
+           std::abs(A.E3_kWh - B.E3_kWh) < tol &&
+           std::abs(A.cumQ3_kVARh - B.cumQ3_kVARh) < tol &&
+           std::abs(A.total_charge_time_hrs - B.total_charge_time_hrs) < tol;
+}
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+    const int num_queries = (argc > 2) ? std::stoi(argv[2]) : 20000;
+
+    load_EV_EVSE_inventory load_inventory{ input_path };
+    const EV_EVSE_inventory& inventory = load_inventory.get_EV_EVSE_inventory();
+
+    std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > validation_data;
+    const pev_charge_profile_library library = factory_charge_profile_library::get_charge_profile_library( inventory, false, true, validation_data );
+
+    std::mt19937 gen(1234);
+    std::uniform_real_distribution<double> unif(0.0, 1.0);
+
+    double batch_sec = 0;
+    double scalar_sec = 0;
+    int num_profiles = 0;
+    int num_mismatches = 0;
+
+    for( const pev_SE_pair& pev_SE : inventory.get_all_compatible_pev_SE_combinations() )
+    {
+        const pev_charge_profile& charge_profile = library.get_charge_profile( pev_SE.ev_type, pev_SE.se_type );
+        const double max_P3kW = charge_profile.get_charge_event_P3kW_limits().max_P3kW;
+
+        std::vector<double> setpoint_P3kW(num_queries), startSOC(num_queries), endSOC(num_queries);
+
+        for( int i = 0; i < num_queries; i++ )
+        {
+            setpoint_P3kW[i] = 0.01 + 1.2*max_P3kW*unif(gen);
+            startSOC[i] = 100*unif(gen);
+            endSOC[i] = startSOC[i] + (100 - startSOC[i])*unif(gen);
+        }
+
+        std::vector<pev_charge_profile_result> batch_results(num_queries), scalar_results(num_queries);
+
+        auto t0 = std::chrono::steady_clock::now();
+        charge_profile.find_results_given_startSOC_and_endSOC( setpoint_P3kW, startSOC, endSOC, batch_results );
+        auto t1 = std::chrono::steady_clock::now();
+        batch_sec += std::chrono::duration<double>(t1 - t0).count();
+
+        t0 = std::chrono::steady_clock::now();
+        for( int i = 0; i < num_queries; i++ )
+        {
+            scalar_results[i] = charge_profile.find_result_given_startSOC_and_endSOC( setpoint_P3kW[i], startSOC[i], endSOC[i] );
+        }
+        t1 = std::chrono::steady_clock::now();
+        scalar_sec += std::chrono::duration<double>(t1 - t0).count();
+
+        num_profiles += 1;
+
+        for( int i = 0; i < num_queries; i++ )
+        {
+            if( !results_are_equal(batch_results[i], scalar_results[i]) )
+            {
+                num_mismatches += 1;
+                std::cout << "Error: different results for EV_type: " << pev_SE.ev_type << "  EVSE_type: " << pev_SE.se_type
+                          << "  setpoint_P3kW: " << setpoint_P3kW[i] << "  startSOC: " << startSOC[i] << "  endSOC: " << endSOC[i] << std::endl;
+                break;
+            }
+        }
+    }
+
+    std::cout << "profiles: " << num_profiles << "  queries per profile: " << num_queries << std::endl;
+    std::cout << "batched:      " << batch_sec << " s" << std::endl;
+    std::cout << "one by one:   " << scalar_sec << " s" << std::endl;
+    std::cout << "speedup:      " << scalar_sec / batch_sec << std::endl;
+    std::cout << "mismatches:   " << num_mismatches << std::endl;
+
+    return num_mismatches;
+}
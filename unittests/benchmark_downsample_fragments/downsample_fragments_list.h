@@ -0,0 +1,230 @@
+
+#ifndef inl_downsample_fragments_list_H
+#define inl_downsample_fragments_list_H
+
+#include "datatypes_global.h"   // pev_charge_fragment_removal_criteria
+
+#include <vector>
+#include <map>
+#include <list>
+#include <iterator>
+#include <algorithm>
+#include <unordered_set>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+// The std::list / std::map implementation downsample_charge_fragment_vector had before
+// the indexed heap, kept as the reference for the benchmark.  The only change is the
+// tie-breaking: the map key is (variation_rank, original_charge_fragment_index) instead
+// of variation_rank plus a random number, so both implementations must keep the same
+// fragments.
+
+class downsample_charge_fragment_vector_list
+{
+private:
+    typedef std::pair<int64_t, int> rank_key;
+
+    pev_charge_fragment_removal_criteria fragment_removal_criteria;
+    double change_metric_multiplier;
+
+    std::list<pev_charge_fragment_variation> charge_fragment_variations;
+    std::map<rank_key, std::list<pev_charge_fragment_variation>::iterator> variationRank_to_fragmentVariationIt_map;
+
+    std::vector<pev_charge_fragment_variation> removed_fragments;
+    std::vector<pev_charge_fragment_variation> retained_fragments;
+
+    int64_t calculate_variation_rank(std::list<pev_charge_fragment_variation>::iterator it)
+    {
+        std::list<pev_charge_fragment_variation>::iterator it_next = std::next(it);
+        std::list<pev_charge_fragment_variation>::iterator it_prev = std::prev(it);
+
+        double P3kW_delta_A = std::abs(it->P3_kW - it_prev->P3_kW);
+        double P3kW_delta_B = std::abs(it_next->P3_kW - it->P3_kW);
+        double P3kW_delta_C = std::abs(it_next->P3_kW - it_prev->P3_kW);
+        double P3kW_delta = std::max({P3kW_delta_A, P3kW_delta_B, P3kW_delta_C});
+
+        double kW_change_metric = P3kW_delta / this->fragment_removal_criteria.kW_change_threshold;
+        return (int64_t)((kW_change_metric)*this->change_metric_multiplier);
+    }
+
+    int get_index_of_elbow(int start_index, int end_index)
+    {
+        std::list<pev_charge_fragment_variation>::iterator it = std::next(this->charge_fragment_variations.begin(), start_index);
+        double soc_0 = it->soc;
+        double P3kW_0 = it->P3_kW;
+
+        it = std::next(it, end_index - start_index);
+        double soc_1 = it->soc;
+        double P3kW_1 = it->P3_kW;
+
+        double m = (P3kW_1 - P3kW_0) / (soc_1 - soc_0);
+        double b = P3kW_1 - m*soc_1;
+
+        it = std::next(this->charge_fragment_variations.begin(), start_index);
+
+        double tmp_diff, max_diff_P3kW = 0;
+        int index_of_elbow = 0;
+
+        for(int i=start_index; i<end_index; i++)
+        {
+            tmp_diff = std::abs(it->P3_kW - (m*it->soc + b));
+            if(tmp_diff > max_diff_P3kW)
+            {
+                max_diff_P3kW = tmp_diff;
+                index_of_elbow = it->original_charge_fragment_index;
+            }
+
+            it = std::next(it);
+        }
+
+        return index_of_elbow;
+    }
+
+public:
+    downsample_charge_fragment_vector_list(pev_charge_fragment_removal_criteria fragment_removal_criteria_)
+        : fragment_removal_criteria{ fragment_removal_criteria_ },
+        change_metric_multiplier{ std::pow(10, 12) }
+    {
+    }
+
+    std::vector<pev_charge_fragment_variation> get_removed_fragments() { return this->removed_fragments; }
+    std::vector<pev_charge_fragment_variation> get_retained_fragments() { return this->retained_fragments; }
+
+    void downsample(std::vector<pev_charge_fragment>& original_charge_fragments, std::vector<pev_charge_fragment>& downsampled_charge_fragments)
+    {
+        downsampled_charge_fragments.clear();
+        this->variationRank_to_fragmentVariationIt_map.clear();
+        this->charge_fragment_variations.clear();
+        this->removed_fragments.clear();
+        this->retained_fragments.clear();
+
+        std::sort(original_charge_fragments.begin(), original_charge_fragments.end());
+        int num_original_fragments = original_charge_fragments.size();
+
+        if(std::abs(original_charge_fragments[0].time_since_charge_began_hrs) < 0.000001)
+            this->charge_fragment_variations.emplace_back(0, original_charge_fragments[0].time_since_charge_began_hrs, original_charge_fragments[0].soc, 0.0);
+        else
+            this->charge_fragment_variations.emplace_back(0, original_charge_fragments[0].time_since_charge_began_hrs, original_charge_fragments[0].soc, original_charge_fragments[0].E3_kWh / original_charge_fragments[0].time_since_charge_began_hrs);
+
+        for(int i=1; i<num_original_fragments; i++)
+        {
+            double P3_kW = (original_charge_fragments[i].E3_kWh - original_charge_fragments[i-1].E3_kWh) / (original_charge_fragments[i].time_since_charge_began_hrs - original_charge_fragments[i-1].time_since_charge_began_hrs);
+            this->charge_fragment_variations.emplace_back(i, original_charge_fragments[i].time_since_charge_began_hrs, original_charge_fragments[i].soc, P3_kW);
+        }
+
+        //----------------------
+
+        std::unordered_set<int> unremovable_charge_fragment_indexes = {0, num_original_fragments-1};
+        std::list<pev_charge_fragment_variation>::iterator it;
+
+        std::vector<pev_charge_fragment_variation> fragments_with_max_P3_kW;
+        double max_P3_kW = -1;
+
+        for(it=this->charge_fragment_variations.begin(); it!=this->charge_fragment_variations.end(); it++)
+            if(it->P3_kW > max_P3_kW)
+                max_P3_kW = it->P3_kW;
+
+        for(it=this->charge_fragment_variations.begin(); it!=this->charge_fragment_variations.end(); it++)
+            if(std::abs(max_P3_kW - it->P3_kW) < this->fragment_removal_criteria.threshold_to_determine_not_removable_fragments_on_flat_peak_kW)
+                fragments_with_max_P3_kW.push_back(*it);
+
+        int not_removable_fragment_index_flat_LB = fragments_with_max_P3_kW[0].original_charge_fragment_index;
+        int not_removable_fragment_index_flat_UB = fragments_with_max_P3_kW[fragments_with_max_P3_kW.size()-1].original_charge_fragment_index;
+
+        unremovable_charge_fragment_indexes.insert(not_removable_fragment_index_flat_LB);
+        unremovable_charge_fragment_indexes.insert(not_removable_fragment_index_flat_UB);
+
+        if(0 < this->fragment_removal_criteria.perc_of_max_starting_point_to_determine_not_removable_fragments_on_low_elbow)
+        {
+            int index_UB = not_removable_fragment_index_flat_LB;
+            int index_LB = -1;
+            double start_P3_kW = max_P3_kW * this->fragment_removal_criteria.perc_of_max_starting_point_to_determine_not_removable_fragments_on_low_elbow/100.0;
+
+            for(it=this->charge_fragment_variations.begin(); it!=this->charge_fragment_variations.end(); it++)
+            {
+                if(it->P3_kW > start_P3_kW)
+                {
+                    index_LB = it->original_charge_fragment_index;
+                    break;
+                }
+            }
+
+            int elbow_center = get_index_of_elbow(index_LB, index_UB);
+            int elbow_lower = get_index_of_elbow(index_LB, elbow_center);
+            int elbow_upper = get_index_of_elbow(elbow_center, index_UB);
+
+            unremovable_charge_fragment_indexes.insert(elbow_center);
+            unremovable_charge_fragment_indexes.insert(elbow_lower);
+            unremovable_charge_fragment_indexes.insert(elbow_upper);
+        }
+
+        //----------------------
+
+        for(it=this->charge_fragment_variations.begin(); it!=this->charge_fragment_variations.end(); it++)
+        {
+            if(unremovable_charge_fragment_indexes.count(it->original_charge_fragment_index) == 0)
+            {
+                it->is_removable = true;
+                it->variation_rank = calculate_variation_rank(it);
+                this->variationRank_to_fragmentVariationIt_map[rank_key(it->variation_rank, it->original_charge_fragment_index)] = it;
+            }
+            else
+                it->is_removable = false;
+        }
+
+        //----------------------
+
+        std::list<pev_charge_fragment_variation>::iterator it_prev, it_next;
+        std::unordered_set<int> indexes_to_remove;
+
+        int max_number_of_fragments_that_can_be_removed = (int)num_original_fragments*this->fragment_removal_criteria.max_percent_of_fragments_that_can_be_removed/100;
+
+        while(!this->variationRank_to_fragmentVariationIt_map.empty())
+        {
+            const rank_key min_key = this->variationRank_to_fragmentVariationIt_map.begin()->first;
+
+            if(min_key.first > (int64_t)this->change_metric_multiplier)
+                break;
+
+            it = this->variationRank_to_fragmentVariationIt_map.begin()->second;
+            it_prev = std::prev(it);
+            it_next = std::next(it);
+
+            indexes_to_remove.insert(it->original_charge_fragment_index);
+            this->removed_fragments.push_back(*it);
+            this->variationRank_to_fragmentVariationIt_map.erase(min_key);
+            this->charge_fragment_variations.erase(it);
+
+            if(it_prev->is_removable)
+            {
+                this->variationRank_to_fragmentVariationIt_map.erase(rank_key(it_prev->variation_rank, it_prev->original_charge_fragment_index));
+                it_prev->variation_rank = calculate_variation_rank(it_prev);
+                this->variationRank_to_fragmentVariationIt_map[rank_key(it_prev->variation_rank, it_prev->original_charge_fragment_index)] = it_prev;
+            }
+
+            if(it_next->is_removable)
+            {
+                this->variationRank_to_fragmentVariationIt_map.erase(rank_key(it_next->variation_rank, it_next->original_charge_fragment_index));
+                it_next->variation_rank = calculate_variation_rank(it_next);
+                this->variationRank_to_fragmentVariationIt_map[rank_key(it_next->variation_rank, it_next->original_charge_fragment_index)] = it_next;
+            }
+
+            if(indexes_to_remove.size() >= max_number_of_fragments_that_can_be_removed)
+                break;
+        }
+
+        for(it=this->charge_fragment_variations.begin(); it != this->charge_fragment_variations.end(); it++)
+            this->retained_fragments.push_back(*it);
+
+        for(int i=0; i<num_original_fragments; i++)
+        {
+            if(indexes_to_remove.count(i) == 0)
+                downsampled_charge_fragments.push_back(original_charge_fragments[i]);
+        }
+    }
+};
+
+
+#endif
+
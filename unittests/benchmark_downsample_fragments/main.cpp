@@ -0,0 +1,139 @@
+#include "load_EV_EVSE_inventory.h"
+#include "SE_EV_factory_charge_profile.h"
+#include "charge_profile_downsample_fragments.h"
+#include "downsample_fragments_list.h"
+
+#include <iostream>
+#include <sstream>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>                                    // omp_get_max_threads, omp_set_num_threads
+#endif
+
+// Compares downsample_charge_fragment_vector with the std::list / std::map implementation
+// it replaced, on the fragments of a charge profile library build.
+//
+//    benchmark_downsample_fragments [input_path] [num_repeats]
+//
+// Fails when the two implementations keep different fragments, compared index by index in
+// the retained, the removed and the downsampled fragments, or when two builds of the
+// library differ.  Ties in the variation rank go to the earlier fragment, so the library
+// does not depend on the build or on the number of threads it is built with.
+
+
+std::string get_library_bytes( const EV_EVSE_inventory& inventory, const int num_threads )
+{
+#ifdef _OPENMP
+    const int max_threads = omp_get_max_threads();
+    omp_set_num_threads(num_threads);
+#endif
+
+    std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > validation_data;
+    const pev_charge_profile_library library = factory_charge_profile_library::get_charge_profile_library( inventory, false, true, validation_data );
+
+#ifdef _OPENMP
+    omp_set_num_threads(max_threads);
+#endif
+
+    std::ostringstream out(std::ios::out | std::ios::binary);
+    library.write_binary(out);
+    return out.str();
+}
+
+
+std::vector<int> get_indexes( const std::vector<pev_charge_fragment_variation>& fragments )
+{
+    std::vector<int> return_val;
+    for( const pev_charge_fragment_variation& X : fragments )
+    {
+        return_val.push_back( X.original_charge_fragment_index );
+    }
+    return return_val;
+}
+
+
+std::vector<double> get_times( const std::vector<pev_charge_fragment>& fragments )
+{
+    std::vector<double> return_val;
+    for( const pev_charge_fragment& X : fragments )
+    {
+        return_val.push_back( X.time_since_charge_began_hrs );
+    }
+    return return_val;
+}
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+    const int num_repeats = (argc > 2) ? std::stoi(argv[2]) : 5;
+
+    load_EV_EVSE_inventory load_inventory{ input_path };
+    const EV_EVSE_inventory& inventory = load_inventory.get_EV_EVSE_inventory();
+
+    // The validation data holds the fragments and removal criteria of every profile in the library.
+    std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > validation_data;
+    factory_charge_profile_library::get_charge_profile_library( inventory, true, true, validation_data );
+
+    double heap_sec = 0;
+    double list_sec = 0;
+    int num_profiles = 0;
+    int num_fragments = 0;
+    int num_mismatches = 0;
+
+    for( const std::pair<const std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> >& X : validation_data )
+    {
+        for( const charge_profile_validation_data& data : X.second )
+        {
+            std::vector<pev_charge_fragment> fragments, heap_downsampled, list_downsampled;
+
+            downsample_charge_fragment_vector heap_obj{ data.fragment_removal_criteria };
+            downsample_charge_fragment_vector_list list_obj{ data.fragment_removal_criteria };
+
+            for( int i = 0; i < num_repeats; i++ )
+            {
+                fragments = data.original_charge_fragments;
+                auto t0 = std::chrono::steady_clock::now();
+                heap_obj.downsample( fragments, heap_downsampled );
+                auto t1 = std::chrono::steady_clock::now();
+                heap_sec += std::chrono::duration<double>(t1 - t0).count();
+
+                fragments = data.original_charge_fragments;
+                t0 = std::chrono::steady_clock::now();
+                list_obj.downsample( fragments, list_downsampled );
+                t1 = std::chrono::steady_clock::now();
+                list_sec += std::chrono::duration<double>(t1 - t0).count();
+            }
+
+            num_profiles += 1;
+            num_fragments += (int)data.original_charge_fragments.size();
+
+            if( get_indexes(heap_obj.get_retained_fragments()) != get_indexes(list_obj.get_retained_fragments()) ||
+                get_indexes(heap_obj.get_removed_fragments()) != get_indexes(list_obj.get_removed_fragments()) ||
+                get_times(heap_downsampled) != get_times(list_downsampled) )
+            {
+                num_mismatches += 1;
+                std::cout << "Error: different fragments retained for EV_type: " << X.first.first << "  EVSE_type: " << X.first.second
+                          << "  target_acP3_kW: " << data.target_acP3_kW << std::endl;
+            }
+        }
+    }
+
+    const int num_threads = 8;
+    if( get_library_bytes(inventory, 1) != get_library_bytes(inventory, num_threads) )
+    {
+        num_mismatches += 1;
+        std::cout << "Error: the library built with 1 thread differs from the one built with " << num_threads << " threads." << std::endl;
+    }
+
+    std::cout << "profiles: " << num_profiles << "  fragments: " << num_fragments << "  repeats: " << num_repeats << std::endl;
+    std::cout << "indexed heap:      " << heap_sec << " s" << std::endl;
+    std::cout << "std::list / map:   " << list_sec << " s" << std::endl;
+    std::cout << "speedup:           " << list_sec / heap_sec << std::endl;
+    std::cout << "mismatches:        " << num_mismatches << std::endl;
+
+    return num_mismatches;
+}
@@ -0,0 +1,249 @@
+
+#ifndef inl_interface_test_fixture_H
+#define inl_interface_test_fixture_H
+
+#include "ICM_interface.h"
+
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Setup shared by the tests that step interface_to_SE_groups over registered grid nodes
+// (test_trial_steps, test_checkpoints, test_charging_power_sensitivity, ...).
+//
+// Grid node i has one SE of each of get_SE_types().  The charge events mix uncontrolled
+// charging, time of use, FLAT and voltage support, so the charge models, converters,
+// control strategies (with their LPF and random numbers) and charge event queues are all
+// stepped.
+
+
+class interface_test_fixture
+{
+protected:
+
+    static const int num_grid_nodes = 4;
+    static const int num_SEs_per_grid_node = 3;
+
+    static constexpr double start_unix_time = 8*3600;
+    static constexpr double time_step_sec = 60;
+
+    static L2_control_strategy_parameters get_L2_control_strategy_parameters()
+    {
+        ES100_L2_parameters ES100_A;
+        ES100_A.beginning_of_TofU_rate_period__time_from_midnight_hrs = 11.0;
+        ES100_A.end_of_TofU_rate_period__time_from_midnight_hrs = 16.0;
+        ES100_A.randomization_method = "M1";
+        ES100_A.M1_delay_period_hrs = 0.25;
+        ES100_A.random_seed = 100;
+
+        ES100_L2_parameters ES100_B;
+        ES100_B.beginning_of_TofU_rate_period__time_from_midnight_hrs = -1;
+        ES100_B.end_of_TofU_rate_period__time_from_midnight_hrs = 5;
+        ES100_B.randomization_method = "M2";
+        ES100_B.M1_delay_period_hrs = 0.25;
+        ES100_B.random_seed = 100;
+
+        ES110_L2_parameters ES110;
+        ES110.random_seed = 100;
+
+        ES200_L2_parameters ES200;
+        ES200.weight_factor_to_calculate_valley_fill_target = 0.0;
+
+        ES300_L2_parameters ES300;
+        ES300.weight_factor_to_calculate_valley_fill_target = 0.0;
+
+        ES400_L2_parameters ES400;
+        ES400.communication = false;
+
+        normal_random_error random_err;
+        random_err.seed = 100;
+        random_err.stdev = 200;
+        random_err.stdev_bounds = 1.5;
+
+        ES500_L2_parameters ES500;
+        ES500.aggregator_timestep_mins = 15;
+        ES500.off_to_on_lead_time_sec = random_err;
+        ES500.default_lead_time_sec = random_err;
+
+        LPF_parameters_randomize_window_size LPF;
+        LPF.is_active = true;
+        LPF.seed = 100;
+        LPF.window_size_LB = 2;
+        LPF.window_size_UB = 18;
+        LPF.window_type = LPF_window_enum::Rectangular;
+
+        VS100_L2_parameters VS100;
+        VS100.target_P3_reference__percent_of_maxP3 = 90;
+        VS100.max_delta_kW_per_min = 1000;
+        VS100.volt_delta_kW_curve_puV = std::vector<double>{0.95, 0.99, 1.0, 1.03, 1.05};
+        VS100.volt_delta_kW_percP = std::vector<double>{-40, -2, 0, 0, 10};
+        VS100.voltage_LPF = LPF;
+
+        VS200_L2_parameters VS200;
+        VS200.target_P3_reference__percent_of_maxP3 = 70;
+        VS200.max_delta_kVAR_per_min = 1000;
+        VS200.volt_var_curve_puV = std::vector<double>{0.95, 0.975, 0.99, 1, 1.03, 1.05};
+        VS200.volt_var_curve_percQ = std::vector<double>{-100, -25, -5, 0, 0, 20};
+        VS200.voltage_LPF = LPF;
+
+        VS300_L2_parameters VS300;
+        VS300.target_P3_reference__percent_of_maxP3 = 90;
+        VS300.max_QkVAR_as_percent_of_SkVA = 90;
+        VS300.gamma = 1.0;
+        VS300.voltage_LPF = LPF;
+
+        L2_control_strategy_parameters params;
+        params.ES100_A = ES100_A;
+        params.ES100_B = ES100_B;
+        params.ES110 = ES110;
+        params.ES200 = ES200;
+        params.ES300 = ES300;
+        params.ES400 = ES400;
+        params.ES500 = ES500;
+        params.VS100 = VS100;
+        params.VS200_A = VS200;
+        params.VS200_B = VS200;
+        params.VS200_C = VS200;
+        params.VS300 = VS300;
+
+        return params;
+    }
+
+    static std::string get_grid_node_id( const int node_index )
+    {
+        return "node" + std::to_string(node_index + 1);
+    }
+
+    static std::vector<grid_node_id_type> get_grid_node_ids( const int num_nodes )
+    {
+        std::vector<grid_node_id_type> grid_node_ids;
+        for( int i = 0; i < num_nodes; i++ )
+            grid_node_ids.push_back(get_grid_node_id(i));
+
+        return grid_node_ids;
+    }
+
+    static std::vector<std::string> get_SE_types()
+    {
+        return { "L2_7200W", "L2_17280W", "xfc_50kW" };
+    }
+
+    static std::vector<SE_configuration> get_SE_configurations()
+    {
+        const std::vector<std::string> SE_types = get_SE_types();
+
+        std::vector<SE_configuration> SEs;
+        for( int i = 0; i < num_grid_nodes; i++ )
+        {
+            for( int j = 0; j < num_SEs_per_grid_node; j++ )
+                SEs.push_back(SE_configuration{ 10, 1 + i*num_SEs_per_grid_node + j, SE_types[j], 0, 0, get_grid_node_id(i), "home" });
+        }
+
+        return SEs;
+    }
+
+    static bool is_L2( const int SE_id )
+    {
+        return (SE_id - 1) % num_SEs_per_grid_node != 2;
+    }
+
+    static interface_to_SE_groups_inputs get_interface_inputs( const std::vector<SE_configuration>& SEs,
+                                                               const L2_control_strategy_parameters& L2_parameters )
+    {
+        charge_event_queuing_inputs CE_queuing_inputs;
+        CE_queuing_inputs.max_allowed_overlap_time_sec = 0.0;
+        CE_queuing_inputs.queuing_mode = queuing_mode_enum::overlapLimited_mostRecentlyQueuedHasPriority;
+
+        const int data_timestep_sec = 60;
+        const std::vector<double> load_akW(2*24*3600/data_timestep_sec, 0.0);
+
+        interface_to_SE_groups_inputs inputs{
+            true,
+            EV_ramping_map{},
+            std::vector<pev_charge_ramping_workaround>{},
+            CE_queuing_inputs,
+            { SE_group_configuration{ 10, SEs } },
+            0,
+            data_timestep_sec,
+            load_akW,
+            load_akW,
+            0,
+            L2_parameters,
+            true
+        };
+        inputs.lazy_charge_profile_library = true;
+
+        return inputs;
+    }
+
+    static interface_to_SE_groups_inputs get_interface_inputs()
+    {
+        return get_interface_inputs(get_SE_configurations(), get_L2_control_strategy_parameters());
+    }
+
+    // Back to back charge events, so SEs pick up queued events in the middle of the run.
+    // The voltage support strategies only run along with an energy shifting strategy,
+    // and the control strategies only on the L2 SEs.
+    static std::vector<charge_event_data> get_charge_events()
+    {
+        const std::vector<std::string> EV_types = { "ld_50kWh", "ld_100kWh", "md_200kWh" };
+        const std::vector<L2_control_strategies_enum> ES_strategies = { L2_control_strategies_enum::NA, L2_control_strategies_enum::ES100_A, L2_control_strategies_enum::ES200 };
+        const std::vector<L2_control_strategies_enum> VS_strategies = { L2_control_strategies_enum::NA, L2_control_strategies_enum::VS100, L2_control_strategies_enum::VS300 };
+
+        std::vector<charge_event_data> charge_events;
+        int charge_event_id = 1;
+
+        for( int SE_id = 1; SE_id <= num_grid_nodes*num_SEs_per_grid_node; SE_id++ )
+        {
+            double arrival_unix_time = start_unix_time + 600*(SE_id % 5) + 0.5*3600;
+
+            for( int k = 0; k < 3; k++ )
+            {
+                const int n = SE_id + k;
+
+                control_strategy_enums control_enums;
+                control_enums.ES_control_strategy = is_L2(SE_id) ? ES_strategies[n % 3] : L2_control_strategies_enum::NA;
+                control_enums.VS_control_strategy = (control_enums.ES_control_strategy != L2_control_strategies_enum::NA) ? VS_strategies[(n / 3) % 3] : L2_control_strategies_enum::NA;
+                control_enums.inverter_model_supports_Qsetpoint = (control_enums.VS_control_strategy == L2_control_strategies_enum::VS300);
+                control_enums.ext_control_strategy = "NA";
+
+                const double departure_unix_time = arrival_unix_time + 3600*(1.5 + k);
+
+                charge_events.emplace_back(charge_event_id++, 10, SE_id, 100 + SE_id, EV_types[n % 3], arrival_unix_time, departure_unix_time,
+                                           10 + 5*k, 90, stop_charging_criteria{}, control_enums);
+
+                arrival_unix_time = departure_unix_time + 120;
+            }
+        }
+
+        return charge_events;
+    }
+
+    // Voltages of step k, low enough at times for the P2 vs puVrms limit to bind.
+    static void get_pu_Vrms( const int k, const double offset, std::vector<double>& pu_Vrms )
+    {
+        for( int i = 0; i < (int)pu_Vrms.size(); i++ )
+            pu_Vrms[i] = 0.99 + 0.05*std::sin(0.01*k + 1.3*i) + offset;
+    }
+
+    // P and Q of every grid node in every step.
+    struct trajectory
+    {
+        std::vector<double> P3_kW;
+        std::vector<double> Q3_kVAR;
+
+        void add( const std::vector<double>& P3_kW_, const std::vector<double>& Q3_kVAR_ )
+        {
+            this->P3_kW.insert(this->P3_kW.end(), P3_kW_.begin(), P3_kW_.end());
+            this->Q3_kVAR.insert(this->Q3_kVAR.end(), Q3_kVAR_.begin(), Q3_kVAR_.end());
+        }
+
+        bool operator==( const trajectory& rhs ) const
+        {
+            return this->P3_kW == rhs.P3_kW && this->Q3_kVAR == rhs.Q3_kVAR;
+        }
+    };
+};
+
+#endif
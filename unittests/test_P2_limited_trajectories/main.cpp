@@ -0,0 +1,248 @@
+#include "load_EV_EVSE_inventory.h"
+#include "factory_EV_charge_model.h"
+#include "factory_puVrms_vs_P2.h"
+#include "factory_SOC_vs_P2.h"                      // apply_P2_limit_to_P2_vs_soc_segments
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cmath>
+
+// The P2 limit from the voltage clips the P2_vs_soc segments of the battery, an upper bound
+// when charging and a lower bound when discharging.  The curves of every compatible EV / EVSE
+// pair are checked with a limit that cuts them (cap hit) and one above them (no cap), in both
+// modes, and a stepped charge model must charge at the limit rounded down to
+// factory_SOC_vs_P2::P2_limit_resolution_kW at a sagged voltage, never faster.
+
+
+class test_P2_limited_trajectories
+{
+private:
+
+    static bool are_equal( const double A, const double B )
+    {
+        return std::abs(A - B) <= 1e-9 * std::max(1.0, std::max(std::abs(A), std::abs(B)));
+    }
+
+    // P2 of the segments at soc, NAN outside of them.
+    static double get_P2( const std::vector<line_segment>& segments, const double soc )
+    {
+        for( const line_segment& seg : segments )
+        {
+            if( seg.x_LB <= soc && soc <= seg.x_UB )
+                return seg.y(soc);
+        }
+
+        return NAN;
+    }
+
+    static double get_max_abs_P2( const std::vector<line_segment>& segments )
+    {
+        double return_val = 0;
+        for( const line_segment& seg : segments )
+            return_val = std::max(return_val, std::max(std::abs(seg.y_LB()), std::abs(seg.y_UB())));
+
+        return return_val;
+    }
+
+    // The limited segments must cover the same socs as the curve without gaps, and be the curve
+    // clipped at P2_limit at every segment end and middle.
+    static bool is_clipped_curve( const std::vector<line_segment>& curve,
+                                  const std::vector<line_segment>& limited,
+                                  const battery_charge_mode mode,
+                                  const double P2_limit )
+    {
+        if( limited.empty() || !are_equal(limited.front().x_LB, curve.front().x_LB) || !are_equal(limited.back().x_UB, curve.back().x_UB) )
+            return false;
+
+        for( int i = 0; i < (int)limited.size(); i++ )
+        {
+            if( i > 0 && !are_equal(limited[i-1].x_UB, limited[i].x_LB) )
+                return false;
+
+            for( const double soc : { limited[i].x_LB, 0.5*(limited[i].x_LB + limited[i].x_UB), limited[i].x_UB } )
+            {
+                const double P2 = get_P2(curve, soc);
+                const double expected_P2 = (mode == battery_charge_mode::charging) ? std::min(P2, P2_limit) : std::max(P2, P2_limit);
+
+                if( !are_equal(limited[i].y(soc), expected_P2) )
+                    return false;
+            }
+        }
+
+        return true;
+    }
+
+public:
+
+    static int test_P2_limited_segments( const EV_EVSE_inventory& inventory )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_P2_limited_segments" << std::endl;
+
+        const factory_SOC_vs_P2 SOCP_factory{ inventory };
+
+        for( const pev_SE_pair& pair : inventory.get_all_compatible_pev_SE_combinations() )
+        {
+            const std::string msg = " (EV_type:" + pair.ev_type + "  SE_type:" + pair.se_type + ")";
+
+            const SOC_vs_P2& curve = SOCP_factory.get_SOC_vs_P2_curves(pair.ev_type, pair.se_type, 25, 10);
+            const std::vector<line_segment>& charging_curve = *SOCP_factory.get_P2_vs_soc_segments(curve);
+
+            // The discharging curve mirrors the charging one.
+            std::vector<line_segment> discharging_curve;
+            for( const line_segment& seg : charging_curve )
+                discharging_curve.emplace_back(seg.x_LB, seg.x_UB, -seg.a, -seg.b);
+
+            const double max_abs_P2 = get_max_abs_P2(charging_curve);
+
+            for( const battery_charge_mode mode : { battery_charge_mode::charging, battery_charge_mode::discharging } )
+            {
+                const bool is_charging = (mode == battery_charge_mode::charging);
+                const std::vector<line_segment>& segments = is_charging ? charging_curve : discharging_curve;
+                const std::string mode_msg = (is_charging ? " charging" : " discharging") + msg;
+
+                // Cap hit
+                const double cap_P2_limit = (is_charging ? 0.5 : -0.5) * max_abs_P2;
+                const std::vector<line_segment> capped = apply_P2_limit_to_P2_vs_soc_segments(segments, mode, cap_P2_limit);
+
+                assert_bool_true( is_clipped_curve(segments, capped, mode, cap_P2_limit), "Error: the P2 limited segments are not the clipped curve." + mode_msg );
+                assert_bool_true( are_equal(get_max_abs_P2(capped), std::abs(cap_P2_limit)), "Error: the P2 limit is not reached." + mode_msg );
+
+                // No cap
+                const double no_cap_P2_limit = (is_charging ? 2.0 : -2.0) * max_abs_P2;
+                const std::vector<line_segment> not_capped = apply_P2_limit_to_P2_vs_soc_segments(segments, mode, no_cap_P2_limit);
+
+                bool is_unchanged = (not_capped.size() == segments.size());
+                for( int i = 0; is_unchanged && i < (int)segments.size(); i++ )
+                {
+                    is_unchanged = not_capped[i].x_LB == segments[i].x_LB && not_capped[i].x_UB == segments[i].x_UB &&
+                                   not_capped[i].a == segments[i].a && not_capped[i].b == segments[i].b;
+                }
+
+                assert_bool_true( is_unchanged, "Error: a P2 limit above the curve changes the segments." + mode_msg );
+
+                // Per mode, the same limit is an upper bound when charging and a lower bound when discharging.
+                const battery_charge_mode other_mode = is_charging ? battery_charge_mode::discharging : battery_charge_mode::charging;
+                const std::vector<line_segment> other_mode_capped = apply_P2_limit_to_P2_vs_soc_segments(segments, other_mode, cap_P2_limit);
+
+                assert_bool_true( is_clipped_curve(segments, other_mode_capped, other_mode, cap_P2_limit), "Error: the P2 limit is not applied by the mode of the battery." + mode_msg );
+            }
+        }
+
+        return exit_code;
+    }
+
+    static int test_stepped_charge_model( const EV_EVSE_inventory& inventory )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_stepped_charge_model" << std::endl;
+
+        const factory_EV_charge_model charge_model_factory{ inventory, EV_ramping_map{}, EV_EVSE_ramping_map{}, false };
+        const factory_puVrms_vs_P2 VP_factory{ inventory };
+
+        control_strategy_enums cs;
+        cs.inverter_model_supports_Qsetpoint = false;
+        cs.ES_control_strategy = L2_control_strategies_enum::NA;
+        cs.VS_control_strategy = L2_control_strategies_enum::NA;
+        cs.ext_control_strategy = "";
+
+        const double time_step_sec = 60;
+        const int num_steps = 120;
+        int num_capped_pairs = 0;
+
+        for( const pev_SE_pair& pair : inventory.get_all_compatible_pev_SE_combinations() )
+        {
+            const std::string msg = " (EV_type:" + pair.ev_type + "  SE_type:" + pair.se_type + ")";
+            const double SE_P2_limit_kW = inventory.get_EVSE_inventory().at(pair.se_type).get_power_limit_kW();
+
+            // The P2 limit at a sagged voltage, against the trajectory at nominal voltage.
+            const double pu_Vrms = 0.9;
+            poly_function_of_x P2_vs_puVrms = VP_factory.get_puVrms_vs_P2(pair.se_type, SE_P2_limit_kW);
+            const double P2_limit = P2_vs_puVrms.get_val(pu_Vrms);
+            const double rounded_P2_limit = std::floor(P2_limit / factory_SOC_vs_P2::P2_limit_resolution_kW) * factory_SOC_vs_P2::P2_limit_resolution_kW;
+
+            const auto get_P2_kW = [&] ( const double pu_Vrms )
+            {
+                const charge_event_data event(1, 1, 1, 1, pair.ev_type, 0, num_steps * time_step_sec, 10, 95, stop_charging_criteria{}, cs);
+
+                vehicle_charge_model* model = charge_model_factory.alloc_get_EV_charge_model(event, pair.se_type, SE_P2_limit_kW);
+                model->set_target_P2_kW(10000000);
+
+                std::vector<double> P2_kW;
+                bool charge_has_completed = false;
+                battery_state bat_state;
+
+                for( int step = 1; step <= num_steps && !charge_has_completed; step++ )
+                {
+                    model->get_next((step - 1) * time_step_sec, step * time_step_sec, pu_Vrms, charge_has_completed, bat_state);
+                    P2_kW.push_back(bat_state.P2_kW);
+                }
+
+                factory_EV_charge_model::release_EV_charge_model(model);
+                return P2_kW;
+            };
+
+            const std::vector<double> nominal_P2_kW = get_P2_kW(1.0);
+            const std::vector<double> sagged_P2_kW = get_P2_kW(pu_Vrms);
+
+            const double max_nominal_P2_kW = *std::max_element(nominal_P2_kW.begin(), nominal_P2_kW.end());
+            const double max_sagged_P2_kW = *std::max_element(sagged_P2_kW.begin(), sagged_P2_kW.end());
+
+            assert_bool_true( max_sagged_P2_kW <= P2_limit + 1e-6, "Error: the battery charges faster than the P2 limit." + msg );
+
+            if( rounded_P2_limit < max_nominal_P2_kW - 1e-3 )
+            {
+                num_capped_pairs += 1;
+                assert_bool_true( are_equal(max_sagged_P2_kW, rounded_P2_limit), "Error: the battery does not charge at the rounded P2 limit." + msg );
+            }
+            else
+            {
+                assert_bool_true( sagged_P2_kW == nominal_P2_kW, "Error: a P2 limit that does not bind changes the trajectory." + msg );
+            }
+        }
+
+        assert_bool_true( num_capped_pairs > 0, "Error: the P2 limit binds for none of the pairs." );
+
+        return exit_code;
+    }
+};
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+
+    load_EV_EVSE_inventory load_inventory{ input_path };
+    const EV_EVSE_inventory& inventory = load_inventory.get_EV_EVSE_inventory();
+
+    int sum = 0;
+    sum += test_P2_limited_trajectories::test_P2_limited_segments(inventory);
+    sum += test_P2_limited_trajectories::test_stepped_charge_model(inventory);
+
+    if( sum == 0 )
+        std::cout << "Success." << std::endl;
+
+    return sum;
+}
@@ -0,0 +1,229 @@
+#include "interface_test_fixture.h"
+#include "load_EV_EVSE_inventory.h"
+#include "factory_EV_charge_model.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>                                    // omp_get_max_threads, omp_set_num_threads
+#endif
+
+// EV charge models and ac to dc converters are recycled between charge events (see
+// object_pool).  Over a simulation of several days with the same charge events every day,
+// the first day fills the pools and the later days must not allocate any more of them:
+// get_charge_model_allocation_counters must stop increasing the allocated counts while
+// the reused counts keep growing.
+//
+// The pools are per thread, so the run is stepped on one thread.
+//
+// factory_EV_charge_model copies the charge models from a prototype per (EV, EVSE, SE P2
+// limit, battery size, curve).  A model from the prototype cache must step exactly like a
+// model built directly from its charge event.
+
+
+class test_charge_model_pool : private interface_test_fixture
+{
+private:
+
+    static const int num_days = 4;
+
+    // The charge events of the fixture, uncontrolled and repeated every day.
+    static std::vector<charge_event_data> get_daily_charge_events()
+    {
+        const std::vector<charge_event_data> day_charge_events = get_charge_events();
+
+        std::vector<charge_event_data> charge_events;
+        int charge_event_id = 1;
+
+        for( int day = 0; day < num_days; day++ )
+        {
+            for( charge_event_data CE : day_charge_events )
+            {
+                CE.charge_event_id = charge_event_id++;
+                CE.arrival_unix_time += day*24*3600;
+                CE.departure_unix_time += day*24*3600;
+                CE.control_enums.ES_control_strategy = L2_control_strategies_enum::NA;
+                CE.control_enums.VS_control_strategy = L2_control_strategies_enum::NA;
+                CE.control_enums.inverter_model_supports_Qsetpoint = false;
+                charge_events.push_back(CE);
+            }
+        }
+
+        return charge_events;
+    }
+
+public:
+
+    static int test_warm_pool( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_warm_pool" << std::endl;
+
+#ifdef _OPENMP
+        const int max_threads = omp_get_max_threads();
+        omp_set_num_threads(1);
+#endif
+
+        interface_to_SE_groups icm{ input_path, get_interface_inputs() };
+        icm.add_charge_events(get_daily_charge_events());
+        icm.register_grid_nodes(get_grid_node_ids(num_grid_nodes));
+
+        const int num_steps_per_day = 24*3600/time_step_sec;
+
+        std::vector<double> pu_Vrms(num_grid_nodes, 1.0);
+        std::vector<double> P3_kW(num_grid_nodes);
+        std::vector<double> Q3_kVAR(num_grid_nodes);
+
+        std::vector<charge_model_allocation_counters> counters_by_day;
+
+        for( int k = 0; k < num_days*num_steps_per_day; k++ )
+        {
+            const double prev_unix_time = start_unix_time + k*time_step_sec;
+            const double now_unix_time = prev_unix_time + time_step_sec;
+
+            icm.get_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+
+            if( (k + 1) % num_steps_per_day == 0 )
+                counters_by_day.push_back(icm.get_charge_model_allocation_counters());
+        }
+
+#ifdef _OPENMP
+        omp_set_num_threads(max_threads);
+#endif
+
+        const charge_model_allocation_counters& first_day = counters_by_day.front();
+        assert_bool_true( first_day.EV_charge_models_allocated > 0 && first_day.ac_to_dc_converters_allocated > 0, "Error: the first day allocates nothing." );
+
+        for( int day = 1; day < num_days; day++ )
+        {
+            const charge_model_allocation_counters& prev = counters_by_day[day - 1];
+            const charge_model_allocation_counters& cur = counters_by_day[day];
+            const std::string day_str = " (day " + std::to_string(day + 1) + ")";
+
+            assert_bool_true( cur.EV_charge_models_allocated == prev.EV_charge_models_allocated, "Error: EV charge models are allocated once the pool is warm." + day_str );
+            assert_bool_true( cur.ac_to_dc_converters_allocated == prev.ac_to_dc_converters_allocated, "Error: ac to dc converters are allocated once the pool is warm." + day_str );
+            assert_bool_true( cur.EV_charge_models_reused > prev.EV_charge_models_reused, "Error: no EV charge model is reused." + day_str );
+            assert_bool_true( cur.ac_to_dc_converters_reused > prev.ac_to_dc_converters_reused, "Error: no ac to dc converter is reused." + day_str );
+        }
+
+        return exit_code;
+    }
+
+    static int test_prototype_cache( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_prototype_cache" << std::endl;
+
+        load_EV_EVSE_inventory load_inventory{ input_path };
+        const EV_EVSE_inventory& inventory = load_inventory.get_EV_EVSE_inventory();
+
+        const factory_EV_charge_model charge_model_factory{ inventory, EV_ramping_map{}, EV_EVSE_ramping_map{}, false };
+
+        // The factories of the directly built models, separate from the ones of charge_model_factory.
+        const factory_charging_transitions CT_factory{ inventory, EV_ramping_map{}, EV_EVSE_ramping_map{} };
+        const factory_puVrms_vs_P2 VP_factory{ inventory };
+        const factory_SOC_vs_P2 SOCP_factory{ inventory };
+        const factory_P2_vs_battery_efficiency PE_factory{ inventory };
+
+        control_strategy_enums cs;
+        cs.inverter_model_supports_Qsetpoint = false;
+        cs.ES_control_strategy = L2_control_strategies_enum::NA;
+        cs.VS_control_strategy = L2_control_strategies_enum::NA;
+        cs.ext_control_strategy = "NA";
+
+        std::vector<double> pu_Vrms(1);
+
+        for( const pev_SE_pair& pair : inventory.get_all_compatible_pev_SE_combinations() )
+        {
+            const std::string msg = " (EV_type:" + pair.ev_type + "  SE_type:" + pair.se_type + ")";
+
+            const EV_type_id EV_id = inventory.get_EV_type_id(pair.ev_type);
+            const EVSE_type_id EVSE_id = inventory.get_EVSE_type_id(pair.se_type);
+            const double SE_P2_limit_kW = inventory.get_EVSE_inventory().at(pair.se_type).get_power_limit_kW();
+            const double battery_size_kWh = inventory.get_EV_inventory().at(pair.ev_type).get_usable_battery_size_kWh();
+
+            // The first charge event fills the prototype cache, the second one is copied from it.
+            const std::vector<charge_event_data> charge_events = {
+                charge_event_data(1, 10, 1, 101, pair.ev_type, start_unix_time, start_unix_time + 4*3600, 10, 95, stop_charging_criteria{}, cs),
+                charge_event_data(2, 10, 1, 102, pair.ev_type, start_unix_time + 1800, start_unix_time + 3*3600, 35, 80, stop_charging_criteria{}, cs)
+            };
+
+            for( const charge_event_data& CE : charge_events )
+            {
+                const std::string CE_msg = " charge_event_id:" + std::to_string(CE.charge_event_id) + msg;
+
+                vehicle_charge_model* cached = charge_model_factory.alloc_get_EV_charge_model(CE, pair.se_type, SE_P2_limit_kW);
+                vehicle_charge_model direct{ vehicle_charge_model_inputs{ CE, EV_id, EVSE_id, SE_P2_limit_kW, battery_size_kWh, CT_factory, VP_factory, SOCP_factory, PE_factory } };
+
+                cached->set_target_P2_kW(10000000);
+                direct.set_target_P2_kW(10000000);
+
+                bool is_same = true;
+                bool cached_has_completed = false;
+                bool direct_has_completed = false;
+                battery_state cached_state, direct_state;
+
+                for( int k = 0; is_same && !cached_has_completed && CE.arrival_unix_time + k*time_step_sec < CE.departure_unix_time; k++ )
+                {
+                    const double prev_unix_time = CE.arrival_unix_time + k*time_step_sec;
+                    get_pu_Vrms(k, -0.05, pu_Vrms);
+
+                    cached->get_next(prev_unix_time, prev_unix_time + time_step_sec, pu_Vrms[0], cached_has_completed, cached_state);
+                    direct.get_next(prev_unix_time, prev_unix_time + time_step_sec, pu_Vrms[0], direct_has_completed, direct_state);
+
+                    is_same = cached_has_completed == direct_has_completed &&
+                              cached_state.soc_t1 == direct_state.soc_t1 &&
+                              cached_state.P1_kW == direct_state.P1_kW &&
+                              cached_state.P2_kW == direct_state.P2_kW &&
+                              cached_state.reached_target_status == direct_state.reached_target_status &&
+                              cached_state.E1_energy_to_target_soc_kWh == direct_state.E1_energy_to_target_soc_kWh &&
+                              cached_state.min_time_to_target_soc_hrs == direct_state.min_time_to_target_soc_hrs;
+                }
+
+                assert_bool_true( is_same, "Error: the charge model from the prototype cache differs from the one built directly." + CE_msg );
+                assert_bool_true( cached_state.soc_t1 > CE.arrival_SOC, "Error: the charge model did not charge." + CE_msg );
+
+                factory_EV_charge_model::release_EV_charge_model(cached);
+            }
+        }
+
+        return exit_code;
+    }
+};
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+
+    int sum = 0;
+    sum += test_charge_model_pool::test_warm_pool(input_path);
+    sum += test_charge_model_pool::test_prototype_cache(input_path);
+
+    if( sum == 0 )
+        std::cout << "Success." << std::endl;
+
+    return sum;
+}
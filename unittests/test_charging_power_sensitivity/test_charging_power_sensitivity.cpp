@@ -0,0 +1,250 @@
+#include "interface_test_fixture.h"
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// get_charging_power_sensitivity_by_index must match the central difference of the power
+// from get_trial_charging_power_by_index at pu_Vrms +- delta_pu_Vrms:
+//
+//    - grid nodes whose batteries are held at the P2 vs puVrms limit have a non-zero dP3/dV.
+//    - grid nodes whose batteries are not voltage limited have dP3/dV = dQ3/dV = 0.
+//
+// Both the pf converter and the Q setpoint converter are covered.  The Q setpoint converters
+// are given a reactive power setpoint the kVA limit clips, so their Q3 moves with P3.
+//
+// The batteries only move their P2 limit once it changes by more than 0.5 kW, and clip their
+// curves at the limit rounded down to factory_SOC_vs_P2::P2_limit_resolution_kW (0.5 kW).  So
+// delta_pu_Vrms moves the P2 limit by a multiple of 0.5 kW above 0.5 kW on the linear part of
+// the P2 vs puVrms curve ((0.35, 0.373) to (0.94, 1.0) times the SE power limit), and pu_Vrms
+// keeps the limits at pu_Vrms +- delta_pu_Vrms clear of the rounding steps, so the rounded
+// limits move by as much as the limits.  The voltages keep P3 away from the kinks of the
+// converter curves (the L2 pf curve is flat above 6 kW), so the central difference is the
+// slope up to the curvature of the converter curves and of the kVA limit.
+
+
+class test_charging_power_sensitivity : private interface_test_fixture
+{
+private:
+
+    static const int num_warm_up_steps = 20;
+    static const int num_checked_steps = 10;
+
+    static constexpr double max_relative_error = 0.01;
+
+    // One SE per grid node.
+    struct grid_node
+    {
+        std::string SE_type;
+        bool supports_Qsetpoint;
+        double pu_Vrms;
+        double delta_pu_Vrms;
+        bool is_voltage_limited;
+    };
+
+    static std::vector<grid_node> get_grid_nodes()
+    {
+        return {
+            { "L2_17280W", false, 0.480941, 0.040842, true  },     // P2 limit 8.10, 8.85 and 9.60 kW
+            { "L2_17280W", true,  0.693317, 0.054455, true  },     // P2 limit 11.75, 12.75 and 13.75 kW
+            { "L2_7200W",  false, 1.05, 0.05, false },
+            { "L2_17280W", true,  1.05, 0.05, false }
+        };
+    }
+
+    // No charge event uses a control strategy, but the voltage support LPFs are sized from
+    // these parameters for every SE.
+    static L2_control_strategy_parameters get_voltage_LPF_parameters()
+    {
+        LPF_parameters_randomize_window_size LPF;
+        LPF.is_active = true;
+        LPF.window_size_LB = 1;
+        LPF.window_size_UB = 1;
+        LPF.window_type = LPF_window_enum::Rectangular;
+
+        L2_control_strategy_parameters params;
+        params.VS100.voltage_LPF = LPF;
+        params.VS200_A.voltage_LPF = LPF;
+        params.VS200_B.voltage_LPF = LPF;
+        params.VS200_C.voltage_LPF = LPF;
+        params.VS300.voltage_LPF = LPF;
+
+        return params;
+    }
+
+    static std::unique_ptr<interface_to_SE_groups> get_interface( const std::string& input_path )
+    {
+        const std::vector<grid_node> grid_nodes = get_grid_nodes();
+
+        std::vector<SE_configuration> SEs;
+        for( int i = 0; i < (int)grid_nodes.size(); i++ )
+            SEs.push_back(SE_configuration{ 10, i + 1, grid_nodes[i].SE_type, 0, 0, get_grid_node_id(i), "home" });
+
+        std::unique_ptr<interface_to_SE_groups> icm = std::make_unique<interface_to_SE_groups>(input_path, get_interface_inputs(SEs, get_voltage_LPF_parameters()));
+
+        // The Q setpoint converters are driven by an external control strategy, which is
+        // what sets their reactive power.
+        std::vector<charge_event_data> charge_events;
+
+        for( int i = 0; i < (int)grid_nodes.size(); i++ )
+        {
+            control_strategy_enums control_enums;
+            control_enums.ES_control_strategy = L2_control_strategies_enum::NA;
+            control_enums.VS_control_strategy = L2_control_strategies_enum::NA;
+            control_enums.inverter_model_supports_Qsetpoint = grid_nodes[i].supports_Qsetpoint;
+            control_enums.ext_control_strategy = grid_nodes[i].supports_Qsetpoint ? "ext0001" : "NA";
+
+            charge_events.emplace_back(i + 1, 10, i + 1, 100 + i, "md_200kWh", start_unix_time, start_unix_time + 12*3600,
+                                       20, 90, stop_charging_criteria{}, control_enums);
+        }
+
+        icm->add_charge_events(charge_events);
+        icm->register_grid_nodes(get_grid_node_ids(grid_nodes.size()));
+
+        return icm;
+    }
+
+    static void set_PQ_setpoints( interface_to_SE_groups& icm, const double now_unix_time )
+    {
+        const std::vector<grid_node> grid_nodes = get_grid_nodes();
+
+        std::vector<SE_setpoint> SE_setpoints;
+        for( int i = 0; i < (int)grid_nodes.size(); i++ )
+        {
+            if(!grid_nodes[i].supports_Qsetpoint)
+                continue;
+
+            SE_setpoint X;
+            X.SE_id = i + 1;
+            X.PkW = 100;
+            X.QkVAR = -100;
+            SE_setpoints.push_back(X);
+        }
+
+        icm.set_PQ_setpoints(now_unix_time, SE_setpoints);
+    }
+
+    static double get_relative_error( const double A, const double B )
+    {
+        return std::abs(A - B) / std::max(1e-6, std::max(std::abs(A), std::abs(B)));
+    }
+
+public:
+
+    static int test_finite_differences( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_finite_differences" << std::endl;
+
+        const std::vector<grid_node> grid_nodes = get_grid_nodes();
+        const int num_nodes = grid_nodes.size();
+
+        std::unique_ptr<interface_to_SE_groups> icm = get_interface(input_path);
+
+        std::vector<double> pu_Vrms(num_nodes), pu_Vrms_up(num_nodes), pu_Vrms_down(num_nodes);
+        for( int i = 0; i < num_nodes; i++ )
+        {
+            pu_Vrms[i] = grid_nodes[i].pu_Vrms;
+            pu_Vrms_up[i] = grid_nodes[i].pu_Vrms + grid_nodes[i].delta_pu_Vrms;
+            pu_Vrms_down[i] = grid_nodes[i].pu_Vrms - grid_nodes[i].delta_pu_Vrms;
+        }
+
+        std::vector<double> P3_kW(num_nodes), Q3_kVAR(num_nodes);
+        std::vector<double> P3_up(num_nodes), Q3_up(num_nodes), P3_down(num_nodes), Q3_down(num_nodes);
+        std::vector<double> dP3_dpuVrms(num_nodes), dQ3_dpuVrms(num_nodes);
+        std::vector<double> max_abs_dP3(num_nodes, 0), max_abs_dQ3(num_nodes, 0);
+
+        for( int k = 0; k < num_warm_up_steps + num_checked_steps; k++ )
+        {
+            const double prev_unix_time = start_unix_time + k*time_step_sec;
+            const double now_unix_time = prev_unix_time + time_step_sec;
+
+            set_PQ_setpoints(*icm, prev_unix_time);
+
+            if( k < num_warm_up_steps )
+            {
+                icm->get_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+                continue;
+            }
+
+            icm->get_trial_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+            icm->get_charging_power_sensitivity_by_index(pu_Vrms.data(), dP3_dpuVrms.data(), dQ3_dpuVrms.data());
+
+            std::map<grid_node_id_type, double> gnid_to_puVrms_map;
+            for( int i = 0; i < num_nodes; i++ )
+                gnid_to_puVrms_map[get_grid_node_id(i)] = pu_Vrms[i];
+            const std::map<grid_node_id_type, std::pair<double, double> > sensitivity = icm->get_charging_power_sensitivity(gnid_to_puVrms_map);
+
+            icm->get_trial_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms_up.data(), P3_up.data(), Q3_up.data());
+            icm->get_trial_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms_down.data(), P3_down.data(), Q3_down.data());
+            icm->rollback_trial_step();
+
+            icm->get_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+
+            for( int i = 0; i < num_nodes; i++ )
+            {
+                const double delta = 2*grid_nodes[i].delta_pu_Vrms;
+                const double FD_dP3 = (P3_up[i] - P3_down[i]) / delta;
+                const double FD_dQ3 = (Q3_up[i] - Q3_down[i]) / delta;
+
+                const std::string node = get_grid_node_id(i) + " (" + grid_nodes[i].SE_type + (grid_nodes[i].supports_Qsetpoint ? ", Q setpoint" : ", pf") + ")";
+                const std::string step = " in step " + std::to_string(k);
+
+                assert_bool_true( get_relative_error(dP3_dpuVrms[i], FD_dP3) <= max_relative_error,
+                                  "Error: " + node + " dP3/dpuVrms = " + std::to_string(dP3_dpuVrms[i]) + ", finite difference " + std::to_string(FD_dP3) + step );
+                assert_bool_true( get_relative_error(dQ3_dpuVrms[i], FD_dQ3) <= max_relative_error,
+                                  "Error: " + node + " dQ3/dpuVrms = " + std::to_string(dQ3_dpuVrms[i]) + ", finite difference " + std::to_string(FD_dQ3) + step );
+
+                const std::pair<double, double>& X = sensitivity.at(get_grid_node_id(i));
+                assert_bool_true( X.first == dP3_dpuVrms[i] && X.second == dQ3_dpuVrms[i],
+                                  "Error: " + node + " get_charging_power_sensitivity differs from get_charging_power_sensitivity_by_index" + step );
+
+                max_abs_dP3[i] = std::max(max_abs_dP3[i], std::abs(dP3_dpuVrms[i]));
+                max_abs_dQ3[i] = std::max(max_abs_dQ3[i], std::abs(dQ3_dpuVrms[i]));
+            }
+        }
+
+        for( int i = 0; i < num_nodes; i++ )
+        {
+            const std::string node = get_grid_node_id(i) + " (" + grid_nodes[i].SE_type + ")";
+
+            if( grid_nodes[i].is_voltage_limited )
+            {
+                assert_bool_true( max_abs_dP3[i] > 1, "Error: " + node + " is meant to be voltage limited but has no dP3/dpuVrms." );
+
+                if( grid_nodes[i].supports_Qsetpoint )
+                    assert_bool_true( max_abs_dQ3[i] > 1, "Error: " + node + " has a clipped Q setpoint but no dQ3/dpuVrms." );
+            }
+            else
+                assert_bool_true( max_abs_dP3[i] == 0 && max_abs_dQ3[i] == 0, "Error: " + node + " is not voltage limited but has a non-zero sensitivity." );
+        }
+
+        return exit_code;
+    }
+};
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+
+    int sum = 0;
+    sum += test_charging_power_sensitivity::test_finite_differences(input_path);
+
+    if( sum == 0 )
+        std::cout << "Success." << std::endl;
+
+    return sum;
+}
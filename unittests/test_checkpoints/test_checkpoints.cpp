@@ -0,0 +1,444 @@
+#include "interface_test_fixture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// restore_checkpoint must put the simulation back exactly: a run that saves a checkpoint,
+// goes on, and then restores it and runs again gives the same P and Q as a run that was
+// never interrupted, however many times the checkpoint is restored.
+//
+// A checkpoint restored into a new interface built from the same inputs and SE groups must
+// give the same P and Q as well, also once the interface that saved it is destroyed.
+//
+// fork must copy the simulation exactly and independently: a fork run to the end gives the
+// same P and Q as the run it was forked from, and running it does not change the run it was
+// forked from.
+//
+// The L2 SEs get controlled charge events up front and the DCFC SEs read uncontrolled
+// ones from a charge event file with no trailing newline, so the checkpoints also cover
+// the charge event queues and the read position of the file.
+//
+// The step states of the SEs of a checkpoint written to a file and read back into the SEs
+// of a new interface must give the same P and Q as well, so a warm-up can be kept on disk.
+//
+// Once every L2 SE has gone idle, each gets one more charge event at late_step.  A
+// checkpoint is saved right after they are added, before a step has woken the SEs up.
+
+
+class test_checkpoints : private interface_test_fixture
+{
+private:
+
+    static const int num_steps = 12*60;
+    static constexpr double lookahead_sec = 600;
+    static const int late_step = 10*60;
+
+    // One uncontrolled charge event per L2 SE, added at late_step.  The SEs have finished
+    // their other charge events by then, so the new ones are all that wakes them up.
+    static std::vector<charge_event_data> get_late_charge_events()
+    {
+        control_strategy_enums control_enums;
+        control_enums.ES_control_strategy = L2_control_strategies_enum::NA;
+        control_enums.VS_control_strategy = L2_control_strategies_enum::NA;
+        control_enums.inverter_model_supports_Qsetpoint = false;
+        control_enums.ext_control_strategy = "NA";
+
+        const double arrival_unix_time = start_unix_time + late_step*time_step_sec + 1800;
+
+        std::vector<charge_event_data> charge_events;
+        for( int SE_id = 1; SE_id <= num_grid_nodes*num_SEs_per_grid_node; SE_id++ )
+        {
+            if( is_L2(SE_id) )
+                charge_events.emplace_back(1000 + SE_id, 10, SE_id, 200 + SE_id, "ld_100kWh", arrival_unix_time + 60*SE_id, arrival_unix_time + 3600,
+                                           20, 90, stop_charging_criteria{}, control_enums);
+        }
+
+        return charge_events;
+    }
+
+    // The charge events of the DCFC SEs, sorted by arrival time, with no newline after the
+    // last line.
+    static void write_charge_events_file( const std::string& file_path )
+    {
+        std::vector<charge_event_data> charge_events;
+        for( const charge_event_data& CE : get_charge_events() )
+        {
+            if( !is_L2(CE.SE_id) )
+                charge_events.push_back(CE);
+        }
+
+        std::stable_sort(charge_events.begin(), charge_events.end(), [] ( const charge_event_data& A, const charge_event_data& B )
+        {
+            return A.arrival_unix_time < B.arrival_unix_time;
+        });
+
+        std::ofstream f(file_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        f << std::setprecision(17);
+        f << charge_event_data::get_file_header();
+
+        for( const charge_event_data& CE : charge_events )
+            f << "\n" << CE;
+    }
+
+    static std::unique_ptr<interface_to_SE_groups> get_interface( const std::string& input_path, const std::string& charge_events_file )
+    {
+        std::unique_ptr<interface_to_SE_groups> icm = std::make_unique<interface_to_SE_groups>(input_path, get_interface_inputs());
+
+        std::vector<charge_event_data> L2_charge_events;
+        for( const charge_event_data& CE : get_charge_events() )
+        {
+            if( is_L2(CE.SE_id) )
+                L2_charge_events.push_back(CE);
+        }
+        icm->add_charge_events(L2_charge_events);
+        icm->set_charge_event_source(charge_events_file, lookahead_sec);
+        icm->register_grid_nodes(get_grid_node_ids(num_grid_nodes));
+
+        return icm;
+    }
+
+    // P and Q of every grid node in steps [begin_step, end_step).  The late charge events
+    // are added at the beginning of late_step, unless the run starts there.
+    static trajectory run( interface_to_SE_groups& icm, const int begin_step, const int end_step )
+    {
+        std::vector<double> pu_Vrms(num_grid_nodes);
+        std::vector<double> P3_kW(num_grid_nodes);
+        std::vector<double> Q3_kVAR(num_grid_nodes);
+        trajectory result;
+
+        for( int k = begin_step; k < end_step; k++ )
+        {
+            const double prev_unix_time = start_unix_time + k*time_step_sec;
+            const double now_unix_time = prev_unix_time + time_step_sec;
+
+            if( k == late_step && k > begin_step )
+                icm.add_charge_events(get_late_charge_events());
+
+            get_pu_Vrms(k, 0, pu_Vrms);
+            icm.get_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+            result.add(P3_kW, Q3_kVAR);
+        }
+
+        return result;
+    }
+
+    static trajectory get_steps( const trajectory& X, const int begin_step, const int end_step )
+    {
+        trajectory result;
+        result.P3_kW.assign(X.P3_kW.begin() + begin_step*num_grid_nodes, X.P3_kW.begin() + end_step*num_grid_nodes);
+        result.Q3_kVAR.assign(X.Q3_kVAR.begin() + begin_step*num_grid_nodes, X.Q3_kVAR.begin() + end_step*num_grid_nodes);
+        return result;
+    }
+
+public:
+
+    static int test_restore_checkpoint( const std::string& input_path, const std::filesystem::path& test_dir )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_restore_checkpoint" << std::endl;
+
+        const std::string charge_events_file = (test_dir / "charge_events.csv").string();
+        write_charge_events_file(charge_events_file);
+
+        const trajectory reference = run(*get_interface(input_path, charge_events_file), 0, num_steps);
+
+        double max_P3_kW = 0;
+        for( const double P3_kW : reference.P3_kW )
+            max_P3_kW = std::max(max_P3_kW, P3_kW);
+        assert_bool_true( max_P3_kW > 1, "Error: the reference run does not charge." );
+
+        double max_late_P3_kW = 0;
+        for( const double P3_kW : get_steps(reference, late_step, num_steps).P3_kW )
+            max_late_P3_kW = std::max(max_late_P3_kW, P3_kW);
+        assert_bool_true( max_late_P3_kW > 1, "Error: the late charge events do not charge." );
+
+        // Checkpoints while charge events are still being read from the file, while the
+        // last line is the next charge event (it arrives at step 314 and is read ahead by
+        // the lookahead and the wake up window), once the whole file has been read and right
+        // after the late charge events are added.
+        const std::vector<int> checkpoint_steps = { 2*60, 280, 6*60, late_step };
+
+        std::unique_ptr<interface_to_SE_groups> icm = get_interface(input_path, charge_events_file);
+        std::vector<std::shared_ptr<interface_to_SE_groups_checkpoint> > checkpoints;
+
+        int step = 0;
+        for( const int checkpoint_step : checkpoint_steps )
+        {
+            const trajectory X = run(*icm, step, checkpoint_step);
+            assert_bool_true( X == get_steps(reference, step, checkpoint_step), "Error: save_checkpoint changed the trajectory." );
+
+            if( checkpoint_step == late_step )
+                icm->add_charge_events(get_late_charge_events());
+
+            checkpoints.push_back(icm->save_checkpoint());
+            step = checkpoint_step;
+        }
+
+        const trajectory X = run(*icm, step, num_steps);
+        assert_bool_true( X == get_steps(reference, step, num_steps), "Error: save_checkpoint changed the trajectory." );
+
+        // Each checkpoint is restored twice, out of order.
+        for( int i = 0; i < 2; i++ )
+        {
+            for( int j = (int)checkpoints.size() - 1; j >= 0; j-- )
+            {
+                icm->restore_checkpoint(checkpoints[j]);
+                const trajectory Y = run(*icm, checkpoint_steps[j], num_steps);
+                assert_bool_true( Y == get_steps(reference, checkpoint_steps[j], num_steps), "Error: the run after restoring the checkpoint at step " + std::to_string(checkpoint_steps[j]) + " differs." );
+            }
+        }
+
+        return exit_code;
+    }
+
+    static int test_restore_into_new_interface( const std::string& input_path, const std::filesystem::path& test_dir )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_restore_into_new_interface" << std::endl;
+
+        const std::string charge_events_file = (test_dir / "charge_events.csv").string();
+        write_charge_events_file(charge_events_file);
+
+        const trajectory reference = run(*get_interface(input_path, charge_events_file), 0, num_steps);
+
+        // Each checkpoint is restored into an interface that was only constructed, with no
+        // charge events and no registered grid nodes.  The interface that saved the last one
+        // is destroyed before it is restored.
+        const std::vector<int> checkpoint_steps = { 2*60, 280, 6*60, late_step };
+
+        std::unique_ptr<interface_to_SE_groups> icm = get_interface(input_path, charge_events_file);
+
+        int step = 0;
+        for( const int checkpoint_step : checkpoint_steps )
+        {
+            run(*icm, step, checkpoint_step);
+
+            if( checkpoint_step == late_step )
+                icm->add_charge_events(get_late_charge_events());
+
+            const std::shared_ptr<interface_to_SE_groups_checkpoint> checkpoint = icm->save_checkpoint();
+            step = checkpoint_step;
+
+            if( checkpoint_step == checkpoint_steps.back() )
+                icm.reset();
+
+            interface_to_SE_groups icm_new(input_path, get_interface_inputs());
+            icm_new.restore_checkpoint(checkpoint);
+
+            const trajectory Y = run(icm_new, checkpoint_step, num_steps);
+            assert_bool_true( Y == get_steps(reference, checkpoint_step, num_steps), "Error: the run of a new interface after restoring the checkpoint at step " + std::to_string(checkpoint_step) + " differs." );
+
+            // An interface with other SEs can not take the checkpoint.
+            std::vector<SE_configuration> SEs = get_SE_configurations();
+            SEs.pop_back();
+            interface_to_SE_groups icm_other(input_path, get_interface_inputs(SEs, get_L2_control_strategy_parameters()));
+
+            bool was_rejected = false;
+            try
+            {
+                icm_other.restore_checkpoint(checkpoint);
+            }
+            catch( const std::invalid_argument& )
+            {
+                was_rejected = true;
+            }
+            assert_bool_true( was_rejected, "Error: an interface with other SEs restored the checkpoint." );
+        }
+
+        return exit_code;
+    }
+
+    static int test_step_state_file( const std::string& input_path, const std::filesystem::path& test_dir )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_step_state_file" << std::endl;
+
+        const std::string charge_events_file = (test_dir / "charge_events.csv").string();
+        write_charge_events_file(charge_events_file);
+
+        const std::string step_state_file = (test_dir / "SE_step_states.bin").string();
+
+        const trajectory reference = run(*get_interface(input_path, charge_events_file), 0, num_steps);
+
+        // The SEs of each checkpoint are written to the file.  They are read back into the
+        // SEs of a new interface that has not been stepped, which replace the SEs of a copy
+        // of the checkpoint, and the copy is restored into the new interface.
+        const std::vector<int> checkpoint_steps = { 2*60, 280, 6*60, late_step };
+
+        std::unique_ptr<interface_to_SE_groups> icm = get_interface(input_path, charge_events_file);
+
+        int step = 0;
+        for( const int checkpoint_step : checkpoint_steps )
+        {
+            run(*icm, step, checkpoint_step);
+
+            if( checkpoint_step == late_step )
+                icm->add_charge_events(get_late_charge_events());
+
+            const std::shared_ptr<interface_to_SE_groups_checkpoint> checkpoint = icm->save_checkpoint();
+            step = checkpoint_step;
+
+            {
+                std::ofstream f(step_state_file, std::ios::out | std::ios::binary | std::ios::trunc);
+                for( const supply_equipment& SE : checkpoint->SE_objs )
+                    SE.write_step_state(f);
+            }
+
+            std::unique_ptr<interface_to_SE_groups> icm_new = get_interface(input_path, charge_events_file);
+            const std::shared_ptr<interface_to_SE_groups_checkpoint> branch = std::make_shared<interface_to_SE_groups_checkpoint>(*checkpoint);
+            branch->SE_objs = icm_new->save_checkpoint()->SE_objs;
+
+            {
+                std::ifstream f(step_state_file, std::ios::in | std::ios::binary);
+                for( supply_equipment& SE : branch->SE_objs )
+                    SE.read_step_state(f);
+
+                assert_bool_true( f.peek() == std::ifstream::traits_type::eof(), "Error: the SEs did not read the whole step state file." );
+            }
+
+            icm_new->restore_checkpoint(branch);
+
+            const trajectory Y = run(*icm_new, checkpoint_step, num_steps);
+            assert_bool_true( Y == get_steps(reference, checkpoint_step, num_steps), "Error: the run after reading the step states at step " + std::to_string(checkpoint_step) + " differs." );
+        }
+
+        const trajectory X = run(*icm, step, num_steps);
+        assert_bool_true( X == get_steps(reference, step, num_steps), "Error: writing the step states changed the trajectory." );
+
+        // The step state of one SE can not be read into another, or from a truncated file.
+        std::vector<supply_equipment> SE_objs = icm->save_checkpoint()->SE_objs;
+
+        std::stringstream SE_0_state;
+        SE_objs[0].write_step_state(SE_0_state);
+
+        const auto is_rejected = [] ( supply_equipment& SE, const std::string& bytes )
+        {
+            std::stringstream in(bytes);
+
+            try
+            {
+                SE.read_step_state(in);
+            }
+            catch( const std::invalid_argument& )
+            {
+                return true;
+            }
+
+            return false;
+        };
+
+        const std::string bytes = SE_0_state.str();
+        assert_bool_true( is_rejected(SE_objs[1], bytes), "Error: an SE read the step state of another SE." );
+        assert_bool_true( is_rejected(SE_objs[0], bytes.substr(0, bytes.size()/2)), "Error: an SE read a truncated step state." );
+
+        return exit_code;
+    }
+
+    static int test_fork( const std::string& input_path, const std::filesystem::path& test_dir )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_fork" << std::endl;
+
+        const std::string charge_events_file = (test_dir / "charge_events.csv").string();
+        write_charge_events_file(charge_events_file);
+
+        const trajectory reference = run(*get_interface(input_path, charge_events_file), 0, num_steps);
+
+        // Forks at the same steps as the checkpoints.  Each fork runs to the end before the
+        // interface it was forked from goes on.
+        const std::vector<int> fork_steps = { 2*60, 280, 6*60, late_step };
+
+        std::unique_ptr<interface_to_SE_groups> icm = get_interface(input_path, charge_events_file);
+
+        int step = 0;
+        for( const int fork_step : fork_steps )
+        {
+            const trajectory X = run(*icm, step, fork_step);
+            assert_bool_true( X == get_steps(reference, step, fork_step), "Error: running a fork changed the interface it was forked from." );
+
+            if( fork_step == late_step )
+                icm->add_charge_events(get_late_charge_events());
+
+            std::unique_ptr<interface_to_SE_groups> icm_fork = icm->fork();
+            const trajectory Y = run(*icm_fork, fork_step, num_steps);
+            assert_bool_true( Y == get_steps(reference, fork_step, num_steps), "Error: the run of the fork at step " + std::to_string(fork_step) + " differs." );
+
+            step = fork_step;
+        }
+
+        const trajectory X = run(*icm, step, num_steps);
+        assert_bool_true( X == get_steps(reference, step, num_steps), "Error: running a fork changed the interface it was forked from." );
+
+        return exit_code;
+    }
+};
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+
+    const std::filesystem::path test_dir = std::filesystem::temp_directory_path() / "test_checkpoints";
+    std::filesystem::create_directories(test_dir);
+
+    int sum = 0;
+    sum += test_checkpoints::test_restore_checkpoint(input_path, test_dir);
+    sum += test_checkpoints::test_restore_into_new_interface(input_path, test_dir);
+    sum += test_checkpoints::test_step_state_file(input_path, test_dir);
+    sum += test_checkpoints::test_fork(input_path, test_dir);
+
+    std::filesystem::remove_all(test_dir);
+
+    if( sum == 0 )
+        std::cout << "Success." << std::endl;
+
+    return sum;
+}
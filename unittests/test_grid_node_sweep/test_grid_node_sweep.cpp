@@ -0,0 +1,403 @@
+#include "interface_test_fixture.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifdef _OPENMP
+#include <omp.h>                                    // omp_get_max_threads, omp_set_num_threads
+#endif
+
+// The sweep over registered grid nodes must give the same P and Q with one thread as with
+// several.  One grid node holds more SEs than a thread's share of the sweep, so with several
+// threads it is swept with its SEs split across the threads, and with one thread it is
+// handed out whole like the others.
+//
+// The charge events are uncontrolled, because the control strategies draw their random
+// numbers in the order the threads reach them.
+//
+// Over a day with varying voltages, get_charging_power_by_index, which steps only the SEs
+// with a PEV connected or about to arrive, must give the same P and Q as the map based
+// get_charging_power, which steps every SE.  The charge events leave long gaps, so SEs go
+// to sleep and are woken by the calendar, also for events added during the run.
+//
+// advance over N steps must give the same P and Q, step by step, as N calls of
+// get_charging_power_by_index at the same voltages, and must reject invalid arguments.
+
+
+class test_grid_node_sweep : private interface_test_fixture
+{
+private:
+
+    static const int num_steps = 12*60;
+    static const int num_threads = 4;
+
+    static std::vector<int> get_num_SEs_per_grid_node()
+    {
+        return { 24, 1, 2, 3, 4, 6 };
+    }
+
+    static std::vector<SE_configuration> get_sweep_SE_configurations()
+    {
+        const std::vector<int> num_SEs_per_grid_node = get_num_SEs_per_grid_node();
+        const std::vector<std::string> SE_types = get_SE_types();
+
+        std::vector<SE_configuration> SEs;
+        for( int i = 0; i < (int)num_SEs_per_grid_node.size(); i++ )
+        {
+            for( int j = 0; j < num_SEs_per_grid_node[i]; j++ )
+            {
+                const int SE_id = SEs.size() + 1;
+                SEs.push_back(SE_configuration{ 10, SE_id, SE_types[SE_id % 2 == 0 ? 0 : 2], 0, 0, get_grid_node_id(i), "home" });
+            }
+        }
+
+        return SEs;
+    }
+
+    // Back to back uncontrolled charge events with staggered arrivals.
+    static std::vector<charge_event_data> get_uncontrolled_charge_events( const int num_SEs )
+    {
+        const std::vector<std::string> EV_types = { "ld_50kWh", "ld_100kWh", "md_200kWh" };
+
+        control_strategy_enums control_enums;
+        control_enums.ES_control_strategy = L2_control_strategies_enum::NA;
+        control_enums.VS_control_strategy = L2_control_strategies_enum::NA;
+        control_enums.inverter_model_supports_Qsetpoint = false;
+        control_enums.ext_control_strategy = "NA";
+
+        std::vector<charge_event_data> charge_events;
+        int charge_event_id = 1;
+
+        for( int SE_id = 1; SE_id <= num_SEs; SE_id++ )
+        {
+            double arrival_unix_time = start_unix_time + 300*(SE_id % 7) + 0.5*3600;
+
+            for( int k = 0; k < 3; k++ )
+            {
+                const double departure_unix_time = arrival_unix_time + 3600*(1 + 0.5*k);
+
+                charge_events.emplace_back(charge_event_id++, 10, SE_id, 100 + SE_id, EV_types[(SE_id + k) % 3], arrival_unix_time, departure_unix_time,
+                                           10 + 5*k, 90, stop_charging_criteria{}, control_enums);
+
+                arrival_unix_time = departure_unix_time + 600;
+            }
+        }
+
+        return charge_events;
+    }
+
+    // Charge events of the fixture's SEs with two to four hour gaps between them.  The
+    // events arriving after split_unix_time are returned in late_charge_events.
+    static std::vector<charge_event_data> get_sleeping_charge_events( const double split_unix_time,
+                                                                      std::vector<charge_event_data>& late_charge_events )
+    {
+        const std::vector<std::string> EV_types = { "ld_50kWh", "ld_100kWh", "md_200kWh" };
+        const std::vector<L2_control_strategies_enum> ES_strategies = { L2_control_strategies_enum::NA, L2_control_strategies_enum::ES100_A, L2_control_strategies_enum::ES200 };
+        const std::vector<L2_control_strategies_enum> VS_strategies = { L2_control_strategies_enum::NA, L2_control_strategies_enum::VS100, L2_control_strategies_enum::VS300 };
+
+        std::vector<charge_event_data> charge_events;
+        late_charge_events.clear();
+        int charge_event_id = 1;
+
+        for( int SE_id = 1; SE_id <= num_grid_nodes*num_SEs_per_grid_node; SE_id++ )
+        {
+            double arrival_unix_time = start_unix_time + 900*(SE_id % 4) + 0.5*3600;
+
+            for( int k = 0; k < 4; k++ )
+            {
+                const int n = SE_id + k;
+
+                control_strategy_enums control_enums;
+                control_enums.ES_control_strategy = is_L2(SE_id) ? ES_strategies[n % 3] : L2_control_strategies_enum::NA;
+                control_enums.VS_control_strategy = (control_enums.ES_control_strategy != L2_control_strategies_enum::NA) ? VS_strategies[(n / 3) % 3] : L2_control_strategies_enum::NA;
+                control_enums.inverter_model_supports_Qsetpoint = (control_enums.VS_control_strategy == L2_control_strategies_enum::VS300);
+                control_enums.ext_control_strategy = "NA";
+
+                const double departure_unix_time = arrival_unix_time + 3600*(1 + 0.5*(n % 3));
+
+                const charge_event_data charge_event( charge_event_id++, 10, SE_id, 100 + SE_id, EV_types[n % 3], arrival_unix_time, departure_unix_time,
+                                                      10 + 5*k, 90, stop_charging_criteria{}, control_enums );
+
+                if( arrival_unix_time < split_unix_time )
+                    charge_events.push_back(charge_event);
+                else
+                    late_charge_events.push_back(charge_event);
+
+                arrival_unix_time = departure_unix_time + 3600*(2 + (n % 3));
+            }
+        }
+
+        return charge_events;
+    }
+
+    static std::unique_ptr<interface_to_SE_groups> get_interface( const std::string& input_path )
+    {
+        const std::vector<SE_configuration> SEs = get_sweep_SE_configurations();
+
+        std::unique_ptr<interface_to_SE_groups> icm = std::make_unique<interface_to_SE_groups>(input_path, get_interface_inputs(SEs, get_L2_control_strategy_parameters()));
+        icm->add_charge_events(get_uncontrolled_charge_events(SEs.size()));
+        icm->register_grid_nodes(get_grid_node_ids(get_num_SEs_per_grid_node().size()));
+
+        return icm;
+    }
+
+    static trajectory run_by_index( interface_to_SE_groups& icm )
+    {
+        const int num_nodes = icm.get_num_registered_grid_nodes();
+
+        std::vector<double> pu_Vrms(num_nodes);
+        std::vector<double> P3_kW(num_nodes);
+        std::vector<double> Q3_kVAR(num_nodes);
+        trajectory result;
+
+        for( int k = 0; k < num_steps; k++ )
+        {
+            const double prev_unix_time = start_unix_time + k*time_step_sec;
+            const double now_unix_time = prev_unix_time + time_step_sec;
+
+            get_pu_Vrms(k, 0, pu_Vrms);
+            icm.get_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+            result.add(P3_kW, Q3_kVAR);
+        }
+
+        return result;
+    }
+
+public:
+
+    static int test_thread_count( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_thread_count" << std::endl;
+
+#ifdef _OPENMP
+        const int max_threads = omp_get_max_threads();
+        omp_set_num_threads(1);
+#endif
+        const trajectory one_thread = run_by_index(*get_interface(input_path));
+
+#ifdef _OPENMP
+        omp_set_num_threads(num_threads);
+#endif
+        const trajectory several_threads = run_by_index(*get_interface(input_path));
+
+#ifdef _OPENMP
+        omp_set_num_threads(max_threads);
+#endif
+
+        double max_P3_kW = 0;
+        for( const double P3_kW : one_thread.P3_kW )
+            max_P3_kW = std::max(max_P3_kW, P3_kW);
+        assert_bool_true( max_P3_kW > 1, "Error: the run does not charge." );
+
+        assert_bool_true( one_thread == several_threads, "Error: the sweep with " + std::to_string(num_threads) + " threads differs from the sweep with one thread." );
+
+        return exit_code;
+    }
+
+    static int test_map_vs_index( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_map_vs_index" << std::endl;
+
+        // The control strategies draw their random numbers in the order the threads reach
+        // them, so both runs are stepped on one thread.
+#ifdef _OPENMP
+        const int max_threads = omp_get_max_threads();
+        omp_set_num_threads(1);
+#endif
+
+        const int num_day_steps = 24*3600/time_step_sec;
+        const int split_step = num_day_steps/2;
+        const double split_unix_time = start_unix_time + split_step*time_step_sec;
+
+        std::vector<charge_event_data> late_charge_events;
+        const std::vector<charge_event_data> charge_events = get_sleeping_charge_events(split_unix_time, late_charge_events);
+
+        interface_to_SE_groups icm_map{ input_path, get_interface_inputs() };
+        interface_to_SE_groups icm_index{ input_path, get_interface_inputs() };
+
+        icm_map.add_charge_events(charge_events);
+        icm_index.add_charge_events(charge_events);
+
+        const std::vector<grid_node_id_type> grid_node_ids = get_grid_node_ids(num_grid_nodes);
+        icm_index.register_grid_nodes(grid_node_ids);
+
+        std::vector<double> pu_Vrms(num_grid_nodes);
+        std::vector<double> P3_kW(num_grid_nodes);
+        std::vector<double> Q3_kVAR(num_grid_nodes);
+        std::map<grid_node_id_type, double> pu_Vrms_map;
+
+        double max_abs_diff = 0;
+        double max_P3_kW = 0;
+        int num_steps_charging = 0;
+        int num_steps_idle = 0;
+
+        for( int k = 0; k < num_day_steps; k++ )
+        {
+            const double prev_unix_time = start_unix_time + k*time_step_sec;
+            const double now_unix_time = prev_unix_time + time_step_sec;
+
+            // The rest of the events is added during the run, while their SEs sleep.
+            if( k == split_step )
+            {
+                icm_map.add_charge_events(late_charge_events);
+                icm_index.add_charge_events(late_charge_events);
+            }
+
+            get_pu_Vrms(k, -0.01, pu_Vrms);
+            for( int i = 0; i < num_grid_nodes; i++ )
+                pu_Vrms_map[grid_node_ids[i]] = pu_Vrms[i];
+
+            const std::map<grid_node_id_type, std::pair<double, double> > PQ = icm_map.get_charging_power(prev_unix_time, now_unix_time, pu_Vrms_map);
+            icm_index.get_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+
+            double total_P3_kW = 0;
+            for( int i = 0; i < num_grid_nodes; i++ )
+            {
+                const std::pair<double, double>& PQ_node = PQ.at(grid_node_ids[i]);
+
+                max_abs_diff = std::max(max_abs_diff, std::abs(PQ_node.first - P3_kW[i]));
+                max_abs_diff = std::max(max_abs_diff, std::abs(PQ_node.second - Q3_kVAR[i]));
+                total_P3_kW += P3_kW[i];
+            }
+
+            max_P3_kW = std::max(max_P3_kW, total_P3_kW);
+            if( total_P3_kW > 1 )
+                num_steps_charging++;
+            else
+                num_steps_idle++;
+        }
+
+#ifdef _OPENMP
+        omp_set_num_threads(max_threads);
+#endif
+
+        assert_bool_true( max_P3_kW > 1 && num_steps_charging > 0 && num_steps_idle > 0, "Error: the run does not both charge and idle." );
+
+        // The grid nodes add their SEs in a different order in the two sweeps.
+        assert_bool_true( max_abs_diff < 1e-9, "Error: get_charging_power_by_index differs from get_charging_power by " + std::to_string(max_abs_diff) + "." );
+
+        return exit_code;
+    }
+
+    static int test_advance( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        const auto throws_invalid_argument = [] ( const auto& f )
+        {
+            try
+            {
+                f();
+            }
+            catch( const std::invalid_argument& )
+            {
+                return true;
+            }
+            return false;
+        };
+
+        std::cout << "test_advance" << std::endl;
+
+        std::unique_ptr<interface_to_SE_groups> icm_advance = get_interface(input_path);
+        std::unique_ptr<interface_to_SE_groups> icm_by_index = get_interface(input_path);
+
+        const int num_nodes = icm_advance->get_num_registered_grid_nodes();
+
+        // advance holds the voltages constant over its steps.
+        std::vector<double> pu_Vrms(num_nodes);
+        get_pu_Vrms(0, -0.02, pu_Vrms);
+
+        const grid_nodes_advance_result result = icm_advance->advance(start_unix_time, num_steps, time_step_sec, pu_Vrms, true);
+
+        std::vector<double> P3_kW(num_nodes);
+        std::vector<double> Q3_kVAR(num_nodes);
+        std::vector<double> E3_kWh(num_nodes, 0.0);
+        trajectory by_index;
+
+        for( int k = 0; k < num_steps; k++ )
+        {
+            const double prev_unix_time = start_unix_time + k*time_step_sec;
+            const double now_unix_time = start_unix_time + (k+1)*time_step_sec;
+
+            icm_by_index->get_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+            by_index.add(P3_kW, Q3_kVAR);
+
+            for( int i = 0; i < num_nodes; i++ )
+                E3_kWh[i] += P3_kW[i] * (time_step_sec / 3600.0);
+        }
+
+        assert_bool_true( result.num_steps == num_steps && result.num_grid_nodes == num_nodes && result.has_time_series, "Error: the advance result has the wrong shape." );
+        assert_bool_true( result.P3_kW == by_index.P3_kW && result.Q3_kVAR == by_index.Q3_kVAR, "Error: advance differs from get_charging_power_by_index." );
+        assert_bool_true( result.E3_kWh == E3_kWh, "Error: the energy of advance differs from the sum of the get_charging_power_by_index steps." );
+
+        // Without a time series only the last step is returned.
+        const grid_nodes_advance_result last_step = icm_advance->advance(start_unix_time + num_steps*time_step_sec, 1, time_step_sec, pu_Vrms, false);
+        icm_by_index->get_charging_power_by_index(start_unix_time + num_steps*time_step_sec, start_unix_time + (num_steps + 1)*time_step_sec, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+        assert_bool_true( last_step.P3_kW == P3_kW && last_step.Q3_kVAR == Q3_kVAR, "Error: advance without a time series differs from get_charging_power_by_index." );
+
+        grid_nodes_advance_result X;
+        const double next_unix_time = start_unix_time + (num_steps + 1)*time_step_sec;
+
+        assert_bool_true( throws_invalid_argument([&] { icm_advance->advance(next_unix_time, -1, time_step_sec, pu_Vrms.data(), true, X); }), "Error: advance accepts a negative num_steps." );
+        assert_bool_true( throws_invalid_argument([&] { icm_advance->advance(next_unix_time, 1, 0, pu_Vrms.data(), true, X); }), "Error: advance accepts a zero time_step_sec." );
+        assert_bool_true( throws_invalid_argument([&] { icm_advance->advance(next_unix_time, 1, time_step_sec, nullptr, true, X); }), "Error: advance accepts no pu_Vrms." );
+        assert_bool_true( throws_invalid_argument([&] { icm_advance->advance(next_unix_time, 1, time_step_sec, std::vector<double>(num_nodes + 1, 1.0), true); }), "Error: advance accepts too many pu_Vrms." );
+
+        interface_to_SE_groups icm_unregistered{ input_path, get_interface_inputs(get_sweep_SE_configurations(), get_L2_control_strategy_parameters()) };
+        assert_bool_true( throws_invalid_argument([&] { icm_unregistered.advance(start_unix_time, 1, time_step_sec, pu_Vrms.data(), true, X); }), "Error: advance runs without registered grid nodes." );
+
+        return exit_code;
+    }
+};
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+
+    int sum = 0;
+    sum += test_grid_node_sweep::test_thread_count(input_path);
+    sum += test_grid_node_sweep::test_map_vs_index(input_path);
+    sum += test_grid_node_sweep::test_advance(input_path);
+
+    if( sum == 0 )
+        std::cout << "Success." << std::endl;
+
+    return sum;
+}
@@ -0,0 +1,519 @@
+#include "load_charge_events.h"
+#include "interface_test_fixture.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <string>
+#include <vector>
+
+// A file that load_charge_events rejects ends the process (ASSERT), so the rejection
+// tests load each file in a new process running this executable as:
+//
+//    test_load_charge_events load <charge_events_file>
+//
+// An interface reading its charge events from a file through set_charge_event_source must
+// give the same get_SE_power as an interface given all the events up front.
+//
+// A charge event with a vehicle type that is not in the inventory is reported and not
+// queued by add_charge_events and add_charge_events_by_SE_group, like one with an unknown
+// SE_id, without ending the process.
+
+
+class test_load_charge_events : private interface_test_fixture
+{
+private:
+
+    static std::vector<charge_event_data> get_charge_events()
+    {
+        std::vector<charge_event_data> charge_events;
+
+        for( int i = 0; i < 50; i++ )
+        {
+            charge_event_data CE;
+            CE.charge_event_id = i;
+            CE.SE_group_id = 1 + i % 3;
+            CE.SE_id = 100 + i % 7;
+            CE.vehicle_id = 1000 + i;
+            CE.vehicle_type = (i % 2 == 0) ? "bev250_ld2_300kW" : "phev_SUV";
+            CE.arrival_unix_time = 3600.0 + 123.456789*i;
+            CE.departure_unix_time = CE.arrival_unix_time + 7200.25;
+            CE.arrival_SOC = 10.0 + 0.1*i;
+            CE.departure_SOC = 95.0 - 0.3*i;
+            CE.stop_charge.decision_metric = (stop_charging_decision_metric)(i % 3);
+            CE.stop_charge.soc_mode = (stop_charging_mode)(i % 2);
+            CE.stop_charge.depart_time_mode = (stop_charging_mode)((i + 1) % 2);
+            CE.stop_charge.soc_block_charging_max_undershoot_percent = 50 - 0.5*i;
+            CE.stop_charge.depart_time_block_charging_max_undershoot_percent = 40 + 0.25*i;
+            charge_events.push_back(CE);
+        }
+
+        return charge_events;
+    }
+
+    static void write_CSV_file( const std::string& file_path, const std::vector<charge_event_data>& charge_events )
+    {
+        std::ofstream f(file_path, std::ios::out | std::ios::trunc);
+        f << std::setprecision(17);
+        f << charge_event_data::get_file_header() << std::endl;
+
+        for( const charge_event_data& CE : charge_events )
+            f << CE << std::endl;
+    }
+
+    static void write_text_file( const std::string& file_path, const std::string& text )
+    {
+        std::ofstream f(file_path, std::ios::out | std::ios::binary | std::ios::trunc);
+        f << text;
+    }
+
+    static bool are_equal( const charge_event_data& A, const charge_event_data& B )
+    {
+        return A.charge_event_id == B.charge_event_id &&
+               A.SE_group_id == B.SE_group_id &&
+               A.SE_id == B.SE_id &&
+               A.vehicle_id == B.vehicle_id &&
+               A.vehicle_type == B.vehicle_type &&
+               A.arrival_unix_time == B.arrival_unix_time &&
+               A.departure_unix_time == B.departure_unix_time &&
+               A.arrival_SOC == B.arrival_SOC &&
+               A.departure_SOC == B.departure_SOC &&
+               A.stop_charge.decision_metric == B.stop_charge.decision_metric &&
+               A.stop_charge.soc_mode == B.stop_charge.soc_mode &&
+               A.stop_charge.depart_time_mode == B.stop_charge.depart_time_mode &&
+               A.stop_charge.soc_block_charging_max_undershoot_percent == B.stop_charge.soc_block_charging_max_undershoot_percent &&
+               A.stop_charge.depart_time_block_charging_max_undershoot_percent == B.stop_charge.depart_time_block_charging_max_undershoot_percent &&
+               A.arrival_battery_temperature_C == B.arrival_battery_temperature_C &&
+               A.control_enums.inverter_model_supports_Qsetpoint == B.control_enums.inverter_model_supports_Qsetpoint &&
+               A.control_enums.ES_control_strategy == B.control_enums.ES_control_strategy &&
+               A.control_enums.VS_control_strategy == B.control_enums.VS_control_strategy &&
+               A.control_enums.ext_control_strategy == B.control_enums.ext_control_strategy;
+    }
+
+    static bool are_equal( const std::vector<charge_event_data>& A, const std::vector<charge_event_data>& B )
+    {
+        if( A.size() != B.size() )
+            return false;
+
+        for( int i = 0; i < (int)A.size(); i++ )
+        {
+            if( !are_equal(A[i], B[i]) )
+                return false;
+        }
+
+        return true;
+    }
+
+    static bool is_rejected( const std::string& test_executable, const std::string& file_path )
+    {
+        const std::string command = "\"" + test_executable + "\" load \"" + file_path + "\"";
+        return std::system(command.c_str()) != 0;
+    }
+
+    // The columns of a valid CSV line, see charge_event_data::get_file_header.
+    static std::vector<std::string> get_valid_fields()
+    {
+        return { "1", "10", "100", "1000", "bev250_ld2_300kW", "3600", "7200", "20", "80",
+                 "stop_charging_using_target_soc", "target_charging", "block_charging", "50", "40" };
+    }
+
+    static std::string to_CSV_line( const std::vector<std::string>& fields )
+    {
+        std::string line;
+        for( int i = 0; i < (int)fields.size(); i++ )
+            line += (i == 0 ? "" : ",") + fields[i];
+        return line + "\n";
+    }
+
+public:
+
+    static int test_round_trip( const std::filesystem::path& test_dir )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_round_trip" << std::endl;
+
+        const std::vector<charge_event_data> charge_events = get_charge_events();
+        const std::string CSV_file = (test_dir / "charge_events.csv").string();
+        const std::string binary_file = (test_dir / "charge_events.bin").string();
+
+        write_CSV_file(CSV_file, charge_events);
+        load_charge_events::write_binary_file(binary_file, charge_events);
+
+        for( const std::string& file_path : { CSV_file, binary_file } )
+        {
+            // Read in windows, the way the interface reads within its lookahead.
+            load_charge_events loader{ file_path };
+            std::vector<charge_event_data> loaded;
+
+            for( double unix_time = 0; loader.has_next(); unix_time += 1000 )
+            {
+                loader.read_until(unix_time, loaded);
+                assert_bool_true( loaded.empty() || loaded.back().arrival_unix_time <= unix_time, file_path + ": read past the window." );
+                assert_bool_true( loader.get_next_arrival_unix_time() > unix_time, file_path + ": event left behind in the window." );
+            }
+
+            assert_bool_true( are_equal(loaded, charge_events), file_path + ": charge events differ from the ones written." );
+            assert_bool_true( loader.get_next_arrival_unix_time() == std::numeric_limits<double>::max(), file_path + ": next arrival time after the last event." );
+        }
+
+        // CSV converted to binary reads back the same.
+        {
+            load_charge_events CSV_loader{ CSV_file };
+            std::vector<charge_event_data> loaded_CSV;
+            CSV_loader.read_until(std::numeric_limits<double>::max(), loaded_CSV);
+
+            const std::string converted_file = (test_dir / "converted.bin").string();
+            load_charge_events::write_binary_file(converted_file, loaded_CSV);
+
+            load_charge_events binary_loader{ converted_file };
+            std::vector<charge_event_data> loaded_binary;
+            binary_loader.read_until(std::numeric_limits<double>::max(), loaded_binary);
+
+            assert_bool_true( are_equal(loaded_CSV, loaded_binary), "CSV converted to binary differs." );
+        }
+
+        // The binary format also keeps the fields the CSV has no columns for.
+        {
+            std::vector<charge_event_data> controlled_charge_events = get_charge_events();
+            for( int i = 0; i < (int)controlled_charge_events.size(); i++ )
+            {
+                charge_event_data& CE = controlled_charge_events[i];
+                CE.arrival_battery_temperature_C = -10.0 + 0.75*i;
+                CE.control_enums.inverter_model_supports_Qsetpoint = (i % 2 == 0);
+                CE.control_enums.ES_control_strategy = (i % 3 == 0) ? L2_control_strategies_enum::NA : L2_control_strategies_enum::ES500;
+                CE.control_enums.VS_control_strategy = (i % 4 == 0) ? L2_control_strategies_enum::NA : L2_control_strategies_enum::VS300;
+                CE.control_enums.ext_control_strategy = (i % 5 == 0) ? "NA" : "ext" + std::to_string(i);
+            }
+
+            const std::string file_path = (test_dir / "controlled.bin").string();
+            load_charge_events::write_binary_file(file_path, controlled_charge_events);
+
+            load_charge_events loader{ file_path };
+            std::vector<charge_event_data> loaded;
+            loader.read_until(std::numeric_limits<double>::max(), loaded);
+
+            assert_bool_true( are_equal(loaded, controlled_charge_events), "Binary file: battery temperatures or control strategies differ from the ones written." );
+        }
+
+        // Blank lines and spaces around the fields are accepted.
+        {
+            const std::string file_path = (test_dir / "spaces.csv").string();
+            write_text_file(file_path, charge_event_data::get_file_header() + "\n\n" + to_CSV_line({ " 1", "10 ", "100", "1000", "bev250_ld2_300kW", " 3600 ", "7200", "20", "80",
+                                                                                                        "stop_charging_using_target_soc", "target_charging", "block_charging", "50", "40\r" }) + "\n");
+
+            load_charge_events loader{ file_path };
+            std::vector<charge_event_data> loaded;
+            loader.read_until(std::numeric_limits<double>::max(), loaded);
+            assert_bool_true( loaded.size() == 1 && loaded[0].charge_event_id == 1 && loaded[0].arrival_unix_time == 3600, "Spaces around the fields are not accepted." );
+        }
+
+        return exit_code;
+    }
+
+    static int test_save_restore_position( const std::filesystem::path& test_dir )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_save_restore_position" << std::endl;
+
+        const std::vector<charge_event_data> charge_events = get_charge_events();
+        const std::string CSV_file = (test_dir / "charge_events.csv").string();
+        const std::string no_trailing_newline_file = (test_dir / "no_trailing_newline.csv").string();
+        const std::string binary_file = (test_dir / "charge_events.bin").string();
+
+        write_CSV_file(CSV_file, charge_events);
+        load_charge_events::write_binary_file(binary_file, charge_events);
+
+        // The last line ends at the end of the file, with no newline.
+        {
+            std::ifstream f(CSV_file, std::ios::in | std::ios::binary);
+            std::string text((std::istreambuf_iterator<char>(f)), std::istreambuf_iterator<char>());
+            while( !text.empty() && (text.back() == '\n' || text.back() == '\r') )
+                text.pop_back();
+            write_text_file(no_trailing_newline_file, text);
+        }
+
+        for( const std::string& file_path : { CSV_file, no_trailing_newline_file, binary_file } )
+        {
+            // Save after k events, read to the end, restore and read to the end again, in
+            // the same reader and in a new one.
+            for( int k = 0; k <= (int)charge_events.size(); k++ )
+            {
+                load_charge_events loader{ file_path };
+                std::vector<charge_event_data> loaded;
+                if( k > 0 )
+                    loader.read_until(charge_events[k-1].arrival_unix_time, loaded);
+
+                const load_charge_events_position position = loader.get_position();
+
+                std::vector<charge_event_data> remaining;
+                loader.read_until(std::numeric_limits<double>::max(), remaining);
+
+                const std::vector<charge_event_data> expected(charge_events.begin() + k, charge_events.end());
+                assert_bool_true( (int)loaded.size() == k && are_equal(remaining, expected), file_path + ": wrong events before saving after " + std::to_string(k) + " events." );
+
+                loader.set_position(position);
+                std::vector<charge_event_data> restored;
+                loader.read_until(std::numeric_limits<double>::max(), restored);
+                assert_bool_true( are_equal(restored, expected), file_path + ": restoring the same reader after " + std::to_string(k) + " events differs." );
+
+                load_charge_events new_loader{ file_path };
+                new_loader.set_position(position);
+                std::vector<charge_event_data> new_restored;
+                new_loader.read_until(std::numeric_limits<double>::max(), new_restored);
+                assert_bool_true( are_equal(new_restored, expected), file_path + ": restoring a new reader after " + std::to_string(k) + " events differs." );
+            }
+        }
+
+        return exit_code;
+    }
+
+    static int test_get_SE_power_stream( const std::string& input_path, const std::filesystem::path& test_dir )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_get_SE_power_stream" << std::endl;
+
+        const int num_steps = 12*60;
+        const double lookahead_sec = 600;
+
+        std::vector<charge_event_data> charge_events = interface_test_fixture::get_charge_events();
+        std::stable_sort(charge_events.begin(), charge_events.end(), [] ( const charge_event_data& A, const charge_event_data& B )
+        {
+            return A.arrival_unix_time < B.arrival_unix_time;
+        });
+
+        const std::string file_path = (test_dir / "SE_power.bin").string();
+        load_charge_events::write_binary_file(file_path, charge_events);
+
+        interface_to_SE_groups icm_up_front{ input_path, get_interface_inputs() };
+        interface_to_SE_groups icm_stream{ input_path, get_interface_inputs() };
+
+        icm_up_front.add_charge_events(charge_events);
+        icm_stream.set_charge_event_source(file_path, lookahead_sec);
+
+        const int num_SEs = num_grid_nodes*num_SEs_per_grid_node;
+        bool is_same = true;
+        double max_P3_kW = 0;
+
+        for( int k = 0; k < num_steps; k++ )
+        {
+            const double prev_unix_time = start_unix_time + k*time_step_sec;
+            const double now_unix_time = prev_unix_time + time_step_sec;
+            const double pu_Vrms = 0.98 + 0.03*std::sin(0.01*k);
+
+            for( int SE_id = 1; SE_id <= num_SEs; SE_id++ )
+            {
+                const SE_power up_front = icm_up_front.get_SE_power(SE_id, prev_unix_time, now_unix_time, pu_Vrms);
+                const SE_power stream = icm_stream.get_SE_power(SE_id, prev_unix_time, now_unix_time, pu_Vrms);
+
+                is_same = is_same && up_front.P3_kW == stream.P3_kW && up_front.Q3_kVAR == stream.Q3_kVAR && up_front.soc == stream.soc;
+                max_P3_kW = std::max(max_P3_kW, up_front.P3_kW);
+            }
+        }
+
+        assert_bool_true( max_P3_kW > 1, "Error: the run does not charge." );
+        assert_bool_true( is_same, "Error: get_SE_power with the charge events streamed from a file differs from the charge events added up front." );
+
+        return exit_code;
+    }
+
+    static int test_unknown_vehicle_type( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_unknown_vehicle_type" << std::endl;
+
+        const std::vector<charge_event_data> charge_events = interface_test_fixture::get_charge_events();
+
+        charge_event_data unknown_CE = charge_events[1];
+        unknown_CE.vehicle_type = "not_an_EV";
+
+        interface_to_SE_groups icm{ input_path, get_interface_inputs() };
+
+        icm.add_charge_events({ charge_events[0] });
+        icm.add_charge_events({ unknown_CE });
+        icm.add_charge_events_by_SE_group({ SE_group_charge_event_data{ unknown_CE.SE_group_id, { unknown_CE } } });
+
+        assert_bool_true( icm.get_charge_event_queue_memory_usage().num_queued_charge_events == 1, "Error: a charge event with an unknown vehicle type is queued." );
+
+        icm.add_charge_events({ charge_events[1] });
+        assert_bool_true( icm.get_charge_event_queue_memory_usage().num_queued_charge_events == 2, "Error: charge events are not queued after one with an unknown vehicle type." );
+
+        return exit_code;
+    }
+
+    static int test_rejected_files( const std::filesystem::path& test_dir, const std::string& test_executable )
+    {
+        int exit_code = 0;
+
+        std::cout << "test_rejected_files (each rejected file prints its assertion)" << std::endl;
+
+        const std::string header = charge_event_data::get_file_header() + "\n";
+        const std::string valid_line = to_CSV_line(get_valid_fields());
+
+        std::vector<std::pair<std::string, std::string> > files;    // {name, contents}
+
+        const auto add_invalid_field = [&] ( const std::string& name, const int column, const std::string& value )
+        {
+            std::vector<std::string> fields = get_valid_fields();
+            fields[column] = value;
+            files.push_back({ name, header + valid_line + to_CSV_line(fields) });
+        };
+
+        add_invalid_field("trailing_garbage_int.csv", 0, "12abc");
+        add_invalid_field("trailing_garbage_double.csv", 7, "1.5x");
+        add_invalid_field("empty_number.csv", 2, "");
+        add_invalid_field("not_a_number.csv", 5, "noon");
+        add_invalid_field("two_numbers.csv", 6, "7200 7300");
+        add_invalid_field("invalid_decision_metric.csv", 9, "stop_charging_when_full");
+        add_invalid_field("invalid_soc_mode.csv", 10, "trickle_charging");
+        add_invalid_field("departure_before_arrival.csv", 6, "3000");
+        add_invalid_field("arrival_SOC_above_100.csv", 7, "120");
+        add_invalid_field("departure_SOC_below_0.csv", 8, "-1");
+
+        std::vector<std::string> fields = get_valid_fields();
+        fields.pop_back();
+        files.push_back({ "missing_column.csv", header + to_CSV_line(fields) });
+
+        fields = get_valid_fields();
+        fields[5] = "1800";
+        files.push_back({ "not_sorted.csv", header + valid_line + to_CSV_line(fields) });
+
+        files.push_back({ "wrong_header.csv", "charge_event_id,SE_group_id\n" + valid_line });
+
+        for( const std::pair<std::string, std::string>& X : files )
+        {
+            const std::string file_path = (test_dir / X.first).string();
+            write_text_file(file_path, X.second);
+
+            if( !is_rejected(test_executable, file_path) )
+            {
+                exit_code++;
+                std::cout << "Error: " << X.first << " was not rejected." << std::endl;
+            }
+        }
+
+        // A truncated binary file.
+        {
+            const std::string file_path = (test_dir / "truncated.bin").string();
+            load_charge_events::write_binary_file(file_path, get_charge_events());
+            std::filesystem::resize_file(file_path, std::filesystem::file_size(file_path) - 5);
+
+            if( !is_rejected(test_executable, file_path) )
+            {
+                exit_code++;
+                std::cout << "Error: truncated.bin was not rejected." << std::endl;
+            }
+        }
+
+        // A binary file with a control strategy that is not an energy shifting strategy.
+        {
+            std::vector<charge_event_data> charge_events = get_charge_events();
+            charge_events.back().control_enums.ES_control_strategy = L2_control_strategies_enum::VS100;
+
+            const std::string file_path = (test_dir / "invalid_control_strategy.bin").string();
+            load_charge_events::write_binary_file(file_path, charge_events);
+
+            if( !is_rejected(test_executable, file_path) )
+            {
+                exit_code++;
+                std::cout << "Error: invalid_control_strategy.bin was not rejected." << std::endl;
+            }
+        }
+
+        // A binary file of the first version, which had no battery temperatures or control
+        // strategies.
+        {
+            const std::string file_path = (test_dir / "old_version.bin").string();
+            write_text_file(file_path, std::string("CLDRACE1") + std::string(64, '\0'));
+
+            if( !is_rejected(test_executable, file_path) )
+            {
+                exit_code++;
+                std::cout << "Error: old_version.bin was not rejected." << std::endl;
+            }
+        }
+
+        // The valid line alone is accepted, so the files above fail for the intended reason.
+        {
+            const std::string file_path = (test_dir / "valid.csv").string();
+            write_text_file(file_path, header + valid_line);
+
+            if( is_rejected(test_executable, file_path) )
+            {
+                exit_code++;
+                std::cout << "Error: valid.csv was rejected." << std::endl;
+            }
+        }
+
+        return exit_code;
+    }
+};
+
+
+int main(int argc, char* argv[])
+{
+    if( argc == 3 && std::string(argv[1]) == "load" )
+    {
+        load_charge_events loader{ argv[2] };
+        std::vector<charge_event_data> charge_events;
+        loader.read_until(std::numeric_limits<double>::max(), charge_events);
+        return 0;
+    }
+
+    const std::filesystem::path test_dir = std::filesystem::temp_directory_path() / "test_load_charge_events";
+    std::filesystem::create_directories(test_dir);
+
+    int sum = 0;
+    sum += test_load_charge_events::test_round_trip(test_dir);
+    sum += test_load_charge_events::test_save_restore_position(test_dir);
+    sum += test_load_charge_events::test_rejected_files(test_dir, argv[0]);
+    sum += test_load_charge_events::test_get_SE_power_stream("../../inputs/eMosaic", test_dir);
+    sum += test_load_charge_events::test_unknown_vehicle_type("../../inputs/eMosaic");
+
+    std::filesystem::remove_all(test_dir);
+    return sum;
+}
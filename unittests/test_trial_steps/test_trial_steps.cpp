@@ -0,0 +1,136 @@
+#include "interface_test_fixture.h"
+
+#include <cmath>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Trial steps (get_trial_charging_power_by_index) must not change the simulation:
+//
+//    - any number of trials followed by rollback_trial_step and get_charging_power_by_index
+//      gives the same P and Q as get_charging_power_by_index alone.
+//    - commit_trial_step after a trial gives the same P and Q, and the same following
+//      steps, as get_charging_power_by_index with the voltages of the last trial.
+//
+// The SEs and charge events of interface_test_fixture step the charge models, converters,
+// control strategies and charge event queues in the trials.
+
+
+class test_trial_steps : private interface_test_fixture
+{
+private:
+
+    static const int num_steps = 12*60;
+
+    static std::unique_ptr<interface_to_SE_groups> get_interface( const std::string& input_path )
+    {
+        std::unique_ptr<interface_to_SE_groups> icm = std::make_unique<interface_to_SE_groups>(input_path, get_interface_inputs());
+        icm->add_charge_events(get_charge_events());
+        icm->register_grid_nodes(get_grid_node_ids(num_grid_nodes));
+
+        return icm;
+    }
+
+    enum class trial_mode
+    {
+        no_trials,
+        trials_then_rollback,
+        one_trial_then_commit,
+        trials_then_commit
+    };
+
+    static trajectory run( const std::string& input_path, const trial_mode mode )
+    {
+        std::unique_ptr<interface_to_SE_groups> icm = get_interface(input_path);
+
+        std::vector<double> pu_Vrms(num_grid_nodes);
+        std::vector<double> P3_kW(num_grid_nodes);
+        std::vector<double> Q3_kVAR(num_grid_nodes);
+        trajectory result;
+
+        for( int k = 0; k < num_steps; k++ )
+        {
+            const double prev_unix_time = start_unix_time + k*time_step_sec;
+            const double now_unix_time = prev_unix_time + time_step_sec;
+
+            if( mode == trial_mode::trials_then_rollback || mode == trial_mode::trials_then_commit )
+            {
+                for( const double offset : { 0.04, -0.08, 0.01 } )
+                {
+                    get_pu_Vrms(k, offset, pu_Vrms);
+                    icm->get_trial_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+                }
+            }
+
+            get_pu_Vrms(k, 0, pu_Vrms);
+
+            if( mode == trial_mode::no_trials )
+            {
+                icm->get_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+            }
+            else if( mode == trial_mode::trials_then_rollback )
+            {
+                icm->rollback_trial_step();
+                icm->get_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+            }
+            else
+            {
+                icm->get_trial_charging_power_by_index(prev_unix_time, now_unix_time, pu_Vrms.data(), P3_kW.data(), Q3_kVAR.data());
+                icm->commit_trial_step();
+            }
+
+            result.add(P3_kW, Q3_kVAR);
+        }
+
+        return result;
+    }
+
+public:
+
+    static int test_trials( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_trials" << std::endl;
+
+        const trajectory reference = run(input_path, trial_mode::no_trials);
+
+        double max_P3_kW = 0;
+        double max_abs_Q3_kVAR = 0;
+        for( int i = 0; i < (int)reference.P3_kW.size(); i++ )
+        {
+            max_P3_kW = std::max(max_P3_kW, reference.P3_kW[i]);
+            max_abs_Q3_kVAR = std::max(max_abs_Q3_kVAR, std::abs(reference.Q3_kVAR[i]));
+        }
+        assert_bool_true( max_P3_kW > 1 && max_abs_Q3_kVAR > 0, "Error: the reference run does not charge or has no reactive power." );
+
+        assert_bool_true( run(input_path, trial_mode::trials_then_rollback) == reference, "Error: trials and rollback_trial_step changed the trajectory." );
+        assert_bool_true( run(input_path, trial_mode::one_trial_then_commit) == reference, "Error: commit_trial_step after one trial differs from get_charging_power_by_index." );
+        assert_bool_true( run(input_path, trial_mode::trials_then_commit) == reference, "Error: commit_trial_step after several trials differs from get_charging_power_by_index." );
+
+        return exit_code;
+    }
+};
+
+
+int main(int argc, char* argv[])
+{
+    const std::string input_path = (argc > 1) ? argv[1] : "../../inputs/eMosaic";
+
+    int sum = 0;
+    sum += test_trial_steps::test_trials(input_path);
+
+    if( sum == 0 )
+        std::cout << "Success." << std::endl;
+
+    return sum;
+}
@@ -0,0 +1,130 @@
+#include "load_EV_EVSE_inventory.h"
+#include "factory_SOC_vs_P2.h"
+#include "factory_P2_vs_battery_efficiency.h"
+#include "factory_charging_transitions.h"
+#include "charge_profile_library.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+// The lookups by EV_type_id / EVSE_type_id must give the same curves, transitions and
+// charge profiles as the lookups by EV_type / EVSE_type, for every (EV, EVSE) combination
+// of every input set.
+
+
+class test_type_ids
+{
+private:
+
+    static bool is_same_curve( const std::vector<line_segment>& lhs, const std::vector<line_segment>& rhs )
+    {
+        if( lhs.size() != rhs.size() )
+            return false;
+
+        for( int i = 0; i < (int)lhs.size(); i++ )
+        {
+            if( lhs[i].x_LB != rhs[i].x_LB || lhs[i].x_UB != rhs[i].x_UB || lhs[i].a != rhs[i].a || lhs[i].b != rhs[i].b )
+                return false;
+        }
+
+        return true;
+    }
+
+public:
+
+    static int test_input_set( const std::string& input_path )
+    {
+        int exit_code = 0;
+
+        const auto assert_bool_true = [&exit_code] ( const bool b, const std::string error_msg_if_false )
+        {
+            if( !b )
+            {
+                exit_code++;
+                std::cout << error_msg_if_false << std::endl;
+            }
+        };
+
+        std::cout << "test_input_set " << input_path << std::endl;
+
+        load_EV_EVSE_inventory load_inventory{ input_path };
+        const EV_EVSE_inventory& inventory = load_inventory.get_EV_EVSE_inventory();
+
+        const std::vector<EV_type> EVs = inventory.get_all_EVs();
+        const std::vector<EVSE_type> EVSEs = inventory.get_all_EVSEs();
+
+        assert_bool_true( !EVs.empty() && !inventory.get_all_compatible_pev_SE_combinations().empty(), "Error: the inventory is empty." );
+        assert_bool_true( inventory.get_num_EV_types() == (int)EVs.size() && inventory.get_num_EVSE_types() == (int)EVSEs.size(), "Error: the number of type ids differs from the inventory." );
+        assert_bool_true( inventory.get_EV_type_id("not_an_EV") == -1 && inventory.get_EVSE_type_id("not_an_EVSE") == -1, "Error: an unknown type has an id." );
+
+        const factory_SOC_vs_P2 SOC_vs_P2_obj{ inventory };
+        const factory_P2_vs_battery_efficiency P2_vs_battery_eff_obj{ inventory };
+        const factory_charging_transitions charging_transitions_obj{ inventory, EV_ramping_map{}, EV_EVSE_ramping_map{} };
+
+        // Every compatible pair gets a profile through the string interface.
+        pev_charge_profile_library library{ inventory };
+        for( const pev_SE_pair& pev_SE : inventory.get_all_compatible_pev_SE_combinations() )
+            library.add_charge_profile_to_library(pev_SE.ev_type, pev_SE.se_type, pev_charge_profile{});
+
+        for( const EV_type& EV : EVs )
+        {
+            const EV_type_id EV_id = inventory.get_EV_type_id(EV);
+            const std::string EV_msg = " (EV_type:" + EV + ")";
+
+            assert_bool_true( EV_id >= 0 && inventory.get_EV_type(EV_id) == EV, "Error: the EV type id does not map back to its type." + EV_msg );
+
+            for( const battery_charge_mode mode : { battery_charge_mode::charging, battery_charge_mode::discharging } )
+            {
+                const P2_vs_battery_efficiency& by_type = P2_vs_battery_eff_obj.get_P2_vs_battery_eff(EV, mode);
+                const P2_vs_battery_efficiency& by_id = P2_vs_battery_eff_obj.get_P2_vs_battery_eff(EV_id, mode);
+
+                assert_bool_true( is_same_curve({ by_type.curve }, { by_id.curve }) && by_type.zero_slope_threshold == by_id.zero_slope_threshold,
+                                  "Error: P2_vs_battery_efficiency by id differs from by type." + EV_msg );
+            }
+
+            for( const EVSE_type& EVSE : EVSEs )
+            {
+                const EVSE_type_id EVSE_id = inventory.get_EVSE_type_id(EVSE);
+                const std::string msg = " (EV_type:" + EV + "  SE_type:" + EVSE + ")";
+
+                assert_bool_true( EVSE_id >= 0 && inventory.get_EVSE_type(EVSE_id) == EVSE, "Error: the EVSE type id does not map back to its type." + msg );
+                assert_bool_true( inventory.get_EVSE_level(EVSE_id) == inventory.get_EVSE_inventory().at(EVSE).get_level(), "Error: the EVSE level by id differs from by type." + msg );
+
+                const bool is_compatible = inventory.pev_is_compatible_with_supply_equipment(pev_SE_pair{ EV, EVSE });
+                assert_bool_true( inventory.pev_is_compatible_with_supply_equipment(EV_id, EVSE_id) == is_compatible, "Error: the compatibility by id differs from by type." + msg );
+
+                assert_bool_true( library.has_charge_profile(EV_id, EVSE_id) == library.has_charge_profile(EV, EVSE), "Error: has_charge_profile by id differs from by type." + msg );
+
+                if( !is_compatible )
+                    continue;
+
+                assert_bool_true( &library.get_charge_profile(EV_id, EVSE_id) == &library.get_charge_profile(EV, EVSE), "Error: the charge profile by id differs from by type." + msg );
+                assert_bool_true( &charging_transitions_obj.get_charging_transitions(EV_id, EVSE_id) == &charging_transitions_obj.get_charging_transitions(EV, EVSE), "Error: the charging transitions by id differ from by type." + msg );
+
+                const SOC_vs_P2& by_type = SOC_vs_P2_obj.get_SOC_vs_P2_curves(EV, EVSE, 25, 20);
+                const SOC_vs_P2& by_id = SOC_vs_P2_obj.get_SOC_vs_P2_curves(EV_id, EVSE_id, 25, 20);
+
+                assert_bool_true( !by_id.curve.empty() && is_same_curve(by_type.curve, by_id.curve) && by_type.zero_slope_threshold == by_id.zero_slope_threshold,
+                                  "Error: SOC_vs_P2 by id differs from by type." + msg );
+            }
+        }
+
+        return exit_code;
+    }
+};
+
+
+int main(int argc, char* argv[])
+{
+    const std::string inputs_path = (argc > 1) ? argv[1] : "../../inputs";
+
+    int sum = 0;
+    for( const std::string input_set : { "eMosaic", "DirectXFC", "EVs_at_Risk" } )
+        sum += test_type_ids::test_input_set(inputs_path + "/" + input_set);
+
+    if( sum == 0 )
+        std::cout << "Success." << std::endl;
+
+    return sum;
+}